@@ -0,0 +1,176 @@
+#include "AccessorView.h"
+
+#include <emmintrin.h>
+
+#include <cassert>
+#include <cstring>
+
+krt::hlp::AccessorView::AccessorView()
+    : m_Data(nullptr)
+    , m_Count(0)
+    , m_ElementSize(0)
+    , m_Stride(0)
+    , m_ComponentType(fx::gltf::Accessor::ComponentType::None)
+{
+}
+
+krt::hlp::AccessorView::AccessorView(const void* a_Data, uint64_t a_Count, uint32_t a_ElementSize, uint32_t a_Stride,
+    fx::gltf::Accessor::ComponentType a_ComponentType)
+    : m_Data(static_cast<const uint8_t*>(a_Data))
+    , m_Count(a_Count)
+    , m_ElementSize(a_ElementSize)
+    , m_Stride(a_Stride)
+    , m_ComponentType(a_ComponentType)
+{
+}
+
+krt::hlp::AccessorView krt::hlp::AccessorView::Slice(uint64_t a_First, uint64_t a_Count) const
+{
+    assert(a_First + a_Count <= m_Count);
+    return AccessorView(m_Data + a_First * m_Stride, a_Count, m_ElementSize, m_Stride, m_ComponentType);
+}
+
+uint32_t krt::hlp::AccessorView::GetElementSize(const fx::gltf::Accessor& a_Accessor)
+{
+    return GetComponentCount(a_Accessor) * GetComponentSize(a_Accessor);
+}
+
+uint32_t krt::hlp::AccessorView::GetComponentCount(const fx::gltf::Accessor& a_Accessor)
+{
+    switch (a_Accessor.type)
+    {
+    case fx::gltf::Accessor::Type::Scalar:
+        return 1;
+    case fx::gltf::Accessor::Type::Vec2:
+        return 2;
+    case fx::gltf::Accessor::Type::Vec3:
+        return 3;
+    case fx::gltf::Accessor::Type::Vec4:
+    case fx::gltf::Accessor::Type::Mat2:
+        return 4;
+    case fx::gltf::Accessor::Type::Mat3:
+        return 9;
+    case fx::gltf::Accessor::Type::Mat4:
+        return 16;
+    default:
+        assert(0 && "Failed to load GLTF file.");
+        return 0;
+    }
+}
+
+uint32_t krt::hlp::AccessorView::GetComponentSize(const fx::gltf::Accessor& a_Accessor)
+{
+    switch (a_Accessor.componentType)
+    {
+    case fx::gltf::Accessor::ComponentType::Byte:
+    case fx::gltf::Accessor::ComponentType::UnsignedByte:
+        return 1;
+    case fx::gltf::Accessor::ComponentType::Short:
+    case fx::gltf::Accessor::ComponentType::UnsignedShort:
+        return 2;
+    case fx::gltf::Accessor::ComponentType::Float:
+    case fx::gltf::Accessor::ComponentType::UnsignedInt:
+        return 4;
+    default:
+        assert(0 && "Failed to load GLTF file.");
+        return 0;
+    }
+}
+
+void krt::hlp::AccessorView::CopyTo(void* a_Destination) const
+{
+    auto destination = static_cast<uint8_t*>(a_Destination);
+
+    if (!m_Data)
+    {
+        memset(destination, 0, GetSizeInBytes());
+        return;
+    }
+
+    if (IsTightlyPacked())
+    {
+        memcpy(destination, m_Data, GetSizeInBytes());
+        return;
+    }
+
+    // The common vertex attribute sizes get a dedicated gather loop, where each element is a single load and store
+    switch (m_ElementSize)
+    {
+    case 4:
+        Gather<4>(destination);
+        break;
+    case 8:
+        Gather<8>(destination);
+        break;
+    case 16:
+        Gather<16>(destination);
+        break;
+    case 12:
+        if (m_Stride >= 16)
+        {
+            GatherVec3(destination);
+            break;
+        }
+        [[fallthrough]];
+    default:
+        for (uint64_t i = 0; i < m_Count; i++)
+            memcpy(destination + i * m_ElementSize, m_Data + i * m_Stride, m_ElementSize);
+        break;
+    }
+}
+
+void krt::hlp::AccessorView::CopyElementTo(uint64_t a_Index, void* a_Destination) const
+{
+    assert(a_Index < m_Count);
+
+    if (m_Data)
+        memcpy(a_Destination, m_Data + a_Index * m_Stride, m_ElementSize);
+    else
+        memset(a_Destination, 0, m_ElementSize);
+}
+
+void krt::hlp::AccessorView::CopyTo(void* a_Destination, uint32_t a_DestinationStride) const
+{
+    assert(a_DestinationStride >= m_ElementSize);
+    auto destination = static_cast<uint8_t*>(a_Destination);
+
+    for (uint64_t i = 0; i < m_Count; i++)
+    {
+        if (m_Data)
+            memcpy(destination + i * a_DestinationStride, m_Data + i * m_Stride, m_ElementSize);
+        else
+            memset(destination + i * a_DestinationStride, 0, m_ElementSize);
+    }
+}
+
+template <uint32_t ElementSize>
+void krt::hlp::AccessorView::Gather(uint8_t* a_Destination) const
+{
+    const uint8_t* source = m_Data;
+    for (uint64_t i = 0; i < m_Count; i++)
+    {
+        // A memcpy with a constant size compiles down to a single (vector) load and store
+        memcpy(a_Destination, source, ElementSize);
+        a_Destination += ElementSize;
+        source += m_Stride;
+    }
+}
+
+void krt::hlp::AccessorView::GatherVec3(uint8_t* a_Destination) const
+{
+    if (m_Count == 0)
+        return;
+
+    // With a stride of at least 16, a full SSE register can be read from every element but the last.
+    // The 4 bytes written past each element are overwritten by the next one.
+
+    const uint8_t* source = m_Data;
+    for (uint64_t i = 0; i < m_Count - 1; i++)
+    {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(a_Destination), _mm_loadu_si128(reinterpret_cast<const __m128i*>(source)));
+        a_Destination += 12;
+        source += m_Stride;
+    }
+
+    memcpy(a_Destination, source, 12);
+}
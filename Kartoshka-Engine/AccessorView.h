@@ -0,0 +1,74 @@
+#pragma once
+
+#include "FX-GLTF/gltf.h"
+
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace krt
+{
+    namespace hlp
+    {
+        // Non-owning, typed view of the elements of a glTF accessor.
+        // The view points directly into the buffer holding the elements, which has to outlive the view.
+        // Elements can be interleaved with other data, in which case the stride is larger than the element size.
+        class AccessorView
+        {
+        public:
+            AccessorView();
+            AccessorView(const void* a_Data, uint64_t a_Count, uint32_t a_ElementSize, uint32_t a_Stride,
+                fx::gltf::Accessor::ComponentType a_ComponentType = fx::gltf::Accessor::ComponentType::None);
+
+            // Creates a tightly packed view of the contents of a vector
+            template<typename ElementType>
+            static AccessorView FromVector(const std::vector<ElementType>& a_Vector);
+
+            static uint32_t GetElementSize(const fx::gltf::Accessor& a_Accessor);
+            static uint32_t GetComponentCount(const fx::gltf::Accessor& a_Accessor);
+            static uint32_t GetComponentSize(const fx::gltf::Accessor& a_Accessor);
+
+            uint64_t Size() const { return m_Count; }
+            bool Empty() const { return m_Count == 0; }
+            uint32_t GetElementSize() const { return m_ElementSize; }
+            uint32_t GetStride() const { return m_Stride; }
+            uint64_t GetSizeInBytes() const { return m_Count * m_ElementSize; }
+            fx::gltf::Accessor::ComponentType GetComponentType() const { return m_ComponentType; }
+            bool IsTightlyPacked() const { return m_Stride == m_ElementSize; }
+
+            // A view of a_Count elements of this view, starting at element a_First
+            AccessorView Slice(uint64_t a_First, uint64_t a_Count) const;
+
+            // Reads a single element. The size of the element type has to match the element size of the view.
+            template<typename ElementType>
+            ElementType Get(uint64_t a_Index) const;
+            // Copies the raw bytes of a single element, for elements whose type is only known at runtime
+            void CopyElementTo(uint64_t a_Index, void* a_Destination) const;
+
+            // Writes all elements tightly packed to the destination, which has to hold GetSizeInBytes() bytes.
+            // Tightly packed data is copied with a single memcpy, strided data is gathered element by element.
+            void CopyTo(void* a_Destination) const;
+            // Writes the elements into a buffer of interleaved data, placing them a_DestinationStride bytes apart.
+            // Bytes between the elements are left untouched.
+            void CopyTo(void* a_Destination, uint32_t a_DestinationStride) const;
+
+            template<typename ElementType>
+            std::vector<ElementType> ToVector() const;
+
+        private:
+
+            template<uint32_t ElementSize>
+            void Gather(uint8_t* a_Destination) const;
+            void GatherVec3(uint8_t* a_Destination) const;
+
+            const uint8_t* m_Data;
+            uint64_t m_Count;
+            uint32_t m_ElementSize;
+            uint32_t m_Stride;
+            fx::gltf::Accessor::ComponentType m_ComponentType;
+        };
+    }
+}
+
+#include "AccessorView.inl"
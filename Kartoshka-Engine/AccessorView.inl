@@ -0,0 +1,30 @@
+template <typename ElementType>
+krt::hlp::AccessorView krt::hlp::AccessorView::FromVector(const std::vector<ElementType>& a_Vector)
+{
+    return AccessorView(a_Vector.data(), a_Vector.size(), static_cast<uint32_t>(sizeof(ElementType)),
+        static_cast<uint32_t>(sizeof(ElementType)));
+}
+
+template <typename ElementType>
+ElementType krt::hlp::AccessorView::Get(uint64_t a_Index) const
+{
+    assert(sizeof(ElementType) == m_ElementSize);
+    assert(a_Index < m_Count);
+
+    ElementType element = {};
+    if (m_Data)
+        memcpy(&element, m_Data + a_Index * m_Stride, sizeof(ElementType));
+
+    return element;
+}
+
+template <typename ElementType>
+std::vector<ElementType> krt::hlp::AccessorView::ToVector() const
+{
+    assert(sizeof(ElementType) == m_ElementSize);
+
+    std::vector<ElementType> elements(m_Count);
+    CopyTo(elements.data());
+
+    return elements;
+}
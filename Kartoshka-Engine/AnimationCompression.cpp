@@ -0,0 +1,193 @@
+#include "AnimationCompression.h"
+
+namespace
+{
+    using krt::AnimationTrack;
+
+    const float RotationTolerance = 0.001f;     // Radians
+    const float ScaleTolerance = 0.001f;
+    const float TranslationTolerance = 0.001f;  // Relative to the farthest the track places its bone from the parent
+
+    glm::quat ToQuat(const glm::vec4& a_Value)
+    {
+        return glm::quat(a_Value.w, a_Value.x, a_Value.y, a_Value.z);
+    }
+
+    // Interpolates the raw values the same way the decoded ones are interpolated when a pose is sampled
+    glm::vec4 Interpolate(AnimationTrack::EPath a_Path, const glm::vec4& a_First, const glm::vec4& a_Second, float a_Factor)
+    {
+        if (a_Path != AnimationTrack::ERotation)
+            return glm::mix(a_First, a_Second, a_Factor);
+
+        auto rotation = glm::slerp(ToQuat(a_First), ToQuat(a_Second), a_Factor);
+        return glm::vec4(rotation.x, rotation.y, rotation.z, rotation.w);
+    }
+
+    bool IsClose(AnimationTrack::EPath a_Path, const glm::vec4& a_First, const glm::vec4& a_Second, float a_Tolerance)
+    {
+        // q and -q are the same rotation, and the angle between two rotations is twice the angle between their quaternions
+        if (a_Path == AnimationTrack::ERotation)
+            return std::abs(glm::dot(a_First, a_Second)) >= std::cos(a_Tolerance * 0.5f);
+
+        return glm::length(glm::vec3(a_First) - glm::vec3(a_Second)) <= a_Tolerance;
+    }
+}
+
+bool krt::hlp::CompressTrack(const RawTrack& a_Raw, const glm::vec4& a_RestValue, float a_Duration, AnimationTrack& a_Track,
+                             ClipCompressionStatistics& a_Statistics)
+{
+    auto path = a_Raw.m_Path;
+    auto& times = a_Raw.m_Times;
+    auto numKeys = times.size();
+
+    a_Statistics.m_NumTracks++;
+    a_Statistics.m_NumKeys += numKeys;
+    a_Statistics.m_RawSize += numKeys * (sizeof(float) + sizeof(glm::vec4));
+
+    auto values = a_Raw.m_Values;
+    float tolerance = path == AnimationTrack::ERotation ? RotationTolerance : ScaleTolerance;
+
+    if (path == AnimationTrack::ERotation)
+    {
+        for (auto& value : values)
+            value = glm::normalize(value);
+    }
+    else if (path == AnimationTrack::ETranslation)
+    {
+        float reach = 0.0f;
+        for (auto& value : values)
+            reach = std::max(reach, glm::length(glm::vec3(value)));
+
+        tolerance = TranslationTolerance * std::max(reach, 0.0001f);
+    }
+
+    // Every kept key is the start of a line which the skipped keys after it lie close enough to
+    std::vector<size_t> kept = { 0 };
+
+    if (a_Raw.m_Step)
+    {
+        for (size_t i = 1; i < numKeys; i++)
+        {
+            if (!IsClose(path, values[i], values[kept.back()], tolerance))
+                kept.push_back(i);
+        }
+    }
+    else
+    {
+        size_t anchor = 0;
+        for (size_t end = 2; end < numKeys; end++)
+        {
+            float span = times[end] - times[anchor];
+
+            bool fits = true;
+            for (size_t i = anchor + 1; i < end && fits; i++)
+            {
+                float factor = span > 0.0f ? (times[i] - times[anchor]) / span : 0.0f;
+                fits = IsClose(path, Interpolate(path, values[anchor], values[end], factor), values[i], tolerance);
+            }
+
+            if (!fits)
+            {
+                anchor = end - 1;
+                kept.push_back(anchor);
+            }
+        }
+
+        if (numKeys > 1)
+            kept.push_back(numKeys - 1);
+
+        // The keys in between lie close to the line between the first and last, so a track whose ends match never moves
+        if (kept.size() == 2 && IsClose(path, values[kept[0]], values[kept[1]], tolerance))
+            kept.pop_back();
+    }
+
+    // The pose starts out at the rest pose, so a track that holds it adds nothing
+    glm::vec4 rest = path == AnimationTrack::ERotation ? glm::normalize(a_RestValue) : a_RestValue;
+    if (kept.size() == 1 && IsClose(path, values[0], rest, tolerance))
+    {
+        a_Statistics.m_DroppedTracks++;
+        return false;
+    }
+
+    a_Track.m_Bone = a_Raw.m_Bone;
+    a_Track.m_Path = path;
+    a_Track.m_Step = a_Raw.m_Step;
+    a_Track.m_Min = glm::vec3(0.0f);
+    a_Track.m_Extent = glm::vec3(0.0f);
+    a_Track.m_Times.clear();
+    a_Track.m_Values.clear();
+
+    if (path != AnimationTrack::ERotation)
+    {
+        glm::vec3 min(values[kept[0]]);
+        glm::vec3 max(values[kept[0]]);
+        for (auto key : kept)
+        {
+            min = glm::min(min, glm::vec3(values[key]));
+            max = glm::max(max, glm::vec3(values[key]));
+        }
+
+        a_Track.m_Min = min;
+        a_Track.m_Extent = max - min;
+    }
+
+    for (auto key : kept)
+    {
+        a_Track.m_Times.push_back(static_cast<uint16_t>(std::round(GetTrackTime(times[key], a_Duration))));
+
+        if (path == AnimationTrack::ERotation)
+            a_Track.m_Values.push_back(EncodeRotation(ToQuat(values[key])));
+        else
+            a_Track.m_Values.push_back(EncodeTrackVector(glm::vec3(values[key]), a_Track.m_Min, a_Track.m_Extent));
+    }
+
+    a_Statistics.m_KeptKeys += kept.size();
+    a_Statistics.m_CompressedSize += kept.size() * (sizeof(uint16_t) + sizeof(glm::u16vec3));
+
+    return true;
+}
+
+glm::u16vec3 krt::hlp::EncodeTrackVector(const glm::vec3& a_Value, const glm::vec3& a_Min, const glm::vec3& a_Extent)
+{
+    glm::u16vec3 encoded;
+    for (int i = 0; i < 3; i++)
+    {
+        float normalized = a_Extent[i] > 0.0f ? glm::clamp((a_Value[i] - a_Min[i]) / a_Extent[i], 0.0f, 1.0f) : 0.0f;
+        encoded[i] = static_cast<uint16_t>(std::round(normalized * 65535.0f));
+    }
+
+    return encoded;
+}
+
+glm::u16vec3 krt::hlp::EncodeRotation(const glm::quat& a_Rotation)
+{
+    glm::vec4 components = glm::normalize(glm::vec4(a_Rotation.x, a_Rotation.y, a_Rotation.z, a_Rotation.w));
+
+    uint32_t largest = 0;
+    for (uint32_t i = 1; i < 4; i++)
+    {
+        if (std::abs(components[i]) > std::abs(components[largest]))
+            largest = i;
+    }
+
+    // The dropped component is restored as positive, which q and -q both describe
+    if (components[largest] < 0.0f)
+        components = -components;
+
+    // The other components are at most 1 / sqrt(2) in magnitude, since the largest one is at least as large
+    glm::u16vec3 encoded;
+    uint32_t next = 0;
+    for (uint32_t i = 0; i < 4; i++)
+    {
+        if (i == largest)
+            continue;
+
+        float normalized = glm::clamp(components[i] * std::sqrt(2.0f), -1.0f, 1.0f) * 0.5f + 0.5f;
+        encoded[next++] = static_cast<uint16_t>(std::round(normalized * 32767.0f));
+    }
+
+    encoded.x |= static_cast<uint16_t>((largest & 1) << 15);
+    encoded.y |= static_cast<uint16_t>((largest >> 1) << 15);
+
+    return encoded;
+}
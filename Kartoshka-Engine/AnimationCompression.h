@@ -0,0 +1,57 @@
+#pragma once
+
+#include "Skeleton.h"
+
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <glm/gtc/type_precision.hpp>
+
+#include <cstdint>
+#include <vector>
+
+namespace krt
+{
+    namespace hlp
+    {
+        // Keys of one channel as they are read from a glTF sampler
+        struct RawTrack
+        {
+            uint32_t m_Bone;
+            AnimationTrack::EPath m_Path;
+            bool m_Step;
+            std::vector<float> m_Times;         // Ascending, in seconds
+            std::vector<glm::vec4> m_Values;    // xyz for translations and scales, rotations as x, y, z, w
+        };
+
+        // How a clip shrank while it was compressed
+        struct ClipCompressionStatistics
+        {
+            uint32_t m_NumTracks = 0;
+            uint32_t m_DroppedTracks = 0;   // Tracks that only held the rest pose
+            uint64_t m_NumKeys = 0;
+            uint64_t m_KeptKeys = 0;
+            uint64_t m_RawSize = 0;         // Bytes of the float times and values
+            uint64_t m_CompressedSize = 0;
+        };
+
+        // Drops the keys that linear interpolation between their neighbours restores within a tolerance,
+        // which is 0.001 radians for rotations, 0.001 for scales and 0.1 percent of the reach of the bone for translations.
+        // The remaining keys are quantized. Returns false if the track never leaves the rest value, in which case it is not needed.
+        bool CompressTrack(const RawTrack& a_Raw, const glm::vec4& a_RestValue, float a_Duration, AnimationTrack& a_Track,
+                           ClipCompressionStatistics& a_Statistics);
+
+        // The time of a clip in the units of AnimationTrack::m_Times, not rounded
+        float GetTrackTime(float a_Time, float a_Duration);
+
+        glm::u16vec3 EncodeTrackVector(const glm::vec3& a_Value, const glm::vec3& a_Min, const glm::vec3& a_Extent);
+        glm::vec3 DecodeTrackVector(const glm::u16vec3& a_Encoded, const glm::vec3& a_Min, const glm::vec3& a_Extent);
+
+        // Smallest three encoding: the largest component is dropped and restored from the unit length of the quaternion.
+        // The other three are stored in 15 bits each, and the index of the dropped one in the top bits of the first two.
+        glm::u16vec3 EncodeRotation(const glm::quat& a_Rotation);
+        glm::quat DecodeRotation(const glm::u16vec3& a_Encoded);
+    }
+}
+
+#include "AnimationCompression.inl"
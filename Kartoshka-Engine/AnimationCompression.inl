@@ -0,0 +1,33 @@
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+inline float krt::hlp::GetTrackTime(float a_Time, float a_Duration)
+{
+    return a_Duration > 0.0f ? glm::clamp(a_Time / a_Duration, 0.0f, 1.0f) * 65535.0f : 0.0f;
+}
+
+inline glm::vec3 krt::hlp::DecodeTrackVector(const glm::u16vec3& a_Encoded, const glm::vec3& a_Min, const glm::vec3& a_Extent)
+{
+    return a_Min + glm::vec3(a_Encoded) * (a_Extent / 65535.0f);
+}
+
+inline glm::quat krt::hlp::DecodeRotation(const glm::u16vec3& a_Encoded)
+{
+    const float scale = 2.0f / 32767.0f / std::sqrt(2.0f);
+    const float bias = -1.0f / std::sqrt(2.0f);
+
+    uint32_t largest = (a_Encoded.x >> 15) | ((a_Encoded.y >> 15) << 1);
+    glm::vec3 smallest = glm::vec3(a_Encoded & glm::u16vec3(0x7FFF)) * scale + bias;
+
+    glm::vec4 components;
+    uint32_t next = 0;
+    for (uint32_t i = 0; i < 4; i++)
+        components[i] = i == largest ? 0.0f : smallest[next++];
+
+    components[largest] = std::sqrt(std::max(0.0f, 1.0f - glm::dot(smallest, smallest)));
+
+    return glm::quat(components.w, components.x, components.y, components.z);
+}
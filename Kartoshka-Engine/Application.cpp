@@ -24,6 +24,15 @@
 #include "ImGui.h"
 #include "SemaphoreAllocator.h"
 #include "CubeShadowMap.h"
+#include "ThreadPool.h"
+#include "ClusterCuller.h"
+#include "InstanceBatcher.h"
+#include "SkinningSystem.h"
+#include "MorphSystem.h"
+#include "VertexAnimation.h"
+#include "CrowdRenderer.h"
+#include "StagingRing.h"
+#include "FrameAllocator.h"
 
 #include "VkHelpers.h"
 
@@ -39,16 +48,11 @@
 #include <algorithm>
 #include <set>
 #include <array>
+#include <chrono>
 
 // Global pointer to the application so that the focus function can find it
 krt::Application* g_Application;
 
-struct Mats
-{
-    glm::mat4 m_World;
-    glm::mat4 m_MVP;
-};
-
 krt::Application::Application()
     : m_Window(nullptr)
     , m_WindowWidth(0)
@@ -70,7 +74,18 @@ krt::Application::~Application()
     vkDestroySemaphore(m_LogicalDevice->GetVkDevice(), m_RenderFinishedSemaphore, m_ServiceLocator->m_AllocationCallbacks);
 
     m_Window->DestroySwapChain();
+    // The frame allocator holds descriptor sets of the pipelines
+    m_FrameAllocator.reset();
     m_GraphicsPipeline.reset();
+    m_ConstantColorPipeline.reset();
+    m_SkinnedPipeline.reset();
+    m_SkinnedConstantColorPipeline.reset();
+    m_SingleSidedPipeline.reset();
+    m_SingleSidedConstantColorPipeline.reset();
+    m_SingleSidedSkinnedPipeline.reset();
+    m_SingleSidedSkinnedConstantColorPipeline.reset();
+    m_CrowdPipeline.reset();
+    m_CrowdConstantColorPipeline.reset();
     m_ForwardRenderPass.reset();
 
     m_PhysicalDevice.reset();
@@ -85,13 +100,31 @@ void krt::Application::Run(const InitializationInfo& a_Info)
     Initialize(a_Info);
 
     Semaphore lastFrameSemaphore = nullptr;
+    auto lastFrameTime = std::chrono::steady_clock::now();
+    float morphTime = 0.0f;
 
     while (!m_Window->ShouldClose())
     {
         m_Window->PollEvents();
+
+        // Measured while out of focus as well, so the animations do not jump ahead once it returns
+        auto frameTime = std::chrono::steady_clock::now();
+        float deltaTime = std::chrono::duration<float>(frameTime - lastFrameTime).count();
+        lastFrameTime = frameTime;
+
         if (!m_InFocus)
             continue;
         ProcessInput();
+        m_SkinningSystem->Update(*m_Sponza, deltaTime);
+        // Texture levels are requested for the view of the frame that is about to be drawn
+        m_ModelManager->GetTextureStreamer().RequestLevels(*m_Sponza, *m_Camera, static_cast<float>(m_Window->GetScreenSize().y));
+        m_ModelManager->Update(m_StreamingBudget);
+        // Blended after the update, so primitives that were just handed to their meshes are blended before they are drawn
+        morphTime += deltaTime;
+        AnimateMorphWeights(morphTime);
+        m_MorphSystem->Update(*m_Sponza);
+        if (m_CrowdRenderer)
+            m_CrowdRenderer->Update(deltaTime);
         lastFrameSemaphore = DrawFrame(lastFrameSemaphore);
     }
 
@@ -160,7 +193,25 @@ void krt::Application::InitializeVulkan(const InitializationInfo& a_Info)
     m_SemaphoreAllocator = std::make_unique<SemaphoreAllocator>(*m_ServiceLocator);
     m_ServiceLocator->m_SemaphoreAllocator = m_SemaphoreAllocator.get();
 
-    m_ModelManager = std::make_unique<ModelManager>(*m_ServiceLocator);
+    m_FrameAllocator = std::make_unique<FrameAllocator>(*m_ServiceLocator);
+    m_ServiceLocator->m_FrameAllocator = m_FrameAllocator.get();
+
+    m_ThreadPool = std::make_unique<ThreadPool>(a_Info.m_WorkerThreadCount);
+    m_ServiceLocator->m_ThreadPool = m_ThreadPool.get();
+
+    m_ModelManager = std::make_unique<ModelManager>(*m_ServiceLocator, m_VertexLayout, m_OptimizeMeshes, m_GenerateMipmaps,
+        m_CompressTextures, m_TextureMemoryBudget);
+
+    // The streamer keeps the textures within their budget, so the panel flags it if something else pushes them past it
+    if (m_TextureMemoryBudget != 0)
+        m_LogicalDevice->GetMemoryTracker().SetBudget(ETextureMemory, m_TextureMemoryBudget);
+
+    m_ForwardCuller = std::make_unique<ClusterCuller>();
+    m_ShadowCuller = std::make_unique<ClusterCuller>();
+    m_ForwardBatcher = std::make_unique<InstanceBatcher>();
+    m_ShadowBatcher = std::make_unique<InstanceBatcher>();
+    m_SkinningSystem = std::make_unique<SkinningSystem>(*m_ThreadPool);
+    m_MorphSystem = std::make_unique<MorphSystem>(*m_ThreadPool);
 
     m_Window->CreateFrameBuffers(*m_ForwardRenderPass);
 
@@ -198,7 +249,7 @@ void krt::Application::CreateGraphicsPipeline()
 #pragma region GeometryPipeline
     GraphicsPipeline::CreateInfo pipelineInfo;
     pipelineInfo.m_FragmentShaderFilepath = "../../../SpirV/Fragment.spv";
-    pipelineInfo.m_VertexShaderFilepath = "../../../SpirV/Vertex.spv";
+    pipelineInfo.m_VertexShaderFilepath = m_VertexLayout == EQuantizedVertexAttributes ? "../../../SpirV/QuantizedVertex.spv" : "../../../SpirV/Vertex.spv";
     pipelineInfo.m_DynamicStates.push_back(VK_DYNAMIC_STATE_VIEWPORT);
     pipelineInfo.m_DynamicStates.push_back(VK_DYNAMIC_STATE_SCISSOR);
     pipelineInfo.m_Viewports.push_back({ 0.0f, 0.0f, static_cast<float>(screenSize.x), static_cast<float>(screenSize.y), 0.0f, 1.0f });
@@ -208,13 +259,11 @@ void krt::Application::CreateGraphicsPipeline()
     pipelineInfo.m_ColorBlendInfo->pAttachments = &colorAttachment;
     pipelineInfo.m_ColorBlendInfo->attachmentCount = 1;
 
-    pipelineInfo.m_VertexInput.AddPerVertexAttribute<glm::vec3>(0, 0, VK_FORMAT_R32G32B32_SFLOAT); // Positions
-    pipelineInfo.m_VertexInput.AddPerVertexAttribute<glm::vec2>(1, 1, VK_FORMAT_R32G32_SFLOAT); // Tex Coords
-    pipelineInfo.m_VertexInput.AddPerVertexAttribute<glm::vec4>(2, 2, VK_FORMAT_R32G32B32A32_SFLOAT); // Vertex Colors
-    pipelineInfo.m_VertexInput.AddPerVertexAttribute<glm::vec3>(3, 3, VK_FORMAT_R32G32B32_SFLOAT); // Normals
-    pipelineInfo.m_VertexInput.AddPerVertexAttribute<glm::vec4>(4, 4, VK_FORMAT_R32G32B32A32_SFLOAT); // Tangents
+    Mesh::DescribeVertexInput(m_VertexLayout, false, pipelineInfo.m_VertexInput);
+    InstanceBatcher::DescribeInstanceInput(pipelineInfo.m_VertexInput);
 
-    pipelineInfo.m_PipelineLayout.AddPushConstantRange<Mats>(VK_SHADER_STAGE_VERTEX_BIT);
+    // The world matrices are read per instance, so only the view projection is pushed
+    pipelineInfo.m_PipelineLayout.AddPushConstantRange<glm::mat4>(VK_SHADER_STAGE_VERTEX_BIT);
 
     pipelineInfo.m_PipelineLayout.AddLayoutBinding(0, 0, VK_SHADER_STAGE_FRAGMENT_BIT, VK_DESCRIPTOR_TYPE_SAMPLER);
     pipelineInfo.m_PipelineLayout.AddLayoutBinding(0, 1, VK_SHADER_STAGE_FRAGMENT_BIT, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE);
@@ -233,6 +282,78 @@ void krt::Application::CreateGraphicsPipeline()
     m_GraphicsPipeline = std::make_unique<GraphicsPipeline>(*m_ServiceLocator, pipelineInfo);
 
     m_ServiceLocator->m_GraphicsPipelines.emplace(Forward, m_GraphicsPipeline.get());
+
+    // Every forward variant has a twin which culls back faces, for the primitives of single sided materials
+    auto createSingleSided = [&](GraphicsPipeline::CreateInfo a_Info)
+    {
+        a_Info.m_RasterizationStateInfo->cullMode = cullMode;
+        return std::make_unique<GraphicsPipeline>(*m_ServiceLocator, a_Info);
+    };
+
+    m_SingleSidedPipeline = createSingleSided(pipelineInfo);
+
+    // Quantized primitives without vertex colors read a constant color per instance, which only differs in the vertex input
+    if (m_VertexLayout == EQuantizedVertexAttributes)
+    {
+        pipelineInfo.m_VertexInput = VertexInputInfo();
+        Mesh::DescribeVertexInput(m_VertexLayout, true, pipelineInfo.m_VertexInput);
+        InstanceBatcher::DescribeInstanceInput(pipelineInfo.m_VertexInput);
+
+        m_ConstantColorPipeline = std::make_unique<GraphicsPipeline>(*m_ServiceLocator, pipelineInfo);
+        m_ServiceLocator->m_GraphicsPipelines.emplace(ForwardConstantColor, m_ConstantColorPipeline.get());
+        m_SingleSidedConstantColorPipeline = createSingleSided(pipelineInfo);
+    }
+
+    // The crowd variants share the material and the lights, but replace the palette with the vertex animation texture
+    auto crowdPipelineInfo = pipelineInfo;
+
+    // The skinned variants add the joints and weights, and the palette after the material and the lights
+    pipelineInfo.m_VertexShaderFilepath = m_VertexLayout == EQuantizedVertexAttributes ? "../../../SpirV/SkinnedQuantizedVertex.spv" : "../../../SpirV/SkinnedVertex.spv";
+    pipelineInfo.m_PipelineLayout.AddLayoutBinding(2, 0, VK_SHADER_STAGE_VERTEX_BIT, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC);
+
+    pipelineInfo.m_VertexInput = VertexInputInfo();
+    Mesh::DescribeVertexInput(m_VertexLayout, false, pipelineInfo.m_VertexInput);
+    InstanceBatcher::DescribeInstanceInput(pipelineInfo.m_VertexInput);
+    Mesh::DescribeSkinInput(pipelineInfo.m_VertexInput);
+
+    m_SkinnedPipeline = std::make_unique<GraphicsPipeline>(*m_ServiceLocator, pipelineInfo);
+    m_ServiceLocator->m_GraphicsPipelines.emplace(ForwardSkinned, m_SkinnedPipeline.get());
+    m_SingleSidedSkinnedPipeline = createSingleSided(pipelineInfo);
+
+    if (m_VertexLayout == EQuantizedVertexAttributes)
+    {
+        pipelineInfo.m_VertexInput = VertexInputInfo();
+        Mesh::DescribeVertexInput(m_VertexLayout, true, pipelineInfo.m_VertexInput);
+        InstanceBatcher::DescribeInstanceInput(pipelineInfo.m_VertexInput);
+        Mesh::DescribeSkinInput(pipelineInfo.m_VertexInput);
+
+        m_SkinnedConstantColorPipeline = std::make_unique<GraphicsPipeline>(*m_ServiceLocator, pipelineInfo);
+        m_ServiceLocator->m_GraphicsPipelines.emplace(ForwardSkinnedConstantColor, m_SkinnedConstantColorPipeline.get());
+        m_SingleSidedSkinnedConstantColorPipeline = createSingleSided(pipelineInfo);
+    }
+
+    // Only the texture coordinates and colors of the vertex buffers are read, the rest comes from the vertex animation texture
+    crowdPipelineInfo.m_VertexShaderFilepath = "../../../SpirV/CrowdVertex.spv";
+    crowdPipelineInfo.m_PipelineLayout.AddPushConstantRange<CrowdRenderer::PushConstants>(VK_SHADER_STAGE_VERTEX_BIT);
+    crowdPipelineInfo.m_PipelineLayout.AddLayoutBinding(CrowdRenderer::AnimationSet, 0, VK_SHADER_STAGE_VERTEX_BIT, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE);
+    crowdPipelineInfo.m_PipelineLayout.AddLayoutBinding(CrowdRenderer::AnimationSet, 1, VK_SHADER_STAGE_VERTEX_BIT, VK_DESCRIPTOR_TYPE_SAMPLER);
+
+    crowdPipelineInfo.m_VertexInput = VertexInputInfo();
+    Mesh::DescribeVertexInput(m_VertexLayout, false, crowdPipelineInfo.m_VertexInput);
+    CrowdRenderer::DescribeInstanceInput(crowdPipelineInfo.m_VertexInput);
+
+    m_CrowdPipeline = std::make_unique<GraphicsPipeline>(*m_ServiceLocator, crowdPipelineInfo);
+    m_ServiceLocator->m_GraphicsPipelines.emplace(ForwardCrowd, m_CrowdPipeline.get());
+
+    if (m_VertexLayout == EQuantizedVertexAttributes)
+    {
+        crowdPipelineInfo.m_VertexInput = VertexInputInfo();
+        Mesh::DescribeVertexInput(m_VertexLayout, true, crowdPipelineInfo.m_VertexInput);
+        CrowdRenderer::DescribeInstanceInput(crowdPipelineInfo.m_VertexInput);
+
+        m_CrowdConstantColorPipeline = std::make_unique<GraphicsPipeline>(*m_ServiceLocator, crowdPipelineInfo);
+        m_ServiceLocator->m_GraphicsPipelines.emplace(ForwardCrowdConstantColor, m_CrowdConstantColorPipeline.get());
+    }
     
 #pragma endregion 
 #pragma region ShadowMapPipeline
@@ -247,6 +368,7 @@ void krt::Application::CreateGraphicsPipeline()
 
     //shadowMapPipeline.m_VertexInput.AddPerVertexAttribute<glm::vec3>(0, 0, VK_FORMAT_R32G32B32_SFLOAT); // Position
     shadowMapPipeline.m_VertexInput.AddPerVertexAttribute<glm::vec3>(0, 0, VK_FORMAT_R32G32B32_SFLOAT); // Positions
+    InstanceBatcher::DescribeInstanceInput(shadowMapPipeline.m_VertexInput);
 
     shadowMapPipeline.m_PipelineLayout.AddPushConstantRange<glm::mat4>(VK_SHADER_STAGE_VERTEX_BIT);
 
@@ -257,6 +379,14 @@ void krt::Application::CreateGraphicsPipeline()
     m_ShadowPipeline = std::make_unique<GraphicsPipeline>(*m_ServiceLocator, shadowMapPipeline);
     m_ServiceLocator->m_GraphicsPipelines.emplace(ShadowMap, m_ShadowPipeline.get());
 
+    // Without the material and the lights, the palette is the only descriptor set of the skinned shadow pipeline
+    shadowMapPipeline.m_VertexShaderFilepath = "../../../SpirV/SkinnedShadowVertex.spv";
+    Mesh::DescribeSkinInput(shadowMapPipeline.m_VertexInput);
+    shadowMapPipeline.m_PipelineLayout.AddLayoutBinding(0, 0, VK_SHADER_STAGE_VERTEX_BIT, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC);
+
+    m_SkinnedShadowPipeline = std::make_unique<GraphicsPipeline>(*m_ServiceLocator, shadowMapPipeline);
+    m_ServiceLocator->m_GraphicsPipelines.emplace(ShadowMapSkinned, m_SkinnedShadowPipeline.get());
+
 #pragma endregion
 
     printf("Graphics pipeline created successfully.\n");
@@ -397,7 +527,8 @@ void krt::Application::LoadAssets()
     auto& transferQueue = m_LogicalDevice->GetCommandQueue(ETransferQueue);
 
     m_TestShadowMap = std::make_unique<CubeShadowMap>(*m_ServiceLocator);
-    auto res = m_ModelManager->LoadGltf("../../../../Assets/GLTF/Sponza/Sponza.gltf");
+    // Streams in while the first frames are drawn, the meshes fill up as their data becomes resident
+    auto res = m_ModelManager->LoadGltfAsync("../../../../Assets/GLTF/Sponza/Sponza.gltf");
     //auto res = m_ModelManager->LoadGltf("../../../../Assets/GLTF/Tests/NormalTangentMirrorTest.gltf");
     //auto res = m_ModelManager->LoadGltf("../../../../Assets/GLTF/CrowdKing/JL.gltf");
     //auto res = m_ModelManager->LoadGltf("../../../../Assets/GLTF/Lantern/Lantern.gltf");
@@ -437,6 +568,100 @@ void krt::Application::LoadAssets()
     m_DebugCube->m_Transform->SetScale(glm::vec3(0.1f, 0.1f, 0.1f));
     m_DebugCube1->m_Transform->SetScale(glm::vec3(10.0f, 10.0f, 10.0f));
 
+    if (m_NumDuckCopies != 0)
+    {
+        auto duckRes = m_ModelManager->LoadGltf("../../../../Assets/Models/Duck.gltf");
+
+        // A square grid on the floor of the atrium, with the ducks scaled down to about a third of a unit
+        auto gridSize = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<float>(m_NumDuckCopies))));
+        const float spacing = 0.4f;
+
+        std::vector<glm::mat4> placements;
+        placements.reserve(m_NumDuckCopies);
+        for (uint32_t i = 0; i < m_NumDuckCopies; i++)
+        {
+            glm::vec3 position((static_cast<float>(i % gridSize) - gridSize * 0.5f) * spacing, 0.0f,
+                               (static_cast<float>(i / gridSize) - gridSize * 0.5f) * spacing);
+
+            placements.push_back(glm::scale(glm::translate(glm::mat4(1.0f), position), glm::vec3(0.2f)));
+        }
+
+        m_Sponza->AddCopies(*duckRes->GetScene(), placements);
+    }
+
+    if (m_NumFoxCopies != 0)
+    {
+        auto foxRes = m_ModelManager->LoadGltf("../../../../Assets/Models/Fox.gltf");
+
+        // The fox is about a hundred units long, it is scaled down to about half a unit
+        auto gridSize = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<float>(m_NumFoxCopies))));
+        const float spacing = 0.6f;
+
+        std::vector<glm::mat4> placements;
+        placements.reserve(m_NumFoxCopies);
+        for (uint32_t i = 0; i < m_NumFoxCopies; i++)
+        {
+            glm::vec3 position((static_cast<float>(i % gridSize) - gridSize * 0.5f) * spacing, 0.0f,
+                               (static_cast<float>(i / gridSize) - gridSize * 0.5f) * spacing);
+
+            placements.push_back(glm::scale(glm::translate(glm::mat4(1.0f), position), glm::vec3(0.005f)));
+        }
+
+        auto firstCopy = m_Sponza->m_StaticMeshes.size();
+        m_Sponza->AddCopies(*foxRes->GetScene(), placements);
+
+        // Every copy plays a different clip from a different time, so no two foxes share a pose
+        for (auto i = firstCopy; i < m_Sponza->m_StaticMeshes.size(); i++)
+        {
+            auto& animation = m_Sponza->m_StaticMeshes[i]->m_Animation;
+            animation.m_Clip = static_cast<uint32_t>(i - firstCopy);
+            animation.m_Time = static_cast<float>(i - firstCopy) * 0.37f;
+        }
+    }
+
+    if (!m_MorphTargetModel.empty())
+    {
+        auto morphRes = m_ModelManager->LoadGltf(m_MorphTargetModel);
+
+        auto firstCopy = m_Sponza->m_StaticMeshes.size();
+        m_Sponza->AddCopies(*morphRes->GetScene(), { glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 1.0f, 0.0f)) });
+
+        for (auto i = firstCopy; i < m_Sponza->m_StaticMeshes.size(); i++)
+        {
+            auto& mesh = m_Sponza->m_StaticMeshes[i]->GetMesh();
+            if (mesh && std::find(m_AnimatedMorphMeshes.begin(), m_AnimatedMorphMeshes.end(), mesh) == m_AnimatedMorphMeshes.end())
+                m_AnimatedMorphMeshes.push_back(mesh);
+        }
+    }
+
+    if (m_NumCrowdAgents != 0)
+    {
+        auto animation = m_ModelManager->BakeVertexAnimation("../../../../Assets/Models/Fox.gltf", 30.0f);
+        if (animation)
+        {
+            m_CrowdRenderer = std::make_unique<CrowdRenderer>(*m_ServiceLocator, animation);
+
+            // Placed in a grid next to the copies of the fox, with the same clips and offsets, and speeds between 0.75 and 1.25
+            auto gridSize = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<float>(m_NumCrowdAgents))));
+            const float spacing = 0.6f;
+
+            std::vector<CrowdRenderer::Agent> agents(m_NumCrowdAgents);
+            for (uint32_t i = 0; i < m_NumCrowdAgents; i++)
+            {
+                glm::vec3 position((static_cast<float>(i % gridSize) - gridSize * 0.5f) * spacing, 0.0f,
+                                   (static_cast<float>(i / gridSize) + 1.0f) * spacing);
+
+                auto& agent = agents[i];
+                agent.m_World = glm::scale(glm::translate(glm::mat4(1.0f), position), glm::vec3(0.005f));
+                agent.m_Clip = i;
+                agent.m_TimeOffset = static_cast<float>(i) * 0.37f;
+                agent.m_Speed = 0.75f + static_cast<float>(i % 11) * 0.05f;
+            }
+
+            m_CrowdRenderer->SetAgents(agents);
+        }
+    }
+
     transferQueue.Flush();
 
 
@@ -445,6 +670,9 @@ void krt::Application::LoadAssets()
 
 krt::Semaphore krt::Application::DrawFrame(krt::Semaphore a_LastFrameSem)
 {
+    // The instances, palettes and morphed vertices of the frame are bump allocated from a buffer of their own
+    m_FrameAllocator->BeginFrame();
+
     auto imageAvailableSem = m_SemaphoreAllocator->GetSemaphore();
     auto drawFinishedSem = m_SemaphoreAllocator->GetSemaphore();
 
@@ -482,51 +710,79 @@ krt::Semaphore krt::Application::DrawFrame(krt::Semaphore a_LastFrameSem)
     }
 
     commandBuffer.AddWaitSemaphore(semWait.m_Semaphore, semWait.m_StageFlags);
-    commandBuffer.SetDescriptorSet(m_Sponza->GetLightsDescriptorSet(semWait), 1);    
+    // The shadow maps are done with their palette, so it can be replaced by the one of this command buffer
+    m_SkinningSystem->Upload(commandBuffer);
+    m_MorphSystem->Upload(commandBuffer);
+    auto& lightsDescriptorSet = m_Sponza->GetLightsDescriptorSet(semWait);
+    commandBuffer.SetDescriptorSet(lightsDescriptorSet, 1);
     commandBuffer.AddWaitSemaphore(semWait.m_Semaphore, semWait.m_StageFlags);
+
+    GraphicsPipeline* boundPipeline = m_GraphicsPipeline.get();
     //commandBuffer.AddSignalSemaphore(signalSem);
 
-    for (auto& mesh : m_Sponza->m_StaticMeshes)
+    m_ForwardCuller->ResetStatistics();
+    m_ForwardCuller->BeginView(cameraMatrix, m_Camera->GetPosition());
+
+    // Static meshes that share a mesh are drawn together, with their world matrices read per instance
+    commandBuffer.PushConstant(cameraMatrix, 0);
+    m_ForwardBatcher->Gather(*m_Sponza, cameraMatrix);
+    m_ForwardBatcher->Upload(commandBuffer);
+
+    for (auto& batch : m_ForwardBatcher->GetBatches())
     {
-        if (!mesh->m_Enabled)
-            continue;
+        m_ForwardBatcher->BindInstances(commandBuffer, batch);
 
-        auto& m = *mesh;
-        glm::mat4 mvp;
+        // The meshlets of a mesh are only culled when it has a single instance
+        if (batch.m_NumInstances == 1)
+            m_ForwardCuller->SetObject(m_ForwardBatcher->GetWorldMatrix(batch, 0));
 
-        Mats mats;
+        // Mirroring flips the winding of the triangles, so the rasterizer would cull the front faces of mirrored instances
+        bool mirrored = false;
+        for (uint32_t i = 0; i < batch.m_NumInstances && !mirrored; i++)
+            mirrored = glm::determinant(glm::mat3(m_ForwardBatcher->GetWorldMatrix(batch, i))) < 0.0f;
 
-        mats.m_MVP = cameraMatrix * mesh->m_Transform->GetTransformationMatrix();
-        mats.m_World = mesh->m_Transform->GetTransformationMatrix();
+        for (auto& primitive : batch.m_Mesh->m_Primitives)
+        {
+            // Binding a different pipeline unbinds the descriptor sets, the push constants stay valid since the layouts match
+            bool skinned = batch.m_Skinned && primitive.m_SkinAttributes;
+            bool singleSided = !mirrored && (!primitive.m_Material || !primitive.m_Material->IsDoubleSided());
+            GraphicsPipeline* pipeline;
+            if (skinned && primitive.m_ConstantColor)
+                pipeline = singleSided ? m_SingleSidedSkinnedConstantColorPipeline.get() : m_SkinnedConstantColorPipeline.get();
+            else if (skinned)
+                pipeline = singleSided ? m_SingleSidedSkinnedPipeline.get() : m_SkinnedPipeline.get();
+            else if (primitive.m_ConstantColor)
+                pipeline = singleSided ? m_SingleSidedConstantColorPipeline.get() : m_ConstantColorPipeline.get();
+            else
+                pipeline = singleSided ? m_SingleSidedPipeline.get() : m_GraphicsPipeline.get();
 
-        mvp = cameraMatrix * mesh->m_Transform->GetTransformationMatrix();
-        commandBuffer.PushConstant(mats, 0);
+            if (pipeline != boundPipeline)
+            {
+                commandBuffer.BindPipeline(*pipeline);
+                commandBuffer.SetDescriptorSet(lightsDescriptorSet, 1);
+                if (skinned)
+                    m_SkinningSystem->BindPalette(commandBuffer, 2);
+                boundPipeline = pipeline;
+            }
+
+            primitive.BindVertexBuffers(commandBuffer);
+            m_MorphSystem->BindVertexBuffers(commandBuffer, primitive);
 
-        for (auto& primitive : m->m_Primitives)
-        {            
-            commandBuffer.SetVertexBuffer(*primitive.m_Positions, 0);
-            commandBuffer.SetVertexBuffer(*primitive.m_TexCoords, 1);
-            commandBuffer.SetVertexBuffer(*primitive.m_VertexColors, 2);
-            commandBuffer.SetVertexBuffer(*primitive.m_Normals, 3);          
-            commandBuffer.SetVertexBuffer(*primitive.m_Tangents, 4);
+            if (primitive.m_ConstantColor)
+                m_ForwardBatcher->BindConstantColors(commandBuffer);
 
             if (primitive.m_Material)
             {
                 commandBuffer.SetMaterial(*primitive.m_Material, 0);
             }
 
-            if (primitive.m_IndexBuffer)
-            {
-                commandBuffer.SetIndexBuffer(*primitive.m_IndexBuffer);
-                commandBuffer.DrawIndexed(primitive.m_IndexBuffer->GetElementCount());
-            }
-            else
-            {
-                commandBuffer.Draw(primitive.m_Positions->GetElementCount());
-            }
+            // Back facing meshlets can only be skipped when the bound pipeline culls back faces
+            m_ForwardCuller->Draw(commandBuffer, primitive, singleSided, batch.m_NumInstances);
         }
     }
 
+    if (m_CrowdRenderer)
+        m_CrowdRenderer->Draw(commandBuffer, lightsDescriptorSet, cameraMatrix);
 
     commandBuffer.EndRenderPass();
     commandBuffer.AddWaitSemaphore(imageAvailableSem, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
@@ -550,6 +806,7 @@ krt::Semaphore krt::Application::DrawFrame(krt::Semaphore a_LastFrameSem)
 
 
     ImGui::Begin("Debug");
+    ImGui::Text("Frame time: %.2f ms", 1000.0f / ImGui::GetIO().Framerate);
     ImGui::DragFloat3("Model Position", &p[0]);
     ImGui::DragFloat3("Model Rotation", &r[0]);
     ImGui::DragFloat3("Model Scale", &s[0]);
@@ -560,6 +817,96 @@ krt::Semaphore krt::Application::DrawFrame(krt::Semaphore a_LastFrameSem)
     m_Light->SetColor(c);
     m_Light->SetPosition(v);
 
+    bool clusterCulling = m_ForwardCuller->IsEnabled();
+    ImGui::Checkbox("Cluster Culling", &clusterCulling);
+    m_ForwardCuller->SetEnabled(clusterCulling);
+    m_ShadowCuller->SetEnabled(clusterCulling);
+
+    auto printCullingStatistics = [](const char* a_Pass, const ClusterCuller::Statistics& a_Statistics)
+    {
+        ImGui::Text("%s: %llu of %llu triangles culled, %u draw calls", a_Pass, static_cast<unsigned long long>(a_Statistics.m_CulledTriangles),
+                    static_cast<unsigned long long>(a_Statistics.m_NumTriangles), a_Statistics.m_NumDrawCalls);
+    };
+    printCullingStatistics("Forward", m_ForwardCuller->GetStatistics());
+    printCullingStatistics("Shadows", m_ShadowCuller->GetStatistics());
+
+    auto& instancingStatistics = m_ForwardBatcher->GetStatistics();
+    ImGui::Text("Instancing: %u instances in %u batches, %u outside of the view", instancingStatistics.m_NumInstances,
+                instancingStatistics.m_NumBatches, instancingStatistics.m_CulledInstances);
+
+    auto& skinningStatistics = m_SkinningSystem->GetStatistics();
+    if (skinningStatistics.m_NumCharacters != 0)
+    {
+        // Characters per millisecond of worker time is the throughput, independent of how many workers there are
+        float throughput = skinningStatistics.m_ThreadTime > 0.0f ? skinningStatistics.m_NumCharacters / skinningStatistics.m_ThreadTime : 0.0f;
+        ImGui::Text("Skinning: %u characters, %u joints, %.2f ms on this thread, %.2f ms on the workers, %.0f characters per worker ms",
+                    skinningStatistics.m_NumCharacters, skinningStatistics.m_NumJoints, skinningStatistics.m_WallTime,
+                    skinningStatistics.m_ThreadTime, throughput);
+        ImGui::Text("Clip sampling: %.2f ms, %.1f ns per joint", skinningStatistics.m_SampleTime,
+                    skinningStatistics.m_SampleTime * 1000000.0f / std::max(skinningStatistics.m_NumJoints, 1u));
+    }
+
+    auto& morphStatistics = m_MorphSystem->GetStatistics();
+    if (morphStatistics.m_NumPrimitives != 0)
+    {
+        // The cost per applied delta shows how well the blend kernel runs, independent of how many targets are active
+        ImGui::Text("Morph targets: %u primitives, %u of %u targets active, %u morphed vertices, %.1f KB uploaded",
+                    morphStatistics.m_NumPrimitives, morphStatistics.m_ActiveTargets, morphStatistics.m_NumTargets,
+                    morphStatistics.m_NumMorphedVertices, static_cast<float>(morphStatistics.m_UploadSize) / 1024.0f);
+        ImGui::Text("Morph blending: %.2f ms on this thread, %.2f ms on the workers, %.2f ns per delta", morphStatistics.m_WallTime,
+                    morphStatistics.m_BlendTime, morphStatistics.m_BlendTime * 1000000.0f / std::max<uint64_t>(morphStatistics.m_NumDeltas, 1));
+    }
+
+    if (m_CrowdRenderer)
+    {
+        // The record time stays flat as agents are added, the cost moves to the vertex shader
+        auto& crowdStatistics = m_CrowdRenderer->GetStatistics();
+        ImGui::Text("Crowd: %u agents, %u draw calls, %llu triangles, %.1f MB animation, %.3f ms to record", crowdStatistics.m_NumAgents,
+                    crowdStatistics.m_NumDrawCalls, static_cast<unsigned long long>(crowdStatistics.m_NumTriangles),
+                    static_cast<float>(crowdStatistics.m_AnimationMemory) / (1024.0f * 1024.0f), crowdStatistics.m_RecordTime);
+    }
+
+    // Every buffer and texture used to be a device allocation of its own, the blocks are what the driver sees now
+    auto memoryStatistics = m_LogicalDevice->GetMemoryAllocator().GetStatistics();
+    ImGui::Text("Device memory: %u allocations in %u blocks (%u dedicated), %llu device allocations made", memoryStatistics.m_NumAllocations,
+                memoryStatistics.m_NumBlocks, memoryStatistics.m_NumDedicatedBlocks, static_cast<unsigned long long>(memoryStatistics.m_NumDeviceAllocations));
+    ImGui::Text("Device memory: %.1f of %.1f MB used, %u free ranges, %.1f%% fragmented",
+                static_cast<float>(memoryStatistics.m_UsedMemory) / (1024.0f * 1024.0f), static_cast<float>(memoryStatistics.m_BlockMemory) / (1024.0f * 1024.0f),
+                memoryStatistics.m_NumFreeRanges, memoryStatistics.GetFragmentation() * 100.0f);
+
+    auto stagingStatistics = m_LogicalDevice->GetStagingRing().GetStatistics();
+    ImGui::Text("Staging ring: %.1f MB in flight in %u ranges, %.1f MB staged, %llu waits, %llu fallback buffers",
+                static_cast<float>(stagingStatistics.m_UsedBytes) / (1024.0f * 1024.0f), stagingStatistics.m_NumLiveRanges,
+                static_cast<float>(stagingStatistics.m_StagedBytes) / (1024.0f * 1024.0f), static_cast<unsigned long long>(stagingStatistics.m_NumWaits),
+                static_cast<unsigned long long>(stagingStatistics.m_NumFallbackBuffers));
+
+    auto frameStatistics = m_FrameAllocator->GetStatistics();
+    ImGui::Text("Frame data: %u allocations, %.1f of %.1f MB in frame %u, %llu growths, %llu waits", frameStatistics.m_NumAllocations,
+                static_cast<float>(frameStatistics.m_UsedBytes) / (1024.0f * 1024.0f), static_cast<float>(frameStatistics.m_FrameSize) / (1024.0f * 1024.0f),
+                frameStatistics.m_FrameIndex, static_cast<unsigned long long>(frameStatistics.m_NumGrowths),
+                static_cast<unsigned long long>(frameStatistics.m_NumWaits));
+
+    auto createdObjects = m_LogicalDevice->GetCreatedObjects();
+    ImGui::Text("Created last frame: %llu buffers, %llu textures, %llu descriptor pools, %llu descriptor sets",
+                static_cast<unsigned long long>(createdObjects.m_Buffers - m_CreatedObjects.m_Buffers),
+                static_cast<unsigned long long>(createdObjects.m_Textures - m_CreatedObjects.m_Textures),
+                static_cast<unsigned long long>(createdObjects.m_DescriptorPools - m_CreatedObjects.m_DescriptorPools),
+                static_cast<unsigned long long>(createdObjects.m_DescriptorSets - m_CreatedObjects.m_DescriptorSets));
+    m_CreatedObjects = createdObjects;
+
+    auto textureStatistics = m_ModelManager->GetTextureStatistics();
+    ImGui::Text("Textures: %u resident, %u uploaded, %u shared by path, %u shared by content", textureStatistics.m_NumTextures,
+                textureStatistics.m_Misses, textureStatistics.m_PathHits, textureStatistics.m_ContentHits);
+
+    auto& streamingStatistics = m_ModelManager->GetTextureStreamer().GetStatistics();
+    ImGui::Text("Texture streaming: %.1f of %.1f MB, %u pending, %u levels missing",
+                static_cast<float>(streamingStatistics.m_ResidentBytes) / (1024.0f * 1024.0f),
+                static_cast<float>(m_TextureMemoryBudget) / (1024.0f * 1024.0f), streamingStatistics.m_NumPending,
+                streamingStatistics.m_NumMissingLevels);
+
+    if (m_ModelManager->IsStreaming())
+        ImGui::Text("Streaming assets...");
+
     if (std::abs(r.y) > 90.0f && std::abs(meshTransform->GetRotationEuler().y) < 90.0f)
     {
         //r.x += 180.0f;
@@ -574,6 +921,8 @@ krt::Semaphore krt::Application::DrawFrame(krt::Semaphore a_LastFrameSem)
     auto newRot = difQuat * meshTransform->GetRotationQuat();
 
     ImGui::End();
+    m_ImGui->ShowMemoryBudget();
+
     meshTransform->SetPosition(p);
     meshTransform->SetRotation(newRot);
     meshTransform->SetScale(s);
@@ -594,6 +943,16 @@ void krt::Application::ParseInitializationInfo(const InitializationInfo& a_Info)
     m_WindowWidth = a_Info.m_Width;
     m_WindowHeight = a_Info.m_Height;
     m_WindowTitle = a_Info.m_Title;
+    m_VertexLayout = a_Info.m_VertexLayout;
+    m_OptimizeMeshes = a_Info.m_OptimizeMeshes;
+    m_GenerateMipmaps = a_Info.m_GenerateMipmaps;
+    m_CompressTextures = a_Info.m_CompressTextures;
+    m_StreamingBudget = a_Info.m_StreamingBudget;
+    m_TextureMemoryBudget = a_Info.m_TextureMemoryBudget;
+    m_NumDuckCopies = a_Info.m_NumDuckCopies;
+    m_NumFoxCopies = a_Info.m_NumFoxCopies;
+    m_MorphTargetModel = a_Info.m_MorphTargetModel;
+    m_NumCrowdAgents = a_Info.m_NumCrowdAgents;
 }
 
 VkBool32 krt::Application::DebugCallback(VkDebugUtilsMessageSeverityFlagBitsEXT /*a_MessageSeverity*/,
@@ -616,7 +975,9 @@ krt::SemaphoreWait krt::Application::GenerateShadowMaps()
 
     auto& fbs = light->GetFramebuffers();
 
-
+    m_ShadowCuller->ResetStatistics();
+    m_SkinningSystem->Upload(cmdBuffer);
+    m_MorphSystem->Upload(cmdBuffer);
 
     for (int i = 0; i < 6; i++)
     {
@@ -657,33 +1018,40 @@ krt::SemaphoreWait krt::Application::GenerateShadowMaps()
         auto lookat = glm::lookAt(eye, center, up[i]);
 
         glm::mat4 cameraMatrix = proj * lookat;
+        m_ShadowCuller->BeginView(cameraMatrix, eye);
+
+        // Every face sees different instances, so each one gets its own instance buffer
+        cmdBuffer.PushConstant(cameraMatrix, 0);
+        m_ShadowBatcher->Gather(*m_Sponza, cameraMatrix, m_DebugCube);
+        m_ShadowBatcher->Upload(cmdBuffer);
+        GraphicsPipeline* boundPipeline = m_ShadowPipeline.get();
 
-        for (auto& mesh : m_Sponza->m_StaticMeshes)
+        for (auto& batch : m_ShadowBatcher->GetBatches())
         {
-            if (!mesh->m_Enabled)
-                continue;
-            if (m_DebugCube == mesh.get())
-            {
-                continue;
-            }
-            auto& m = *mesh;
-            glm::mat4 mvp = cameraMatrix * mesh->m_Transform->GetTransformationMatrix();
+            m_ShadowBatcher->BindInstances(cmdBuffer, batch);
 
-            cmdBuffer.PushConstant(mvp, 0);
+            if (batch.m_NumInstances == 1)
+                m_ShadowCuller->SetObject(m_ShadowBatcher->GetWorldMatrix(batch, 0));
 
-            for (auto& primitive : m->m_Primitives)
+            for (auto& primitive : batch.m_Mesh->m_Primitives)
             {
-                cmdBuffer.SetVertexBuffer(*primitive.m_Positions, 0);
-
-                if (primitive.m_IndexBuffer)
+                bool skinned = batch.m_Skinned && primitive.m_SkinAttributes;
+                auto* pipeline = skinned ? m_SkinnedShadowPipeline.get() : m_ShadowPipeline.get();
+                if (pipeline != boundPipeline)
                 {
-                    cmdBuffer.SetIndexBuffer(*primitive.m_IndexBuffer);
-                    cmdBuffer.DrawIndexed(primitive.m_IndexBuffer->GetElementCount());
-                }
-                else
-                {
-                    cmdBuffer.Draw(primitive.m_Positions->GetElementCount());
+                    cmdBuffer.BindPipeline(*pipeline);
+                    if (skinned)
+                        m_SkinningSystem->BindPalette(cmdBuffer, 0);
+                    boundPipeline = pipeline;
                 }
+
+                cmdBuffer.SetVertexBuffer(*primitive.m_Positions, 0);
+                m_MorphSystem->BindVertexBuffers(cmdBuffer, primitive, true);
+                if (skinned)
+                    cmdBuffer.SetVertexBuffer(*primitive.m_SkinAttributes, Mesh::SkinBinding);
+
+                // The shadow pipeline only draws the faces that point towards the light, whether the material is double sided or not
+                m_ShadowCuller->Draw(cmdBuffer, primitive, true, batch.m_NumInstances);
             }
         }
 
@@ -771,6 +1139,17 @@ void krt::Application::ProcessInput()
     };*/
 }
 
+void krt::Application::AnimateMorphWeights(float a_Time)
+{
+    for (auto& mesh : m_AnimatedMorphMeshes)
+    {
+        // The weights are only there once the primitives of the mesh are loaded
+        auto& weights = mesh->m_MorphWeights;
+        for (size_t i = 0; i < weights.size(); i++)
+            weights[i] = std::max(std::sin(a_Time * (0.5f + 0.05f * static_cast<float>(i)) + 1.7f * static_cast<float>(i)), 0.0f);
+    }
+}
+
 void krt::Application::FocusCallback(GLFWwindow*, int a_Focus)
 {
     if (a_Focus == GLFW_TRUE)
@@ -10,6 +10,8 @@
 #include <map>
 
 #include "SemaphoreWait.h"
+#include "Mesh.h"
+#include "LogicalDevice.h"
 
 namespace krt
 {
@@ -34,6 +36,13 @@ namespace krt
     class SemaphoreAllocator;
     class CubeShadowMap;
     class StaticMesh;
+    class ThreadPool;
+    class FrameAllocator;
+    class ClusterCuller;
+    class InstanceBatcher;
+    class SkinningSystem;
+    class MorphSystem;
+    class CrowdRenderer;
 
     class Camera;
     class Transform;
@@ -50,6 +59,17 @@ namespace krt
         uint32_t m_Width;       // Width of the screen
         uint32_t m_Height;      // Height of the screen
         std::string m_Title;    // Title of the window
+        uint32_t m_WorkerThreadCount = 0; // Number of worker threads used for asset loading, 0 uses all hardware threads
+        EVertexLayout m_VertexLayout = EInterleavedVertexAttributes; // How imported meshes store their vertex attributes
+        bool m_OptimizeMeshes = false; // Welds and reorders the vertices and triangles of imported meshes
+        bool m_GenerateMipmaps = true; // Gives imported textures full mip chains, disable to compare against sampling the full resolution
+        bool m_CompressTextures = true; // Stores imported textures block compressed, and caches them in that form
+        uint64_t m_StreamingBudget = 16 * 1024 * 1024; // Bytes of streamed assets staged for upload per frame
+        uint64_t m_TextureMemoryBudget = 256 * 1024 * 1024; // Device memory for the mip levels of streamed textures, 0 keeps all levels resident
+        uint32_t m_NumDuckCopies = 0; // Copies of Duck.gltf placed in a grid on the floor, to measure instanced drawing
+        uint32_t m_NumFoxCopies = 0; // Animated copies of Fox.gltf placed in a grid on the floor, to measure skinning
+        std::string m_MorphTargetModel; // A glTF file with morph targets placed in the atrium, with its weights animated to measure blending
+        uint32_t m_NumCrowdAgents = 0; // Agents of Fox.gltf drawn from a baked vertex animation, to measure crowd rendering
     };
 
     class Application
@@ -110,11 +130,24 @@ namespace krt
 
         void ProcessInput();
 
+        // Drives every morph target of the meshes of the morph target model with a sine of its own, about half of them are inactive at any time
+        void AnimateMorphWeights(float a_Time);
+
         static void FocusCallback(GLFWwindow* a_Window, int a_Focus);
 
         uint32_t                        m_WindowWidth;
         uint32_t                        m_WindowHeight;
         std::string                     m_WindowTitle;
+        EVertexLayout                   m_VertexLayout;
+        bool                            m_OptimizeMeshes;
+        bool                            m_GenerateMipmaps;
+        bool                            m_CompressTextures;
+        uint64_t                        m_StreamingBudget;
+        uint64_t                        m_TextureMemoryBudget;
+        uint32_t                        m_NumDuckCopies;
+        uint32_t                        m_NumFoxCopies;
+        std::string                     m_MorphTargetModel;
+        uint32_t                        m_NumCrowdAgents;
 
         VkDebugUtilsMessengerEXT        m_VkDebugMessenger;
 
@@ -128,17 +161,40 @@ namespace krt
         std::unique_ptr<PhysicalDevice> m_PhysicalDevice;
         std::unique_ptr<LogicalDevice>  m_LogicalDevice;
         std::unique_ptr<SemaphoreAllocator> m_SemaphoreAllocator;
+        std::unique_ptr<FrameAllocator> m_FrameAllocator;
 
+        std::unique_ptr<ThreadPool>     m_ThreadPool;
         std::unique_ptr<ModelManager>   m_ModelManager;
 
         std::unique_ptr<RenderPass>     m_ForwardRenderPass;
         std::unique_ptr<RenderPass>     m_ShadowRenderPass;
         std::unique_ptr<GraphicsPipeline> m_GraphicsPipeline;
+        std::unique_ptr<GraphicsPipeline> m_ConstantColorPipeline;
         std::unique_ptr<GraphicsPipeline> m_ShadowPipeline;
+        std::unique_ptr<GraphicsPipeline> m_SkinnedPipeline;
+        std::unique_ptr<GraphicsPipeline> m_SkinnedConstantColorPipeline;
+        std::unique_ptr<GraphicsPipeline> m_SkinnedShadowPipeline;
+        std::unique_ptr<GraphicsPipeline> m_SingleSidedPipeline;
+        std::unique_ptr<GraphicsPipeline> m_SingleSidedConstantColorPipeline;
+        std::unique_ptr<GraphicsPipeline> m_SingleSidedSkinnedPipeline;
+        std::unique_ptr<GraphicsPipeline> m_SingleSidedSkinnedConstantColorPipeline;
+        std::unique_ptr<GraphicsPipeline> m_CrowdPipeline;
+        std::unique_ptr<GraphicsPipeline> m_CrowdConstantColorPipeline;
         std::unique_ptr<VkImGui>        m_ImGui;
 
         std::unique_ptr<Camera>         m_Camera;
 
+        // Separate cullers so the statistics of both passes can be shown side by side
+        std::unique_ptr<ClusterCuller>  m_ForwardCuller;
+        std::unique_ptr<ClusterCuller>  m_ShadowCuller;
+
+        std::unique_ptr<InstanceBatcher> m_ForwardBatcher;
+        std::unique_ptr<InstanceBatcher> m_ShadowBatcher;
+
+        std::unique_ptr<SkinningSystem> m_SkinningSystem;
+        std::unique_ptr<MorphSystem>    m_MorphSystem;
+        std::unique_ptr<CrowdRenderer>  m_CrowdRenderer;
+
         std::unique_ptr<CubeShadowMap>  m_TestShadowMap;
 
         StaticMesh*                      m_DebugCube;
@@ -148,8 +204,12 @@ namespace krt
         PointLight*                     m_Light1;
 
         std::shared_ptr<Scene>          m_Sponza;
+        std::vector<std::shared_ptr<Mesh>> m_AnimatedMorphMeshes;
 
         bool                            m_InFocus;
+
+        // Objects created up to the previous frame, to show how many each frame creates
+        LogicalDevice::CreatedObjects   m_CreatedObjects;
     };
 
     
@@ -2,6 +2,8 @@
 
 #include "vulkan/vulkan.h"
 
+#include "DeviceMemoryAllocator.h"
+
 #include "set"
 
 namespace krt
@@ -19,9 +21,11 @@ namespace krt
             VkMemoryPropertyFlags a_MemoryPropertyFlags, std::set<ECommandQueueType> a_QueuesWithAccess);
         virtual ~Buffer();
 
+        // Host visible buffers stay mapped from their creation until they are destroyed, this is null for other buffers
+        uint8_t* GetMappedData() const { return m_Allocation.m_Mapped; }
 
         VkBuffer m_VkBuffer;
-        VkDeviceMemory m_VkDeviceMemory;
+        DeviceMemoryAllocator::Allocation m_Allocation;
         const VkBufferUsageFlags m_UsageFlags;
         const VkMemoryPropertyFlags m_MemoryPropertyFlags;
         const std::set<ECommandQueueType> m_QueuesWithAccess;
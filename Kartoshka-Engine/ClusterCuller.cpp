@@ -0,0 +1,122 @@
+#include "ClusterCuller.h"
+
+#include "CommandBuffer.h"
+#include "IndexBuffer.h"
+#include "VertexBuffer.h"
+
+#include <glm/geometric.hpp>
+#include <glm/matrix.hpp>
+
+krt::ClusterCuller::ClusterCuller()
+    : m_ViewProjection(1.0f)
+    , m_ViewPosition(0.0f)
+    , m_ObjectViewPosition(0.0f)
+    , m_MirroredObject(false)
+    , m_Enabled(true)
+{
+}
+
+void krt::ClusterCuller::BeginView(const glm::mat4& a_ViewProjection, const glm::vec3& a_ViewPosition)
+{
+    m_ViewProjection = a_ViewProjection;
+    m_ViewPosition = a_ViewPosition;
+
+    SetObject(glm::mat4(1.0f));
+}
+
+void krt::ClusterCuller::SetObject(const glm::mat4& a_World)
+{
+    // The planes of the frustum are combinations of the rows of the object to clip space matrix (Gribb & Hartmann).
+    // The near plane assumes a depth range of [-w, w], which is conservative if the projection maps to [0, w] instead.
+    glm::mat4 transposed = glm::transpose(m_ViewProjection * a_World);
+
+    m_ObjectPlanes[0] = transposed[3] + transposed[0];
+    m_ObjectPlanes[1] = transposed[3] - transposed[0];
+    m_ObjectPlanes[2] = transposed[3] + transposed[1];
+    m_ObjectPlanes[3] = transposed[3] - transposed[1];
+    m_ObjectPlanes[4] = transposed[3] + transposed[2];
+    m_ObjectPlanes[5] = transposed[3] - transposed[2];
+
+    for (auto& plane : m_ObjectPlanes)
+        plane /= glm::length(glm::vec3(plane));
+
+    // Mirroring transforms flip the winding of the triangles, which the cones do not account for
+    m_MirroredObject = glm::determinant(glm::mat3(a_World)) < 0.0f;
+
+    m_ObjectViewPosition = glm::vec3(glm::inverse(a_World) * glm::vec4(m_ViewPosition, 1.0f));
+}
+
+void krt::ClusterCuller::Draw(CommandBuffer& a_CommandBuffer, const Mesh::Primitive& a_Primitive, bool a_CullBackFacing, uint32_t a_NumInstances)
+{
+    if (!a_Primitive.m_IndexBuffer)
+    {
+        auto numVertices = a_Primitive.m_Positions->GetElementCount();
+        a_CommandBuffer.Draw(numVertices, a_NumInstances);
+
+        m_Statistics.m_NumTriangles += static_cast<uint64_t>(numVertices / 3) * a_NumInstances;
+        m_Statistics.m_NumDrawCalls++;
+        return;
+    }
+
+    auto numIndices = a_Primitive.m_IndexBuffer->GetElementCount();
+    a_CommandBuffer.SetIndexBuffer(*a_Primitive.m_IndexBuffer);
+    m_Statistics.m_NumTriangles += static_cast<uint64_t>(numIndices / 3) * a_NumInstances;
+
+    if (!m_Enabled || a_Primitive.m_Meshlets.empty() || a_NumInstances > 1 || a_Primitive.m_SkinAttributes ||
+        a_Primitive.m_MorphTargets)
+    {
+        a_CommandBuffer.DrawIndexed(numIndices, a_NumInstances);
+        m_Statistics.m_NumDrawCalls++;
+        return;
+    }
+
+    bool cullBackFacing = a_CullBackFacing && !m_MirroredObject;
+
+    // The meshlets lie back to back in the index buffer, so runs of visible meshlets are drawn together
+    uint32_t runStart = 0;
+    uint32_t runLength = 0;
+
+    auto flushRun = [&]()
+    {
+        if (runLength == 0)
+            return;
+
+        a_CommandBuffer.DrawIndexed(runLength, 1, runStart);
+        m_Statistics.m_NumDrawCalls++;
+        runLength = 0;
+    };
+
+    for (auto& meshlet : a_Primitive.m_Meshlets)
+    {
+        if (!IsVisible(meshlet, cullBackFacing))
+        {
+            flushRun();
+            m_Statistics.m_CulledTriangles += meshlet.m_NumIndices / 3;
+            continue;
+        }
+
+        if (runLength == 0)
+            runStart = meshlet.m_FirstIndex;
+
+        runLength += meshlet.m_NumIndices;
+    }
+
+    flushRun();
+}
+
+bool krt::ClusterCuller::IsVisible(const Mesh::Meshlet& a_Meshlet, bool a_CullBackFacing) const
+{
+    for (auto& plane : m_ObjectPlanes)
+    {
+        if (glm::dot(glm::vec3(plane), a_Meshlet.m_Center) + plane.w < -a_Meshlet.m_Radius)
+            return false;
+    }
+
+    if (!a_CullBackFacing)
+        return true;
+
+    // Every direction from the view position into the bounding sphere lies within the cone of the triangle normals,
+    // so all triangles are seen from behind. This is the cone test of meshoptimizer, using the sphere instead of a cone apex.
+    glm::vec3 toCenter = a_Meshlet.m_Center - m_ObjectViewPosition;
+    return glm::dot(toCenter, a_Meshlet.m_ConeAxis) < a_Meshlet.m_ConeCutoff * glm::length(toCenter) + a_Meshlet.m_Radius;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "Mesh.h"
+
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+
+namespace krt
+{
+    class CommandBuffer;
+}
+
+namespace krt
+{
+    // Culls the meshlets of primitives against a view on the CPU, and draws the remaining ones with as few draw calls as possible.
+    // Meshlets outside of the frustum are skipped, and so are meshlets whose triangles all face away from the view position.
+    class ClusterCuller
+    {
+    public:
+
+        // Triangles of the primitives drawn since the last reset, and how many of them were skipped
+        struct Statistics
+        {
+            uint64_t m_NumTriangles = 0;
+            uint64_t m_CulledTriangles = 0;
+            uint32_t m_NumDrawCalls = 0;
+        };
+
+        ClusterCuller();
+
+        // Sets the view the following objects are culled against
+        void BeginView(const glm::mat4& a_ViewProjection, const glm::vec3& a_ViewPosition);
+        // Brings the frustum and the view position into the object space of the primitives drawn next
+        void SetObject(const glm::mat4& a_World);
+
+        // Binds the index buffer of the primitive and draws it, its vertex buffers have to be bound already.
+        // Back facing meshlets are only culled with a_CullBackFacing, which has to be false if the rasterizer would draw their triangles.
+        // Primitives drawn with more than one instance are drawn whole, since every instance sees different meshlets.
+        // Skinned and morphed primitives are drawn whole as well, their meshlet bounds only hold for the undeformed vertices.
+        void Draw(CommandBuffer& a_CommandBuffer, const Mesh::Primitive& a_Primitive, bool a_CullBackFacing, uint32_t a_NumInstances = 1);
+
+        // A disabled culler still counts the triangles, but draws every primitive with a single draw call
+        void SetEnabled(bool a_Enabled) { m_Enabled = a_Enabled; }
+        bool IsEnabled() const { return m_Enabled; }
+
+        const Statistics& GetStatistics() const { return m_Statistics; }
+        void ResetStatistics() { m_Statistics = Statistics(); }
+
+    private:
+
+        bool IsVisible(const Mesh::Meshlet& a_Meshlet, bool a_CullBackFacing) const;
+
+        glm::mat4 m_ViewProjection;
+        glm::vec3 m_ViewPosition;
+
+        // Planes of the frustum and the view position in the space of the current object.
+        // The planes are normalized, so the distance of a point to a plane is dot(xyz, point) + w.
+        glm::vec4 m_ObjectPlanes[6];
+        glm::vec3 m_ObjectViewPosition;
+        bool m_MirroredObject;
+
+        bool m_Enabled;
+        Statistics m_Statistics;
+    };
+}
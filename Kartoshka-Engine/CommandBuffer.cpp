@@ -14,14 +14,20 @@
 #include "DescriptorSet.h"
 #include "IndexBuffer.h"
 #include "Mesh.h"
+#include "StagingRing.h"
 
 #include "stb/stb_image.h"
 
 #include "VkHelpers.h"
+#include "VkConstants.h"
+
+#include <algorithm>
+#include <cstring>
 
 krt::CommandBuffer::CommandBuffer(ServiceLocator& a_Services, CommandQueue& a_CommandQueue)
     : m_Services(a_Services)
     , m_CommandQueue(a_CommandQueue)
+    , m_UsesFrameData(false)
 {
     VkCommandBufferAllocateInfo allocInfo = {};
     allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
@@ -50,8 +56,17 @@ void krt::CommandBuffer::Reset()
 
     m_IntermediateBuffers.clear();
     m_IntermediateDescriptorSetAllocations.clear();
+
+    // The fence of the command buffer has signaled, so the device is done copying out of its staging ranges
+    auto& stagingRing = m_Services.m_LogicalDevice->GetStagingRing();
+    for (auto id : m_StagingRanges)
+        stagingRing.Release(id);
+
+    m_StagingRanges.clear();
     m_CurrentlyBoundDescriptorSets.clear();
+    m_PendingDynamicSets.clear();
     m_InUseDescriptorSets.clear();
+    m_UsesFrameData = false;
 
     vkResetCommandBuffer(m_VkCommandBuffer, 0);
 }
@@ -76,10 +91,18 @@ void krt::CommandBuffer::End()
     }
 }
 
-void krt::CommandBuffer::Submit()
+uint64_t krt::CommandBuffer::Submit()
 {
     CommandBuffer& commandBuffer = *this;
-    m_CommandQueue.SubmitCommandBuffer(commandBuffer);
+    auto submissionIndex = m_CommandQueue.SubmitCommandBuffer(commandBuffer);
+
+    if (!m_StagingRanges.empty())
+        m_Services.m_LogicalDevice->GetStagingRing().SetSubmission(m_StagingRanges, m_CommandQueue.GetType(), submissionIndex);
+
+    if (m_UsesFrameData)
+        m_Services.m_FrameAllocator->AddSubmission(m_CommandQueue.GetType(), submissionIndex);
+
+    return submissionIndex;
 }
 
 void krt::CommandBuffer::AddWaitSemaphore(Semaphore a_Semaphore, VkPipelineStageFlags a_StageFlags)
@@ -125,7 +148,7 @@ void krt::CommandBuffer::SetScissorRect(const VkRect2D& a_Scissor)
     vkCmdSetScissor(m_VkCommandBuffer, 0, 1, &a_Scissor);
 }
 
-void krt::CommandBuffer::SetVertexBuffer(VertexBuffer& a_VertexBuffer, uint32_t a_Binding, VkDeviceSize a_Offset)
+void krt::CommandBuffer::SetVertexBuffer(Buffer& a_VertexBuffer, uint32_t a_Binding, VkDeviceSize a_Offset)
 {
     vkCmdBindVertexBuffers(m_VkCommandBuffer, a_Binding, 1, &a_VertexBuffer.m_VkBuffer, &a_Offset);
 }
@@ -191,6 +214,7 @@ std::unique_ptr<krt::Texture> krt::CommandBuffer::CreateTextureFromFile(std::str
     glm::uvec2 dimensions(static_cast<uint32_t>(width), static_cast<uint32_t>(height));
 
     auto tex = CreateTexture(data, dimensions, 4, 1, a_QueuesWithAccess, a_UsingStages);
+    m_Services.m_LogicalDevice->GetMemoryTracker().SetOwner(tex.get(), a_Filepath);
 
     stbi_image_free(data);
 
@@ -200,91 +224,36 @@ std::unique_ptr<krt::Texture> krt::CommandBuffer::CreateTextureFromFile(std::str
 std::unique_ptr<krt::Texture> krt::CommandBuffer::CreateTexture(void* a_Data, glm::uvec2 a_Dimensions,
          const uint8_t a_NumChannels, const uint8_t a_BytesPerChannel, std::set<ECommandQueueType> a_QueuesWithAccess, VkPipelineStageFlags a_UsingStages)
 {
-    a_Data;
-    
     assert(a_NumChannels <= 4);
     assert(a_BytesPerChannel <= 8);
 
     VkFormat imageFormat = hlp::PickTextureFormat(a_NumChannels);
 
-    uint64_t sizeInBytes = a_Dimensions.x * a_Dimensions.y * a_NumChannels * a_BytesPerChannel;
-    std::unique_ptr<Texture> texture = std::make_unique<Texture>(m_Services, imageFormat);
-
-    VkExtent3D extent;
-    extent.width = a_Dimensions.x;
-    extent.height = a_Dimensions.y;
-    extent.depth = 1;
-
-    auto queueIndices = m_Services.m_LogicalDevice->GetQueueIndices(a_QueuesWithAccess);
-
-    VkImageCreateInfo imageInfo = {};
-    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
-    imageInfo.imageType = VK_IMAGE_TYPE_2D;
-    imageInfo.extent = extent;
-    imageInfo.mipLevels = 1;
-    imageInfo.arrayLayers = 1;
-    imageInfo.format = imageFormat;
-    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
-    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    imageInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
-    imageInfo.pQueueFamilyIndices = queueIndices.data();
-    imageInfo.queueFamilyIndexCount = static_cast<uint32_t>(queueIndices.size());
-    imageInfo.sharingMode = queueIndices.size() == 1 ? VK_SHARING_MODE_EXCLUSIVE : VK_SHARING_MODE_CONCURRENT;
-    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
-
-    ThrowIfFailed(vkCreateImage(m_Services.m_LogicalDevice->GetVkDevice(), &imageInfo, m_Services.m_AllocationCallbacks, &texture->m_VkImage));
-
-    auto memInfo = m_Services.m_PhysicalDevice->GetMemoryInfoForImage(texture->m_VkImage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-
-    auto stagingBuffer = m_Services.m_LogicalDevice->CreateBuffer(memInfo.m_Size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-        VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, { ETransferQueue });
-
-    m_Services.m_LogicalDevice->CopyToDeviceMemory(stagingBuffer->m_VkDeviceMemory, a_Data, sizeInBytes);
-
-    VkMemoryAllocateInfo allocInfo = {};
-    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocInfo.allocationSize = memInfo.m_Size;
-    allocInfo.memoryTypeIndex = memInfo.m_MemoryType;
-
-    ThrowIfFailed(vkAllocateMemory(m_Services.m_LogicalDevice->GetVkDevice(), &allocInfo, m_Services.m_AllocationCallbacks, &texture->m_VkDeviceMemory));
-    ThrowIfFailed(vkBindImageMemory(m_Services.m_LogicalDevice->GetVkDevice(), texture->m_VkImage, texture->m_VkDeviceMemory, 0));
+    auto texture = m_Services.m_LogicalDevice->CreateTexture(a_Dimensions, imageFormat,
+        VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, a_QueuesWithAccess);
 
     TransitionImageLayout(texture->m_VkImage, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
         0,VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
 
-    VkBufferImageCopy copy;
-    copy.bufferImageHeight = 0;
-    copy.bufferOffset = 0;
-    copy.bufferRowLength = 0;
-    
-    copy.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    copy.imageSubresource.baseArrayLayer = 0;
-    copy.imageSubresource.layerCount = 1;
-    copy.imageSubresource.mipLevel = 0;
+    // Large images are streamed through the staging ring a band of rows at a time
+    const VkDeviceSize chunkSize = StagingRing::ChunkSize;
+    const VkDeviceSize rowSize = static_cast<VkDeviceSize>(a_Dimensions.x) * a_NumChannels * a_BytesPerChannel;
+    const auto rowsPerChunk = static_cast<uint32_t>(std::max<VkDeviceSize>(chunkSize / rowSize, 1));
 
-    copy.imageOffset = { 0,0,0 };
-    copy.imageExtent = { a_Dimensions.x, a_Dimensions.y, 1 };
+    for (uint32_t row = 0; row < a_Dimensions.y; row += rowsPerChunk)
+    {
+        uint32_t numRows = std::min(rowsPerChunk, a_Dimensions.y - row);
+        VkDeviceSize size = numRows * rowSize;
 
-    vkCmdCopyBufferToImage(m_VkCommandBuffer, stagingBuffer->m_VkBuffer, texture->m_VkImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copy);
+        auto staging = ReserveStaging(size, constants::StagingBufferAlignment);
+        memcpy(staging.m_Mapped, static_cast<const uint8_t*>(a_Data) + row * rowSize, size);
+
+        CopyBufferToImage(staging.m_VkBuffer, texture->m_VkImage, glm::uvec2(a_Dimensions.x, numRows), staging.m_Offset, 0, row);
+    }
 
     TransitionImageLayout(texture->m_VkImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, 
         VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, a_UsingStages);
 
-    VkImageViewCreateInfo viewInfo = {};
-    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-    viewInfo.format = imageFormat;
-    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
-    viewInfo.image = texture->m_VkImage;
-    viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    viewInfo.subresourceRange.baseArrayLayer = 0;
-    viewInfo.subresourceRange.layerCount = 1;
-    viewInfo.subresourceRange.baseMipLevel = 0;
-    viewInfo.subresourceRange.levelCount = 1;
-
-    vkCreateImageView(m_Services.m_LogicalDevice->GetVkDevice(), &viewInfo, m_Services.m_AllocationCallbacks, &texture->m_VkImageView);
-
-    m_IntermediateBuffers.push_back(std::move(stagingBuffer));
-
     return texture;
 }
 
@@ -309,9 +278,20 @@ void krt::CommandBuffer::SetTexture(Texture& a_Texture, uint32_t a_Binding, uint
     update.m_DescriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
 }
 
+void krt::CommandBuffer::SetStorageBuffer(Buffer& a_Buffer, uint32_t a_Binding, uint32_t a_Set)
+{
+    auto& update = m_PendingDescriptorUpdates[a_Set].emplace_back();
+    update.m_BufferUpdate = {};
+    update.m_BufferUpdate.offset = 0;
+    update.m_BufferUpdate.buffer = a_Buffer.m_VkBuffer;
+    update.m_BufferUpdate.range = VK_WHOLE_SIZE;
+    update.m_TargetBinding = a_Binding;
+    update.m_DescriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+}
+
 void krt::CommandBuffer::SetMaterial(Material& a_Material, uint32_t a_Set)
 {
-    auto& descriptorSet = a_Material.GetDescriptorSet(*m_CurrentGraphicsPipeline, a_Set);
+    auto& descriptorSet = a_Material.GetDescriptorSet(*m_CurrentGraphicsPipeline, a_Set, m_CommandQueue);
     SetDescriptorSet(descriptorSet, a_Set);
 }
 
@@ -350,6 +330,7 @@ void krt::CommandBuffer::BindDescriptorSets()
             switch (change.m_DescriptorType)
             {
             case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER:
+            case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER:
                 writeInfo.pBufferInfo = &change.m_BufferUpdate;
                 break;
             case VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE:
@@ -373,10 +354,26 @@ void krt::CommandBuffer::BindDescriptorSets()
     }
 
     m_PendingDescriptorUpdates.clear();
+
+    // The sets of frame data are the same for every draw of the frame, only their dynamic offsets move
+    for (auto& pending : m_PendingDynamicSets)
+    {
+        auto set = m_Services.m_FrameAllocator->GetDescriptorSet(*m_CurrentGraphicsPipeline, pending.first, *pending.second.m_Buffer);
+
+        std::vector<uint32_t> offsets;
+        offsets.reserve(pending.second.m_Offsets.size());
+        for (auto& offset : pending.second.m_Offsets)
+            offsets.push_back(offset.second);
+
+        vkCmdBindDescriptorSets(m_VkCommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_CurrentGraphicsPipeline->m_VkPipelineLayout,
+            pending.first, 1, &set, static_cast<uint32_t>(offsets.size()), offsets.data());
+    }
+
+    m_PendingDynamicSets.clear();
 }
 
 void krt::CommandBuffer::TransitionImageLayout(VkImage a_VkImage, VkImageLayout a_OldLayout, VkImageLayout a_NewLayout, VkAccessFlags a_SrcAccessMask, VkAccessFlags
-                                               a_DstAccessMask, VkPipelineStageFlags a_SrcStageMask, VkPipelineStageFlags a_DstStageMask)
+                                               a_DstAccessMask, VkPipelineStageFlags a_SrcStageMask, VkPipelineStageFlags a_DstStageMask, uint32_t a_NumMips)
 {
     VkImageMemoryBarrier imageBarrier = {};
     imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
@@ -389,7 +386,7 @@ void krt::CommandBuffer::TransitionImageLayout(VkImage a_VkImage, VkImageLayout
     imageBarrier.subresourceRange.baseArrayLayer = 0;
     imageBarrier.subresourceRange.layerCount = 1;
     imageBarrier.subresourceRange.baseMipLevel = 0;
-    imageBarrier.subresourceRange.levelCount = 1;
+    imageBarrier.subresourceRange.levelCount = a_NumMips;
     imageBarrier.srcAccessMask = a_SrcAccessMask;
     imageBarrier.dstAccessMask = a_DstAccessMask;
 
@@ -407,18 +404,11 @@ std::unique_ptr<krt::VertexBuffer> krt::CommandBuffer::CreateVertexBuffer(void*
 
     uint64_t bufferSize = a_NumElements * a_ElementSize;
 
-    auto staging = m_Services.m_LogicalDevice->CreateBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, 
-                                                                    VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,{ ETransferQueue });
-
     auto local = m_Services.m_LogicalDevice->CreateBuffer<VertexBuffer>(bufferSize,
-        usageFlags, memoryProperties, a_QueuesWithAccess);
+        usageFlags, memoryProperties, a_QueuesWithAccess, EGeometryMemory);
 
     local->m_NumElements = static_cast<uint32_t>(a_NumElements);
-    m_Services.m_LogicalDevice->CopyToDeviceMemory(staging->m_VkDeviceMemory, a_BufferData, bufferSize);
-
-    BufferCopy(*staging, *local, bufferSize);
-
-    m_IntermediateBuffers.push_back(std::move(staging));
+    StageBufferUpload(a_BufferData, bufferSize, local->m_VkBuffer);
 
     return local;
 }
@@ -431,10 +421,8 @@ std::unique_ptr<krt::IndexBuffer> krt::CommandBuffer::CreateIndexBuffer(void* a_
     const VkBufferUsageFlags usageFlags = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT;
     const VkMemoryPropertyFlags memoryProperties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
 
-    auto staging = m_Services.m_LogicalDevice->CreateBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, 
-        VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, {ETransferQueue});
     auto local = m_Services.m_LogicalDevice->CreateBuffer<IndexBuffer>(bufferSize, usageFlags,
-        memoryProperties, a_QueuesWithAccess);
+        memoryProperties, a_QueuesWithAccess, EGeometryMemory);
 
     local->m_NumElements = static_cast<uint32_t>(a_NumElements);
 
@@ -444,20 +432,46 @@ std::unique_ptr<krt::IndexBuffer> krt::CommandBuffer::CreateIndexBuffer(void* a_
         local->m_IndexType = VK_INDEX_TYPE_UINT16;
         break;
     case 4:
-        local->m_IndexType = VK_INDEX_TYPE_UINT16;
+        local->m_IndexType = VK_INDEX_TYPE_UINT32;
         break;
     default:
         printf("Unknown Index buffer index type with size %d\n", a_ElementSize);
         abort();
     }
 
-    m_Services.m_LogicalDevice->CopyToDeviceMemory(staging->m_VkDeviceMemory, a_IndexData, bufferSize);
+    StageBufferUpload(a_IndexData, bufferSize, local->m_VkBuffer);
 
-    BufferCopy(*staging, *local, bufferSize);
+    return std::move(local);
+}
 
-    m_IntermediateBuffers.push_back(std::move(staging));
+void krt::CommandBuffer::CopyBufferToImage(Buffer& a_SourceBuffer, VkImage a_DestinationImage, glm::uvec2 a_Dimensions,
+    VkDeviceSize a_SourceOffset, uint32_t a_MipLevel)
+{
+    CopyBufferToImage(a_SourceBuffer.m_VkBuffer, a_DestinationImage, a_Dimensions, a_SourceOffset, a_MipLevel);
+}
 
-    return std::move(local);
+void krt::CommandBuffer::CopyBufferToImage(VkBuffer a_SourceBuffer, VkImage a_DestinationImage, glm::uvec2 a_Dimensions,
+    VkDeviceSize a_SourceOffset, uint32_t a_MipLevel, uint32_t a_FirstRow)
+{
+    VkBufferImageCopy copy;
+    copy.bufferImageHeight = 0;
+    copy.bufferOffset = a_SourceOffset;
+    copy.bufferRowLength = 0;
+
+    copy.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    copy.imageSubresource.baseArrayLayer = 0;
+    copy.imageSubresource.layerCount = 1;
+    copy.imageSubresource.mipLevel = a_MipLevel;
+
+    copy.imageOffset = { 0, static_cast<int32_t>(a_FirstRow), 0 };
+    copy.imageExtent = { a_Dimensions.x, a_Dimensions.y, 1 };
+
+    vkCmdCopyBufferToImage(m_VkCommandBuffer, a_SourceBuffer, a_DestinationImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copy);
+}
+
+void krt::CommandBuffer::AddIntermediateBuffer(std::unique_ptr<Buffer> a_Buffer)
+{
+    m_IntermediateBuffers.push_back(std::move(a_Buffer));
 }
 
 void krt::CommandBuffer::BufferCopy(Buffer& a_SourceBuffer, Buffer& a_DestinationBuffer, VkDeviceSize a_Size, VkDeviceSize a_SourceOffset, VkDeviceSize a_DestinationOffset)
@@ -484,41 +498,102 @@ bool krt::CommandBuffer::UploadToBuffer(const void* a_Data, VkDeviceSize a_DataS
         resized = true;
     }
 
-    // If the memory of the target buffer allows a direct copy from CPU memory, there is no need for staging buffers
-    if (a_TargetBuffer.m_MemoryPropertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT
-        && a_TargetBuffer.m_MemoryPropertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)
+    // If the memory of the target buffer allows a direct copy from CPU memory, there is no need for staging buffers.
+    // Memory that is not coherent is flushed by the copy.
+    if (a_TargetBuffer.m_MemoryPropertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
     {
-        m_Services.m_LogicalDevice->CopyToDeviceMemory(a_TargetBuffer.m_VkDeviceMemory, a_Data, a_DataSize);
+        m_Services.m_LogicalDevice->CopyToDeviceMemory(a_TargetBuffer.m_Allocation, a_Data, a_DataSize);
         return resized;
     }
 
-    auto& staging = m_IntermediateBuffers.emplace_back(std::move(m_Services.m_LogicalDevice->CreateBuffer(a_DataSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, { ETransferQueue })));
+    StageBufferUpload(a_Data, a_DataSize, a_TargetBuffer.m_VkBuffer);
+    return resized;
+}
 
-    m_Services.m_LogicalDevice->CopyToDeviceMemory(staging->m_VkDeviceMemory, a_Data, a_DataSize);
+krt::CommandBuffer::StagingRange krt::CommandBuffer::ReserveStaging(VkDeviceSize a_Size, VkDeviceSize a_Alignment)
+{
+    auto& ring = m_Services.m_LogicalDevice->GetStagingRing();
 
-    BufferCopy(*staging, a_TargetBuffer, a_DataSize);
-    return resized;
+    StagingRing::Range range;
+    while (!ring.Reserve(a_Size, a_Alignment, range))
+    {
+        // Wait for the submission which holds the oldest range of the ring to free it. If that range has not been submitted yet,
+        // possibly because it belongs to this command buffer, waiting would never end, so the data gets a staging buffer of its own.
+        ECommandQueueType queue;
+        uint64_t submissionIndex;
+        if (!ring.GetOldestSubmission(queue, submissionIndex))
+        {
+            ring.CountFallbackBuffer();
+
+            auto buffer = m_Services.m_LogicalDevice->CreateBuffer(a_Size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, { m_CommandQueue.GetType() },
+                EStagingMemory, "Staging fallback");
+
+            StagingRange fallback = { buffer->m_VkBuffer, 0, buffer->GetMappedData() };
+            m_IntermediateBuffers.push_back(std::move(buffer));
+            return fallback;
+        }
+
+        auto& commandQueue = m_Services.m_LogicalDevice->GetCommandQueue(queue);
+        if (!commandQueue.IsSubmissionComplete(submissionIndex))
+        {
+            ring.CountWait();
+            commandQueue.WaitForSubmission(submissionIndex);
+        }
+    }
+
+    m_StagingRanges.push_back(range.m_Id);
+    return { range.m_VkBuffer, range.m_Offset, range.m_Mapped };
 }
 
+void krt::CommandBuffer::StageBufferUpload(const void* a_Data, VkDeviceSize a_DataSize, VkBuffer a_TargetBuffer)
+{
+    // Large uploads are streamed in chunks, so they never hold more than a chunk of the ring at once
+    const VkDeviceSize chunkSize = StagingRing::ChunkSize;
+    auto* data = static_cast<const uint8_t*>(a_Data);
 
-void krt::CommandBuffer::SetUniformBuffer(const void* a_Data, uint64_t a_DataSize, uint32_t a_Binding, uint32_t a_Set)
+    for (VkDeviceSize offset = 0; offset < a_DataSize; offset += chunkSize)
+    {
+        VkDeviceSize size = std::min(a_DataSize - offset, chunkSize);
+
+        auto staging = ReserveStaging(size, constants::StagingBufferAlignment);
+        memcpy(staging.m_Mapped, data + offset, size);
+
+        BufferCopy(staging.m_VkBuffer, a_TargetBuffer, size, staging.m_Offset, offset);
+    }
+}
+
+krt::FrameAllocator::Allocation krt::CommandBuffer::CreateTransientBuffer(const void* a_Data, uint64_t a_DataSize)
 {
-    auto buffer = m_Services.m_LogicalDevice->CreateBuffer(a_DataSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-                                                                   VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, { m_CommandQueue.GetType() });
+    m_UsesFrameData = true;
+    return m_Services.m_FrameAllocator->Allocate(a_Data, a_DataSize);
+}
 
-    m_Services.m_LogicalDevice->CopyToDeviceMemory(buffer->m_VkDeviceMemory, a_Data, a_DataSize);
+krt::FrameAllocator::Allocation krt::CommandBuffer::CreateTransientStorageBuffer(const void* a_Data, uint64_t a_DataSize)
+{
+    m_UsesFrameData = true;
+    auto& frameAllocator = *m_Services.m_FrameAllocator;
+    return frameAllocator.Allocate(a_Data, a_DataSize, frameAllocator.GetStorageRange());
+}
 
-    m_IntermediateBuffers.push_back(std::move(buffer));
+void krt::CommandBuffer::SetDynamicBuffer(const FrameAllocator::Allocation& a_Allocation, uint32_t a_Binding, uint32_t a_Set)
+{
+    auto& dynamicSet = m_PendingDynamicSets[a_Set];
+    assert((dynamicSet.m_Offsets.empty() || dynamicSet.m_Buffer == a_Allocation.m_Buffer) &&
+        "All dynamic buffers of a set have to be allocated from the same frame buffer.");
 
-    auto& update = m_PendingDescriptorUpdates[a_Set].emplace_back();
-    update.m_BufferUpdate = {};
-    update.m_BufferUpdate.offset = 0;
-    update.m_BufferUpdate.buffer = m_IntermediateBuffers.back()->m_VkBuffer;
-    update.m_BufferUpdate.range = VK_WHOLE_SIZE;
-    update.m_TargetBinding = a_Binding;
-    update.m_DescriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    dynamicSet.m_Buffer = a_Allocation.m_Buffer;
+    dynamicSet.m_Offsets[a_Binding] = static_cast<uint32_t>(a_Allocation.m_Offset);
+}
+
+void krt::CommandBuffer::SetUniformBuffer(const void* a_Data, uint64_t a_DataSize, uint32_t a_Binding, uint32_t a_Set)
+{
+    // The data is bump allocated from the frame, and bound through a dynamic uniform buffer descriptor
+    m_UsesFrameData = true;
+    auto& frameAllocator = *m_Services.m_FrameAllocator;
+    auto allocation = frameAllocator.Allocate(a_Data, a_DataSize, frameAllocator.GetUniformRange());
 
+    SetDynamicBuffer(allocation, a_Binding, a_Set);
 }
 
 void krt::CommandBuffer::PushConstant(const void* a_Data, uint32_t a_DataSize, uint32_t a_Slot)
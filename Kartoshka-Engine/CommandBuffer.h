@@ -2,6 +2,7 @@
 
 
 #include "VkHelpers.h"
+#include "FrameAllocator.h"
 
 #include "vulkan/vulkan.h"
 
@@ -54,7 +55,8 @@ namespace krt
         void Reset();
         void Begin();
         void End();
-        void Submit();
+        // Submits the command buffer to its queue and returns the index of the submission
+        uint64_t Submit();
 
         // Adds a semaphore that should be signaled once the command buffer's execution is finished
         void AddSignalSemaphore(Semaphore a_Semaphore);
@@ -67,13 +69,15 @@ namespace krt
         void SetViewport(const VkViewport& a_Viewport);
         void SetScissorRect(const VkRect2D& a_Scissor);
 
-        void SetVertexBuffer(VertexBuffer& a_VertexBuffer, uint32_t a_Binding, VkDeviceSize a_Offset = 0);
+        void SetVertexBuffer(Buffer& a_VertexBuffer, uint32_t a_Binding, VkDeviceSize a_Offset = 0);
         void SetIndexBuffer(IndexBuffer& a_IndexBuffer, uint32_t a_Offset = 0);
         void BindPipeline(GraphicsPipeline& a_Pipeline);
         
         void SetDescriptorSet(DescriptorSet& a_Set, uint32_t a_Slot);
         void SetSampler(Sampler& a_Sampler, uint32_t a_Binding, uint32_t a_Set);
         void SetTexture(Texture& a_Texture, uint32_t a_Binding, uint32_t a_Set);
+        // The buffer has to stay alive until the command buffer has finished executing
+        void SetStorageBuffer(Buffer& a_Buffer, uint32_t a_Binding, uint32_t a_Set);
 
         void SetMaterial(Material& a_Material, uint32_t a_Set);
 
@@ -88,6 +92,7 @@ namespace krt
         std::unique_ptr<Texture> CreateTexture(void* a_Data, glm::uvec2 a_Dimensions, const uint8_t a_NumChannels, const uint8_t a_BytesPerChannel,
             std::set<ECommandQueueType> a_QueuesWithAccess, VkPipelineStageFlags a_UsingStages = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
 
+        // Copies the data into the buffer of the current frame and binds it to a dynamic uniform buffer binding, see SetDynamicBuffer
         template<typename DataType>
         void SetUniformBuffer(const DataType& a_Data, uint32_t a_Binding, uint32_t a_Set);
 
@@ -112,15 +117,49 @@ namespace krt
         // Performs from the source Buffer object to the destination Buffer object based on the given copy region size and offsets
         void BufferCopy(VkBuffer a_SourceBuffer, VkBuffer a_DestinationBuffer, VkDeviceSize a_Size, VkDeviceSize a_SourceOffset = 0, VkDeviceSize a_DestinationOffset = 0);
 
+        // Copies tightly packed pixel data from the source Buffer object to one mip level of an image in the transfer destination layout.
+        // a_Dimensions are the dimensions of that level.
+        void CopyBufferToImage(Buffer& a_SourceBuffer, VkImage a_DestinationImage, glm::uvec2 a_Dimensions, VkDeviceSize a_SourceOffset = 0,
+                               uint32_t a_MipLevel = 0);
+        // Copies a band of rows instead, a_Dimensions are the width of the level and the number of rows
+        void CopyBufferToImage(VkBuffer a_SourceBuffer, VkImage a_DestinationImage, glm::uvec2 a_Dimensions, VkDeviceSize a_SourceOffset,
+                               uint32_t a_MipLevel, uint32_t a_FirstRow = 0);
+
+        struct StagingRange
+        {
+            VkBuffer m_VkBuffer;
+            VkDeviceSize m_Offset;
+            uint8_t* m_Mapped;  // Start of the range, the data has to be written here before the command buffer is submitted
+        };
+
+        // Reserves a range of the staging ring which is reclaimed once the command buffer has finished executing.
+        // Waits for older submissions if the ring is full, and only creates a staging buffer if the ring is held by unsubmitted uploads.
+        StagingRange ReserveStaging(VkDeviceSize a_Size, VkDeviceSize a_Alignment);
+
+        // Keeps the buffer alive until the command buffer has finished executing
+        void AddIntermediateBuffer(std::unique_ptr<Buffer> a_Buffer);
+
+        // Copies the data into the buffer of the current frame, for vertex data that changes every frame.
+        // The command buffer has to be submitted in the frame the data was created in.
+        FrameAllocator::Allocation CreateTransientBuffer(const void* a_Data, uint64_t a_DataSize);
+        // Same as CreateTransientBuffer, for data that is read through a dynamic storage buffer descriptor
+        FrameAllocator::Allocation CreateTransientStorageBuffer(const void* a_Data, uint64_t a_DataSize);
+        // Binds frame data to a binding of a set which only holds dynamic buffers. The set stays the same, only its dynamic offset changes.
+        void SetDynamicBuffer(const FrameAllocator::Allocation& a_Allocation, uint32_t a_Binding, uint32_t a_Set);
+
         // Transfers the CPU data to a GPU buffer, even if the buffer is not in host visible memory.
         // Returns true if the target buffer was resized, false otherwise.
         bool UploadToBuffer(const void* a_Data, VkDeviceSize a_DataSize, Buffer& a_TargetBuffer);
+        // Transitions the first a_NumMips levels of the image
         void TransitionImageLayout(VkImage a_VkImage, VkImageLayout a_OldLayout, VkImageLayout a_NewLayout, VkAccessFlags a_SrcAccessMask, VkAccessFlags
-                                   a_DstAccessMask, VkPipelineStageFlags a_SrcStageMask, VkPipelineStageFlags a_DstStageMask);
+                                   a_DstAccessMask, VkPipelineStageFlags a_SrcStageMask, VkPipelineStageFlags a_DstStageMask, uint32_t a_NumMips = 1);
     private:
 
         void BindDescriptorSets();
 
+        // Copies the data to the target buffer through the staging ring
+        void StageBufferUpload(const void* a_Data, VkDeviceSize a_DataSize, VkBuffer a_TargetBuffer);
+
 
 
 
@@ -135,6 +174,8 @@ namespace krt
 
         std::vector<std::unique_ptr<Buffer>> m_IntermediateBuffers;
         std::vector<std::unique_ptr<DescriptorSetAllocation>> m_IntermediateDescriptorSetAllocations;
+        // Ids of the staging ring ranges the command buffer copies from
+        std::vector<uint64_t> m_StagingRanges;
 
         std::set<Semaphore> m_SignalSemaphores;
         mutable std::vector<SemaphoreWait> m_WaitSemaphores;
@@ -153,6 +194,17 @@ namespace krt
         std::map<uint32_t, std::vector<DescriptorUpdate>>  m_PendingDescriptorUpdates;
         std::map<uint32_t, VkDescriptorSet> m_CurrentlyBoundDescriptorSets;
 
+        // Sets of dynamic buffers, which are bound with the dynamic offsets of their bindings in binding order
+        struct DynamicSet
+        {
+            Buffer* m_Buffer = nullptr;
+            std::map<uint32_t, uint32_t> m_Offsets;
+        };
+
+        std::map<uint32_t, DynamicSet> m_PendingDynamicSets;
+        // Whether the command buffer reads data of the frame allocator, which then has to wait for it before reusing the data
+        bool m_UsesFrameData;
+
         bool m_HasBegun;
     };
 
@@ -5,10 +5,14 @@
 
 #include "ServiceLocator.h"
 
+#include <cassert>
+
 krt::CommandQueue::CommandQueue(ServiceLocator& a_Services, uint32_t a_QueueFamily, ECommandQueueType a_QueueType)
     : m_Services(a_Services)
     , m_QueueFamilyIndex(a_QueueFamily)
     , m_QueueType(a_QueueType)
+    , m_NextSubmissionIndex(1)
+    , m_LastCompletedSubmissionIndex(0)
 {
     vkGetDeviceQueue(m_Services.m_LogicalDevice->GetVkDevice(), m_QueueFamilyIndex, 0, &m_VkQueue);
 
@@ -24,6 +28,9 @@ krt::CommandQueue::~CommandQueue()
 {
     Flush();
 
+    // The queue is idle, so nothing can use the resources anymore
+    m_DeferredReleases = {};
+
     for (auto& buffer : m_SingleUseCommandBuffers)
     {
         buffer.reset();
@@ -38,7 +45,7 @@ void krt::CommandQueue::Flush()
     vkQueueWaitIdle(m_VkQueue);
 }
 
-void krt::CommandQueue::SubmitCommandBuffer(CommandBuffer& a_CommandBuffer)
+uint64_t krt::CommandQueue::SubmitCommandBuffer(CommandBuffer& a_CommandBuffer)
 {
     a_CommandBuffer.End();
 
@@ -79,6 +86,35 @@ void krt::CommandQueue::SubmitCommandBuffer(CommandBuffer& a_CommandBuffer)
     auto& pending = m_PendingCommandBuffers.emplace();
     pending.m_CommandBuffers.push_back(&a_CommandBuffer);
     pending.m_SyncFence = fence;
+    pending.m_SubmissionIndex = m_NextSubmissionIndex++;
+
+    return pending.m_SubmissionIndex;
+}
+
+bool krt::CommandQueue::IsSubmissionComplete(uint64_t a_SubmissionIndex)
+{
+    UpdateCommandBufferQueues();
+
+    return a_SubmissionIndex <= m_LastCompletedSubmissionIndex;
+}
+
+void krt::CommandQueue::WaitForSubmission(uint64_t a_SubmissionIndex)
+{
+    assert(a_SubmissionIndex < m_NextSubmissionIndex && "Waiting for a submission which has not been made.");
+
+    // Submissions are retired in order, so waiting on the oldest pending fence until the index is retired is enough
+    while (!IsSubmissionComplete(a_SubmissionIndex))
+    {
+        // Every index below the next one is either retired or pending, so an empty queue means the index was never submitted
+        if (m_PendingCommandBuffers.empty())
+        {
+            assert(false && "Waiting for a submission which is not pending.");
+            break;
+        }
+
+        auto fence = m_PendingCommandBuffers.front().m_SyncFence;
+        vkWaitForFences(m_Services.m_LogicalDevice->GetVkDevice(), 1, &fence, VK_TRUE, UINT64_MAX);
+    }
 }
 
 
@@ -97,6 +133,11 @@ krt::CommandBuffer& krt::CommandQueue::GetSingleUseCommandBuffer()
     return *buffer;
 }
 
+void krt::CommandQueue::ReleaseAfterSubmissions(std::shared_ptr<void> a_Resource)
+{
+    m_DeferredReleases.emplace(m_NextSubmissionIndex - 1, std::move(a_Resource));
+}
+
 VkCommandPool krt::CommandQueue::GetVkCommandPool()
 {
     return m_VkCommandPool;
@@ -124,12 +165,16 @@ void krt::CommandQueue::UpdateCommandBufferQueues()
 
             vkResetFences(m_Services.m_LogicalDevice->GetVkDevice(), 1, &front.m_SyncFence);
             m_AvailableFences.push(front.m_SyncFence);
+            m_LastCompletedSubmissionIndex = front.m_SubmissionIndex;
         }
         else
         {
             break;
         }
     }
+
+    while (!m_DeferredReleases.empty() && m_DeferredReleases.front().first <= m_LastCompletedSubmissionIndex)
+        m_DeferredReleases.pop();
 }
 
 VkFence krt::CommandQueue::GetUnusedFence()
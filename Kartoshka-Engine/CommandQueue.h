@@ -31,12 +31,22 @@ namespace krt
         // Puts the thread to sleep until the queue is finished with its operations
         void Flush();
 
-        // Submit a single command buffer
-        void SubmitCommandBuffer(CommandBuffer& a_CommandBuffer);
+        // Submit a single command buffer. Returns an index which identifies the submission.
+        // Submission indices increase monotonically, starting at 1.
+        uint64_t SubmitCommandBuffer(CommandBuffer& a_CommandBuffer);
+
+        // Returns true once the GPU has finished executing the submission with the given index
+        bool IsSubmissionComplete(uint64_t a_SubmissionIndex);
+        // Puts the thread to sleep until the submission with the given index has finished executing
+        void WaitForSubmission(uint64_t a_SubmissionIndex);
 
         // Returns a command buffer which is not being used elsewhere in the application or pending execution
         CommandBuffer& GetSingleUseCommandBuffer();
 
+        // Keeps the resource alive until every submission made to the queue so far has finished executing,
+        // for resources that are replaced while frames which use them may still be in flight
+        void ReleaseAfterSubmissions(std::shared_ptr<void> a_Resource);
+
         VkCommandPool GetVkCommandPool();
         VkQueue GetVkQueue();
         uint32_t GetFamilyIndex() const { return m_QueueFamilyIndex; }
@@ -64,12 +74,19 @@ namespace krt
         {
             std::vector<CommandBuffer*> m_CommandBuffers;
             VkFence m_SyncFence;
+            uint64_t m_SubmissionIndex;
         };
 
         // Queue of command buffers that are currently being executed on the queue
         std::queue<PendingCommandBuffersEntry>                  m_PendingCommandBuffers;
         // Queue of command buffers that can be used to record new commands to
         std::queue<CommandBuffer*>                  m_AvailableCommandBuffers;
+
+        uint64_t m_NextSubmissionIndex;
+        uint64_t m_LastCompletedSubmissionIndex;
+
+        // Resources with the index of the last submission that may still use them
+        std::queue<std::pair<uint64_t, std::shared_ptr<void>>> m_DeferredReleases;
     };
 
 }
@@ -0,0 +1,175 @@
+#include "CrowdRenderer.h"
+
+#include "ServiceLocator.h"
+#include "VertexAnimation.h"
+#include "InstanceBatcher.h"
+#include "GraphicsPipeline.h"
+#include "LogicalDevice.h"
+#include "CommandBuffer.h"
+#include "VertexBuffer.h"
+#include "IndexBuffer.h"
+#include "UploadBatch.h"
+#include "Sampler.h"
+#include "Texture.h"
+
+#include <glm/vec2.hpp>
+#include <glm/gtc/type_precision.hpp>
+
+#include <cassert>
+#include <chrono>
+#include <cstring>
+#include <utility>
+
+krt::CrowdRenderer::CrowdRenderer(ServiceLocator& a_Services, std::shared_ptr<const VertexAnimation> a_Animation)
+    : m_Services(a_Services)
+    , m_Animation(std::move(a_Animation))
+    , m_ConstantColorOffset(0)
+    , m_NumAgents(0)
+    , m_Time(0.0f)
+{
+    assert(m_Animation && !m_Animation->m_Clips.empty());
+
+    auto samplerInfo = Sampler::CreateInfo::CreateDefault();
+    samplerInfo->magFilter = VK_FILTER_NEAREST;
+    samplerInfo->minFilter = VK_FILTER_NEAREST;
+    samplerInfo->mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    samplerInfo->anisotropyEnable = VK_FALSE;
+    samplerInfo->addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo->addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo->addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    m_Sampler = std::make_unique<Sampler>(m_Services, samplerInfo);
+
+    m_Statistics.m_AnimationMemory = m_Animation->GetMemorySize();
+}
+
+krt::CrowdRenderer::~CrowdRenderer()
+{
+}
+
+void krt::CrowdRenderer::DescribeInstanceInput(VertexInputInfo& a_VertexInput)
+{
+    static_assert(sizeof(Instance) == sizeof(glm::mat4) + 2 * sizeof(uint32_t) + 2 * sizeof(float), "The instance has to be tightly packed.");
+
+    for (uint32_t column = 0; column < 4; column++)
+        a_VertexInput.AddPerInstanceAttribute<glm::vec4>(InstanceBinding, InstanceLocation + column, VK_FORMAT_R32G32B32A32_SFLOAT);
+
+    a_VertexInput.AddPerInstanceAttribute<glm::uvec2>(InstanceBinding, ClipLocation, VK_FORMAT_R32G32_UINT);
+    a_VertexInput.AddPerInstanceAttribute<glm::vec2>(InstanceBinding, PlaybackLocation, VK_FORMAT_R32G32_SFLOAT);
+}
+
+void krt::CrowdRenderer::SetAgents(const std::vector<Agent>& a_Agents)
+{
+    auto& clips = m_Animation->m_Clips;
+
+    std::vector<Instance> instances;
+    instances.reserve(a_Agents.size());
+
+    for (auto& agent : a_Agents)
+    {
+        auto& clip = clips[agent.m_Clip % clips.size()];
+
+        auto& instance = instances.emplace_back();
+        instance.m_World = agent.m_World;
+        instance.m_FirstFrame = clip.m_FirstFrame;
+        instance.m_NumFrames = clip.m_NumFrames;
+        instance.m_TimeOffset = agent.m_TimeOffset;
+        instance.m_Rate = clip.m_Duration > 0.0f ? agent.m_Speed / clip.m_Duration : 0.0f;
+    }
+
+    m_NumAgents = static_cast<uint32_t>(instances.size());
+    m_Statistics.m_NumAgents = m_NumAgents;
+    m_InstanceBuffer.reset();
+
+    if (instances.empty())
+        return;
+
+    // A white color for every agent, which primitives without vertex colors read instead
+    uint64_t instancesSize = instances.size() * sizeof(Instance);
+    uint64_t colorsSize = instances.size() * sizeof(glm::u8vec4);
+
+    std::vector<uint8_t> data(instancesSize + colorsSize, 255);
+    memcpy(data.data(), instances.data(), instancesSize);
+
+    UploadBatch batch(m_Services);
+    batch.SetOwner("Crowd");
+    m_InstanceBuffer = batch.CreateVertexBuffer(data.data(), data.size(), 1, { EGraphicsQueue });
+    m_ConstantColorOffset = instancesSize;
+
+    batch.Submit();
+    batch.WaitUntilResident();
+}
+
+void krt::CrowdRenderer::Update(float a_DeltaTime)
+{
+    m_Time += a_DeltaTime;
+}
+
+void krt::CrowdRenderer::Draw(CommandBuffer& a_CommandBuffer, DescriptorSet& a_LightsDescriptorSet, const glm::mat4& a_ViewProjection)
+{
+    auto start = std::chrono::steady_clock::now();
+    m_Statistics.m_NumDrawCalls = 0;
+    m_Statistics.m_NumTriangles = 0;
+
+    if (!m_InstanceBuffer)
+        return;
+
+    auto& pipelines = m_Services.m_GraphicsPipelines;
+    GraphicsPipeline* boundPipeline = nullptr;
+
+    auto& primitives = m_Animation->m_Mesh->m_Primitives;
+    for (size_t i = 0; i < primitives.size(); i++)
+    {
+        auto& primitive = primitives[i];
+        auto& baked = m_Animation->m_Primitives[i];
+        if (!baked.m_Texture)
+            continue;
+
+        // The crowd pipelines have a push constant of their own, so the view projection is pushed again after switching to them
+        auto* pipeline = pipelines.at(primitive.m_ConstantColor ? ForwardCrowdConstantColor : ForwardCrowd);
+        if (pipeline != boundPipeline)
+        {
+            a_CommandBuffer.BindPipeline(*pipeline);
+            a_CommandBuffer.SetDescriptorSet(a_LightsDescriptorSet, 1);
+            a_CommandBuffer.PushConstant(a_ViewProjection, 0);
+            boundPipeline = pipeline;
+        }
+
+        PushConstants constants;
+        constants.m_BoundsMin = baked.m_BoundsMin;
+        constants.m_Time = m_Time;
+        constants.m_BoundsExtent = baked.m_BoundsExtent;
+        constants.m_RowsPerFrame = baked.m_RowsPerFrame;
+        a_CommandBuffer.PushConstant(constants, 1);
+
+        primitive.BindVertexBuffers(a_CommandBuffer);
+        a_CommandBuffer.SetVertexBuffer(*m_InstanceBuffer, InstanceBinding);
+        if (primitive.m_ConstantColor)
+            a_CommandBuffer.SetVertexBuffer(*m_InstanceBuffer, InstanceBatcher::ConstantColorBinding, m_ConstantColorOffset);
+
+        a_CommandBuffer.SetTexture(*baked.m_Texture, 0, AnimationSet);
+        a_CommandBuffer.SetSampler(*m_Sampler, 1, AnimationSet);
+
+        if (primitive.m_Material)
+            a_CommandBuffer.SetMaterial(*primitive.m_Material, 0);
+
+        // The agents are spread over the scene, so the primitives are drawn whole instead of culling their meshlets
+        if (primitive.m_IndexBuffer)
+        {
+            auto numIndices = primitive.m_IndexBuffer->GetElementCount();
+            a_CommandBuffer.SetIndexBuffer(*primitive.m_IndexBuffer);
+            a_CommandBuffer.DrawIndexed(numIndices, m_NumAgents);
+            m_Statistics.m_NumTriangles += static_cast<uint64_t>(numIndices / 3) * m_NumAgents;
+        }
+        else
+        {
+            auto numVertices = primitive.m_Positions->GetElementCount();
+            a_CommandBuffer.Draw(numVertices, m_NumAgents);
+            m_Statistics.m_NumTriangles += static_cast<uint64_t>(numVertices / 3) * m_NumAgents;
+        }
+
+        m_Statistics.m_NumDrawCalls++;
+    }
+
+    using Milliseconds = std::chrono::duration<float, std::milli>;
+    m_Statistics.m_RecordTime = std::chrono::duration_cast<Milliseconds>(std::chrono::steady_clock::now() - start).count();
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace krt
+{
+    struct ServiceLocator;
+    struct VertexAnimation;
+    class VertexBuffer;
+    class Sampler;
+    class CommandBuffer;
+    class DescriptorSet;
+    class VertexInputInfo;
+}
+
+namespace krt
+{
+    // Draws every agent of a crowd as an instance of one mesh, animated by the vertex animation it was baked into.
+    // The agents are uploaded once, with the clip, time offset and speed each of them plays, and the vertex shader
+    // picks their frames from the time that is pushed for the whole crowd. Recording a frame costs the same for any number of agents.
+    class CrowdRenderer
+    {
+    public:
+
+        // Binding of the agents, whose world matrix takes up the four locations from InstanceLocation on
+        static const uint32_t InstanceBinding = 5;
+        static const uint32_t InstanceLocation = 5;
+        // The first and number of frames of the clip of an agent follow its world matrix, and its time offset and playback rate those
+        static const uint32_t ClipLocation = InstanceLocation + 4;
+        static const uint32_t PlaybackLocation = ClipLocation + 1;
+        // Descriptor set of the vertex animation texture and its sampler, after the material and the lights
+        static const uint32_t AnimationSet = 2;
+
+        struct Agent
+        {
+            glm::mat4 m_World;
+            uint32_t m_Clip;        // Wraps around the clips of the animation
+            float m_TimeOffset;     // Seconds the agent is ahead of the crowd
+            float m_Speed = 1.0f;
+        };
+
+        // Pushed for every primitive after the view projection, see CrowdVertex.glsl
+        struct PushConstants
+        {
+            glm::vec3 m_BoundsMin;
+            float m_Time;
+            glm::vec3 m_BoundsExtent;
+            uint32_t m_RowsPerFrame;
+        };
+
+        struct Statistics
+        {
+            uint32_t m_NumAgents = 0;
+            uint32_t m_NumDrawCalls = 0;
+            uint64_t m_NumTriangles = 0;
+            uint64_t m_AnimationMemory = 0;    // Bytes of the vertex animation textures
+            float m_RecordTime = 0.0f;         // Milliseconds it took to record the draws
+        };
+
+        CrowdRenderer(ServiceLocator& a_Services, std::shared_ptr<const VertexAnimation> a_Animation);
+        ~CrowdRenderer();
+
+        CrowdRenderer(CrowdRenderer&) = delete;
+        CrowdRenderer(CrowdRenderer&&) = delete;
+        CrowdRenderer& operator=(CrowdRenderer&) = delete;
+        CrowdRenderer& operator=(CrowdRenderer&&) = delete;
+
+        // Adds the per instance world matrix, clip and playback of the crowd pipelines
+        static void DescribeInstanceInput(VertexInputInfo& a_VertexInput);
+
+        // Uploads the agents and blocks until they are resident, which may only happen while no frame that draws the crowd is in flight
+        void SetAgents(const std::vector<Agent>& a_Agents);
+
+        // Advances the time of the whole crowd, the agents never change on the CPU
+        void Update(float a_DeltaTime);
+
+        // Draws every primitive of the animation once for all agents, with the crowd pipelines of the service locator.
+        // Leaves whichever crowd pipeline it bound last bound, with the lights in their descriptor set.
+        void Draw(CommandBuffer& a_CommandBuffer, DescriptorSet& a_LightsDescriptorSet, const glm::mat4& a_ViewProjection);
+
+        const Statistics& GetStatistics() const { return m_Statistics; }
+
+    private:
+
+        // Per agent data as it is laid out in the instance buffer
+        struct Instance
+        {
+            glm::mat4 m_World;
+            uint32_t m_FirstFrame;
+            uint32_t m_NumFrames;
+            float m_TimeOffset;
+            float m_Rate;       // Loops of the clip per second
+        };
+
+        ServiceLocator& m_Services;
+        std::shared_ptr<const VertexAnimation> m_Animation;
+
+        // Texels are fetched by their coordinates, so the sampler never filters
+        std::unique_ptr<Sampler> m_Sampler;
+
+        // The colors follow the agents in the same buffer, for primitives with a constant color
+        std::unique_ptr<VertexBuffer> m_InstanceBuffer;
+        uint64_t m_ConstantColorOffset;
+        uint32_t m_NumAgents;
+
+        float m_Time;
+
+        Statistics m_Statistics;
+    };
+}
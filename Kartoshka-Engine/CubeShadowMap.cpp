@@ -75,16 +75,8 @@ void krt::CubeShadowMap::CreateImage()
 
     vkCreateImage(m_Services.m_LogicalDevice->GetVkDevice(), &info, m_Services.m_AllocationCallbacks, &m_VkImage);
 
-    auto memInfo = m_Services.m_PhysicalDevice->GetMemoryInfoForImage(m_VkImage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-
-    VkMemoryAllocateInfo allocInfo = {};
-    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocInfo.allocationSize = memInfo.m_Size;
-    allocInfo.memoryTypeIndex = memInfo.m_MemoryType;
-
-    vkAllocateMemory(m_Services.m_LogicalDevice->GetVkDevice(), &allocInfo, m_Services.m_AllocationCallbacks, &m_VkDeviceMemory);
-
-    vkBindImageMemory(m_Services.m_LogicalDevice->GetVkDevice(), m_VkImage, m_VkDeviceMemory, 0);
+    m_Allocation = m_Services.m_LogicalDevice->GetMemoryAllocator().BindImage(m_VkImage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    m_Services.m_LogicalDevice->GetMemoryTracker().Track(static_cast<Texture*>(this), m_Allocation, EShadowMapMemory, "Cube shadow map");
 
 }
 
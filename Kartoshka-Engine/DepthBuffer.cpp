@@ -34,15 +34,8 @@ krt::DepthBuffer::DepthBuffer(ServiceLocator& a_Services, uint32_t a_Width, uint
     
     vkCreateImage(m_Services.m_LogicalDevice->GetVkDevice(), &imageInfo, m_Services.m_AllocationCallbacks, &m_VkImage);
 
-    auto memoryInfo = m_Services.m_PhysicalDevice->GetMemoryInfoForImage(m_VkImage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-
-    VkMemoryAllocateInfo allocInfo = {};
-    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocInfo.memoryTypeIndex = memoryInfo.m_MemoryType;
-    allocInfo.allocationSize = memoryInfo.m_Size;
-
-    vkAllocateMemory(m_Services.m_LogicalDevice->GetVkDevice(), &allocInfo, m_Services.m_AllocationCallbacks, &m_VkDeviceMemory);
-    vkBindImageMemory(m_Services.m_LogicalDevice->GetVkDevice(), m_VkImage, m_VkDeviceMemory, 0);
+    m_Allocation = m_Services.m_LogicalDevice->GetMemoryAllocator().BindImage(m_VkImage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    m_Services.m_LogicalDevice->GetMemoryTracker().Track(static_cast<Texture*>(this), m_Allocation, ERenderTargetMemory, "Depth buffer");
 
     VkImageViewCreateInfo viewInfo = {};
     viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
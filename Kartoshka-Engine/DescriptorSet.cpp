@@ -145,7 +145,7 @@ VkDescriptorSet krt::DescriptorSet::operator*() const
 krt::Semaphore krt::DescriptorSet::CreateBuffer(const void* a_Data, VkDeviceSize a_Size, uint32_t a_Binding, VkBufferUsageFlags a_UsageFlags)
 {
     auto buffer = m_Services.m_LogicalDevice->CreateBuffer(a_Size, VK_BUFFER_USAGE_TRANSFER_DST_BIT | a_UsageFlags,
-        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_QueuesWithAccess);
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_QueuesWithAccess, EUniformMemory, "Descriptor set");
 
     auto& transferQueue = m_Services.m_LogicalDevice->GetCommandQueue(ETransferQueue);
     auto& transferBuffer = transferQueue.GetSingleUseCommandBuffer();
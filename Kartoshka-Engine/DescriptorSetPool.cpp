@@ -30,6 +30,8 @@ krt::DescriptorSetPool::~DescriptorSetPool()
 
 std::unique_ptr<krt::DescriptorSetAllocation> krt::DescriptorSetPool::GetDescriptorSet()
 {
+    m_Services.m_LogicalDevice->CountDescriptorSet();
+
     DescriptorSetPoolPage* pageToAllocateOn = nullptr;
 
     for (auto& page : m_Pages)
@@ -22,6 +22,7 @@ krt::DescriptorSetPoolPage::DescriptorSetPoolPage(ServiceLocator& a_Services,
     poolInfo.maxSets = a_Capacity;
 
     vkCreateDescriptorPool(device, &poolInfo, m_Services.m_AllocationCallbacks, &m_VkDescriptorPool);
+    m_Services.m_LogicalDevice->CountDescriptorPool();
 
     m_AvailableDescriptorSets.resize(a_Capacity);
     std::vector<VkDescriptorSetLayout> layouts(a_Capacity, a_DescriptorSetLayout);
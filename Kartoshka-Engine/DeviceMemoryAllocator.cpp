@@ -0,0 +1,316 @@
+#include "DeviceMemoryAllocator.h"
+
+#include "ServiceLocator.h"
+#include "LogicalDevice.h"
+#include "PhysicalDevice.h"
+
+#include "VkHelpers.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace
+{
+    VkDeviceSize AlignUp(VkDeviceSize a_Value, VkDeviceSize a_Alignment)
+    {
+        return a_Alignment <= 1 ? a_Value : (a_Value + a_Alignment - 1) / a_Alignment * a_Alignment;
+    }
+}
+
+krt::DeviceMemoryAllocator::DeviceMemoryAllocator(ServiceLocator& a_Services)
+    : m_Services(a_Services)
+    , m_NumAllocations(0)
+    , m_NumDeviceAllocations(0)
+{
+    vkGetPhysicalDeviceMemoryProperties(m_Services.m_PhysicalDevice->GetPhysicalDevice(), &m_MemoryProperties);
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(m_Services.m_PhysicalDevice->GetPhysicalDevice(), &properties);
+    m_NonCoherentAtomSize = std::max<VkDeviceSize>(properties.limits.nonCoherentAtomSize, 1);
+}
+
+krt::DeviceMemoryAllocator::~DeviceMemoryAllocator()
+{
+    for (auto& pool : m_Pools)
+    {
+        for (auto& block : pool.second.m_Blocks)
+        {
+            vkFreeMemory(m_Services.m_LogicalDevice->GetVkDevice(), block->m_VkDeviceMemory, m_Services.m_AllocationCallbacks);
+        }
+    }
+}
+
+krt::DeviceMemoryAllocator::Allocation krt::DeviceMemoryAllocator::BindBuffer(VkBuffer a_Buffer, VkMemoryPropertyFlags a_MemoryProperties)
+{
+    auto memoryInfo = m_Services.m_PhysicalDevice->GetMemoryInfoForBuffer(a_Buffer, a_MemoryProperties);
+
+    auto allocation = Allocate(memoryInfo.m_MemoryType, memoryInfo.m_Size, memoryInfo.m_Alignment, false);
+    ThrowIfFailed(vkBindBufferMemory(m_Services.m_LogicalDevice->GetVkDevice(), a_Buffer, allocation.m_VkDeviceMemory, allocation.m_Offset));
+
+    return allocation;
+}
+
+krt::DeviceMemoryAllocator::Allocation krt::DeviceMemoryAllocator::BindImage(VkImage a_Image, VkMemoryPropertyFlags a_MemoryProperties)
+{
+    auto memoryInfo = m_Services.m_PhysicalDevice->GetMemoryInfoForImage(a_Image, a_MemoryProperties);
+
+    auto allocation = Allocate(memoryInfo.m_MemoryType, memoryInfo.m_Size, memoryInfo.m_Alignment, true);
+    ThrowIfFailed(vkBindImageMemory(m_Services.m_LogicalDevice->GetVkDevice(), a_Image, allocation.m_VkDeviceMemory, allocation.m_Offset));
+
+    return allocation;
+}
+
+void krt::DeviceMemoryAllocator::Free(Allocation& a_Allocation)
+{
+    if (!a_Allocation.m_Block)
+        return;
+
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    auto& block = *a_Allocation.m_Block;
+    assert(block.m_NumAllocations != 0);
+    block.m_NumAllocations--;
+    m_NumAllocations--;
+
+    if (!block.m_Dedicated)
+        AddFreeRange(block, a_Allocation.m_Offset, a_Allocation.m_Size);
+
+    a_Allocation = Allocation();
+
+    // One empty block is kept per pool, so a resource that is recreated every frame does not allocate a block every frame
+    if (block.m_NumAllocations == 0)
+    {
+        auto& blocks = block.m_Pool->m_Blocks;
+        bool keep = !block.m_Dedicated && std::none_of(blocks.begin(), blocks.end(), [&block](const std::unique_ptr<Block>& a_Other)
+        {
+            return a_Other.get() != &block && !a_Other->m_Dedicated && a_Other->m_NumAllocations == 0;
+        });
+
+        if (!keep)
+            DestroyBlock(block);
+    }
+}
+
+void krt::DeviceMemoryAllocator::Flush(const Allocation& a_Allocation, VkDeviceSize a_Offset, VkDeviceSize a_Size)
+{
+    assert(a_Allocation.m_Mapped && "Only host visible allocations can be flushed.");
+
+    // The pool and its flags never change once the block exists, so there is no need to lock
+    auto& block = *a_Allocation.m_Block;
+    if (block.m_Pool->m_PropertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)
+        return;
+
+    VkDeviceSize size = a_Size == VK_WHOLE_SIZE ? a_Allocation.m_Size - a_Offset : a_Size;
+    VkDeviceSize begin = (a_Allocation.m_Offset + a_Offset) / m_NonCoherentAtomSize * m_NonCoherentAtomSize;
+    VkDeviceSize end = std::min(AlignUp(a_Allocation.m_Offset + a_Offset + size, m_NonCoherentAtomSize), block.m_Size);
+
+    VkMappedMemoryRange range = {};
+    range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+    range.memory = block.m_VkDeviceMemory;
+    range.offset = begin;
+    range.size = end - begin;
+
+    ThrowIfFailed(vkFlushMappedMemoryRanges(m_Services.m_LogicalDevice->GetVkDevice(), 1, &range));
+}
+
+krt::DeviceMemoryAllocator::Statistics krt::DeviceMemoryAllocator::GetStatistics() const
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    Statistics statistics;
+    statistics.m_NumAllocations = m_NumAllocations;
+    statistics.m_NumDeviceAllocations = m_NumDeviceAllocations;
+
+    for (auto& pool : m_Pools)
+    {
+        for (auto& block : pool.second.m_Blocks)
+        {
+            statistics.m_NumBlocks++;
+            statistics.m_BlockMemory += block->m_Size;
+            statistics.m_HeapBlockMemory[m_MemoryProperties.memoryTypes[pool.second.m_MemoryType].heapIndex] += block->m_Size;
+
+            VkDeviceSize free = 0;
+            for (auto& range : block->m_FreeRanges)
+            {
+                free += range.second;
+                statistics.m_LargestFreeRange = std::max(statistics.m_LargestFreeRange, static_cast<uint64_t>(range.second));
+            }
+
+            if (block->m_Dedicated)
+                statistics.m_NumDedicatedBlocks++;
+
+            statistics.m_NumFreeRanges += static_cast<uint32_t>(block->m_FreeRanges.size());
+            statistics.m_FreeMemory += free;
+            statistics.m_UsedMemory += block->m_Size - free;
+        }
+    }
+
+    return statistics;
+}
+
+krt::DeviceMemoryAllocator::Allocation krt::DeviceMemoryAllocator::Allocate(uint32_t a_MemoryType, VkDeviceSize a_Size,
+    VkDeviceSize a_Alignment, bool a_Image)
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    auto& pool = m_Pools[std::make_pair(a_MemoryType, a_Image)];
+    if (pool.m_BlockSize == 0)
+    {
+        auto heapSize = m_MemoryProperties.memoryHeaps[m_MemoryProperties.memoryTypes[a_MemoryType].heapIndex].size;
+        pool.m_MemoryType = a_MemoryType;
+        pool.m_PropertyFlags = m_MemoryProperties.memoryTypes[a_MemoryType].propertyFlags;
+        pool.m_BlockSize = std::min(BlockSize, heapSize / 8) / m_NonCoherentAtomSize * m_NonCoherentAtomSize;
+    }
+
+    // Flushes of non-coherent memory cover whole atoms, which must not be shared with other allocations
+    if ((pool.m_PropertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) && !(pool.m_PropertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT))
+    {
+        a_Alignment = std::max(a_Alignment, m_NonCoherentAtomSize);
+        a_Size = AlignUp(a_Size, m_NonCoherentAtomSize);
+    }
+
+    Allocation allocation;
+    allocation.m_HeapIndex = m_MemoryProperties.memoryTypes[a_MemoryType].heapIndex;
+    m_NumAllocations++;
+
+    if (a_Size > std::min(DedicatedThreshold, pool.m_BlockSize / 2))
+    {
+        auto* block = CreateBlock(pool, a_Size, true);
+        block->m_NumAllocations++;
+
+        allocation.m_VkDeviceMemory = block->m_VkDeviceMemory;
+        allocation.m_Size = a_Size;
+        allocation.m_Mapped = block->m_Mapped;
+        allocation.m_Block = block;
+        return allocation;
+    }
+
+    for (auto& block : pool.m_Blocks)
+    {
+        if (!block->m_Dedicated && AllocateFromBlock(*block, a_Size, a_Alignment, allocation))
+            return allocation;
+    }
+
+    auto* block = CreateBlock(pool, pool.m_BlockSize, false);
+    bool allocated = AllocateFromBlock(*block, a_Size, a_Alignment, allocation);
+    assert(allocated && "An empty block has to fit any allocation below the dedicated threshold.");
+    (void)allocated;
+
+    return allocation;
+}
+
+krt::DeviceMemoryAllocator::Block* krt::DeviceMemoryAllocator::CreateBlock(Pool& a_Pool, VkDeviceSize a_Size, bool a_Dedicated)
+{
+    VkMemoryAllocateInfo allocInfo = {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = a_Size;
+    allocInfo.memoryTypeIndex = a_Pool.m_MemoryType;
+
+    auto block = std::make_unique<Block>();
+    block->m_Pool = &a_Pool;
+    block->m_Size = a_Size;
+    block->m_Dedicated = a_Dedicated;
+    block->m_NumAllocations = 0;
+    block->m_Mapped = nullptr;
+
+    ThrowIfFailed(vkAllocateMemory(m_Services.m_LogicalDevice->GetVkDevice(), &allocInfo, m_Services.m_AllocationCallbacks, &block->m_VkDeviceMemory));
+    m_NumDeviceAllocations++;
+
+    // Mapped whole until the block is freed, which unmaps it implicitly
+    if (a_Pool.m_PropertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+    {
+        void* mapped;
+        ThrowIfFailed(vkMapMemory(m_Services.m_LogicalDevice->GetVkDevice(), block->m_VkDeviceMemory, 0, VK_WHOLE_SIZE, 0, &mapped));
+        block->m_Mapped = static_cast<uint8_t*>(mapped);
+    }
+
+    if (!a_Dedicated)
+        AddFreeRange(*block, 0, a_Size);
+
+    a_Pool.m_Blocks.push_back(std::move(block));
+    return a_Pool.m_Blocks.back().get();
+}
+
+void krt::DeviceMemoryAllocator::DestroyBlock(Block& a_Block)
+{
+    vkFreeMemory(m_Services.m_LogicalDevice->GetVkDevice(), a_Block.m_VkDeviceMemory, m_Services.m_AllocationCallbacks);
+
+    auto& blocks = a_Block.m_Pool->m_Blocks;
+    blocks.erase(std::find_if(blocks.begin(), blocks.end(), [&a_Block](const std::unique_ptr<Block>& a_Other)
+    {
+        return a_Other.get() == &a_Block;
+    }));
+}
+
+bool krt::DeviceMemoryAllocator::AllocateFromBlock(Block& a_Block, VkDeviceSize a_Size, VkDeviceSize a_Alignment, Allocation& a_Allocation)
+{
+    // The smallest range that fits, skipping ranges that only fit without the padding for the alignment
+    for (auto it = a_Block.m_FreeBySize.lower_bound(a_Size); it != a_Block.m_FreeBySize.end(); ++it)
+    {
+        VkDeviceSize rangeOffset = it->second;
+        VkDeviceSize rangeSize = it->first;
+        VkDeviceSize offset = AlignUp(rangeOffset, a_Alignment);
+        if (offset + a_Size > rangeOffset + rangeSize)
+            continue;
+
+        RemoveFreeRange(a_Block, a_Block.m_FreeRanges.find(rangeOffset));
+
+        // The padding in front stays free for smaller allocations
+        if (offset != rangeOffset)
+            AddFreeRange(a_Block, rangeOffset, offset - rangeOffset);
+        if (offset + a_Size != rangeOffset + rangeSize)
+            AddFreeRange(a_Block, offset + a_Size, rangeOffset + rangeSize - offset - a_Size);
+
+        a_Block.m_NumAllocations++;
+
+        a_Allocation.m_VkDeviceMemory = a_Block.m_VkDeviceMemory;
+        a_Allocation.m_Offset = offset;
+        a_Allocation.m_Size = a_Size;
+        a_Allocation.m_Mapped = a_Block.m_Mapped ? a_Block.m_Mapped + offset : nullptr;
+        a_Allocation.m_Block = &a_Block;
+        return true;
+    }
+
+    return false;
+}
+
+void krt::DeviceMemoryAllocator::AddFreeRange(Block& a_Block, VkDeviceSize a_Offset, VkDeviceSize a_Size)
+{
+    // Merged with the free ranges right before and after it, which are never adjacent to each other
+    auto next = a_Block.m_FreeRanges.lower_bound(a_Offset);
+    if (next != a_Block.m_FreeRanges.end() && next->first == a_Offset + a_Size)
+    {
+        a_Size += next->second;
+        RemoveFreeRange(a_Block, next);
+    }
+
+    auto previous = a_Block.m_FreeRanges.lower_bound(a_Offset);
+    if (previous != a_Block.m_FreeRanges.begin())
+    {
+        --previous;
+        if (previous->first + previous->second == a_Offset)
+        {
+            a_Offset = previous->first;
+            a_Size += previous->second;
+            RemoveFreeRange(a_Block, previous);
+        }
+    }
+
+    a_Block.m_FreeRanges.emplace(a_Offset, a_Size);
+    a_Block.m_FreeBySize.emplace(a_Size, a_Offset);
+}
+
+void krt::DeviceMemoryAllocator::RemoveFreeRange(Block& a_Block, std::map<VkDeviceSize, VkDeviceSize>::iterator a_Range)
+{
+    auto sizes = a_Block.m_FreeBySize.equal_range(a_Range->second);
+    for (auto it = sizes.first; it != sizes.second; ++it)
+    {
+        if (it->second == a_Range->first)
+        {
+            a_Block.m_FreeBySize.erase(it);
+            break;
+        }
+    }
+
+    a_Block.m_FreeRanges.erase(a_Range);
+}
@@ -0,0 +1,127 @@
+#pragma once
+
+#include "vulkan/vulkan.h"
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace krt
+{
+    struct ServiceLocator;
+}
+
+namespace krt
+{
+    // Backs every buffer and texture with a range of a large block of device memory, instead of a vkAllocateMemory call each.
+    // Blocks are kept per memory type, and buffers and images get separate blocks so they never share a bufferImageGranularity page.
+    // A block hands out its free ranges best fit, and merges them with their neighbours again when they are freed.
+    // Host visible blocks are mapped for as long as they exist, so writing to an allocation never maps or unmaps memory.
+    class DeviceMemoryAllocator
+    {
+        struct Block;
+        struct Pool;
+
+    public:
+
+        // Size of the blocks, smaller on heaps where it would be more than an eighth of the heap
+        static const VkDeviceSize BlockSize = 64 * 1024 * 1024;
+        // Resources larger than this get a block of their own, so they do not leave large holes behind
+        static const VkDeviceSize DedicatedThreshold = BlockSize / 2;
+
+        // A range of a block. Bound to exactly one buffer or image, which frees it along with itself.
+        struct Allocation
+        {
+            VkDeviceMemory m_VkDeviceMemory = VK_NULL_HANDLE;
+            VkDeviceSize m_Offset = 0;
+            VkDeviceSize m_Size = 0;
+            uint8_t* m_Mapped = nullptr;    // Start of the allocation in the mapped block, null unless it is host visible
+            uint32_t m_HeapIndex = 0;
+            Block* m_Block = nullptr;
+        };
+
+        struct Statistics
+        {
+            uint32_t m_NumAllocations = 0;
+            uint32_t m_NumBlocks = 0;
+            uint32_t m_NumDedicatedBlocks = 0;     // Included in m_NumBlocks
+            uint64_t m_NumDeviceAllocations = 0;    // vkAllocateMemory calls since the allocator was created
+            uint64_t m_BlockMemory = 0;             // Bytes of all blocks
+            uint64_t m_UsedMemory = 0;              // Bytes bound to resources, the rest is free or lost to alignment
+            uint32_t m_NumFreeRanges = 0;
+            uint64_t m_FreeMemory = 0;              // Bytes of the free ranges of shared blocks
+            uint64_t m_LargestFreeRange = 0;
+            uint64_t m_HeapBlockMemory[VK_MAX_MEMORY_HEAPS] = {};    // Bytes of the blocks on each heap
+
+            // 0 while all free memory of a block is a single range, approaching 1 as it is split into many small ones
+            float GetFragmentation() const { return m_FreeMemory == 0 ? 0.0f : 1.0f - static_cast<float>(m_LargestFreeRange) / m_FreeMemory; }
+        };
+
+        explicit DeviceMemoryAllocator(ServiceLocator& a_Services);
+        ~DeviceMemoryAllocator();
+
+        DeviceMemoryAllocator(DeviceMemoryAllocator&) = delete;
+        DeviceMemoryAllocator(DeviceMemoryAllocator&&) = delete;
+        DeviceMemoryAllocator& operator=(DeviceMemoryAllocator&) = delete;
+        DeviceMemoryAllocator& operator=(DeviceMemoryAllocator&&) = delete;
+
+        // Allocates memory with the properties for the buffer or image, and binds it
+        Allocation BindBuffer(VkBuffer a_Buffer, VkMemoryPropertyFlags a_MemoryProperties);
+        Allocation BindImage(VkImage a_Image, VkMemoryPropertyFlags a_MemoryProperties);
+
+        // Returns the range to its block and resets the allocation. Does nothing for an empty allocation.
+        void Free(Allocation& a_Allocation);
+
+        // Makes host writes to the range of the allocation visible to the device, which only needs a call for non-coherent memory.
+        // Non-coherent allocations are aligned to nonCoherentAtomSize, so the rounded range never reaches into another allocation.
+        void Flush(const Allocation& a_Allocation, VkDeviceSize a_Offset = 0, VkDeviceSize a_Size = VK_WHOLE_SIZE);
+
+        Statistics GetStatistics() const;
+
+    private:
+
+        struct Block
+        {
+            Pool* m_Pool;
+            VkDeviceMemory m_VkDeviceMemory;
+            VkDeviceSize m_Size;
+            bool m_Dedicated;
+            uint32_t m_NumAllocations;
+
+            std::map<VkDeviceSize, VkDeviceSize> m_FreeRanges;          // Offset to size, to find the neighbours of a freed range
+            std::multimap<VkDeviceSize, VkDeviceSize> m_FreeBySize;     // Size to offset, to find the best fit
+
+            uint8_t* m_Mapped;
+        };
+
+        struct Pool
+        {
+            uint32_t m_MemoryType = 0;
+            VkMemoryPropertyFlags m_PropertyFlags = 0;
+            VkDeviceSize m_BlockSize = 0;     // Picked when the first resource of the pool is allocated
+            std::vector<std::unique_ptr<Block>> m_Blocks;
+        };
+
+        Allocation Allocate(uint32_t a_MemoryType, VkDeviceSize a_Size, VkDeviceSize a_Alignment, bool a_Image);
+
+        Block* CreateBlock(Pool& a_Pool, VkDeviceSize a_Size, bool a_Dedicated);
+        void DestroyBlock(Block& a_Block);
+
+        static bool AllocateFromBlock(Block& a_Block, VkDeviceSize a_Size, VkDeviceSize a_Alignment, Allocation& a_Allocation);
+        static void AddFreeRange(Block& a_Block, VkDeviceSize a_Offset, VkDeviceSize a_Size);
+        static void RemoveFreeRange(Block& a_Block, std::map<VkDeviceSize, VkDeviceSize>::iterator a_Range);
+
+        ServiceLocator& m_Services;
+        VkPhysicalDeviceMemoryProperties m_MemoryProperties;
+        VkDeviceSize m_NonCoherentAtomSize;
+
+        mutable std::mutex m_Mutex;
+        // Keyed by memory type and whether the resources are images
+        std::map<std::pair<uint32_t, bool>, Pool> m_Pools;
+
+        uint32_t m_NumAllocations;
+        uint64_t m_NumDeviceAllocations;
+    };
+}
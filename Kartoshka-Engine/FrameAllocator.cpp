@@ -0,0 +1,171 @@
+#include "FrameAllocator.h"
+
+#include "ServiceLocator.h"
+#include "LogicalDevice.h"
+#include "PhysicalDevice.h"
+#include "CommandQueue.h"
+#include "GraphicsPipeline.h"
+#include "DescriptorSetAllocation.h"
+#include "Buffer.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+namespace
+{
+    VkDeviceSize AlignUp(VkDeviceSize a_Value, VkDeviceSize a_Alignment)
+    {
+        return a_Alignment <= 1 ? a_Value : (a_Value + a_Alignment - 1) / a_Alignment * a_Alignment;
+    }
+}
+
+krt::FrameAllocator::FrameAllocator(ServiceLocator& a_Services)
+    : m_Services(a_Services)
+    , m_FrameIndex(0)
+    , m_NumGrowths(0)
+    , m_NumWaits(0)
+{
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(m_Services.m_PhysicalDevice->GetPhysicalDevice(), &properties);
+    auto& limits = properties.limits;
+
+    // Every allocation may be bound through either kind of descriptor, so all of them satisfy both offset alignments
+    m_Alignment = std::max<VkDeviceSize>({ 16, limits.minUniformBufferOffsetAlignment, limits.minStorageBufferOffsetAlignment });
+    m_UniformRange = std::min<VkDeviceSize>(limits.maxUniformBufferRange, 64 * 1024);
+    m_StorageRange = std::min<VkDeviceSize>(limits.maxStorageBufferRange, InitialFrameSize / 2);
+
+    for (auto& frame : m_Frames)
+        frame.m_Buffer = CreateFrameBuffer(InitialFrameSize);
+}
+
+krt::FrameAllocator::~FrameAllocator()
+{
+}
+
+void krt::FrameAllocator::BeginFrame()
+{
+    m_FrameIndex = (m_FrameIndex + 1) % FramesInFlight;
+    auto& frame = m_Frames[m_FrameIndex];
+
+    for (auto& submission : frame.m_Submissions)
+    {
+        auto& commandQueue = m_Services.m_LogicalDevice->GetCommandQueue(submission.first);
+        if (!commandQueue.IsSubmissionComplete(submission.second))
+        {
+            m_NumWaits++;
+            commandQueue.WaitForSubmission(submission.second);
+        }
+    }
+    frame.m_Submissions.clear();
+
+    // The descriptor sets of outgrown buffers go along with them
+    for (auto it = frame.m_DescriptorSets.begin(); it != frame.m_DescriptorSets.end();)
+    {
+        if (std::get<0>(it->first) != frame.m_Buffer.get())
+            it = frame.m_DescriptorSets.erase(it);
+        else
+            ++it;
+    }
+    frame.m_RetiredBuffers.clear();
+
+    frame.m_Offset = 0;
+    frame.m_NumAllocations = 0;
+}
+
+krt::FrameAllocator::Allocation krt::FrameAllocator::Allocate(const void* a_Data, VkDeviceSize a_Size, VkDeviceSize a_BindRange)
+{
+    assert((a_BindRange == 0 || a_Size <= a_BindRange) && "The data is larger than the descriptor it is read through.");
+
+    auto& frame = m_Frames[m_FrameIndex];
+
+    VkDeviceSize offset = AlignUp(frame.m_Offset, m_Alignment);
+    VkDeviceSize reserved = std::max(a_Size, a_BindRange);
+
+    if (offset + reserved > frame.m_Buffer->m_BufferSize)
+    {
+        // Commands recorded earlier in the frame may still read from the current buffer, so it is kept until the frame comes around again
+        auto size = std::max(frame.m_Buffer->m_BufferSize * 2, reserved);
+        frame.m_RetiredBuffers.push_back(std::move(frame.m_Buffer));
+        frame.m_Buffer = CreateFrameBuffer(size);
+        m_NumGrowths++;
+
+        offset = 0;
+    }
+
+    memcpy(frame.m_Buffer->GetMappedData() + offset, a_Data, a_Size);
+
+    frame.m_Offset = offset + a_Size;
+    frame.m_NumAllocations++;
+
+    Allocation allocation;
+    allocation.m_Buffer = frame.m_Buffer.get();
+    allocation.m_Offset = offset;
+    allocation.m_Size = a_Size;
+    return allocation;
+}
+
+void krt::FrameAllocator::AddSubmission(ECommandQueueType a_Queue, uint64_t a_SubmissionIndex)
+{
+    m_Frames[m_FrameIndex].m_Submissions.emplace_back(a_Queue, a_SubmissionIndex);
+}
+
+VkDescriptorSet krt::FrameAllocator::GetDescriptorSet(GraphicsPipeline& a_Pipeline, uint32_t a_Slot, Buffer& a_Buffer)
+{
+    auto& frame = m_Frames[m_FrameIndex];
+    auto& descriptorSet = frame.m_DescriptorSets[std::make_tuple(&a_Buffer, &a_Pipeline, a_Slot)];
+    if (descriptorSet)
+        return **descriptorSet;
+
+    descriptorSet = a_Pipeline.AllocateDescriptorSet(a_Slot);
+
+    auto& bindings = a_Pipeline.GetDescriptorSetBindings(a_Slot);
+    std::vector<VkDescriptorBufferInfo> bufferInfos(bindings.size());
+    std::vector<VkWriteDescriptorSet> writes(bindings.size());
+
+    for (size_t i = 0; i < bindings.size(); i++)
+    {
+        auto type = bindings[i].descriptorType;
+        assert((type == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC || type == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC) &&
+            "Frame data can only be bound to sets of dynamic buffers.");
+
+        // Every binding points at the start of the buffer, the dynamic offsets move it to the data of the draw
+        bufferInfos[i].buffer = a_Buffer.m_VkBuffer;
+        bufferInfos[i].offset = 0;
+        bufferInfos[i].range = type == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC ? m_UniformRange : m_StorageRange;
+
+        writes[i] = {};
+        writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writes[i].dstSet = **descriptorSet;
+        writes[i].dstBinding = bindings[i].binding;
+        writes[i].dstArrayElement = 0;
+        writes[i].descriptorCount = 1;
+        writes[i].descriptorType = type;
+        writes[i].pBufferInfo = &bufferInfos[i];
+    }
+
+    vkUpdateDescriptorSets(m_Services.m_LogicalDevice->GetVkDevice(), static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+
+    return **descriptorSet;
+}
+
+krt::FrameAllocator::Statistics krt::FrameAllocator::GetStatistics() const
+{
+    auto& frame = m_Frames[m_FrameIndex];
+
+    Statistics statistics;
+    statistics.m_FrameIndex = m_FrameIndex;
+    statistics.m_NumAllocations = frame.m_NumAllocations;
+    statistics.m_UsedBytes = frame.m_Offset;
+    statistics.m_FrameSize = frame.m_Buffer->m_BufferSize;
+    statistics.m_NumGrowths = m_NumGrowths;
+    statistics.m_NumWaits = m_NumWaits;
+    return statistics;
+}
+
+std::unique_ptr<krt::Buffer> krt::FrameAllocator::CreateFrameBuffer(VkDeviceSize a_Size)
+{
+    return m_Services.m_LogicalDevice->CreateBuffer(a_Size,
+        VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, { EGraphicsQueue }, EFrameMemory, "Frame allocator");
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include "vulkan/vulkan.h"
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+namespace krt
+{
+    struct ServiceLocator;
+    class Buffer;
+    class GraphicsPipeline;
+    class DescriptorSetAllocation;
+    enum ECommandQueueType : uint8_t;
+}
+
+namespace krt
+{
+    // Hands out the data that changes every frame, like instances, palettes and uniforms, from one large mapped buffer per frame in flight.
+    // Allocating bumps an offset, and the whole buffer is reused once the submissions of the frame that last used it have finished.
+    // Shaders read the data through dynamic uniform and storage buffer descriptors, which are written once per buffer and pipeline set,
+    // so binding new data only changes the dynamic offset.
+    // Only the thread which records the frames uses it.
+    class FrameAllocator
+    {
+    public:
+
+        static const uint32_t FramesInFlight = 3;
+        static const VkDeviceSize InitialFrameSize = 16 * 1024 * 1024;
+
+        struct Allocation
+        {
+            Buffer* m_Buffer = nullptr;
+            VkDeviceSize m_Offset = 0;
+            VkDeviceSize m_Size = 0;
+        };
+
+        struct Statistics
+        {
+            uint32_t m_FrameIndex = 0;
+            uint32_t m_NumAllocations = 0;  // Allocations of the current frame so far
+            uint64_t m_UsedBytes = 0;       // Bytes of the current frame so far, including alignment
+            uint64_t m_FrameSize = 0;       // Size of the buffer of the current frame
+            uint64_t m_NumGrowths = 0;      // Times a frame did not fit its buffer and got a larger one
+            uint64_t m_NumWaits = 0;        // Times a frame waited for the one that last used its buffer
+        };
+
+        explicit FrameAllocator(ServiceLocator& a_Services);
+        ~FrameAllocator();
+
+        FrameAllocator(FrameAllocator&) = delete;
+        FrameAllocator(FrameAllocator&&) = delete;
+        FrameAllocator& operator=(FrameAllocator&) = delete;
+        FrameAllocator& operator=(FrameAllocator&&) = delete;
+
+        // Moves on to the buffer of the next frame, waiting until the submissions of the frame which used it before have finished
+        void BeginFrame();
+
+        // Copies the data into the buffer of the current frame. a_BindRange is the range of the dynamic descriptor the data is read through,
+        // which has to fit in the buffer from the offset on even where the data is smaller.
+        Allocation Allocate(const void* a_Data, VkDeviceSize a_Size, VkDeviceSize a_BindRange = 0);
+
+        // The data of the current frame is read by this submission
+        void AddSubmission(ECommandQueueType a_Queue, uint64_t a_SubmissionIndex);
+
+        // Returns the descriptor set of a_Slot of the pipeline that points at a buffer of the current frame. Every binding of the set has to
+        // be a dynamic uniform or storage buffer. The set is written the first time it is requested and never changes afterwards.
+        VkDescriptorSet GetDescriptorSet(GraphicsPipeline& a_Pipeline, uint32_t a_Slot, Buffer& a_Buffer);
+
+        // Ranges of the dynamic descriptors, so data bound through them can be at most this large
+        VkDeviceSize GetUniformRange() const { return m_UniformRange; }
+        VkDeviceSize GetStorageRange() const { return m_StorageRange; }
+
+        Statistics GetStatistics() const;
+
+    private:
+
+        struct Frame
+        {
+            std::unique_ptr<Buffer> m_Buffer;
+            VkDeviceSize m_Offset = 0;
+            uint32_t m_NumAllocations = 0;
+
+            std::vector<std::pair<ECommandQueueType, uint64_t>> m_Submissions;
+            // Buffers the frame outgrew, which earlier commands of the frame may still read from
+            std::vector<std::unique_ptr<Buffer>> m_RetiredBuffers;
+
+            std::map<std::tuple<Buffer*, GraphicsPipeline*, uint32_t>, std::unique_ptr<DescriptorSetAllocation>> m_DescriptorSets;
+        };
+
+        std::unique_ptr<Buffer> CreateFrameBuffer(VkDeviceSize a_Size);
+
+        ServiceLocator& m_Services;
+
+        VkDeviceSize m_Alignment;
+        VkDeviceSize m_UniformRange;
+        VkDeviceSize m_StorageRange;
+
+        Frame m_Frames[FramesInFlight];
+        uint32_t m_FrameIndex;
+
+        uint64_t m_NumGrowths;
+        uint64_t m_NumWaits;
+    };
+}
@@ -0,0 +1,266 @@
+#include "GltfSource.h"
+
+#include "MappedFile.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+krt::GltfSource::GltfSource(const std::string& a_Path)
+    : m_RootPath(fx::gltf::detail::GetDocumentRootPath(a_Path))
+    , m_IsBinary(false)
+{
+    auto file = std::make_unique<MappedFile>(a_Path);
+
+    uint32_t magic = 0;
+    if (file->GetSize() >= sizeof(magic))
+        memcpy(&magic, file->GetData(), sizeof(magic));
+
+    m_IsBinary = magic == fx::gltf::detail::GLBHeaderMagic;
+
+    ByteSpan json = { file->GetData(), file->GetSize() };
+    ByteSpan glbBinary = { nullptr, 0 };
+
+    if (m_IsBinary)
+        ParseGlb(*file, json, glbBinary);
+
+    try
+    {
+        // Converting straight from JSON skips fx::gltf's own buffer loading, which would read every buffer into the heap
+        m_Document = nlohmann::json::parse(json.m_Data, json.m_Data + json.m_Size);
+    }
+    catch (...)
+    {
+        std::throw_with_nested(fx::gltf::invalid_gltf_document("Invalid glTF document. See nested exception for details."));
+    }
+
+    LoadBuffers(glbBinary);
+    LoadImages();
+    ResolveSparseAccessors();
+
+    // The binary chunk of a .glb file points into its mapping, a .gltf file is no longer needed after parsing
+    if (m_IsBinary)
+        m_MappedFiles.push_back(std::move(file));
+}
+
+krt::GltfSource::~GltfSource()
+{
+}
+
+krt::ByteSpan krt::GltfSource::GetBufferView(int32_t a_BufferViewIndex) const
+{
+    auto& bufferView = m_Document.bufferViews[a_BufferViewIndex];
+    auto& buffer = m_Buffers[bufferView.buffer];
+
+    if (static_cast<uint64_t>(bufferView.byteOffset) + bufferView.byteLength > buffer.m_Size)
+        throw fx::gltf::invalid_gltf_document("Invalid bufferView.byteLength value");
+
+    return { buffer.m_Data + bufferView.byteOffset, bufferView.byteLength };
+}
+
+krt::hlp::AccessorView krt::GltfSource::GetAccessor(int32_t a_AccessorIndex) const
+{
+    if (a_AccessorIndex == -1)
+        return hlp::AccessorView();
+
+    auto& accessor = m_Document.accessors[a_AccessorIndex];
+    auto elementSize = hlp::AccessorView::GetElementSize(accessor);
+
+    auto sparse = m_SparseAccessors.find(a_AccessorIndex);
+    if (sparse != m_SparseAccessors.end())
+        return hlp::AccessorView(sparse->second.data(), accessor.count, elementSize, elementSize, accessor.componentType);
+
+    if (accessor.bufferView == -1)
+        return hlp::AccessorView(nullptr, accessor.count, elementSize, 0, accessor.componentType);
+
+    auto bufferView = GetBufferView(accessor.bufferView);
+
+    // According to the GLTF spec, BufferView::byteStride can be 0.
+    // In those cases the expected stride is the size of the attributes instead.
+    auto stride = std::max(elementSize, m_Document.bufferViews[accessor.bufferView].byteStride);
+
+    if (accessor.count != 0 && accessor.byteOffset + static_cast<uint64_t>(accessor.count - 1) * stride + elementSize > bufferView.m_Size)
+        throw fx::gltf::invalid_gltf_document("Invalid accessor.count value");
+
+    return hlp::AccessorView(bufferView.m_Data + accessor.byteOffset, accessor.count, elementSize, stride, accessor.componentType);
+}
+
+uint64_t krt::GltfSource::GetMappedSize() const
+{
+    uint64_t size = 0;
+    for (auto& file : m_MappedFiles)
+        size += file->GetSize();
+
+    return size;
+}
+
+void krt::GltfSource::ParseGlb(const MappedFile& a_File, ByteSpan& a_Json, ByteSpan& a_Binary) const
+{
+    using namespace fx::gltf::detail;
+
+    auto data = a_File.GetData();
+    auto size = a_File.GetSize();
+
+    GLBHeader header;
+    if (size < HeaderSize)
+        throw fx::gltf::invalid_gltf_document("Invalid GLB header");
+
+    memcpy(&header, data, HeaderSize);
+    if (header.version != 2 ||
+        header.length > size ||
+        header.jsonHeader.chunkType != GLBChunkJSON ||
+        header.jsonHeader.chunkLength + HeaderSize > header.length)
+    {
+        throw fx::gltf::invalid_gltf_document("Invalid GLB header");
+    }
+
+    a_Json = { data + HeaderSize, header.jsonHeader.chunkLength };
+
+    // The binary chunk is optional, a .glb file can reference external buffers only
+    uint64_t binaryHeaderOffset = HeaderSize + header.jsonHeader.chunkLength;
+    if (binaryHeaderOffset + ChunkHeaderSize > header.length)
+        return;
+
+    ChunkHeader binaryHeader;
+    memcpy(&binaryHeader, data + binaryHeaderOffset, ChunkHeaderSize);
+    if (binaryHeader.chunkType != GLBChunkBIN ||
+        binaryHeaderOffset + ChunkHeaderSize + binaryHeader.chunkLength > header.length)
+    {
+        throw fx::gltf::invalid_gltf_document("Invalid GLB header");
+    }
+
+    a_Binary = { data + binaryHeaderOffset + ChunkHeaderSize, binaryHeader.chunkLength };
+}
+
+void krt::GltfSource::LoadBuffers(ByteSpan a_GlbBinary)
+{
+    m_Buffers.reserve(m_Document.buffers.size());
+    m_DecodedBuffers.reserve(m_Document.buffers.size());
+
+    for (auto& buffer : m_Document.buffers)
+    {
+        if (buffer.byteLength == 0)
+            throw fx::gltf::invalid_gltf_document("Invalid buffer.byteLength value : 0");
+
+        ByteSpan span;
+
+        if (buffer.uri.empty())
+        {
+            // Buffers without a URI refer to the binary chunk of the .glb file
+            if (!a_GlbBinary.m_Data)
+                throw fx::gltf::invalid_gltf_document("Invalid GLB buffer data");
+
+            span = a_GlbBinary;
+        }
+        else if (buffer.IsEmbeddedResource())
+        {
+            fx::gltf::Buffer decoded = buffer;
+            fx::gltf::detail::MaterializeData(decoded);
+
+            auto& data = m_DecodedBuffers.emplace_back(std::move(decoded.data));
+            span = { data.data(), data.size() };
+        }
+        else
+        {
+            auto& file = m_MappedFiles.emplace_back(std::make_unique<MappedFile>(
+                fx::gltf::detail::CreateBufferUriPath(m_RootPath, buffer.uri)));
+
+            span = { file->GetData(), file->GetSize() };
+        }
+
+        if (span.m_Size < buffer.byteLength)
+            throw fx::gltf::invalid_gltf_document("Invalid buffer.byteLength value", buffer.uri);
+
+        span.m_Size = buffer.byteLength;
+        m_Buffers.push_back(span);
+    }
+}
+
+void krt::GltfSource::LoadImages()
+{
+    m_Images.reserve(m_Document.images.size());
+
+    for (auto& image : m_Document.images)
+    {
+        ByteSpan span = { nullptr, 0 };
+
+        if (image.uri.empty())
+        {
+            // An image has to be either referenced by its uri or stored in a buffer view
+            if (image.bufferView < 0 || image.bufferView >= static_cast<int32_t>(m_Document.bufferViews.size()))
+                throw fx::gltf::invalid_gltf_document("Invalid image.bufferView value");
+
+            span = GetBufferView(image.bufferView);
+        }
+        else if (image.IsEmbeddedResource())
+        {
+            auto& data = m_DecodedBuffers.emplace_back();
+            image.MaterializeData(data);
+            span = { data.data(), data.size() };
+        }
+
+        m_Images.push_back(span);
+    }
+}
+
+void krt::GltfSource::ResolveSparseAccessors()
+{
+    using ComponentType = fx::gltf::Accessor::ComponentType;
+
+    for (int32_t i = 0; i < static_cast<int32_t>(m_Document.accessors.size()); i++)
+    {
+        auto& accessor = m_Document.accessors[i];
+        auto& sparse = accessor.sparse;
+        if (sparse.empty())
+            continue;
+
+        // The base data is read before the resolved copy is registered, so it still comes from the buffer view or is zero
+        auto base = GetAccessor(i);
+        auto elementSize = base.GetElementSize();
+
+        std::vector<uint8_t> resolved(base.GetSizeInBytes());
+        base.CopyTo(resolved.data());
+
+        auto indexType = sparse.indices.componentType;
+        uint32_t indexSize = indexType == ComponentType::UnsignedByte ? 1 : indexType == ComponentType::UnsignedShort ? 2 : 4;
+
+        auto indices = GetBufferView(sparse.indices.bufferView);
+        auto values = GetBufferView(sparse.values.bufferView);
+        uint64_t numValues = static_cast<uint64_t>(sparse.count);
+
+        if (sparse.indices.byteOffset + numValues * indexSize > indices.m_Size ||
+            sparse.values.byteOffset + numValues * elementSize > values.m_Size)
+        {
+            throw fx::gltf::invalid_gltf_document("Invalid accessor.sparse.count value");
+        }
+
+        auto* index = indices.m_Data + sparse.indices.byteOffset;
+        auto* value = values.m_Data + sparse.values.byteOffset;
+
+        for (uint64_t j = 0; j < numValues; j++, index += indexSize, value += elementSize)
+        {
+            uint32_t element;
+            if (indexSize == 1)
+            {
+                element = *index;
+            }
+            else if (indexSize == 2)
+            {
+                uint16_t shortIndex;
+                memcpy(&shortIndex, index, sizeof(shortIndex));
+                element = shortIndex;
+            }
+            else
+            {
+                memcpy(&element, index, sizeof(element));
+            }
+
+            if (element >= accessor.count)
+                throw fx::gltf::invalid_gltf_document("Invalid accessor.sparse.indices value");
+
+            memcpy(resolved.data() + static_cast<uint64_t>(element) * elementSize, value, elementSize);
+        }
+
+        m_SparseAccessors.emplace(i, std::move(resolved));
+    }
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include "FX-GLTF/gltf.h"
+#include "AccessorView.h"
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace krt
+{
+    class MappedFile;
+}
+
+namespace krt
+{
+    // Non-owning range of bytes
+    struct ByteSpan
+    {
+        const uint8_t* m_Data;
+        uint64_t m_Size;
+    };
+
+    // A glTF document together with the memory holding its binary buffers.
+    // Both .gltf files and binary .glb files are supported, the format is detected from the file header.
+    // External .bin buffers and .glb files are memory mapped instead of being read into the document, so the buffer
+    // data of the document itself stays empty and has to be accessed through this class instead.
+    class GltfSource
+    {
+    public:
+        // Throws fx::gltf::invalid_gltf_document for malformed files and std::system_error for missing files
+        explicit GltfSource(const std::string& a_Path);
+        ~GltfSource();
+
+        GltfSource(GltfSource&) = delete;             // No copy c-tor
+        GltfSource(GltfSource&&) = delete;            // No move c-tor
+        GltfSource& operator=(GltfSource&) = delete;  // No copy assignment
+        GltfSource& operator=(GltfSource&&) = delete; // No move assignment
+
+        const fx::gltf::Document& GetDocument() const { return m_Document; }
+        // The directory relative to which the URIs in the document are resolved
+        const std::string& GetRootPath() const { return m_RootPath; }
+
+        ByteSpan GetBuffer(uint32_t a_BufferIndex) const { return m_Buffers[a_BufferIndex]; }
+        ByteSpan GetBufferView(int32_t a_BufferViewIndex) const;
+
+        // Creates a view of the accessor with the given index, or an empty view if the index is -1.
+        // Accessors without a buffer view are viewed as all zeroes, as described by the glTF spec.
+        // Sparse accessors are viewed in the copy they were resolved into when the document was loaded.
+        hlp::AccessorView GetAccessor(int32_t a_AccessorIndex) const;
+
+        // Encoded contents of an image stored in a buffer view or a data URI.
+        // Images referencing an external file return an empty span, those have to be loaded from GetRootPath() + "/" + uri.
+        ByteSpan GetImageData(uint32_t a_ImageIndex) const { return m_Images[a_ImageIndex]; }
+
+        bool IsBinary() const { return m_IsBinary; }
+        // Total size of the memory mapped files in bytes
+        uint64_t GetMappedSize() const;
+
+    private:
+
+        // Splits a .glb file into its JSON and binary chunk
+        void ParseGlb(const MappedFile& a_File, ByteSpan& a_Json, ByteSpan& a_Binary) const;
+        void LoadBuffers(ByteSpan a_GlbBinary);
+        void LoadImages();
+        // Applies the sparse values of every sparse accessor to a tightly packed copy of its base data
+        void ResolveSparseAccessors();
+
+        fx::gltf::Document m_Document;
+        std::string m_RootPath;
+        bool m_IsBinary;
+
+        std::vector<ByteSpan> m_Buffers;
+        std::vector<ByteSpan> m_Images;
+
+        std::vector<std::unique_ptr<MappedFile>> m_MappedFiles;
+        // Buffers and images embedded as base64 in the JSON have to be decoded, so they can not be mapped
+        std::vector<std::vector<uint8_t>> m_DecodedBuffers;
+        // Resolved copies of the sparse accessors by accessor index, which are complete before any worker reads from the source
+        std::map<int32_t, std::vector<uint8_t>> m_SparseAccessors;
+    };
+}
@@ -13,7 +13,9 @@ VkPipelineVertexInputStateCreateInfo krt::VertexInputInfo::GetVkPipelineVertexIn
 {
     VkPipelineVertexInputStateCreateInfo output = {};
 
+    // The list has to outlive this function, and is rebuilt for every pipeline
     static auto bindingList = std::vector<VkVertexInputBindingDescription>();
+    bindingList.clear();
     bindingList.reserve(m_Bindings.size());
     for (auto& binding : m_Bindings)
     {
@@ -313,6 +315,11 @@ std::unique_ptr<krt::DescriptorSetAllocation> krt::GraphicsPipeline::AllocateDes
     return m_DescriptorSetPools[a_Slot]->GetDescriptorSet();
 }
 
+const std::vector<VkDescriptorSetLayoutBinding>& krt::GraphicsPipeline::GetDescriptorSetBindings(uint32_t a_Slot) const
+{
+    return m_DescriptorSetPools.at(a_Slot)->GetDescriptorSetBindings();
+}
+
 std::unique_ptr<krt::DescriptorSet> krt::GraphicsPipeline::CreateDescriptorSet(uint32_t a_Slot, std::set<ECommandQueueType> a_QueuesWithAccess)
 {
     return std::make_unique<DescriptorSet>(m_Services, *this, a_Slot, a_QueuesWithAccess);
@@ -173,6 +173,7 @@ namespace krt
 
 
         std::unique_ptr<DescriptorSetAllocation> AllocateDescriptorSet(uint32_t a_Slot);
+        const std::vector<VkDescriptorSetLayoutBinding>& GetDescriptorSetBindings(uint32_t a_Slot) const;
         std::unique_ptr<DescriptorSet> CreateDescriptorSet(uint32_t a_Slot, std::set<ECommandQueueType> a_QueuesWithAccess);
 
     private:
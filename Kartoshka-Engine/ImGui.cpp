@@ -7,6 +7,7 @@
 #include "Window.h"
 #include "RenderPass.h"
 #include "CommandBuffer.h"
+#include "MemoryTracker.h"
 
 #include "ImGui/imgui.h"
 #include "ImGui/imgui_impl_glfw.h"
@@ -108,6 +109,64 @@ void krt::VkImGui::Display(uint32_t a_FramebufferIndex, krt::Semaphore a_SignalS
     ImGui::NewFrame();
 }
 
+void krt::VkImGui::ShowMemoryBudget()
+{
+    const float megabyte = 1024.0f * 1024.0f;
+    const ImVec4 overBudgetColor(1.0f, 0.3f, 0.3f, 1.0f);
+
+    auto& tracker = m_Services.m_LogicalDevice->GetMemoryTracker();
+    auto report = tracker.GetReport();
+
+    ImGui::Begin("GPU Memory");
+    ImGui::Text(report.m_HasDriverBudget ? "Budget reported by the driver" : "No VK_EXT_memory_budget, budget is 80%% of each heap");
+
+    for (size_t i = 0; i < report.m_Heaps.size(); i++)
+    {
+        auto& heap = report.m_Heaps[i];
+        char overlay[64];
+        snprintf(overlay, sizeof(overlay), "%.0f / %.0f MB", heap.m_Usage / megabyte, heap.m_Budget / megabyte);
+
+        ImGui::Text("Heap %u (%s, %.0f MB), %.1f MB tracked", static_cast<uint32_t>(i), heap.m_DeviceLocal ? "device local" : "host",
+                    heap.m_Size / megabyte, heap.m_TrackedBytes / megabyte);
+        if (heap.m_Usage > heap.m_Budget)
+            ImGui::PushStyleColor(ImGuiCol_PlotHistogram, overBudgetColor);
+        ImGui::ProgressBar(heap.m_Budget == 0 ? 0.0f : static_cast<float>(heap.m_Usage) / heap.m_Budget, ImVec2(-1.0f, 0.0f), overlay);
+        if (heap.m_Usage > heap.m_Budget)
+            ImGui::PopStyleColor();
+    }
+
+    ImGui::Separator();
+    for (uint32_t i = 0; i < ENumMemoryCategories; i++)
+    {
+        auto& category = report.m_Categories[i];
+        bool overBudget = category.m_Budget != 0 && category.m_Bytes > category.m_Budget;
+
+        if (overBudget)
+            ImGui::PushStyleColor(ImGuiCol_Text, overBudgetColor);
+        ImGui::Text("%s: %.1f MB in %u resources, %.1f MB peak", MemoryTracker::GetCategoryName(static_cast<EMemoryCategory>(i)),
+                    category.m_Bytes / megabyte, category.m_NumResources, category.m_PeakBytes / megabyte);
+        if (category.m_Budget != 0)
+        {
+            ImGui::SameLine();
+            ImGui::Text("of %.1f MB", category.m_Budget / megabyte);
+        }
+        if (overBudget)
+            ImGui::PopStyleColor();
+    }
+
+    ImGui::Separator();
+    for (auto& owner : tracker.GetLargestOwners(10))
+        ImGui::Text("%.1f MB in %u resources: %s", owner.m_Bytes / megabyte, owner.m_NumResources, owner.m_Owner.c_str());
+
+    if (ImGui::Button("Write GpuMemory.json"))
+    {
+        if (!tracker.WriteJson("GpuMemory.json"))
+            printf("Could not write the memory report to GpuMemory.json.\n");
+    }
+
+    ImGui::End();
+}
+
 void krt::VkImGui::CreateRenderPass()
 {
     VkAttachmentDescription attachment = {};
@@ -24,6 +24,9 @@ namespace krt
 
         void Display(uint32_t a_FramebufferIndex, Semaphore a_SignalSemaphore);
 
+        // Window with the memory of every heap against its budget, the memory of every category and the assets holding the most.
+        // The same report can be written to a JSON file from it.
+        void ShowMemoryBudget();
 
     private:
         void CreateRenderPass();
@@ -7,6 +7,7 @@ namespace krt
     class IndexBuffer : public Buffer
     {
         friend class CommandBuffer;
+        friend class UploadBatch;
     public:
         IndexBuffer(ServiceLocator& a_Services, uint64_t a_InitialSize, VkBufferUsageFlags a_UsageFlags,
             VkMemoryPropertyFlags a_MemoryPropertyFlags, std::set<ECommandQueueType> a_QueuesWithAccess);
@@ -0,0 +1,175 @@
+#include "InstanceBatcher.h"
+
+#include "Scene.h"
+#include "StaticMesh.h"
+#include "Transform.h"
+#include "Mesh.h"
+#include "Buffer.h"
+#include "CommandBuffer.h"
+#include "GraphicsPipeline.h"
+
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+#include <glm/vec4.hpp>
+#include <glm/gtc/type_precision.hpp>
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <limits>
+
+krt::InstanceBatcher::InstanceBatcher()
+    : m_LargestBatch(0)
+    , m_ConstantColor(false)
+    , m_ConstantColorOffset(0)
+{
+}
+
+void krt::InstanceBatcher::DescribeInstanceInput(VertexInputInfo& a_VertexInput)
+{
+    // Attributes are at most four components wide, so the matrix is passed as its four columns
+    for (uint32_t column = 0; column < 4; column++)
+        a_VertexInput.AddPerInstanceAttribute<glm::vec4>(InstanceBinding, InstanceLocation + column, VK_FORMAT_R32G32B32A32_SFLOAT);
+
+    a_VertexInput.AddPerInstanceAttribute<uint32_t>(InstanceBinding, PaletteOffsetLocation, VK_FORMAT_R32_UINT);
+}
+
+void krt::InstanceBatcher::Gather(const Scene& a_Scene, const glm::mat4& a_ViewProjection, const StaticMesh* a_Excluded)
+{
+    m_Statistics = Statistics();
+
+    // Same planes as the cluster culler, but in world space
+    glm::mat4 transposed = glm::transpose(a_ViewProjection);
+    glm::vec4 planes[6] = {
+        transposed[3] + transposed[0],
+        transposed[3] - transposed[0],
+        transposed[3] + transposed[1],
+        transposed[3] - transposed[1],
+        transposed[3] + transposed[2],
+        transposed[3] - transposed[2]
+    };
+
+    for (auto& plane : planes)
+        plane /= glm::length(glm::vec3(plane));
+
+    std::map<GroupKey, Group*> gathered;
+
+    for (auto& staticMesh : a_Scene.m_StaticMeshes)
+    {
+        auto* mesh = staticMesh->GetMesh().get();
+        if (!staticMesh->m_Enabled || staticMesh.get() == a_Excluded || !mesh || mesh->m_Primitives.empty())
+            continue;
+
+        GroupKey key(mesh, staticMesh->m_Skeleton != nullptr);
+
+        auto gatheredIter = gathered.find(key);
+        if (gatheredIter == gathered.end())
+        {
+            auto& group = m_Groups[key];
+            group.m_Instances.clear();
+            ComputeBounds(*mesh, group);
+
+            gatheredIter = gathered.emplace(key, &group).first;
+        }
+
+        auto& group = *gatheredIter->second;
+        m_Statistics.m_NumInstances++;
+
+        glm::mat4 world = staticMesh->m_Transform->GetTransformationMatrix();
+        glm::vec3 center = glm::vec3(world * glm::vec4(group.m_Center, 1.0f));
+        float scale = std::max(glm::length(glm::vec3(world[0])), std::max(glm::length(glm::vec3(world[1])), glm::length(glm::vec3(world[2]))));
+        float radius = group.m_Radius * scale;
+
+        // The bounds of skinned meshes only hold in the bind pose, so those are always drawn
+        bool visible = key.second || std::all_of(std::begin(planes), std::end(planes), [&](const glm::vec4& a_Plane)
+        {
+            return glm::dot(glm::vec3(a_Plane), center) + a_Plane.w >= -radius;
+        });
+
+        if (!visible)
+        {
+            m_Statistics.m_CulledInstances++;
+            continue;
+        }
+
+        group.m_Instances.push_back({ world, staticMesh->m_PaletteOffset });
+    }
+
+    // Meshes that were released may have their address reused, so their groups are dropped as soon as they are not drawn
+    for (auto iter = m_Groups.begin(); iter != m_Groups.end();)
+    {
+        if (gathered.find(iter->first) == gathered.end())
+            iter = m_Groups.erase(iter);
+        else
+            ++iter;
+    }
+
+    m_Instances.clear();
+    m_Batches.clear();
+    m_LargestBatch = 0;
+    m_ConstantColor = false;
+
+    for (auto& entry : m_Groups)
+    {
+        auto& group = entry.second;
+        if (group.m_Instances.empty())
+            continue;
+
+        auto& batch = m_Batches.emplace_back();
+        batch.m_Mesh = entry.first.first;
+        batch.m_Skinned = entry.first.second;
+        batch.m_FirstInstance = static_cast<uint32_t>(m_Instances.size());
+        batch.m_NumInstances = static_cast<uint32_t>(group.m_Instances.size());
+
+        m_Instances.insert(m_Instances.end(), group.m_Instances.begin(), group.m_Instances.end());
+        m_LargestBatch = std::max(m_LargestBatch, batch.m_NumInstances);
+        m_ConstantColor |= group.m_ConstantColor;
+    }
+
+    m_Statistics.m_NumBatches = static_cast<uint32_t>(m_Batches.size());
+}
+
+void krt::InstanceBatcher::Upload(CommandBuffer& a_CommandBuffer)
+{
+    m_InstanceBuffer = {};
+    if (m_Instances.empty())
+        return;
+
+    // Every instance of a batch reads its own color, so there have to be as many as the largest batch has instances
+    uint64_t instancesSize = m_Instances.size() * sizeof(Instance);
+    uint64_t colorsSize = m_ConstantColor ? m_LargestBatch * sizeof(glm::u8vec4) : 0;
+
+    std::vector<uint8_t> data(instancesSize + colorsSize, 255);
+    memcpy(data.data(), m_Instances.data(), instancesSize);
+
+    m_InstanceBuffer = a_CommandBuffer.CreateTransientBuffer(data.data(), data.size());
+    m_ConstantColorOffset = instancesSize;
+}
+
+void krt::InstanceBatcher::BindInstances(CommandBuffer& a_CommandBuffer, const Batch& a_Batch) const
+{
+    a_CommandBuffer.SetVertexBuffer(*m_InstanceBuffer.m_Buffer, InstanceBinding, m_InstanceBuffer.m_Offset + a_Batch.m_FirstInstance * sizeof(Instance));
+}
+
+void krt::InstanceBatcher::BindConstantColors(CommandBuffer& a_CommandBuffer) const
+{
+    assert(m_ConstantColor && "None of the gathered meshes has a primitive with a constant color.");
+    a_CommandBuffer.SetVertexBuffer(*m_InstanceBuffer.m_Buffer, ConstantColorBinding, m_InstanceBuffer.m_Offset + m_ConstantColorOffset);
+}
+
+void krt::InstanceBatcher::ComputeBounds(const Mesh& a_Mesh, Group& a_Group)
+{
+    glm::vec3 boundsMin(std::numeric_limits<float>::max());
+    glm::vec3 boundsMax(std::numeric_limits<float>::lowest());
+    a_Group.m_ConstantColor = false;
+
+    for (auto& primitive : a_Mesh.m_Primitives)
+    {
+        boundsMin = glm::min(boundsMin, primitive.m_BoundsMin);
+        boundsMax = glm::max(boundsMax, primitive.m_BoundsMax);
+        a_Group.m_ConstantColor |= primitive.m_ConstantColor;
+    }
+
+    a_Group.m_Center = (boundsMin + boundsMax) * 0.5f;
+    a_Group.m_Radius = glm::length(boundsMax - boundsMin) * 0.5f;
+}
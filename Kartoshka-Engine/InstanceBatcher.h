@@ -0,0 +1,116 @@
+#pragma once
+
+#include "FrameAllocator.h"
+
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+
+#include <cstdint>
+#include <map>
+#include <utility>
+#include <vector>
+
+namespace krt
+{
+    struct Mesh;
+    class Scene;
+    class StaticMesh;
+    class CommandBuffer;
+    class VertexInputInfo;
+}
+
+namespace krt
+{
+    // Groups the static meshes of a scene by the mesh they use, so every primitive of a mesh is drawn once for all of its instances.
+    // The world matrices of the instances are read per instance from a vertex buffer, which is rebuilt for every view
+    // from the instances whose bounds are inside of it. Since every primitive has a single material, the draws of a batch
+    // share their material as well.
+    // Skinned instances are batched apart from the others, and read their joints from the palette of the skinning system.
+    class InstanceBatcher
+    {
+    public:
+
+        // Binding of the world matrices, which take up the four locations from InstanceLocation on
+        static const uint32_t InstanceBinding = 5;
+        static const uint32_t InstanceLocation = 5;
+        // The palette offset of an instance follows its world matrix
+        static const uint32_t PaletteOffsetLocation = InstanceLocation + 4;
+        // Binding of the vertex colors, which BindConstantColors replaces for primitives with a constant color
+        static const uint32_t ConstantColorBinding = 2;
+
+        // The instances of one mesh, which lie back to back in the instance buffer
+        struct Batch
+        {
+            const Mesh* m_Mesh;
+            uint32_t m_FirstInstance;
+            uint32_t m_NumInstances;
+            bool m_Skinned;         // Has to be drawn with the skinned pipelines, its instances are never culled
+        };
+
+        struct Statistics
+        {
+            uint32_t m_NumInstances = 0;     // Enabled static meshes with a mesh
+            uint32_t m_CulledInstances = 0;  // Instances whose bounds are outside of the view
+            uint32_t m_NumBatches = 0;
+        };
+
+        InstanceBatcher();
+
+        // Adds the per instance world matrix and palette offset to the vertex input of a pipeline
+        static void DescribeInstanceInput(VertexInputInfo& a_VertexInput);
+
+        // Groups the enabled static meshes of the scene by their mesh, leaving out a_Excluded and the ones outside of the view
+        void Gather(const Scene& a_Scene, const glm::mat4& a_ViewProjection, const StaticMesh* a_Excluded = nullptr);
+
+        // Copies the world matrices of the gathered instances into a buffer that is kept alive by the command buffer
+        void Upload(CommandBuffer& a_CommandBuffer);
+
+        // Binds the world matrices of the batch, which its draws read from instance 0 on
+        void BindInstances(CommandBuffer& a_CommandBuffer, const Batch& a_Batch) const;
+        // Binds a white color for every instance in place of the vertex colors, which primitives with a constant color do not have
+        void BindConstantColors(CommandBuffer& a_CommandBuffer) const;
+
+        const std::vector<Batch>& GetBatches() const { return m_Batches; }
+        const glm::mat4& GetWorldMatrix(const Batch& a_Batch, uint32_t a_Instance) const { return m_Instances[a_Batch.m_FirstInstance + a_Instance].m_World; }
+
+        const Statistics& GetStatistics() const { return m_Statistics; }
+
+    private:
+
+        // Per instance data as it is laid out in the instance buffer
+        struct Instance
+        {
+            glm::mat4 m_World;
+            uint32_t m_PaletteOffset;   // Unused by the pipelines that are not skinned
+        };
+
+        // Instances of a mesh, split by whether they are skinned
+        using GroupKey = std::pair<const Mesh*, bool>;
+
+        struct Group
+        {
+            // Object space bounding sphere of all primitives, which is recomputed on every gather since meshes fill up while they stream in
+            glm::vec3 m_Center;
+            float m_Radius;
+            bool m_ConstantColor;
+
+            std::vector<Instance> m_Instances;
+        };
+
+        static void ComputeBounds(const Mesh& a_Mesh, Group& a_Group);
+
+        // Kept across gathers so the instance lists keep their memory, groups of meshes that are no longer drawn are removed
+        std::map<GroupKey, Group> m_Groups;
+
+        std::vector<Instance> m_Instances;
+        std::vector<Batch> m_Batches;
+        uint32_t m_LargestBatch;
+        bool m_ConstantColor;
+
+        // The colors follow the world matrices in the same buffer
+        FrameAllocator::Allocation m_InstanceBuffer;
+        uint64_t m_ConstantColorOffset;
+
+        Statistics m_Statistics;
+    };
+}
@@ -0,0 +1,262 @@
+#include "Ktx2File.h"
+
+#include "MappedFile.h"
+#include "MipGenerator.h"
+#include "TextureCompressor.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <system_error>
+#include <thread>
+
+namespace
+{
+    const uint8_t Identifier[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+    struct Header
+    {
+        uint8_t m_Identifier[12];
+        uint32_t m_VkFormat;
+        uint32_t m_TypeSize;
+        uint32_t m_PixelWidth;
+        uint32_t m_PixelHeight;
+        uint32_t m_PixelDepth;
+        uint32_t m_LayerCount;
+        uint32_t m_FaceCount;
+        uint32_t m_LevelCount;
+        uint32_t m_SupercompressionScheme;
+
+        uint32_t m_DfdByteOffset;
+        uint32_t m_DfdByteLength;
+        uint32_t m_KvdByteOffset;
+        uint32_t m_KvdByteLength;
+        uint64_t m_SgdByteOffset;
+        uint64_t m_SgdByteLength;
+    };
+
+    struct LevelIndex
+    {
+        uint64_t m_ByteOffset;
+        uint64_t m_ByteLength;
+        uint64_t m_UncompressedByteLength;
+    };
+
+    static_assert(sizeof(Header) == 80, "The KTX2 header has to be tightly packed.");
+    static_assert(sizeof(LevelIndex) == 24, "The KTX2 level index has to be tightly packed.");
+
+    // Color models and channel ids of the Khronos Data Format specification
+    const uint32_t ModelBC1A = 128;
+    const uint32_t ModelBC3 = 130;
+    const uint32_t ModelBC4 = 131;
+    const uint32_t ModelBC5 = 132;
+    const uint32_t ChannelAlpha = 15;
+
+    // One sample of the basic data format descriptor, a channel within the 4x4 block
+    struct DfdSample
+    {
+        uint32_t m_Channel;
+        uint32_t m_BitOffset;
+    };
+
+    // Builds the data format descriptor KTX2 requires, which describes the texel layout independently of the Vulkan format
+    std::vector<uint32_t> BuildDataFormatDescriptor(VkFormat a_Format)
+    {
+        uint32_t colorModel = 0;
+        std::vector<DfdSample> samples;
+
+        switch (a_Format)
+        {
+        case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+            colorModel = ModelBC1A;
+            samples = { { 0, 0 } };
+            break;
+        case VK_FORMAT_BC3_UNORM_BLOCK:
+            colorModel = ModelBC3;
+            samples = { { ChannelAlpha, 0 }, { 0, 64 } };
+            break;
+        case VK_FORMAT_BC4_UNORM_BLOCK:
+            colorModel = ModelBC4;
+            samples = { { 0, 0 } };
+            break;
+        case VK_FORMAT_BC5_UNORM_BLOCK:
+            colorModel = ModelBC5;
+            samples = { { 0, 0 }, { 1, 64 } };
+            break;
+        default:
+            return {};
+        }
+
+        const uint32_t primariesBT709 = 1;
+        const uint32_t transferLinear = 1;
+        const uint32_t blockSize = 24 + 16 * static_cast<uint32_t>(samples.size());
+
+        std::vector<uint32_t> descriptor;
+        descriptor.push_back(4 + blockSize);                                        // Total size, including this word
+        descriptor.push_back(0);                                                    // Khronos vendor, basic descriptor type
+        descriptor.push_back(2 | (blockSize << 16));                                // Version 2 and the size of the block
+        descriptor.push_back(colorModel | (primariesBT709 << 8) | (transferLinear << 16));
+        descriptor.push_back(3 | (3 << 8));                                         // 4x4 texels per block, stored minus one
+        descriptor.push_back(krt::hlp::GetBlockSize(a_Format));                      // Bytes of plane 0
+        descriptor.push_back(0);
+
+        for (auto& sample : samples)
+        {
+            // The samples span 64 bits each, their length is also stored minus one
+            descriptor.push_back(sample.m_BitOffset | (63 << 16) | (sample.m_Channel << 24));
+            descriptor.push_back(0);
+            descriptor.push_back(0);
+            descriptor.push_back(0xFFFFFFFF);
+        }
+
+        return descriptor;
+    }
+
+    uint64_t AlignUp(uint64_t a_Value, uint64_t a_Alignment)
+    {
+        return (a_Value + a_Alignment - 1) / a_Alignment * a_Alignment;
+    }
+}
+
+krt::Ktx2File::Ktx2File(std::unique_ptr<MappedFile> a_File)
+    : m_File(std::move(a_File))
+    , m_Format(VK_FORMAT_UNDEFINED)
+    , m_Dimensions(0)
+{
+}
+
+krt::Ktx2File::~Ktx2File()
+{
+}
+
+std::unique_ptr<krt::Ktx2File> krt::Ktx2File::Open(const std::string& a_Path)
+{
+    std::unique_ptr<MappedFile> file;
+    try
+    {
+        file = std::make_unique<MappedFile>(a_Path);
+    }
+    catch (std::system_error&)
+    {
+        return nullptr;
+    }
+
+    Header header;
+    if (file->GetSize() < sizeof(Header))
+        return nullptr;
+
+    memcpy(&header, file->GetData(), sizeof(Header));
+
+    auto format = static_cast<VkFormat>(header.m_VkFormat);
+    if (memcmp(header.m_Identifier, Identifier, sizeof(Identifier)) != 0 || BuildDataFormatDescriptor(format).empty() ||
+        header.m_PixelWidth == 0 || header.m_PixelHeight == 0 || header.m_PixelDepth != 0 || header.m_LayerCount != 0 ||
+        header.m_FaceCount != 1 || header.m_SupercompressionScheme != 0 || header.m_LevelCount == 0)
+    {
+        printf("Ignoring %s, it is not a texture written by the engine.\n", a_Path.c_str());
+        return nullptr;
+    }
+
+    glm::uvec2 dimensions(header.m_PixelWidth, header.m_PixelHeight);
+    if (header.m_LevelCount > hlp::GetMipCount(dimensions) || file->GetSize() < sizeof(Header) + header.m_LevelCount * sizeof(LevelIndex))
+        return nullptr;
+
+    std::unique_ptr<Ktx2File> texture(new Ktx2File(std::move(file)));
+    texture->m_Format = format;
+    texture->m_Dimensions = dimensions;
+
+    auto* data = texture->m_File->GetData();
+    auto size = texture->m_File->GetSize();
+    auto blockSize = hlp::GetBlockSize(format);
+
+    for (uint32_t level = 0; level < header.m_LevelCount; level++)
+    {
+        LevelIndex index;
+        memcpy(&index, data + sizeof(Header) + level * sizeof(LevelIndex), sizeof(LevelIndex));
+
+        // Truncated files or levels of the wrong size would be read past their end
+        auto expectedSize = hlp::GetLevelSize(format, hlp::GetMipDimensions(dimensions, level));
+        if (index.m_ByteLength != expectedSize || index.m_ByteOffset > size || index.m_ByteLength > size - index.m_ByteOffset)
+        {
+            printf("Ignoring %s, it is truncated or corrupt.\n", a_Path.c_str());
+            return nullptr;
+        }
+
+        texture->m_Levels.emplace_back(data + index.m_ByteOffset, index.m_ByteLength / blockSize, blockSize, blockSize);
+    }
+
+    return texture;
+}
+
+bool krt::Ktx2File::Write(const std::string& a_Path, VkFormat a_Format, glm::uvec2 a_Dimensions, const std::vector<hlp::AccessorView>& a_Levels)
+{
+    auto descriptor = BuildDataFormatDescriptor(a_Format);
+    if (descriptor.empty() || a_Levels.empty())
+        return false;
+
+    Header header = {};
+    memcpy(header.m_Identifier, Identifier, sizeof(Identifier));
+    header.m_VkFormat = static_cast<uint32_t>(a_Format);
+    header.m_TypeSize = 1;
+    header.m_PixelWidth = a_Dimensions.x;
+    header.m_PixelHeight = a_Dimensions.y;
+    header.m_FaceCount = 1;
+    header.m_LevelCount = static_cast<uint32_t>(a_Levels.size());
+
+    header.m_DfdByteOffset = static_cast<uint32_t>(sizeof(Header) + a_Levels.size() * sizeof(LevelIndex));
+    header.m_DfdByteLength = static_cast<uint32_t>(descriptor.size() * sizeof(uint32_t));
+
+    // The specification stores the smallest level first, and aligns every level to its block size
+    auto blockSize = hlp::GetBlockSize(a_Format);
+    std::vector<LevelIndex> levelIndex(a_Levels.size());
+
+    uint64_t offset = header.m_DfdByteOffset + header.m_DfdByteLength;
+    for (size_t level = a_Levels.size(); level-- > 0;)
+    {
+        offset = AlignUp(offset, blockSize);
+        levelIndex[level].m_ByteOffset = offset;
+        levelIndex[level].m_ByteLength = a_Levels[level].GetSizeInBytes();
+        levelIndex[level].m_UncompressedByteLength = a_Levels[level].GetSizeInBytes();
+        offset += a_Levels[level].GetSizeInBytes();
+    }
+
+    // Several workers can write the same texture at once if the image is shared, so each writes its own temporary file
+    auto tempPath = a_Path + "." + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id())) + ".tmp";
+    std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+    if (!file)
+        return false;
+
+    uint64_t written = 0;
+    const char padding[16] = {};
+
+    auto write = [&](const void* a_Data, uint64_t a_Size)
+    {
+        file.write(static_cast<const char*>(a_Data), static_cast<std::streamsize>(a_Size));
+        written += a_Size;
+    };
+
+    write(&header, sizeof(header));
+    write(levelIndex.data(), levelIndex.size() * sizeof(LevelIndex));
+    write(descriptor.data(), descriptor.size() * sizeof(uint32_t));
+
+    std::vector<uint8_t> scratch;
+    for (size_t level = a_Levels.size(); level-- > 0;)
+    {
+        write(padding, levelIndex[level].m_ByteOffset - written);
+
+        scratch.resize(a_Levels[level].GetSizeInBytes());
+        a_Levels[level].CopyTo(scratch.data());
+        write(scratch.data(), scratch.size());
+    }
+
+    file.close();
+    if (!file)
+    {
+        std::remove(tempPath.c_str());
+        return false;
+    }
+
+    // std::rename does not replace existing files on every platform
+    std::remove(a_Path.c_str());
+    return std::rename(tempPath.c_str(), a_Path.c_str()) == 0;
+}
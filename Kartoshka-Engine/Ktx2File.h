@@ -0,0 +1,56 @@
+#pragma once
+
+#include "AccessorView.h"
+
+#include "vulkan/vulkan.h"
+
+#include <glm/vec2.hpp>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace krt
+{
+    class MappedFile;
+}
+
+namespace krt
+{
+    // A KTX 2.0 texture, read through a memory mapping so its levels can be copied straight into staging memory.
+    // Only what the importer writes is supported: a single 2D image with a mip chain, in one of the formats of hlp::CompressMipChain,
+    // without array layers, cube faces or supercompression.
+    class Ktx2File
+    {
+    public:
+        ~Ktx2File();
+
+        Ktx2File(Ktx2File&) = delete;             // No copy c-tor
+        Ktx2File(Ktx2File&&) = delete;            // No move c-tor
+        Ktx2File& operator=(Ktx2File&) = delete;  // No copy assignment
+        Ktx2File& operator=(Ktx2File&&) = delete; // No move assignment
+
+        // Returns nullptr if the file does not exist, or is not a texture this class can read
+        static std::unique_ptr<Ktx2File> Open(const std::string& a_Path);
+
+        // Writes the levels, starting at the full resolution level, through a temporary file that replaces the target once complete
+        static bool Write(const std::string& a_Path, VkFormat a_Format, glm::uvec2 a_Dimensions, const std::vector<hlp::AccessorView>& a_Levels);
+
+        VkFormat GetVkFormat() const { return m_Format; }
+        glm::uvec2 GetDimensions() const { return m_Dimensions; }
+        uint32_t GetNumMips() const { return static_cast<uint32_t>(m_Levels.size()); }
+
+        // One view per level into the mapped file, starting at the full resolution level
+        const std::vector<hlp::AccessorView>& GetLevels() const { return m_Levels; }
+
+    private:
+
+        Ktx2File(std::unique_ptr<MappedFile> a_File);
+
+        std::unique_ptr<MappedFile> m_File;
+
+        VkFormat m_Format;
+        glm::uvec2 m_Dimensions;
+        std::vector<hlp::AccessorView> m_Levels;
+    };
+}
@@ -4,6 +4,9 @@
 #include "CommandQueue.h"
 #include "CommandBuffer.h"
 #include "Buffer.h"
+#include "Texture.h"
+#include "StagingRing.h"
+#include "MemoryTracker.h"
 
 #include "VkHelpers.h"
 #include "VkConstants.h"
@@ -13,6 +16,12 @@
 
 krt::LogicalDevice::LogicalDevice(ServiceLocator& a_Services, const std::string& a_WindowTitle, const std::string& a_EngineName)
     : m_Services(a_Services)
+    , m_HasProperties2(IsInstanceExtensionSupported(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME))
+    , m_HasMemoryBudget(false)
+    , m_NumBuffers(0)
+    , m_NumTextures(0)
+    , m_NumDescriptorPools(0)
+    , m_NumDescriptorSets(0)
 {
     printf("Creating VkInstance. \n");
     VkApplicationInfo info{};
@@ -60,6 +69,9 @@ krt::LogicalDevice::~LogicalDevice()
         commandQueue.second.reset();
     }
 
+    m_StagingRing.reset();
+    m_MemoryAllocator.reset();
+    m_MemoryTracker.reset();
 
     vkDestroyDevice(m_VkLogicalDevice, nullptr);
     vkDestroyInstance(m_VkInstance, nullptr);
@@ -99,6 +111,7 @@ void krt::LogicalDevice::InitializeDevice()
     physicalDeviceFeatures.samplerAnisotropy = VK_TRUE;
     physicalDeviceFeatures.depthBounds = VK_TRUE;
     physicalDeviceFeatures.fragmentStoresAndAtomics = VK_TRUE;
+    physicalDeviceFeatures.textureCompressionBC = m_Services.m_PhysicalDevice->SupportsBlockCompression() ? VK_TRUE : VK_FALSE;
 
     assert(ValidateExtensionSupport(requiredExtensions));
 
@@ -108,8 +121,14 @@ void krt::LogicalDevice::InitializeDevice()
     deviceCreateInfo.queueCreateInfoCount = static_cast<uint32_t>(queueInfos.size());
     deviceCreateInfo.pEnabledFeatures = &physicalDeviceFeatures;
 
-    deviceCreateInfo.enabledExtensionCount = static_cast<uint32_t>(constants::VkDeviceExtensions.size());
-    deviceCreateInfo.ppEnabledExtensionNames = constants::VkDeviceExtensions.data();
+    // Without the memory budget, the tracker compares the memory of the engine against the sizes of the heaps
+    auto deviceExtensions = constants::VkDeviceExtensions;
+    m_HasMemoryBudget = m_HasProperties2 && m_Services.m_PhysicalDevice->SupportsExtension(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+    if (m_HasMemoryBudget)
+        deviceExtensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+
+    deviceCreateInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
+    deviceCreateInfo.ppEnabledExtensionNames = deviceExtensions.data();
 
 #ifdef _DEBUG
     deviceCreateInfo.ppEnabledLayerNames = constants::VkValidationLayers.data();
@@ -121,6 +140,10 @@ void krt::LogicalDevice::InitializeDevice()
     m_CommandQueues[EComputeQueue] = std::make_unique<CommandQueue>(m_Services, queueFamilies.m_ComputeQueueIndex.value(), EComputeQueue);
     m_CommandQueues[EPresentQueue] = std::make_unique<CommandQueue>(m_Services, queueFamilies.m_PresentQueueIndex.value(), EPresentQueue);
     m_CommandQueues[ETransferQueue] = std::make_unique<CommandQueue>(m_Services, queueFamilies.m_TransferQueueIndex.value(), ETransferQueue);
+
+    m_MemoryAllocator = std::make_unique<DeviceMemoryAllocator>(m_Services);
+    m_MemoryTracker = std::make_unique<MemoryTracker>(m_Services, m_HasMemoryBudget);
+    m_StagingRing = std::make_unique<StagingRing>(m_Services);
 }
 
 VkDevice krt::LogicalDevice::GetVkDevice() const
@@ -133,6 +156,31 @@ krt::CommandQueue& krt::LogicalDevice::GetCommandQueue(const ECommandQueueType a
     return *m_CommandQueues[a_Type];
 }
 
+krt::DeviceMemoryAllocator& krt::LogicalDevice::GetMemoryAllocator()
+{
+    return *m_MemoryAllocator;
+}
+
+krt::StagingRing& krt::LogicalDevice::GetStagingRing()
+{
+    return *m_StagingRing;
+}
+
+krt::MemoryTracker& krt::LogicalDevice::GetMemoryTracker()
+{
+    return *m_MemoryTracker;
+}
+
+krt::LogicalDevice::CreatedObjects krt::LogicalDevice::GetCreatedObjects() const
+{
+    CreatedObjects objects;
+    objects.m_Buffers = m_NumBuffers;
+    objects.m_Textures = m_NumTextures;
+    objects.m_DescriptorPools = m_NumDescriptorPools;
+    objects.m_DescriptorSets = m_NumDescriptorSets;
+    return objects;
+}
+
 std::vector<const char*> krt::LogicalDevice::GetRequiredExtensions() const
 {
     // Get the extensions required for GLFW to function
@@ -145,19 +193,36 @@ std::vector<const char*> krt::LogicalDevice::GetRequiredExtensions() const
     extensions.emplace_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
 #endif
 
+    if (m_HasProperties2)
+        extensions.emplace_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+
     return extensions;
 }
 
+bool krt::LogicalDevice::IsInstanceExtensionSupported(const char* a_Extension)
+{
+    uint32_t numExtensions;
+    ThrowIfFailed(vkEnumerateInstanceExtensionProperties(nullptr, &numExtensions, nullptr));
+    std::vector<VkExtensionProperties> extensions(numExtensions);
+    ThrowIfFailed(vkEnumerateInstanceExtensionProperties(nullptr, &numExtensions, extensions.data()));
+
+    return std::find_if(extensions.begin(), extensions.end(), [&](VkExtensionProperties& a_Entry)
+    {
+        return !std::strcmp(a_Entry.extensionName, a_Extension);
+    }) != extensions.end();
+}
+
 void krt::LogicalDevice::ResizeBuffer(Buffer& a_Buffer, uint64_t a_NewSize, bool a_PreserveContent)
 {
     auto oldBuffer = a_Buffer.m_VkBuffer;
-    auto oldMemory = a_Buffer.m_VkDeviceMemory;
+    auto oldAllocation = a_Buffer.m_Allocation;
 
     auto newElements = CreateBufferElements(a_NewSize, a_Buffer.m_UsageFlags,
         a_Buffer.m_MemoryPropertyFlags, a_Buffer.m_QueuesWithAccess);
 
     a_Buffer.m_VkBuffer = newElements.first;
-    a_Buffer.m_VkDeviceMemory = newElements.second;
+    a_Buffer.m_Allocation = newElements.second;
+    m_MemoryTracker->Retrack(&a_Buffer, a_Buffer.m_Allocation);
 
     if (a_PreserveContent && a_Buffer.m_BufferSize < a_NewSize)
     {
@@ -173,15 +238,60 @@ void krt::LogicalDevice::ResizeBuffer(Buffer& a_Buffer, uint64_t a_NewSize, bool
     a_Buffer.m_BufferSize = a_NewSize;
 
     vkDestroyBuffer(m_VkLogicalDevice, oldBuffer, m_Services.m_AllocationCallbacks);
-    vkFreeMemory(m_VkLogicalDevice, oldMemory, m_Services.m_AllocationCallbacks);
+    m_MemoryAllocator->Free(oldAllocation);
 }
 
-void krt::LogicalDevice::CopyToDeviceMemory(VkDeviceMemory a_DeviceMemory, const void* a_Data, uint64_t a_DataSize)
+std::unique_ptr<krt::Texture> krt::LogicalDevice::CreateTexture(glm::uvec2 a_Dimensions, VkFormat a_Format,
+    VkImageUsageFlags a_Usage, const std::set<ECommandQueueType>& a_QueuesWithAccess, uint32_t a_NumMips, const std::string& a_Owner)
 {
-    void* mem;
-    vkMapMemory(m_Services.m_LogicalDevice->GetVkDevice(), a_DeviceMemory, 0, a_DataSize, 0, &mem);
-    memcpy(mem, a_Data, a_DataSize);
-    vkUnmapMemory(m_Services.m_LogicalDevice->GetVkDevice(), a_DeviceMemory);
+    std::unique_ptr<Texture> texture = std::make_unique<Texture>(m_Services, a_Format);
+    texture->m_NumMips = a_NumMips;
+
+    auto queueIndices = GetQueueIndices(a_QueuesWithAccess);
+
+    VkImageCreateInfo imageInfo = {};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.extent = { a_Dimensions.x, a_Dimensions.y, 1 };
+    imageInfo.mipLevels = a_NumMips;
+    imageInfo.arrayLayers = 1;
+    imageInfo.format = a_Format;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    imageInfo.usage = a_Usage;
+    imageInfo.pQueueFamilyIndices = queueIndices.data();
+    imageInfo.queueFamilyIndexCount = static_cast<uint32_t>(queueIndices.size());
+    imageInfo.sharingMode = queueIndices.size() == 1 ? VK_SHARING_MODE_EXCLUSIVE : VK_SHARING_MODE_CONCURRENT;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+
+    ThrowIfFailed(vkCreateImage(m_VkLogicalDevice, &imageInfo, m_Services.m_AllocationCallbacks, &texture->m_VkImage));
+    m_NumTextures++;
+
+    texture->m_Allocation = m_MemoryAllocator->BindImage(texture->m_VkImage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    m_MemoryTracker->Track(texture.get(), texture->m_Allocation, ETextureMemory, a_Owner);
+
+    VkImageViewCreateInfo viewInfo = {};
+    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewInfo.format = a_Format;
+    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    viewInfo.image = texture->m_VkImage;
+    viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    viewInfo.subresourceRange.baseArrayLayer = 0;
+    viewInfo.subresourceRange.layerCount = 1;
+    viewInfo.subresourceRange.baseMipLevel = 0;
+    viewInfo.subresourceRange.levelCount = a_NumMips;
+
+    ThrowIfFailed(vkCreateImageView(m_VkLogicalDevice, &viewInfo, m_Services.m_AllocationCallbacks, &texture->m_VkImageView));
+
+    return texture;
+}
+
+void krt::LogicalDevice::CopyToDeviceMemory(const DeviceMemoryAllocator::Allocation& a_Allocation, const void* a_Data, uint64_t a_DataSize)
+{
+    assert(a_DataSize <= a_Allocation.m_Size && a_Allocation.m_Mapped);
+
+    memcpy(a_Allocation.m_Mapped, a_Data, a_DataSize);
+    m_MemoryAllocator->Flush(a_Allocation, 0, a_DataSize);
 }
 
 std::vector<uint32_t> krt::LogicalDevice::GetQueueIndices(const std::set<ECommandQueueType>& a_Queues)
@@ -281,7 +391,7 @@ std::vector<VkDeviceQueueCreateInfo> krt::LogicalDevice::GenerateQueueInfos()
     return infos;
 }
 
-std::pair<VkBuffer, VkDeviceMemory> krt::LogicalDevice::CreateBufferElements(uint64_t a_Size,
+std::pair<VkBuffer, krt::DeviceMemoryAllocator::Allocation> krt::LogicalDevice::CreateBufferElements(uint64_t a_Size,
     VkBufferUsageFlags a_Usage, VkMemoryPropertyFlags a_MemoryProperties,
     const std::set<ECommandQueueType>& a_QueuesWithAccess)
 {
@@ -290,7 +400,6 @@ std::pair<VkBuffer, VkDeviceMemory> krt::LogicalDevice::CreateBufferElements(uin
     auto queues = GetQueueIndices(a_QueuesWithAccess);
 
     VkBuffer vkBuffer;
-    VkDeviceMemory vkDeviceMemory;
 
     bufferInfo = {};
     bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
@@ -300,18 +409,11 @@ std::pair<VkBuffer, VkDeviceMemory> krt::LogicalDevice::CreateBufferElements(uin
     bufferInfo.queueFamilyIndexCount = static_cast<uint32_t>(queues.size());
     bufferInfo.sharingMode = queues.size() == 1 ? VK_SHARING_MODE_EXCLUSIVE : VK_SHARING_MODE_CONCURRENT;
     ThrowIfFailed(vkCreateBuffer(m_VkLogicalDevice, &bufferInfo, m_Services.m_AllocationCallbacks, &vkBuffer));
+    m_NumBuffers++;
 
-    auto memoryInfo = m_Services.m_PhysicalDevice->GetMemoryInfoForBuffer(vkBuffer, a_MemoryProperties);
-
-    VkMemoryAllocateInfo alloc = {};
-    alloc.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    alloc.memoryTypeIndex = memoryInfo.m_MemoryType;
-    alloc.allocationSize = memoryInfo.m_Size;
-
-    ThrowIfFailed(vkAllocateMemory(m_VkLogicalDevice, &alloc, m_Services.m_AllocationCallbacks, &vkDeviceMemory));
-    ThrowIfFailed(vkBindBufferMemory(m_VkLogicalDevice, vkBuffer, vkDeviceMemory, 0));
+    auto allocation = m_MemoryAllocator->BindBuffer(vkBuffer, a_MemoryProperties);
 
-    auto buffer = std::make_pair(vkBuffer, vkDeviceMemory);
+    auto buffer = std::make_pair(vkBuffer, allocation);
 
     return buffer;
 }
@@ -3,6 +3,12 @@
 
 #include "vulkan/vulkan.h"
 
+#include "DeviceMemoryAllocator.h"
+#include "MemoryTracker.h"
+
+#include <glm/vec2.hpp>
+
+#include <atomic>
 #include <memory>
 #include <map>
 #include <set>
@@ -15,6 +21,8 @@ namespace krt
     class CommandQueue;
     class PhysicalDevice;
     class Buffer;
+    class Texture;
+    class StagingRing;
 }
 
 namespace krt
@@ -33,6 +41,16 @@ namespace krt
     {
         friend krt::PhysicalDevice;
     public:
+
+        // Vulkan objects created since the device was initialized, which the application compares from frame to frame
+        struct CreatedObjects
+        {
+            uint64_t m_Buffers = 0;
+            uint64_t m_Textures = 0;
+            uint64_t m_DescriptorPools = 0;
+            uint64_t m_DescriptorSets = 0;      // Taken from a pool and written, which is cheaper than creating one but still per call
+        };
+
         LogicalDevice(ServiceLocator& a_Services, const std::string& a_WindowTitle, const std::string& a_EngineName);
         ~LogicalDevice();
 
@@ -47,26 +65,45 @@ namespace krt
         VkDevice            GetVkDevice() const;
         VkInstance          GetVkInstance() const;
         CommandQueue&       GetCommandQueue(const ECommandQueueType a_Type);
-
+        // Backs every buffer and texture. Only exists once InitializeDevice has been called.
+        DeviceMemoryAllocator& GetMemoryAllocator();
+        // Every upload copies its data through the staging ring. Only exists once InitializeDevice has been called.
+        StagingRing&        GetStagingRing();
+        // Knows the category and owner of the memory of every buffer and texture. Only exists once InitializeDevice has been called.
+        MemoryTracker&      GetMemoryTracker();
+
+        // The memory of the buffer counts against a_Category, and a_Owner names the asset it belongs to
         template<typename BufferType = Buffer>
         std::unique_ptr<BufferType> CreateBuffer(uint64_t a_Size, VkBufferUsageFlags a_Usage,
-            VkMemoryPropertyFlags a_MemoryProperties, const std::set<ECommandQueueType>& a_QueuesWithAccess);
+            VkMemoryPropertyFlags a_MemoryProperties, const std::set<ECommandQueueType>& a_QueuesWithAccess,
+            EMemoryCategory a_Category, const std::string& a_Owner = std::string());
+
+        // Creates a device local 2D texture and its image view. The content of the image is undefined until it is uploaded to.
+        // The view covers all a_NumMips levels.
+        std::unique_ptr<Texture> CreateTexture(glm::uvec2 a_Dimensions, VkFormat a_Format, VkImageUsageFlags a_Usage,
+            const std::set<ECommandQueueType>& a_QueuesWithAccess, uint32_t a_NumMips = 1, const std::string& a_Owner = std::string());
 
         // Resize an existing Buffer object. Does not preserve the current buffer content by default.
         // If the buffer is being resized to a smaller size, the contents are never preserved.
         void ResizeBuffer(Buffer& a_Buffer, uint64_t a_NewSize, bool a_PreserveContent = false);
 
-        void CopyToDeviceMemory(VkDeviceMemory a_DeviceMemory, const void* a_Data, uint64_t a_DataSize);
+        // Writes to host visible memory through the mapping it keeps for its whole lifetime, and flushes it if it is not coherent
+        void CopyToDeviceMemory(const DeviceMemoryAllocator::Allocation& a_Allocation, const void* a_Data, uint64_t a_DataSize);
 
         std::vector<uint32_t> GetQueueIndices(const std::set<ECommandQueueType>& a_Queues);
 
+        CreatedObjects GetCreatedObjects() const;
+        void CountDescriptorPool() { m_NumDescriptorPools++; }
+        void CountDescriptorSet() { m_NumDescriptorSets++; }
+
         // Flushes all command queues to ensure that the device is idle
         void Flush();
     private:
 
-        std::pair<VkBuffer, VkDeviceMemory> CreateBufferElements(uint64_t a_Size, VkBufferUsageFlags a_Usage,
+        std::pair<VkBuffer, DeviceMemoryAllocator::Allocation> CreateBufferElements(uint64_t a_Size, VkBufferUsageFlags a_Usage,
             VkMemoryPropertyFlags a_MemoryProperties, const std::set<ECommandQueueType>& a_QueuesWithAccess);
         std::vector<const char*>    GetRequiredExtensions() const;
+        static bool                 IsInstanceExtensionSupported(const char* a_Extension);
         bool                        CheckValidationLayerSupport() const;
         bool                        ValidateExtensionSupport(std::vector<const char*> a_Extensions) const;
 
@@ -76,10 +113,22 @@ namespace krt
 
         ServiceLocator& m_Services;
 
+        // VK_EXT_memory_budget is optional, and needs VK_KHR_get_physical_device_properties2 on the instance
+        const bool                      m_HasProperties2;
+        bool                            m_HasMemoryBudget;
+
         VkInstance                      m_VkInstance;
         VkDevice                        m_VkLogicalDevice;
 
         std::map<ECommandQueueType, std::unique_ptr<CommandQueue>> m_CommandQueues;
+        std::unique_ptr<DeviceMemoryAllocator> m_MemoryAllocator;
+        std::unique_ptr<StagingRing> m_StagingRing;
+        std::unique_ptr<MemoryTracker> m_MemoryTracker;
+
+        std::atomic<uint64_t> m_NumBuffers;
+        std::atomic<uint64_t> m_NumTextures;
+        std::atomic<uint64_t> m_NumDescriptorPools;
+        std::atomic<uint64_t> m_NumDescriptorSets;
     };
 
 }
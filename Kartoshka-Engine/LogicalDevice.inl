@@ -1,7 +1,8 @@
 
 template<typename BufferType>
 std::unique_ptr<BufferType> krt::LogicalDevice::CreateBuffer(uint64_t a_Size, VkBufferUsageFlags a_Usage,
-    VkMemoryPropertyFlags a_MemoryProperties, const std::set<ECommandQueueType>& a_QueuesWithAccess)
+    VkMemoryPropertyFlags a_MemoryProperties, const std::set<ECommandQueueType>& a_QueuesWithAccess,
+    EMemoryCategory a_Category, const std::string& a_Owner)
 {
     static_assert(std::is_base_of<Buffer, BufferType>());
 
@@ -9,7 +10,10 @@ std::unique_ptr<BufferType> krt::LogicalDevice::CreateBuffer(uint64_t a_Size, Vk
 
     auto buffer = std::make_unique<BufferType>(m_Services, a_Size, a_Usage, a_MemoryProperties, a_QueuesWithAccess);
     buffer->m_VkBuffer = elements.first;
-    buffer->m_VkDeviceMemory = elements.second;
+    buffer->m_Allocation = elements.second;
+
+    // Buffers untrack themselves when they are destroyed, by the address of their Buffer base
+    m_MemoryTracker->Track(static_cast<Buffer*>(buffer.get()), buffer->m_Allocation, a_Category, a_Owner);
 
     return std::move(buffer);
 }
\ No newline at end of file
@@ -0,0 +1,97 @@
+#include "MappedFile.h"
+
+#include <system_error>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+krt::MappedFile::MappedFile(const std::string& a_Path)
+    : m_FileHandle(INVALID_HANDLE_VALUE)
+    , m_MappingHandle(nullptr)
+    , m_Data(nullptr)
+    , m_Size(0)
+{
+    m_FileHandle = CreateFileA(a_Path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (m_FileHandle == INVALID_HANDLE_VALUE)
+        throw std::system_error(std::make_error_code(std::errc::no_such_file_or_directory), a_Path);
+
+    LARGE_INTEGER size;
+    GetFileSizeEx(m_FileHandle, &size);
+    m_Size = static_cast<uint64_t>(size.QuadPart);
+
+    // Empty files can not be mapped, but are still valid files
+    if (m_Size == 0)
+        return;
+
+    m_MappingHandle = CreateFileMappingA(m_FileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (m_MappingHandle)
+        m_Data = static_cast<const uint8_t*>(MapViewOfFile(m_MappingHandle, FILE_MAP_READ, 0, 0, 0));
+
+    if (!m_Data)
+    {
+        if (m_MappingHandle)
+            CloseHandle(m_MappingHandle);
+        CloseHandle(m_FileHandle);
+        throw std::system_error(std::make_error_code(std::errc::not_enough_memory), a_Path);
+    }
+}
+
+krt::MappedFile::~MappedFile()
+{
+    if (m_Data)
+        UnmapViewOfFile(m_Data);
+    if (m_MappingHandle)
+        CloseHandle(m_MappingHandle);
+    if (m_FileHandle != INVALID_HANDLE_VALUE)
+        CloseHandle(m_FileHandle);
+}
+
+#else
+
+krt::MappedFile::MappedFile(const std::string& a_Path)
+    : m_FileDescriptor(-1)
+    , m_Data(nullptr)
+    , m_Size(0)
+{
+    m_FileDescriptor = open(a_Path.c_str(), O_RDONLY);
+    if (m_FileDescriptor == -1)
+        throw std::system_error(std::make_error_code(std::errc::no_such_file_or_directory), a_Path);
+
+    struct stat fileStats;
+    fstat(m_FileDescriptor, &fileStats);
+    m_Size = static_cast<uint64_t>(fileStats.st_size);
+
+    // Empty files can not be mapped, but are still valid files
+    if (m_Size == 0)
+        return;
+
+    void* data = mmap(nullptr, m_Size, PROT_READ, MAP_PRIVATE, m_FileDescriptor, 0);
+    if (data == MAP_FAILED)
+    {
+        close(m_FileDescriptor);
+        throw std::system_error(std::make_error_code(std::errc::not_enough_memory), a_Path);
+    }
+
+    m_Data = static_cast<const uint8_t*>(data);
+}
+
+krt::MappedFile::~MappedFile()
+{
+    if (m_Data)
+        munmap(const_cast<uint8_t*>(m_Data), m_Size);
+    if (m_FileDescriptor != -1)
+        close(m_FileDescriptor);
+}
+
+#endif
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+namespace krt
+{
+    // Read-only memory mapping of an entire file.
+    // Pages are only brought into memory by the OS when they are first read, and are backed by the file itself
+    // instead of the page file, so mapping large files does not duplicate them in RAM.
+    class MappedFile
+    {
+    public:
+        // Throws std::system_error if the file can not be opened or mapped
+        explicit MappedFile(const std::string& a_Path);
+        ~MappedFile();
+
+        MappedFile(MappedFile&) = delete;             // No copy c-tor
+        MappedFile(MappedFile&&) = delete;            // No move c-tor
+        MappedFile& operator=(MappedFile&) = delete;  // No copy assignment
+        MappedFile& operator=(MappedFile&&) = delete; // No move assignment
+
+        const uint8_t* GetData() const { return m_Data; }
+        uint64_t GetSize() const { return m_Size; }
+
+    private:
+
+#ifdef _WIN32
+        void* m_FileHandle;
+        void* m_MappingHandle;
+#else
+        int m_FileDescriptor;
+#endif
+
+        const uint8_t* m_Data;
+        uint64_t m_Size;
+    };
+}
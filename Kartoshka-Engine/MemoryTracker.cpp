@@ -0,0 +1,300 @@
+#include "MemoryTracker.h"
+
+#include "ServiceLocator.h"
+#include "LogicalDevice.h"
+#include "PhysicalDevice.h"
+
+#include "VkHelpers.h"
+
+#include "JSON/nlohmann/json.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <fstream>
+
+krt::MemoryTracker::MemoryTracker(ServiceLocator& a_Services, bool a_HasDriverBudget)
+    : m_Services(a_Services)
+    , m_HasDriverBudget(a_HasDriverBudget)
+    , m_HeapBytes()
+{
+    vkGetPhysicalDeviceMemoryProperties(m_Services.m_PhysicalDevice->GetPhysicalDevice(), &m_MemoryProperties);
+}
+
+krt::MemoryTracker::~MemoryTracker()
+{
+}
+
+const char* krt::MemoryTracker::GetCategoryName(EMemoryCategory a_Category)
+{
+    switch (a_Category)
+    {
+    case EGeometryMemory:
+        return "Geometry";
+    case ETextureMemory:
+        return "Textures";
+    case EShadowMapMemory:
+        return "Shadow maps";
+    case ERenderTargetMemory:
+        return "Render targets";
+    case EStagingMemory:
+        return "Staging";
+    case EFrameMemory:
+        return "Frame data";
+    case EUniformMemory:
+        return "Uniforms";
+    default:
+        return "Other";
+    }
+}
+
+void krt::MemoryTracker::Track(const void* a_Resource, const DeviceMemoryAllocator::Allocation& a_Allocation, EMemoryCategory a_Category,
+    const std::string& a_Owner)
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    auto& entry = m_Entries[a_Resource];
+    assert(entry.m_Owner.empty() && entry.m_Size == 0 && "The resource is already tracked.");
+
+    entry.m_Category = a_Category;
+    entry.m_Owner = a_Owner;
+    entry.m_Size = a_Allocation.m_Size;
+    entry.m_HeapIndex = a_Allocation.m_HeapIndex;
+    Add(entry);
+}
+
+void krt::MemoryTracker::Retrack(const void* a_Resource, const DeviceMemoryAllocator::Allocation& a_Allocation)
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    auto it = m_Entries.find(a_Resource);
+    if (it == m_Entries.end())
+        return;
+
+    Remove(it->second);
+    it->second.m_Size = a_Allocation.m_Size;
+    it->second.m_HeapIndex = a_Allocation.m_HeapIndex;
+    Add(it->second);
+}
+
+void krt::MemoryTracker::Untrack(const void* a_Resource)
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    auto it = m_Entries.find(a_Resource);
+    if (it == m_Entries.end())
+        return;
+
+    Remove(it->second);
+    m_Entries.erase(it);
+}
+
+void krt::MemoryTracker::SetOwner(const void* a_Resource, const std::string& a_Owner)
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    auto it = m_Entries.find(a_Resource);
+    if (it != m_Entries.end())
+        it->second.m_Owner = a_Owner;
+}
+
+std::string krt::MemoryTracker::GetOwner(const void* a_Resource) const
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    auto it = m_Entries.find(a_Resource);
+    return it != m_Entries.end() ? it->second.m_Owner : std::string();
+}
+
+void krt::MemoryTracker::SetBudget(EMemoryCategory a_Category, uint64_t a_Bytes)
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    m_Categories[a_Category].m_Budget = a_Bytes;
+}
+
+krt::MemoryTracker::Report krt::MemoryTracker::GetReport() const
+{
+    Report report;
+    report.m_HasDriverBudget = m_HasDriverBudget;
+    report.m_Heaps.resize(m_MemoryProperties.memoryHeapCount);
+
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+
+        for (uint32_t i = 0; i < ENumMemoryCategories; i++)
+            report.m_Categories[i] = m_Categories[i];
+
+        for (uint32_t i = 0; i < m_MemoryProperties.memoryHeapCount; i++)
+            report.m_Heaps[i].m_TrackedBytes = m_HeapBytes[i];
+    }
+
+    for (uint32_t i = 0; i < m_MemoryProperties.memoryHeapCount; i++)
+    {
+        report.m_Heaps[i].m_Size = m_MemoryProperties.memoryHeaps[i].size;
+        report.m_Heaps[i].m_DeviceLocal = (m_MemoryProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0;
+    }
+
+    if (m_HasDriverBudget)
+    {
+        VkPhysicalDeviceMemoryBudgetPropertiesEXT budget = {};
+        budget.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+
+        VkPhysicalDeviceMemoryProperties2 properties = {};
+        properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+        properties.pNext = &budget;
+
+        vkext::GetPhysicalDeviceMemoryProperties2KHR(m_Services.m_LogicalDevice->GetVkInstance(),
+            m_Services.m_PhysicalDevice->GetPhysicalDevice(), properties);
+
+        for (uint32_t i = 0; i < m_MemoryProperties.memoryHeapCount; i++)
+        {
+            report.m_Heaps[i].m_Budget = budget.heapBudget[i];
+            report.m_Heaps[i].m_Usage = budget.heapUsage[i];
+        }
+    }
+    else
+    {
+        // Without the driver's numbers, other processes are assumed to leave a fifth of each heap to this one
+        auto statistics = m_Services.m_LogicalDevice->GetMemoryAllocator().GetStatistics();
+        for (uint32_t i = 0; i < m_MemoryProperties.memoryHeapCount; i++)
+        {
+            report.m_Heaps[i].m_Budget = report.m_Heaps[i].m_Size / 5 * 4;
+            report.m_Heaps[i].m_Usage = statistics.m_HeapBlockMemory[i];
+        }
+    }
+
+    return report;
+}
+
+bool krt::MemoryTracker::Report::IsOverBudget() const
+{
+    for (auto& heap : m_Heaps)
+    {
+        if (heap.m_Usage > heap.m_Budget)
+            return true;
+    }
+
+    for (auto& category : m_Categories)
+    {
+        if (category.m_Budget != 0 && category.m_Bytes > category.m_Budget)
+            return true;
+    }
+
+    return false;
+}
+
+std::vector<krt::MemoryTracker::OwnerReport> krt::MemoryTracker::GetLargestOwners(uint32_t a_MaxOwners) const
+{
+    std::map<std::string, OwnerReport> owners;
+
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+
+        for (auto& entry : m_Entries)
+        {
+            auto& owner = owners[entry.second.m_Owner];
+            owner.m_NumResources++;
+            owner.m_Bytes += entry.second.m_Size;
+            owner.m_CategoryBytes[entry.second.m_Category] += entry.second.m_Size;
+        }
+    }
+
+    std::vector<OwnerReport> largest;
+    largest.reserve(owners.size());
+    for (auto& owner : owners)
+    {
+        largest.push_back(std::move(owner.second));
+        largest.back().m_Owner = owner.first.empty() ? "Untagged" : owner.first;
+    }
+
+    std::sort(largest.begin(), largest.end(), [](const OwnerReport& a_Left, const OwnerReport& a_Right)
+    {
+        return a_Left.m_Bytes > a_Right.m_Bytes;
+    });
+
+    if (largest.size() > a_MaxOwners)
+        largest.resize(a_MaxOwners);
+
+    return largest;
+}
+
+std::string krt::MemoryTracker::DumpJson() const
+{
+    auto report = GetReport();
+
+    nlohmann::json document;
+    document["driverBudget"] = report.m_HasDriverBudget;
+    document["overBudget"] = report.IsOverBudget();
+
+    auto& heaps = document["heaps"] = nlohmann::json::array();
+    for (auto& heap : report.m_Heaps)
+    {
+        heaps.push_back({
+            { "size", heap.m_Size },
+            { "deviceLocal", heap.m_DeviceLocal },
+            { "budget", heap.m_Budget },
+            { "usage", heap.m_Usage },
+            { "tracked", heap.m_TrackedBytes }
+        });
+    }
+
+    auto& categories = document["categories"] = nlohmann::json::object();
+    for (uint32_t i = 0; i < ENumMemoryCategories; i++)
+    {
+        auto& category = report.m_Categories[i];
+        categories[GetCategoryName(static_cast<EMemoryCategory>(i))] = {
+            { "resources", category.m_NumResources },
+            { "bytes", category.m_Bytes },
+            { "peakBytes", category.m_PeakBytes },
+            { "budget", category.m_Budget }
+        };
+    }
+
+    auto& owners = document["owners"] = nlohmann::json::array();
+    for (auto& owner : GetLargestOwners(UINT32_MAX))
+    {
+        nlohmann::json ownerCategories = nlohmann::json::object();
+        for (uint32_t i = 0; i < ENumMemoryCategories; i++)
+        {
+            if (owner.m_CategoryBytes[i] != 0)
+                ownerCategories[GetCategoryName(static_cast<EMemoryCategory>(i))] = owner.m_CategoryBytes[i];
+        }
+
+        owners.push_back({
+            { "owner", owner.m_Owner },
+            { "resources", owner.m_NumResources },
+            { "bytes", owner.m_Bytes },
+            { "categories", std::move(ownerCategories) }
+        });
+    }
+
+    return document.dump(4);
+}
+
+bool krt::MemoryTracker::WriteJson(const std::string& a_Filepath) const
+{
+    std::ofstream file(a_Filepath, std::ios::trunc);
+    if (!file)
+        return false;
+
+    file << DumpJson();
+    return static_cast<bool>(file);
+}
+
+void krt::MemoryTracker::Add(const Entry& a_Entry)
+{
+    auto& category = m_Categories[a_Entry.m_Category];
+    category.m_NumResources++;
+    category.m_Bytes += a_Entry.m_Size;
+    category.m_PeakBytes = std::max(category.m_PeakBytes, category.m_Bytes);
+
+    m_HeapBytes[a_Entry.m_HeapIndex] += a_Entry.m_Size;
+}
+
+void krt::MemoryTracker::Remove(const Entry& a_Entry)
+{
+    auto& category = m_Categories[a_Entry.m_Category];
+    category.m_NumResources--;
+    category.m_Bytes -= a_Entry.m_Size;
+
+    m_HeapBytes[a_Entry.m_HeapIndex] -= a_Entry.m_Size;
+}
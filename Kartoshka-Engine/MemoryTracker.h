@@ -0,0 +1,130 @@
+#pragma once
+
+#include "vulkan/vulkan.h"
+
+#include "DeviceMemoryAllocator.h"
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace krt
+{
+    struct ServiceLocator;
+}
+
+namespace krt
+{
+    // What a buffer or image is used for, which decides the budget its memory counts against
+    enum EMemoryCategory : uint8_t
+    {
+        EGeometryMemory,        // Vertex and index buffers
+        ETextureMemory,
+        EShadowMapMemory,
+        ERenderTargetMemory,    // Depth buffers and other attachments of the screen
+        EStagingMemory,         // The staging ring and the buffers uploads fall back to when it is full
+        EFrameMemory,           // Data written every frame, like instances and palettes
+        EUniformMemory,         // Buffers owned by descriptor sets
+        EOtherMemory,
+        ENumMemoryCategories
+    };
+
+    // Keeps the category and owning asset of every buffer and texture along with the memory bound to it, to see where device memory goes.
+    // The totals of the heaps are compared against the budget the driver reports through VK_EXT_memory_budget when the device supports it.
+    // Resources are tracked from their creation until their destruction, from whichever thread creates them.
+    class MemoryTracker
+    {
+    public:
+
+        struct CategoryReport
+        {
+            uint32_t m_NumResources = 0;
+            uint64_t m_Bytes = 0;
+            uint64_t m_PeakBytes = 0;       // Most bytes the category has held at once
+            uint64_t m_Budget = 0;          // 0 when the category has no budget
+        };
+
+        struct HeapReport
+        {
+            uint64_t m_Size = 0;
+            bool m_DeviceLocal = false;
+            uint64_t m_Budget = 0;          // What the driver allows the process to use, 80% of the heap without VK_EXT_memory_budget
+            uint64_t m_Usage = 0;           // What the driver reports as used by the process, the blocks of the allocator without it
+            uint64_t m_TrackedBytes = 0;    // Bytes bound to tracked resources
+        };
+
+        struct Report
+        {
+            bool m_HasDriverBudget = false;
+            std::vector<HeapReport> m_Heaps;
+            CategoryReport m_Categories[ENumMemoryCategories];
+
+            bool IsOverBudget() const;
+        };
+
+        struct OwnerReport
+        {
+            std::string m_Owner;
+            uint32_t m_NumResources = 0;
+            uint64_t m_Bytes = 0;
+            uint64_t m_CategoryBytes[ENumMemoryCategories] = {};
+        };
+
+        MemoryTracker(ServiceLocator& a_Services, bool a_HasDriverBudget);
+        ~MemoryTracker();
+
+        MemoryTracker(MemoryTracker&) = delete;
+        MemoryTracker(MemoryTracker&&) = delete;
+        MemoryTracker& operator=(MemoryTracker&) = delete;
+        MemoryTracker& operator=(MemoryTracker&&) = delete;
+
+        static const char* GetCategoryName(EMemoryCategory a_Category);
+
+        // a_Resource is the Buffer or Texture the allocation is bound to, which untracks itself when it is destroyed
+        void Track(const void* a_Resource, const DeviceMemoryAllocator::Allocation& a_Allocation, EMemoryCategory a_Category,
+            const std::string& a_Owner);
+        // Moves the resource to the allocation it has been rebound to, keeping its category and owner
+        void Retrack(const void* a_Resource, const DeviceMemoryAllocator::Allocation& a_Allocation);
+        void Untrack(const void* a_Resource);
+
+        // For resources created on behalf of an asset by code that does not know which
+        void SetOwner(const void* a_Resource, const std::string& a_Owner);
+        std::string GetOwner(const void* a_Resource) const;
+
+        // Bytes the category should stay below, 0 to remove the budget
+        void SetBudget(EMemoryCategory a_Category, uint64_t a_Bytes);
+
+        Report GetReport() const;
+        // The owners holding the most memory, largest first
+        std::vector<OwnerReport> GetLargestOwners(uint32_t a_MaxOwners) const;
+
+        // The report and the memory of every owner as JSON, to be compared between runs
+        std::string DumpJson() const;
+        bool WriteJson(const std::string& a_Filepath) const;
+
+    private:
+
+        struct Entry
+        {
+            EMemoryCategory m_Category;
+            std::string m_Owner;
+            uint64_t m_Size;
+            uint32_t m_HeapIndex;
+        };
+
+        void Add(const Entry& a_Entry);
+        void Remove(const Entry& a_Entry);
+
+        ServiceLocator& m_Services;
+        const bool m_HasDriverBudget;
+        VkPhysicalDeviceMemoryProperties m_MemoryProperties;
+
+        mutable std::mutex m_Mutex;
+        std::map<const void*, Entry> m_Entries;
+        CategoryReport m_Categories[ENumMemoryCategories];
+        uint64_t m_HeapBytes[VK_MAX_MEMORY_HEAPS];
+    };
+}
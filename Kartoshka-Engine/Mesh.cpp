@@ -4,15 +4,18 @@
 #include "DescriptorSet.h"
 #include "IndexBuffer.h"
 #include "VertexBuffer.h"
+#include "CommandBuffer.h"
+#include "CommandQueue.h"
+#include "MorphTargets.h"
+
+#include <cassert>
 
 krt::Material::Material()
     : m_Sampler(nullptr)
     , m_DiffuseTexture(nullptr)
-    , m_DescriptorSet(nullptr)
-    , m_DescriptorSetDirty(true)
-    , m_GraphicsPipeline(nullptr)
+    , m_DoubleSided(false)
+    , m_DescriptorSetsDirty(true)
 {
-    m_DescriptorSet = nullptr;
 }
 
 krt::Material::~Material()
@@ -23,53 +26,70 @@ krt::Material::~Material()
 void krt::Material::SetSampler(const Sampler& a_NewSampler)
 {
     m_Sampler = &a_NewSampler;
-    m_DescriptorSetDirty = true;
+    m_DescriptorSetsDirty = true;
 }
 
 void krt::Material::SetDiffuseTexture(const std::shared_ptr<Texture> a_NewDiffuseTexture)
 {
     m_DiffuseTexture = a_NewDiffuseTexture;
-    m_DescriptorSetDirty = true;
+    m_DescriptorSetsDirty = true;
 }
 
 void krt::Material::SetNormalMap(const std::shared_ptr<Texture> a_NewNormalMap)
 {
     m_NormalMap = a_NewNormalMap;
-    m_DescriptorSetDirty = true;
+    m_DescriptorSetsDirty = true;
 }
 
 void krt::Material::SetDiffuseColor(const glm::vec4& a_NewDiffuseColor)
 {
     m_DiffuseColor = a_NewDiffuseColor;
-    m_DescriptorSetDirty = true;
+    m_DescriptorSetsDirty = true;
 }
 
-krt::DescriptorSet& krt::Material::GetDescriptorSet(GraphicsPipeline& a_TargetPipeline, uint32_t a_SetIndex)
+krt::DescriptorSet& krt::Material::GetDescriptorSet(GraphicsPipeline& a_TargetPipeline, uint32_t a_SetIndex, CommandQueue& a_UsingQueue)
 {
-    UpdateDescriptorSet(a_TargetPipeline, a_SetIndex);
-    return *m_DescriptorSet;
+    UpdateDescriptorSet(a_TargetPipeline, a_SetIndex, a_UsingQueue);
+    return *m_DescriptorSets[&a_TargetPipeline];
 }
 
-void krt::Material::UpdateDescriptorSet(GraphicsPipeline& a_TargetPipeline, uint32_t a_SetIndex) const
+void krt::Material::UpdateDescriptorSet(GraphicsPipeline& a_TargetPipeline, uint32_t a_SetIndex, CommandQueue& a_UsingQueue) const
 {
-    if (!m_DescriptorSetDirty && m_GraphicsPipeline == &a_TargetPipeline)
-        return;
+    // Sets can not be written to while frames that use them are in flight, so changed sets are replaced by new ones.
+    // Every pipeline the material is drawn with keeps its own set, so alternating between pipeline variants does not rebuild them.
+    if (m_DescriptorSetsDirty)
+    {
+        if (!m_DescriptorSets.empty())
+        {
+            auto retired = std::make_shared<RetiredDescriptorSets>();
+            retired->m_DescriptorSets = std::move(m_DescriptorSets);
+            retired->m_DiffuseTexture = std::move(m_BoundDiffuseTexture);
+            retired->m_NormalMap = std::move(m_BoundNormalMap);
+            a_UsingQueue.ReleaseAfterSubmissions(std::move(retired));
 
-    if (m_DescriptorSet == nullptr || m_GraphicsPipeline != &a_TargetPipeline)
+            m_DescriptorSets.clear();
+        }
+
+        m_DescriptorSetsDirty = false;
+    }
+
+    auto& descriptorSet = m_DescriptorSets[&a_TargetPipeline];
+    if (descriptorSet == nullptr)
     {
-        m_DescriptorSet = a_TargetPipeline.CreateDescriptorSet(a_SetIndex, { EGraphicsQueue });
-        m_GraphicsPipeline = &a_TargetPipeline;
+        descriptorSet = a_TargetPipeline.CreateDescriptorSet(a_SetIndex, { EGraphicsQueue });
+        BuildDescriptorSet(*descriptorSet);
     }
-    BuildDescriptorSet();
 }
 
-void krt::Material::BuildDescriptorSet() const
+void krt::Material::BuildDescriptorSet(DescriptorSet& a_DescriptorSet) const
 {
-    m_DescriptorSet->SetSampler(*m_Sampler, 0);
-    m_DescriptorSet->SetTexture(*m_DiffuseTexture, 1);
-    m_DescriptorSet->SetUniformBuffer(m_DiffuseColor, 2, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
-    m_DescriptorSet->SetTexture(*m_NormalMap, 3);
-    m_DescriptorSetDirty = false;
+    m_BoundDiffuseTexture = m_DiffuseTexture;
+    m_BoundNormalMap = m_NormalMap;
+
+    a_DescriptorSet.SetSampler(*m_Sampler, 0);
+    a_DescriptorSet.SetTexture(*m_DiffuseTexture, 1);
+    a_DescriptorSet.SetUniformBuffer(m_DiffuseColor, 2, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+    a_DescriptorSet.SetTexture(*m_NormalMap, 3);
 }
 
 krt::Mesh::Mesh()
@@ -79,3 +99,71 @@ krt::Mesh::Mesh()
 krt::Mesh::~Mesh()
 {
 }
+
+void krt::Mesh::DescribeVertexInput(EVertexLayout a_Layout, bool a_ConstantColor, VertexInputInfo& a_VertexInput)
+{
+    if (a_Layout == EQuantizedVertexAttributes)
+    {
+        static_assert(sizeof(QuantizedVertex) == 3 * sizeof(uint32_t), "The quantized vertex has to be tightly packed.");
+
+        a_VertexInput.AddPerVertexAttribute<glm::vec3>(0, 0, VK_FORMAT_R32G32B32_SFLOAT);        // Positions
+        a_VertexInput.AddPerVertexAttribute<glm::u16vec2>(1, 1, VK_FORMAT_R16G16_SFLOAT);        // Tex Coords
+        a_VertexInput.AddPerVertexAttribute<glm::i16vec2>(1, 3, VK_FORMAT_R16G16_SNORM);         // Normals
+        a_VertexInput.AddPerVertexAttribute<glm::i16vec2>(1, 4, VK_FORMAT_R16G16_SNORM);         // Tangents
+
+        if (a_ConstantColor)
+            a_VertexInput.AddPerInstanceAttribute<glm::u8vec4>(2, 2, VK_FORMAT_R8G8B8A8_UNORM);  // Vertex Colors
+        else
+            a_VertexInput.AddPerVertexAttribute<glm::u8vec4>(2, 2, VK_FORMAT_R8G8B8A8_UNORM);    // Vertex Colors
+        return;
+    }
+
+    assert(!a_ConstantColor && "Only the quantized layout supports constant colors.");
+
+    // The vertex input computes the offsets by adding up the attribute sizes of a binding,
+    // so the attributes are added in the order of the members of InterleavedVertex, which has no padding between them
+    static_assert(sizeof(InterleavedVertex) == sizeof(glm::vec2) + sizeof(glm::vec4) + sizeof(glm::vec3) + sizeof(glm::vec4),
+                  "The interleaved vertex has to be tightly packed.");
+
+    // Separate streams use the location of an attribute as its binding, interleaved attributes all share binding 1
+    bool interleaved = a_Layout == EInterleavedVertexAttributes;
+
+    a_VertexInput.AddPerVertexAttribute<glm::vec3>(0, 0, VK_FORMAT_R32G32B32_SFLOAT);                      // Positions
+    a_VertexInput.AddPerVertexAttribute<glm::vec2>(1, 1, VK_FORMAT_R32G32_SFLOAT);                         // Tex Coords
+    a_VertexInput.AddPerVertexAttribute<glm::vec4>(interleaved ? 1 : 2, 2, VK_FORMAT_R32G32B32A32_SFLOAT); // Vertex Colors
+    a_VertexInput.AddPerVertexAttribute<glm::vec3>(interleaved ? 1 : 3, 3, VK_FORMAT_R32G32B32_SFLOAT);    // Normals
+    a_VertexInput.AddPerVertexAttribute<glm::vec4>(interleaved ? 1 : 4, 4, VK_FORMAT_R32G32B32A32_SFLOAT); // Tangents
+}
+
+void krt::Mesh::DescribeSkinInput(VertexInputInfo& a_VertexInput)
+{
+    static_assert(sizeof(SkinVertex) == 2 * sizeof(glm::u16vec4), "The skin vertex has to be tightly packed.");
+
+    a_VertexInput.AddPerVertexAttribute<glm::u16vec4>(SkinBinding, SkinLocation, VK_FORMAT_R16G16B16A16_UINT);        // Joints
+    a_VertexInput.AddPerVertexAttribute<glm::u16vec4>(SkinBinding, SkinLocation + 1, VK_FORMAT_R16G16B16A16_UNORM);   // Weights
+}
+
+void krt::Mesh::Primitive::BindVertexBuffers(CommandBuffer& a_CommandBuffer) const
+{
+    a_CommandBuffer.SetVertexBuffer(*m_Positions, 0);
+
+    if (m_InterleavedAttributes)
+    {
+        a_CommandBuffer.SetVertexBuffer(*m_InterleavedAttributes, 1);
+
+        // The quantized layout keeps the colors out of the interleaved buffer
+        if (m_VertexColors)
+            a_CommandBuffer.SetVertexBuffer(*m_VertexColors, 2);
+    }
+    else
+    {
+        a_CommandBuffer.SetVertexBuffer(*m_TexCoords, 1);
+        a_CommandBuffer.SetVertexBuffer(*m_VertexColors, 2);
+        a_CommandBuffer.SetVertexBuffer(*m_Normals, 3);
+        a_CommandBuffer.SetVertexBuffer(*m_Tangents, 4);
+    }
+
+    // Only read by the skinned pipelines, the others leave the binding unused
+    if (m_SkinAttributes)
+        a_CommandBuffer.SetVertexBuffer(*m_SkinAttributes, SkinBinding);
+}
@@ -1,8 +1,12 @@
 #pragma once
 
+#include <map>
 #include <memory>
 #include <vector>
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
 #include <glm/vec4.hpp>
+#include <glm/gtc/type_precision.hpp>
 
 namespace krt
 {
@@ -12,6 +16,10 @@ namespace krt
     class Sampler;
     class DescriptorSet;
     class GraphicsPipeline;
+    class VertexInputInfo;
+    class CommandBuffer;
+    class CommandQueue;
+    class MorphTargets;
 }
 
 namespace krt
@@ -30,23 +38,48 @@ namespace krt
         void SetDiffuseTexture(const std::shared_ptr<Texture> a_NewDiffuseTexture);
         void SetNormalMap(const std::shared_ptr<Texture> a_NewNormalMap);
         void SetDiffuseColor(const glm::vec4& a_NewDiffuseColor);
+        void SetDoubleSided(bool a_DoubleSided) { m_DoubleSided = a_DoubleSided; }
 
-        DescriptorSet& GetDescriptorSet(GraphicsPipeline& a_TargetPipeline, uint32_t a_SetIndex);
+        // Back faces of single sided materials are never visible, so their primitives may be culled by facing on the CPU
+        bool IsDoubleSided() const { return m_DoubleSided; }
+
+        // Changing any of the properties replaces the descriptor sets instead of writing to them,
+        // the old ones and the textures they reference are released once a_UsingQueue has finished with them
+        DescriptorSet& GetDescriptorSet(GraphicsPipeline& a_TargetPipeline, uint32_t a_SetIndex, CommandQueue& a_UsingQueue);
 
     private:
 
-        void UpdateDescriptorSet(GraphicsPipeline& a_TargetPipeline, uint32_t a_SetIndex) const;
-        void BuildDescriptorSet() const;
+        // Everything a descriptor set that is being replaced may still reference while frames are in flight
+        struct RetiredDescriptorSets
+        {
+            std::map<const GraphicsPipeline*, std::unique_ptr<DescriptorSet>> m_DescriptorSets;
+            std::shared_ptr<const Texture> m_DiffuseTexture;
+            std::shared_ptr<const Texture> m_NormalMap;
+        };
+
+        void UpdateDescriptorSet(GraphicsPipeline& a_TargetPipeline, uint32_t a_SetIndex, CommandQueue& a_UsingQueue) const;
+        void BuildDescriptorSet(DescriptorSet& a_DescriptorSet) const;
 
         const Sampler* m_Sampler;
         std::shared_ptr<const Texture> m_DiffuseTexture;
         std::shared_ptr<const Texture> m_NormalMap;
         glm::vec4 m_DiffuseColor;
+        bool m_DoubleSided;
 
-        mutable std::unique_ptr<DescriptorSet> m_DescriptorSet;
-        mutable bool m_DescriptorSetDirty;
+        mutable std::map<const GraphicsPipeline*, std::unique_ptr<DescriptorSet>> m_DescriptorSets;
+        mutable bool m_DescriptorSetsDirty;
 
-        mutable GraphicsPipeline* m_GraphicsPipeline;
+        // The textures the current descriptor sets were built with
+        mutable std::shared_ptr<const Texture> m_BoundDiffuseTexture;
+        mutable std::shared_ptr<const Texture> m_BoundNormalMap;
+    };
+
+    // How the vertex attributes of a primitive are split across vertex buffers
+    enum EVertexLayout : uint8_t
+    {
+        ESeparateVertexStreams,         // One buffer per attribute
+        EInterleavedVertexAttributes,   // Positions in their own buffer, all other attributes interleaved in a second one
+        EQuantizedVertexAttributes,     // Like the interleaved layout, but with quantized attributes and the colors in a buffer of their own
     };
 
     struct Mesh
@@ -54,20 +87,97 @@ namespace krt
         Mesh();
         ~Mesh();
 
+        // The shading attributes of one vertex in the interleaved layout.
+        // Positions stay in their own buffer, so depth only passes do not fetch any of this.
+        struct InterleavedVertex
+        {
+            glm::vec2 m_TexCoord;
+            glm::vec4 m_Color;
+            glm::vec3 m_Normal;
+            glm::vec4 m_Tangent;
+        };
+
+        // The shading attributes of one vertex in the quantized layout, decoded by QuantizedVertex.glsl.
+        // Colors are stored separately as UNORM8, so primitives without them can use a constant instead.
+        struct QuantizedVertex
+        {
+            glm::u16vec2 m_TexCoord;    // Half floats
+            glm::i16vec2 m_Normal;      // Octahedral SNORM16
+            glm::i16vec2 m_Tangent;     // Octahedral SNORM16, with the handedness in the sign of y
+        };
+
+        // Joints and weights of one vertex of a skinned primitive, which are kept in a buffer of their own in every layout.
+        // The joints index into the skin of the skeleton, the weights are UNORM16 and add up to one.
+        struct SkinVertex
+        {
+            glm::u16vec4 m_Joints;
+            glm::u16vec4 m_Weights;
+        };
+
+        // Binding of the skin attributes, which take up the locations SkinLocation and SkinLocation + 1
+        static const uint32_t SkinBinding = 6;
+        static const uint32_t SkinLocation = 10;
+
+        // Adds the vertex attributes of the forward pipeline, with the bindings and offsets of the given layout.
+        // With a constant color the colors of the quantized layout are read per instance,
+        // from a buffer with a color for every instance that is bound by InstanceBatcher::BindConstantColors.
+        static void DescribeVertexInput(EVertexLayout a_Layout, bool a_ConstantColor, VertexInputInfo& a_VertexInput);
+        // Adds the joints and weights of the skinned pipeline variants
+        static void DescribeSkinInput(VertexInputInfo& a_VertexInput);
+
+        // A cluster of consecutive triangles in the index buffer of a primitive, with the object space data to cull it on the CPU
+        struct Meshlet
+        {
+            uint32_t m_FirstIndex;
+            uint32_t m_NumIndices;
+            glm::vec3 m_Center;     // Bounding sphere of the vertices
+            float m_Radius;
+            glm::vec3 m_ConeAxis;   // Average normal of the triangles
+            float m_ConeCutoff;     // Sine of the widest angle between the axis and a triangle normal, 1 if the cone can never be culled
+        };
+
         struct Primitive
         {
+            // Binds every vertex buffer of the primitive, matching the bindings of DescribeVertexInput
+            void BindVertexBuffers(CommandBuffer& a_CommandBuffer) const;
+
             std::unique_ptr<VertexBuffer> m_Positions;
+
+            // Only used by the interleaved layout, in which case the separate attribute buffers are empty
+            std::unique_ptr<VertexBuffer> m_InterleavedAttributes;
+
             std::unique_ptr<VertexBuffer> m_TexCoords;
-            std::unique_ptr<VertexBuffer> m_VertexColors;
+            std::shared_ptr<VertexBuffer> m_VertexColors; // Empty for primitives with a constant color
             std::unique_ptr<VertexBuffer> m_Normals;
             std::unique_ptr<VertexBuffer> m_Tangents;
+            std::unique_ptr<VertexBuffer> m_SkinAttributes; // Empty for primitives without joints and weights
+
+            // Set for primitives with morph targets, whose blended streams are bound over the ones above by the morph system
+            std::unique_ptr<MorphTargets> m_MorphTargets;
 
             std::unique_ptr<IndexBuffer> m_IndexBuffer;
 
+            // Covers the whole index buffer in order, empty for primitives that are not indexed triangle lists
+            std::vector<Meshlet> m_Meshlets;
+
             std::shared_ptr<Material> m_Material;
+
+            // Has to be drawn with the constant color variant of the forward pipeline
+            bool m_ConstantColor = false;
+
+            // Position of the primitive in its glTF mesh, since the primitives of a streamed mesh are stored in the order they became resident in
+            uint32_t m_Index = 0;
+
+            // Object space bounding box of the positions, which for skinned primitives only holds in the bind pose.
+            // For primitives with morph targets it covers every blend with weights between 0 and 1.
+            glm::vec3 m_BoundsMin;
+            glm::vec3 m_BoundsMax;
         };
 
         std::vector<Primitive> m_Primitives;
 
+        // Weights of the morph targets, which every primitive of the mesh shares and every static mesh using it is drawn with.
+        // Start out as the default weights of the glTF mesh once its first primitive with morph targets is loaded.
+        std::vector<float> m_MorphWeights;
     };
 }
\ No newline at end of file
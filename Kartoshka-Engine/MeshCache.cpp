@@ -0,0 +1,691 @@
+#include "MeshCache.h"
+
+#include "Transform.h"
+#include "Skeleton.h"
+#include "MorphTargets.h"
+#include "VkConstants.h"
+
+#include "FX-GLTF/gltf.h"
+
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <system_error>
+
+namespace
+{
+    uint64_t AlignUp(uint64_t a_Value, uint64_t a_Alignment)
+    {
+        return (a_Value + a_Alignment - 1) / a_Alignment * a_Alignment;
+    }
+
+    // Checks that the range lies within a region of the given size without overflowing
+    bool IsInRange(uint64_t a_Offset, uint64_t a_Size, uint64_t a_RegionSize)
+    {
+        return a_Offset <= a_RegionSize && a_Size <= a_RegionSize - a_Offset;
+    }
+}
+
+krt::MeshCache::MeshCache(std::unique_ptr<MappedFile> a_File, const std::string& a_RootPath)
+    : m_File(std::move(a_File))
+    , m_RootPath(a_RootPath)
+{
+    memcpy(&m_Header, m_File->GetData(), sizeof(Header));
+}
+
+krt::MeshCache::~MeshCache()
+{
+}
+
+std::unique_ptr<krt::MeshCache> krt::MeshCache::Open(const std::string& a_SourcePath, EVertexLayout a_VertexLayout, bool a_Optimized)
+{
+    std::unique_ptr<MappedFile> file;
+    try
+    {
+        file = std::make_unique<MappedFile>(GetCachePath(a_SourcePath));
+    }
+    catch (std::system_error&)
+    {
+        // No cache has been written yet
+        return nullptr;
+    }
+
+    uint32_t magicAndVersion[2] = { 0, 0 };
+    if (file->GetSize() < sizeof(Header))
+        return nullptr;
+
+    memcpy(magicAndVersion, file->GetData(), sizeof(magicAndVersion));
+    if (magicAndVersion[0] != Magic || magicAndVersion[1] != Version)
+    {
+        printf("Ignoring %s, it was written by a different version of the engine.\n", GetCachePath(a_SourcePath).c_str());
+        return nullptr;
+    }
+
+    std::unique_ptr<MeshCache> cache(new MeshCache(std::move(file), fx::gltf::detail::GetDocumentRootPath(a_SourcePath)));
+
+    if (cache->m_Header.m_VertexLayout != a_VertexLayout)
+    {
+        printf("Ignoring %s, it was written with a different vertex layout.\n", GetCachePath(a_SourcePath).c_str());
+        return nullptr;
+    }
+
+    if ((cache->m_Header.m_Optimized != 0) != a_Optimized)
+    {
+        printf("Ignoring %s, it was written with different mesh optimization settings.\n", GetCachePath(a_SourcePath).c_str());
+        return nullptr;
+    }
+
+    if (!cache->IsValid())
+    {
+        printf("Ignoring %s, the file is corrupt.\n", GetCachePath(a_SourcePath).c_str());
+        return nullptr;
+    }
+
+    if (!cache->IsUpToDate())
+    {
+        printf("Ignoring %s, the source files have changed.\n", GetCachePath(a_SourcePath).c_str());
+        return nullptr;
+    }
+
+    return cache;
+}
+
+uint64_t krt::MeshCache::HashBytes(const uint8_t* a_Data, uint64_t a_Size)
+{
+    const uint64_t offsetBasis = 14695981039346656037ull;
+    const uint64_t prime = 1099511628211ull;
+
+    uint64_t hash = offsetBasis;
+    uint64_t i = 0;
+
+    for (; i + sizeof(uint64_t) <= a_Size; i += sizeof(uint64_t))
+    {
+        uint64_t word;
+        memcpy(&word, a_Data + i, sizeof(word));
+        hash ^= word;
+        hash *= prime;
+    }
+
+    for (; i < a_Size; i++)
+    {
+        hash ^= a_Data[i];
+        hash *= prime;
+    }
+
+    return hash;
+}
+
+std::string krt::MeshCache::GetString(const StringRef& a_String) const
+{
+    auto strings = reinterpret_cast<const char*>(m_File->GetData() + m_Header.m_Tables[EStrings].m_Offset);
+    return std::string(strings + a_String.m_Offset, a_String.m_Length);
+}
+
+krt::ByteSpan krt::MeshCache::GetData(uint64_t a_DataOffset, uint64_t a_Size) const
+{
+    return { m_File->GetData() + m_Header.m_Tables[EData].m_Offset + a_DataOffset, a_Size };
+}
+
+krt::hlp::AccessorView krt::MeshCache::GetStream(const PrimitiveEntry& a_Primitive, EStream a_Stream) const
+{
+    auto& stream = a_Primitive.m_Streams[a_Stream];
+    if (stream.m_Count == 0)
+        return hlp::AccessorView();
+
+    auto data = GetData(stream.m_DataOffset, stream.m_Count * stream.m_ElementSize);
+    return hlp::AccessorView(data.m_Data, stream.m_Count, stream.m_ElementSize, stream.m_ElementSize,
+                             static_cast<fx::gltf::Accessor::ComponentType>(stream.m_ComponentType));
+}
+
+uint64_t krt::MeshCache::GetSize() const
+{
+    return m_File->GetSize();
+}
+
+bool krt::MeshCache::IsValid() const
+{
+    const uint64_t entrySizes[ETableCount] = {
+        sizeof(DependencyEntry),
+        sizeof(ImageEntry),
+        sizeof(MaterialEntry),
+        sizeof(MeshEntry),
+        sizeof(PrimitiveEntry),
+        sizeof(SceneEntry),
+        sizeof(NodeEntry),
+        sizeof(SkinEntry),
+        sizeof(BoneEntry),
+        sizeof(JointEntry),
+        sizeof(ClipEntry),
+        sizeof(TrackEntry),
+        1,
+        1,
+    };
+
+    for (uint32_t i = 0; i < ETableCount; i++)
+    {
+        auto& table = m_Header.m_Tables[i];
+        if (table.m_Offset % constants::StagingBufferAlignment != 0 ||
+            table.m_Count > m_File->GetSize() / entrySizes[i] ||
+            !IsInRange(table.m_Offset, table.m_Count * entrySizes[i], m_File->GetSize()))
+        {
+            return false;
+        }
+    }
+
+    auto stringsSize = GetCount(EStrings);
+    auto dataSize = GetCount(EData);
+
+    auto isStringValid = [stringsSize](const StringRef& a_String)
+    {
+        return IsInRange(a_String.m_Offset, a_String.m_Length, stringsSize);
+    };
+
+    auto dependencies = GetEntries<DependencyEntry>(EDependencies);
+    for (uint64_t i = 0; i < GetCount(EDependencies); i++)
+    {
+        if (!isStringValid(dependencies[i].m_Path))
+            return false;
+    }
+
+    auto images = GetEntries<ImageEntry>(EImages);
+    for (uint64_t i = 0; i < GetCount(EImages); i++)
+    {
+        if (!isStringValid(images[i].m_Path) || !IsInRange(images[i].m_DataOffset, images[i].m_DataSize, dataSize))
+            return false;
+    }
+
+    // The images of the materials are looked up by index when the textures are loaded
+    auto materials = GetEntries<MaterialEntry>(EMaterials);
+    auto isImageValid = [this](int32_t a_Image)
+    {
+        return a_Image >= -1 && a_Image < static_cast<int64_t>(GetCount(EImages));
+    };
+
+    for (uint64_t i = 0; i < GetCount(EMaterials); i++)
+    {
+        if (!isImageValid(materials[i].m_BaseColorImage) || !isImageValid(materials[i].m_NormalImage))
+            return false;
+    }
+
+    auto meshes = GetEntries<MeshEntry>(EMeshes);
+    for (uint64_t i = 0; i < GetCount(EMeshes); i++)
+    {
+        if (!IsInRange(meshes[i].m_FirstPrimitive, meshes[i].m_NumPrimitives, GetCount(EPrimitives)))
+            return false;
+    }
+
+    auto primitives = GetEntries<PrimitiveEntry>(EPrimitives);
+    for (uint64_t i = 0; i < GetCount(EPrimitives); i++)
+    {
+        for (auto& stream : primitives[i].m_Streams)
+        {
+            if (stream.m_Count > dataSize || stream.m_ElementSize > dataSize ||
+                !IsInRange(stream.m_DataOffset, stream.m_Count * stream.m_ElementSize, dataSize))
+            {
+                return false;
+            }
+        }
+
+        if (primitives[i].m_Material >= static_cast<int64_t>(GetCount(EMaterials)) || !ArePrimitiveRangesValid(primitives[i]))
+            return false;
+    }
+
+    auto scenes = GetEntries<SceneEntry>(EScenes);
+    for (uint64_t i = 0; i < GetCount(EScenes); i++)
+    {
+        if (!IsInRange(scenes[i].m_FirstNode, scenes[i].m_NumNodes, GetCount(ENodes)))
+            return false;
+    }
+
+    auto nodes = GetEntries<NodeEntry>(ENodes);
+    for (uint64_t i = 0; i < GetCount(ENodes); i++)
+    {
+        if (nodes[i].m_Mesh < 0 || nodes[i].m_Mesh >= static_cast<int64_t>(GetCount(EMeshes)) ||
+            nodes[i].m_Skin >= static_cast<int64_t>(GetCount(ESkins)))
+        {
+            return false;
+        }
+    }
+
+    auto skins = GetEntries<SkinEntry>(ESkins);
+    auto bones = GetEntries<BoneEntry>(EBones);
+    auto joints = GetEntries<JointEntry>(EJoints);
+    auto clips = GetEntries<ClipEntry>(EClips);
+    auto tracks = GetEntries<TrackEntry>(ETracks);
+    for (uint64_t i = 0; i < GetCount(ESkins); i++)
+    {
+        auto& skin = skins[i];
+        if (!IsInRange(skin.m_FirstBone, skin.m_NumBones, GetCount(EBones)) ||
+            !IsInRange(skin.m_FirstJoint, skin.m_NumJoints, GetCount(EJoints)) ||
+            !IsInRange(skin.m_FirstClip, skin.m_NumClips, GetCount(EClips)))
+        {
+            return false;
+        }
+
+        // Parents have to come before their children, which is what lets a pose be resolved in a single pass
+        for (uint32_t j = 0; j < skin.m_NumBones; j++)
+        {
+            if (bones[skin.m_FirstBone + j].m_Parent >= static_cast<int32_t>(j))
+                return false;
+        }
+
+        for (uint32_t j = 0; j < skin.m_NumJoints; j++)
+        {
+            if (joints[skin.m_FirstJoint + j].m_Bone >= skin.m_NumBones)
+                return false;
+        }
+
+        for (uint32_t j = 0; j < skin.m_NumClips; j++)
+        {
+            auto& clip = clips[skin.m_FirstClip + j];
+            if (!isStringValid(clip.m_Name) || !IsInRange(clip.m_FirstTrack, clip.m_NumTracks, GetCount(ETracks)))
+                return false;
+
+            for (uint32_t k = 0; k < clip.m_NumTracks; k++)
+            {
+                auto& track = tracks[clip.m_FirstTrack + k];
+                if (track.m_Bone >= skin.m_NumBones || track.m_Path > AnimationTrack::EScale || track.m_NumKeys > dataSize ||
+                    track.m_NumKeys == 0 || !IsInRange(track.m_TimesOffset, track.m_NumKeys * sizeof(uint16_t), dataSize) ||
+                    !IsInRange(track.m_ValuesOffset, track.m_NumKeys * sizeof(glm::u16vec3), dataSize))
+                {
+                    return false;
+                }
+            }
+        }
+    }
+
+    return true;
+}
+
+bool krt::MeshCache::ArePrimitiveRangesValid(const PrimitiveEntry& a_Primitive) const
+{
+    auto& streams = a_Primitive.m_Streams;
+
+    // Reads an element of a stream whose bounds have already been checked, the data table only guarantees the alignment of the stream
+    auto read = [this](const StreamEntry& a_Stream, uint64_t a_Element, void* a_Destination)
+    {
+        memcpy(a_Destination, GetData(a_Stream.m_DataOffset + a_Element * a_Stream.m_ElementSize, a_Stream.m_ElementSize).m_Data,
+               a_Stream.m_ElementSize);
+    };
+
+    auto& indices = streams[EIndices];
+    if (indices.m_Count != 0 && indices.m_ElementSize != sizeof(uint16_t) && indices.m_ElementSize != sizeof(uint32_t))
+        return false;
+
+    // Meshlets are drawn as ranges of the index buffer
+    auto& meshlets = streams[EMeshlets];
+    if (meshlets.m_Count != 0)
+    {
+        if (meshlets.m_ElementSize != sizeof(Mesh::Meshlet))
+            return false;
+
+        for (uint64_t i = 0; i < meshlets.m_Count; i++)
+        {
+            Mesh::Meshlet meshlet;
+            read(meshlets, i, &meshlet);
+            if (!IsInRange(meshlet.m_FirstIndex, meshlet.m_NumIndices, indices.m_Count))
+                return false;
+        }
+    }
+
+    // The morphed vertices index the vertex streams, the targets index the deltas and the slots index the morphed vertices
+    auto& vertices = streams[EMorphVertices];
+    auto& targets = streams[EMorphTargets];
+    auto& deltas = streams[EMorphDeltas];
+    auto& slots = streams[EMorphSlots];
+    if (vertices.m_Count == 0 && targets.m_Count == 0 && deltas.m_Count == 0 && slots.m_Count == 0)
+        return true;
+
+    if (vertices.m_ElementSize != sizeof(uint32_t) || targets.m_ElementSize != sizeof(MorphTargets::Target) ||
+        deltas.m_ElementSize != sizeof(MorphTargets::Delta) || slots.m_ElementSize != sizeof(uint32_t) || slots.m_Count != deltas.m_Count)
+    {
+        return false;
+    }
+
+    for (uint64_t i = 0; i < vertices.m_Count; i++)
+    {
+        uint32_t vertex;
+        read(vertices, i, &vertex);
+        if (vertex >= streams[EPositions].m_Count)
+            return false;
+    }
+
+    for (uint64_t i = 0; i < targets.m_Count; i++)
+    {
+        MorphTargets::Target target;
+        read(targets, i, &target);
+        if (!IsInRange(target.m_FirstDelta, target.m_NumDeltas, deltas.m_Count))
+            return false;
+    }
+
+    for (uint64_t i = 0; i < slots.m_Count; i++)
+    {
+        uint32_t slot;
+        read(slots, i, &slot);
+        if (slot >= vertices.m_Count)
+            return false;
+    }
+
+    return true;
+}
+
+bool krt::MeshCache::IsUpToDate() const
+{
+    auto dependencies = GetEntries<DependencyEntry>(EDependencies);
+
+    for (uint64_t i = 0; i < GetCount(EDependencies); i++)
+    {
+        auto& dependency = dependencies[i];
+
+        try
+        {
+            MappedFile file(m_RootPath + "/" + GetString(dependency.m_Path));
+
+            // Comparing the size first skips hashing files that obviously changed
+            if (file.GetSize() != dependency.m_Size || HashBytes(file.GetData(), file.GetSize()) != dependency.m_Hash)
+                return false;
+        }
+        catch (std::system_error&)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+krt::MeshCacheWriter::MeshCacheWriter(const std::string& a_RootPath, EVertexLayout a_VertexLayout, bool a_Optimized)
+    : m_RootPath(a_RootPath)
+    , m_VertexLayout(a_VertexLayout)
+    , m_Optimized(a_Optimized)
+    , m_DataSize(0)
+{
+}
+
+krt::MeshCacheWriter::~MeshCacheWriter()
+{
+}
+
+void krt::MeshCacheWriter::AddDependency(const std::string& a_RelativePath)
+{
+    MappedFile file(m_RootPath + "/" + a_RelativePath);
+
+    auto& dependency = m_Dependencies.emplace_back();
+    dependency.m_Path = AddString(a_RelativePath);
+    dependency.m_Size = file.GetSize();
+    dependency.m_Hash = MeshCache::HashBytes(file.GetData(), file.GetSize());
+}
+
+void krt::MeshCacheWriter::AddImage(const std::string& a_RelativePath, ByteSpan a_EncodedData)
+{
+    auto& image = m_Images.emplace_back();
+    image.m_Path = AddString(a_RelativePath);
+    image.m_DataOffset = 0;
+    image.m_DataSize = 0;
+
+    if (a_EncodedData.m_Data)
+    {
+        // The encoded data of the source does not necessarily outlive the writer
+        auto& copy = m_CopiedImages.emplace_back(a_EncodedData.m_Data, a_EncodedData.m_Data + a_EncodedData.m_Size);
+        image.m_DataOffset = AddData(hlp::AccessorView(copy.data(), copy.size(), 1, 1));
+        image.m_DataSize = copy.size();
+    }
+}
+
+void krt::MeshCacheWriter::AddMaterial(const MeshCache::MaterialEntry& a_Material)
+{
+    m_Materials.push_back(a_Material);
+}
+
+void krt::MeshCacheWriter::BeginMesh()
+{
+    auto& mesh = m_Meshes.emplace_back();
+    mesh.m_FirstPrimitive = static_cast<uint32_t>(m_Primitives.size());
+    mesh.m_NumPrimitives = 0;
+}
+
+void krt::MeshCacheWriter::AddPrimitive(const hlp::AccessorView (&a_Streams)[MeshCache::EStreamCount],
+    const glm::vec3& a_BoundsMin, const glm::vec3& a_BoundsMax, int32_t a_Material)
+{
+    assert(!m_Meshes.empty() && "BeginMesh has to be called before adding primitives.");
+
+    MeshCache::PrimitiveEntry primitive = {};
+
+    for (uint32_t i = 0; i < MeshCache::EStreamCount; i++)
+    {
+        auto& stream = primitive.m_Streams[i];
+        auto& view = a_Streams[i];
+
+        if (view.Empty())
+            continue;
+
+        stream.m_DataOffset = AddData(view);
+        stream.m_Count = view.Size();
+        stream.m_ElementSize = view.GetElementSize();
+        stream.m_ComponentType = static_cast<uint32_t>(view.GetComponentType());
+    }
+
+    memcpy(primitive.m_BoundsMin, &a_BoundsMin[0], sizeof(primitive.m_BoundsMin));
+    memcpy(primitive.m_BoundsMax, &a_BoundsMax[0], sizeof(primitive.m_BoundsMax));
+    primitive.m_Material = a_Material;
+
+    m_Primitives.push_back(primitive);
+    m_Meshes.back().m_NumPrimitives++;
+}
+
+void krt::MeshCacheWriter::BeginScene()
+{
+    auto& scene = m_Scenes.emplace_back();
+    scene.m_FirstNode = static_cast<uint32_t>(m_Nodes.size());
+    scene.m_NumNodes = 0;
+}
+
+void krt::MeshCacheWriter::AddSkin(const std::shared_ptr<const Skeleton>& a_Skeleton)
+{
+    auto& skeleton = *a_Skeleton;
+    m_Skeletons.push_back(a_Skeleton);
+
+    auto& skin = m_Skins.emplace_back();
+    skin.m_FirstBone = static_cast<uint32_t>(m_Bones.size());
+    skin.m_NumBones = skeleton.GetNumBones();
+    skin.m_FirstJoint = static_cast<uint32_t>(m_Joints.size());
+    skin.m_NumJoints = skeleton.GetNumJoints();
+    skin.m_FirstClip = static_cast<uint32_t>(m_Clips.size());
+    skin.m_NumClips = static_cast<uint32_t>(skeleton.m_Clips.size());
+
+    auto& rest = skeleton.m_RestPose;
+    for (uint32_t i = 0; i < skeleton.GetNumBones(); i++)
+    {
+        MeshCache::BoneEntry bone;
+        bone.m_Parent = skeleton.m_Parents[i];
+        memcpy(bone.m_Translation, &rest.m_Translations[i][0], sizeof(bone.m_Translation));
+        bone.m_Rotation[0] = rest.m_Rotations[i].x;
+        bone.m_Rotation[1] = rest.m_Rotations[i].y;
+        bone.m_Rotation[2] = rest.m_Rotations[i].z;
+        bone.m_Rotation[3] = rest.m_Rotations[i].w;
+        memcpy(bone.m_Scale, &rest.m_Scales[i][0], sizeof(bone.m_Scale));
+
+        m_Bones.push_back(bone);
+    }
+
+    for (uint32_t i = 0; i < skeleton.GetNumJoints(); i++)
+    {
+        MeshCache::JointEntry joint;
+        joint.m_Bone = skeleton.m_JointBones[i];
+        memcpy(joint.m_InverseBindMatrix, &skeleton.m_InverseBindMatrices[i][0][0], sizeof(joint.m_InverseBindMatrix));
+
+        m_Joints.push_back(joint);
+    }
+
+    for (auto& clip : skeleton.m_Clips)
+    {
+        auto& clipEntry = m_Clips.emplace_back();
+        clipEntry.m_Name = AddString(clip.m_Name);
+        clipEntry.m_Duration = clip.m_Duration;
+        clipEntry.m_FirstTrack = static_cast<uint32_t>(m_Tracks.size());
+        clipEntry.m_NumTracks = static_cast<uint32_t>(clip.m_Tracks.size());
+        clipEntry.m_Padding = 0;
+
+        for (auto& track : clip.m_Tracks)
+        {
+            auto& trackEntry = m_Tracks.emplace_back();
+            trackEntry.m_Bone = track.m_Bone;
+            trackEntry.m_Path = track.m_Path;
+            trackEntry.m_Step = track.m_Step ? 1 : 0;
+            trackEntry.m_NumKeys = static_cast<uint32_t>(track.m_Times.size());
+            memcpy(trackEntry.m_Min, &track.m_Min[0], sizeof(trackEntry.m_Min));
+            memcpy(trackEntry.m_Extent, &track.m_Extent[0], sizeof(trackEntry.m_Extent));
+            trackEntry.m_TimesOffset = AddData(hlp::AccessorView::FromVector(track.m_Times));
+            trackEntry.m_ValuesOffset = AddData(hlp::AccessorView::FromVector(track.m_Values));
+        }
+    }
+}
+
+void krt::MeshCacheWriter::AddNode(int32_t a_Mesh, int32_t a_Skin, const Transform& a_WorldTransform)
+{
+    assert(!m_Scenes.empty() && "BeginScene has to be called before adding nodes.");
+
+    auto& position = a_WorldTransform.GetPosition();
+    auto& rotation = a_WorldTransform.GetRotationQuat();
+    auto& scale = a_WorldTransform.GetScale();
+
+    MeshCache::NodeEntry node;
+    node.m_Mesh = a_Mesh;
+    node.m_Skin = a_Skin;
+    node.m_Position[0] = position.x;
+    node.m_Position[1] = position.y;
+    node.m_Position[2] = position.z;
+    node.m_Rotation[0] = rotation.x;
+    node.m_Rotation[1] = rotation.y;
+    node.m_Rotation[2] = rotation.z;
+    node.m_Rotation[3] = rotation.w;
+    node.m_Scale[0] = scale.x;
+    node.m_Scale[1] = scale.y;
+    node.m_Scale[2] = scale.z;
+
+    m_Nodes.push_back(node);
+    m_Scenes.back().m_NumNodes++;
+}
+
+bool krt::MeshCacheWriter::Write(const std::string& a_Path) const
+{
+    const uint64_t alignment = constants::StagingBufferAlignment;
+
+    // Tables are laid out back to back in the order of MeshCache::ETable, with the data table last
+    MeshCache::Header header = {};
+    header.m_Magic = MeshCache::Magic;
+    header.m_Version = MeshCache::Version;
+    header.m_VertexLayout = m_VertexLayout;
+    header.m_Optimized = m_Optimized ? 1 : 0;
+
+    const void* tableData[MeshCache::ETableCount] = {
+        m_Dependencies.data(), m_Images.data(), m_Materials.data(), m_Meshes.data(),
+        m_Primitives.data(), m_Scenes.data(), m_Nodes.data(), m_Skins.data(), m_Bones.data(), m_Joints.data(),
+        m_Clips.data(), m_Tracks.data(), m_Strings.data(), nullptr
+    };
+    const uint64_t tableSizes[MeshCache::ETableCount] = {
+        m_Dependencies.size() * sizeof(MeshCache::DependencyEntry),
+        m_Images.size() * sizeof(MeshCache::ImageEntry),
+        m_Materials.size() * sizeof(MeshCache::MaterialEntry),
+        m_Meshes.size() * sizeof(MeshCache::MeshEntry),
+        m_Primitives.size() * sizeof(MeshCache::PrimitiveEntry),
+        m_Scenes.size() * sizeof(MeshCache::SceneEntry),
+        m_Nodes.size() * sizeof(MeshCache::NodeEntry),
+        m_Skins.size() * sizeof(MeshCache::SkinEntry),
+        m_Bones.size() * sizeof(MeshCache::BoneEntry),
+        m_Joints.size() * sizeof(MeshCache::JointEntry),
+        m_Clips.size() * sizeof(MeshCache::ClipEntry),
+        m_Tracks.size() * sizeof(MeshCache::TrackEntry),
+        m_Strings.size(),
+        m_DataSize
+    };
+    const uint64_t tableCounts[MeshCache::ETableCount] = {
+        m_Dependencies.size(), m_Images.size(), m_Materials.size(), m_Meshes.size(),
+        m_Primitives.size(), m_Scenes.size(), m_Nodes.size(), m_Skins.size(), m_Bones.size(), m_Joints.size(),
+        m_Clips.size(), m_Tracks.size(), m_Strings.size(), m_DataSize
+    };
+
+    uint64_t offset = AlignUp(sizeof(MeshCache::Header), alignment);
+    for (uint32_t i = 0; i < MeshCache::ETableCount; i++)
+    {
+        header.m_Tables[i].m_Offset = offset;
+        header.m_Tables[i].m_Count = tableCounts[i];
+        offset = AlignUp(offset + tableSizes[i], alignment);
+    }
+
+    auto tempPath = a_Path + ".tmp";
+    std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+    if (!file)
+        return false;
+
+    uint64_t written = 0;
+    const char padding[alignment] = {};
+
+    auto pad = [&](uint64_t a_Offset)
+    {
+        file.write(padding, static_cast<std::streamsize>(a_Offset - written));
+        written = a_Offset;
+    };
+
+    auto write = [&](const void* a_Data, uint64_t a_Size)
+    {
+        file.write(static_cast<const char*>(a_Data), static_cast<std::streamsize>(a_Size));
+        written += a_Size;
+    };
+
+    write(&header, sizeof(header));
+
+    for (uint32_t i = 0; i < MeshCache::EData; i++)
+    {
+        pad(header.m_Tables[i].m_Offset);
+        write(tableData[i], tableSizes[i]);
+    }
+
+    // Strided streams have to be gathered before writing, so every stream goes through one reused scratch buffer
+    std::vector<uint8_t> scratch;
+    uint64_t dataOffset = 0;
+
+    for (auto& data : m_Data)
+    {
+        dataOffset = AlignUp(dataOffset, alignment);
+        pad(header.m_Tables[MeshCache::EData].m_Offset + dataOffset);
+
+        scratch.resize(data.GetSizeInBytes());
+        data.CopyTo(scratch.data());
+        write(scratch.data(), scratch.size());
+
+        dataOffset += data.GetSizeInBytes();
+    }
+
+    file.close();
+    if (!file)
+    {
+        std::remove(tempPath.c_str());
+        return false;
+    }
+
+    // std::rename does not replace existing files on every platform
+    std::remove(a_Path.c_str());
+    return std::rename(tempPath.c_str(), a_Path.c_str()) == 0;
+}
+
+krt::MeshCache::StringRef krt::MeshCacheWriter::AddString(const std::string& a_String)
+{
+    MeshCache::StringRef ref;
+    ref.m_Offset = m_Strings.size();
+    ref.m_Length = a_String.size();
+
+    m_Strings += a_String;
+    return ref;
+}
+
+uint64_t krt::MeshCacheWriter::AddData(const hlp::AccessorView& a_Data)
+{
+    auto offset = AlignUp(m_DataSize, constants::StagingBufferAlignment);
+
+    m_Data.push_back(a_Data);
+    m_DataSize = offset + a_Data.GetSizeInBytes();
+
+    return offset;
+}
@@ -0,0 +1,319 @@
+#pragma once
+
+#include "AccessorView.h"
+#include "GltfSource.h"
+#include "MappedFile.h"
+#include "Mesh.h"
+
+#include <glm/vec3.hpp>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace krt
+{
+    class Transform;
+    struct Skeleton;
+}
+
+namespace krt
+{
+    // Engine native cache of an imported glTF file, stored next to the source file as <source>.kmesh.
+    // It holds the final vertex and index streams of every primitive in the order they are uploaded in,
+    // so loading from the cache is a plain copy from the mapped file into staging memory.
+    // The cache records a content hash of the source file and of its external buffers, and is ignored once any of them changes.
+    class MeshCache
+    {
+    public:
+
+        static const uint32_t Magic = 0x48534D4B; // "KMSH"
+        // Has to be bumped whenever the layout of the file or the processing of the streams changes
+        static const uint32_t Version = 8;
+
+        enum EStream : uint8_t
+        {
+            EPositions,
+            EInterleavedAttributes, // Only present in caches written with the interleaved vertex layout
+            ETexCoords,
+            ENormals,
+            EColors,
+            ETangents,
+            ESkinAttributes,        // Mesh::SkinVertex entries, only present in skinned primitives
+            EIndices,
+            EMeshlets,              // Mesh::Meshlet entries, which stay on the CPU instead of being uploaded
+            EMorphVertices,         // The streams of MorphTargets, only present in primitives with morph targets
+            EMorphTargets,
+            EMorphDeltas,
+            EMorphSlots,
+            EStreamCount
+        };
+
+        enum ETable : uint8_t
+        {
+            EDependencies,
+            EImages,
+            EMaterials,
+            EMeshes,
+            EPrimitives,
+            EScenes,
+            ENodes,
+            ESkins,
+            EBones,
+            EJoints,
+            EClips,
+            ETracks,
+            EStrings,   // Counted in bytes
+            EData,      // Counted in bytes, holds the streams and embedded images
+            ETableCount
+        };
+
+        // All entries of the file are plain structs, offsets are relative to the start of the file
+        // unless stated otherwise.
+        struct Table
+        {
+            uint64_t m_Offset;
+            uint64_t m_Count;
+        };
+
+        struct Header
+        {
+            uint32_t m_Magic;
+            uint32_t m_Version;
+            uint32_t m_VertexLayout; // EVertexLayout the streams were written in
+            uint32_t m_Optimized;    // Non-zero if the primitives went through the mesh optimization pass
+            Table m_Tables[ETableCount];
+        };
+
+        // Range in the string table
+        struct StringRef
+        {
+            uint64_t m_Offset;
+            uint64_t m_Length;
+        };
+
+        // A file the cache was built from, relative to the directory of the source file
+        struct DependencyEntry
+        {
+            StringRef m_Path;
+            uint64_t m_Size;
+            uint64_t m_Hash;
+        };
+
+        // External images are referenced by their path relative to the source file,
+        // images embedded in the source keep their encoded data in the data table instead
+        struct ImageEntry
+        {
+            StringRef m_Path;
+            uint64_t m_DataOffset; // Relative to the data table
+            uint64_t m_DataSize;
+        };
+
+        // Images are indexed directly, the texture indirection of glTF is already resolved
+        struct MaterialEntry
+        {
+            float m_BaseColorFactor[4];
+            int32_t m_BaseColorImage;   // -1 if the material has no texture
+            int32_t m_NormalImage;      // -1 if the material has no normal map
+            uint32_t m_DoubleSided;
+            uint32_t m_Padding;
+        };
+
+        struct MeshEntry
+        {
+            uint32_t m_FirstPrimitive;
+            uint32_t m_NumPrimitives;
+        };
+
+        // Tightly packed stream of elements, a count of 0 means the primitive does not have the stream
+        struct StreamEntry
+        {
+            uint64_t m_DataOffset; // Relative to the data table
+            uint64_t m_Count;
+            uint32_t m_ElementSize;
+            uint32_t m_ComponentType;
+        };
+
+        struct PrimitiveEntry
+        {
+            StreamEntry m_Streams[EStreamCount];
+            float m_BoundsMin[3];
+            float m_BoundsMax[3];
+            int32_t m_Material;
+            uint32_t m_Padding;
+        };
+
+        struct SceneEntry
+        {
+            uint32_t m_FirstNode;
+            uint32_t m_NumNodes;
+        };
+
+        // Mesh instance of a scene, with its transform already resolved to world space
+        struct NodeEntry
+        {
+            int32_t m_Mesh;
+            int32_t m_Skin;      // -1 if the mesh is not skinned
+            float m_Position[3];
+            float m_Rotation[4]; // Quaternion stored as x, y, z, w
+            float m_Scale[3];
+        };
+
+        // A skeleton, with its bones, joints and clips stored back to back in their tables
+        struct SkinEntry
+        {
+            uint32_t m_FirstBone;
+            uint32_t m_NumBones;
+            uint32_t m_FirstJoint;
+            uint32_t m_NumJoints;
+            uint32_t m_FirstClip;
+            uint32_t m_NumClips;
+        };
+
+        // Rest pose of a bone, bones are indexed relative to the first bone of their skin
+        struct BoneEntry
+        {
+            int32_t m_Parent;
+            float m_Translation[3];
+            float m_Rotation[4]; // Quaternion stored as x, y, z, w
+            float m_Scale[3];
+        };
+
+        struct JointEntry
+        {
+            uint32_t m_Bone;
+            float m_InverseBindMatrix[16]; // Column major
+        };
+
+        struct ClipEntry
+        {
+            StringRef m_Name;
+            float m_Duration;
+            uint32_t m_FirstTrack;
+            uint32_t m_NumTracks;
+            uint32_t m_Padding;
+        };
+
+        // The keys of a track are stored as they are compressed, uint16_t times and glm::u16vec3 values in the data table
+        struct TrackEntry
+        {
+            uint32_t m_Bone;
+            uint32_t m_Path;     // AnimationTrack::EPath
+            uint32_t m_Step;
+            uint32_t m_NumKeys;
+            float m_Min[3];
+            float m_Extent[3];
+            uint64_t m_TimesOffset;
+            uint64_t m_ValuesOffset;
+        };
+
+        ~MeshCache();
+
+        MeshCache(MeshCache&) = delete;             // No copy c-tor
+        MeshCache(MeshCache&&) = delete;            // No move c-tor
+        MeshCache& operator=(MeshCache&) = delete;  // No copy assignment
+        MeshCache& operator=(MeshCache&&) = delete; // No move assignment
+
+        static std::string GetCachePath(const std::string& a_SourcePath) { return a_SourcePath + ".kmesh"; }
+
+        // Maps the cache of the source file.
+        // Returns nullptr if there is no cache, if it is corrupt or outdated, or if its streams are in a different vertex layout
+        // or were (not) optimized.
+        static std::unique_ptr<MeshCache> Open(const std::string& a_SourcePath, EVertexLayout a_VertexLayout, bool a_Optimized);
+
+        // 64 bit FNV-1a hash of the data, processed in 8 byte words to keep up with the disk
+        static uint64_t HashBytes(const uint8_t* a_Data, uint64_t a_Size);
+
+        template<typename EntryType>
+        const EntryType* GetEntries(ETable a_Table) const;
+        uint64_t GetCount(ETable a_Table) const { return m_Header.m_Tables[a_Table].m_Count; }
+
+        std::string GetString(const StringRef& a_String) const;
+        ByteSpan GetData(uint64_t a_DataOffset, uint64_t a_Size) const;
+        hlp::AccessorView GetStream(const PrimitiveEntry& a_Primitive, EStream a_Stream) const;
+
+        // The directory relative to which the paths in the cache are resolved
+        const std::string& GetRootPath() const { return m_RootPath; }
+        uint64_t GetSize() const;
+
+    private:
+
+        MeshCache(std::unique_ptr<MappedFile> a_File, const std::string& a_RootPath);
+
+        // Checks that all tables and streams lie within the file, and that every index into another table or stream is within it
+        bool IsValid() const;
+        // The meshlets and the morph targets of a primitive only reference its own streams
+        bool ArePrimitiveRangesValid(const PrimitiveEntry& a_Primitive) const;
+        // Checks that none of the files the cache was built from has changed since
+        bool IsUpToDate() const;
+
+        std::unique_ptr<MappedFile> m_File;
+        std::string m_RootPath;
+        Header m_Header;
+    };
+
+    // Gathers the results of a glTF import and writes them to a .kmesh file.
+    // Streams are only read when the file is written, so the data behind them has to stay alive until then.
+    class MeshCacheWriter
+    {
+    public:
+        MeshCacheWriter(const std::string& a_RootPath, EVertexLayout a_VertexLayout, bool a_Optimized);
+        ~MeshCacheWriter();
+
+        MeshCacheWriter(MeshCacheWriter&) = delete;             // No copy c-tor
+        MeshCacheWriter(MeshCacheWriter&&) = delete;            // No move c-tor
+        MeshCacheWriter& operator=(MeshCacheWriter&) = delete;  // No copy assignment
+        MeshCacheWriter& operator=(MeshCacheWriter&&) = delete; // No move assignment
+
+        // Hashes the file at the path relative to the root path. Throws std::system_error if the file can not be read.
+        void AddDependency(const std::string& a_RelativePath);
+        // Either the path of the image relative to the root path, or its encoded data, which is copied into the cache
+        void AddImage(const std::string& a_RelativePath, ByteSpan a_EncodedData);
+        void AddMaterial(const MeshCache::MaterialEntry& a_Material);
+
+        // Primitives and nodes are added to the mesh and scene that was begun last
+        void BeginMesh();
+        void AddPrimitive(const hlp::AccessorView (&a_Streams)[MeshCache::EStreamCount], const glm::vec3& a_BoundsMin,
+                          const glm::vec3& a_BoundsMax, int32_t a_Material);
+        // Skins are indexed in the order they are added. The skeleton is only read when the file is written.
+        void AddSkin(const std::shared_ptr<const Skeleton>& a_Skeleton);
+        void BeginScene();
+        void AddNode(int32_t a_Mesh, int32_t a_Skin, const Transform& a_WorldTransform);
+
+        // Writes to a temporary file first, so that an interrupted write never leaves a truncated cache behind.
+        // Returns false if the file could not be written.
+        bool Write(const std::string& a_Path) const;
+
+    private:
+
+        MeshCache::StringRef AddString(const std::string& a_String);
+        // Reserves an aligned range in the data table and returns its offset
+        uint64_t AddData(const hlp::AccessorView& a_Data);
+
+        std::string m_RootPath;
+        EVertexLayout m_VertexLayout;
+        bool m_Optimized;
+
+        std::vector<MeshCache::DependencyEntry> m_Dependencies;
+        std::vector<MeshCache::ImageEntry> m_Images;
+        std::vector<MeshCache::MaterialEntry> m_Materials;
+        std::vector<MeshCache::MeshEntry> m_Meshes;
+        std::vector<MeshCache::PrimitiveEntry> m_Primitives;
+        std::vector<MeshCache::SceneEntry> m_Scenes;
+        std::vector<MeshCache::NodeEntry> m_Nodes;
+        std::vector<MeshCache::SkinEntry> m_Skins;
+        std::vector<MeshCache::BoneEntry> m_Bones;
+        std::vector<MeshCache::JointEntry> m_Joints;
+        std::vector<MeshCache::ClipEntry> m_Clips;
+        std::vector<MeshCache::TrackEntry> m_Tracks;
+        std::string m_Strings;
+
+        // Contents of the data table in order, each starting at a multiple of the staging alignment
+        std::vector<hlp::AccessorView> m_Data;
+        std::vector<std::vector<uint8_t>> m_CopiedImages;
+        std::vector<std::shared_ptr<const Skeleton>> m_Skeletons; // Keep the keys in the data table alive
+        uint64_t m_DataSize;
+    };
+}
+
+#include "MeshCache.inl"
@@ -0,0 +1,5 @@
+template <typename EntryType>
+const EntryType* krt::MeshCache::GetEntries(ETable a_Table) const
+{
+    return reinterpret_cast<const EntryType*>(m_File->GetData() + m_Header.m_Tables[a_Table].m_Offset);
+}
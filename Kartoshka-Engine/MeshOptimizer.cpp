@@ -0,0 +1,587 @@
+#include "MeshOptimizer.h"
+
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+#include <glm/vec2.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <numeric>
+
+namespace
+{
+    // Size of the FIFO cache simulated by the statistics and the overdraw clustering
+    const uint32_t FifoCacheSize = 16;
+
+    // Size of the LRU cache simulated by the vertex cache optimization, and the constants of Forsyth's scoring function
+    const uint32_t LruCacheSize = 32;
+    const float CacheDecayPower = 1.5f;
+    const float LastTriangleScore = 0.75f;
+    const float ValenceBoostScale = 2.0f;
+    const float ValenceBoostPower = 0.5f;
+
+    // Resolution of the depth buffer the overdraw is measured with
+    const uint32_t OverdrawGridSize = 256;
+
+    const uint32_t NoTriangle = ~0u;
+
+    // Post-transform FIFO cache that counts the misses of each triangle.
+    // Instead of a queue, each vertex remembers when it last entered the cache, and a vertex is still cached
+    // if fewer than FifoCacheSize vertices have entered after it. Advancing the time by more than that empties the cache.
+    class FifoCache
+    {
+    public:
+        FifoCache(uint32_t a_NumVertices)
+            : m_Timestamps(a_NumVertices, 0)
+            , m_Time(FifoCacheSize + 1)
+        {
+        }
+
+        uint32_t AddTriangle(const uint32_t* a_Triangle)
+        {
+            uint32_t misses = 0;
+            for (uint32_t corner = 0; corner < 3; corner++)
+            {
+                auto& timestamp = m_Timestamps[a_Triangle[corner]];
+                if (m_Time - timestamp > FifoCacheSize)
+                {
+                    timestamp = m_Time++;
+                    misses++;
+                }
+            }
+            return misses;
+        }
+
+        void Clear()
+        {
+            m_Time += FifoCacheSize + 1;
+        }
+
+    private:
+        std::vector<uint32_t> m_Timestamps;
+        uint32_t m_Time;
+    };
+
+    float ComputeVertexScore(int32_t a_CachePosition, uint32_t a_RemainingTriangles)
+    {
+        // Vertices without triangles left to emit are never worth keeping
+        if (a_RemainingTriangles == 0)
+            return -1.0f;
+
+        float score = 0.0f;
+        if (a_CachePosition >= 0)
+        {
+            // The vertices of the last triangle get a fixed score, so the next triangle does not just reuse the same edge
+            if (a_CachePosition < 3)
+                score = LastTriangleScore;
+            else
+                score = std::pow(1.0f - static_cast<float>(a_CachePosition - 3) / (LruCacheSize - 3), CacheDecayPower);
+        }
+
+        // Vertices with few triangles left are finished off first, so they do not have to be fetched again later
+        return score + ValenceBoostScale * std::pow(static_cast<float>(a_RemainingTriangles), -ValenceBoostPower);
+    }
+
+    // Rasterizes the triangles in order into a depth buffer, looking along one of the axes
+    void RasterizeView(const std::vector<uint32_t>& a_Indices, const std::vector<glm::vec3>& a_Positions, uint32_t a_Axis, bool a_Flip,
+                       const glm::vec3& a_BoundsMin, float a_Scale, krt::hlp::MeshStatistics& a_Statistics)
+    {
+        uint32_t uAxis = (a_Axis + 1) % 3;
+        uint32_t vAxis = (a_Axis + 2) % 3;
+
+        std::vector<float> depthBuffer(OverdrawGridSize * OverdrawGridSize, std::numeric_limits<float>::max());
+
+        for (size_t triangle = 0; triangle + 2 < a_Indices.size(); triangle += 3)
+        {
+            glm::vec3 corners[3];
+            for (uint32_t corner = 0; corner < 3; corner++)
+            {
+                glm::vec3 p = (a_Positions[a_Indices[triangle + corner]] - a_BoundsMin) * a_Scale;
+                corners[corner] = glm::vec3(p[uAxis], p[vAxis], a_Flip ? -p[a_Axis] : p[a_Axis]);
+            }
+
+            float area = (corners[1].x - corners[0].x) * (corners[2].y - corners[0].y) - (corners[2].x - corners[0].x) * (corners[1].y - corners[0].y);
+            if (area == 0.0f)
+                continue;
+
+            // Both windings are drawn, so clockwise triangles are turned around to keep the edge functions positive inside
+            if (area < 0.0f)
+            {
+                std::swap(corners[1], corners[2]);
+                area = -area;
+            }
+
+            auto toPixel = [](float a_Coordinate)
+            {
+                return static_cast<int32_t>(glm::clamp(a_Coordinate, 0.0f, static_cast<float>(OverdrawGridSize - 1)));
+            };
+
+            int32_t minX = toPixel(std::min({ corners[0].x, corners[1].x, corners[2].x }));
+            int32_t maxX = toPixel(std::max({ corners[0].x, corners[1].x, corners[2].x }));
+            int32_t minY = toPixel(std::min({ corners[0].y, corners[1].y, corners[2].y }));
+            int32_t maxY = toPixel(std::max({ corners[0].y, corners[1].y, corners[2].y }));
+
+            for (int32_t y = minY; y <= maxY; y++)
+            {
+                for (int32_t x = minX; x <= maxX; x++)
+                {
+                    glm::vec2 pixel(x + 0.5f, y + 0.5f);
+
+                    float weights[3];
+                    bool inside = true;
+                    for (uint32_t edge = 0; edge < 3; edge++)
+                    {
+                        auto& a = corners[(edge + 1) % 3];
+                        auto& b = corners[(edge + 2) % 3];
+                        weights[edge] = (b.x - a.x) * (pixel.y - a.y) - (pixel.x - a.x) * (b.y - a.y);
+                        inside &= weights[edge] >= 0.0f;
+                    }
+
+                    if (!inside)
+                        continue;
+
+                    float depth = (weights[0] * corners[0].z + weights[1] * corners[1].z + weights[2] * corners[2].z) / area;
+                    auto& stored = depthBuffer[y * OverdrawGridSize + x];
+
+                    if (stored == std::numeric_limits<float>::max())
+                        a_Statistics.m_CoveredPixels++;
+
+                    if (depth < stored)
+                    {
+                        stored = depth;
+                        a_Statistics.m_ShadedPixels++;
+                    }
+                }
+            }
+        }
+    }
+}
+
+krt::hlp::MeshStatistics& krt::hlp::MeshStatistics::operator+=(const MeshStatistics& a_Other)
+{
+    m_NumTriangles += a_Other.m_NumTriangles;
+    m_NumVertices += a_Other.m_NumVertices;
+    m_CacheMisses += a_Other.m_CacheMisses;
+    m_CoveredPixels += a_Other.m_CoveredPixels;
+    m_ShadedPixels += a_Other.m_ShadedPixels;
+    return *this;
+}
+
+float krt::hlp::MeshStatistics::GetACMR() const
+{
+    return m_NumTriangles ? static_cast<float>(m_CacheMisses) / m_NumTriangles : 0.0f;
+}
+
+float krt::hlp::MeshStatistics::GetATVR() const
+{
+    return m_NumVertices ? static_cast<float>(m_CacheMisses) / m_NumVertices : 0.0f;
+}
+
+float krt::hlp::MeshStatistics::GetOverdraw() const
+{
+    return m_CoveredPixels ? static_cast<float>(m_ShadedPixels) / m_CoveredPixels : 0.0f;
+}
+
+krt::hlp::MeshStatistics krt::hlp::AnalyzeMesh(const std::vector<uint32_t>& a_Indices, const std::vector<glm::vec3>& a_Positions)
+{
+    MeshStatistics statistics;
+    statistics.m_NumTriangles = a_Indices.size() / 3;
+
+    // Only the referenced vertices count towards the ATVR
+    std::vector<bool> referenced(a_Positions.size(), false);
+    for (auto index : a_Indices)
+        referenced[index] = true;
+    statistics.m_NumVertices = std::count(referenced.begin(), referenced.end(), true);
+
+    FifoCache cache(static_cast<uint32_t>(a_Positions.size()));
+    for (size_t triangle = 0; triangle + 2 < a_Indices.size(); triangle += 3)
+        statistics.m_CacheMisses += cache.AddTriangle(&a_Indices[triangle]);
+
+    if (a_Indices.empty())
+        return statistics;
+
+    glm::vec3 boundsMin(std::numeric_limits<float>::max());
+    glm::vec3 boundsMax(std::numeric_limits<float>::lowest());
+    for (auto index : a_Indices)
+    {
+        boundsMin = glm::min(boundsMin, a_Positions[index]);
+        boundsMax = glm::max(boundsMax, a_Positions[index]);
+    }
+
+    // Every view uses the same scale, so the longest side of the bounding box fills the grid
+    glm::vec3 extent = boundsMax - boundsMin;
+    float maxExtent = std::max({ extent.x, extent.y, extent.z });
+    if (maxExtent <= 0.0f)
+        return statistics;
+
+    float scale = (OverdrawGridSize - 1) / maxExtent;
+
+    for (uint32_t axis = 0; axis < 3; axis++)
+    {
+        RasterizeView(a_Indices, a_Positions, axis, false, boundsMin, scale, statistics);
+        RasterizeView(a_Indices, a_Positions, axis, true, boundsMin, scale, statistics);
+    }
+
+    return statistics;
+}
+
+uint32_t krt::hlp::WeldVertices(const std::vector<AccessorView>& a_Streams, uint64_t a_NumVertices, std::vector<uint32_t>& a_Remap)
+{
+    a_Remap.assign(a_NumVertices, UnusedVertex);
+
+    uint32_t vertexSize = 0;
+    for (auto& stream : a_Streams)
+        vertexSize += stream.GetElementSize();
+
+    // All streams of a vertex are gathered into one contiguous key, so hashing and comparing it is a single pass over memory
+    std::vector<uint8_t> keys(a_NumVertices * vertexSize);
+    uint32_t keyOffset = 0;
+    for (auto& stream : a_Streams)
+    {
+        stream.CopyTo(keys.data() + keyOffset, vertexSize);
+        keyOffset += stream.GetElementSize();
+    }
+
+    auto hashKey = [&](uint64_t a_Vertex)
+    {
+        // 64 bit FNV-1a
+        const uint8_t* key = keys.data() + a_Vertex * vertexSize;
+        uint64_t hash = 14695981039346656037ull;
+        for (uint32_t i = 0; i < vertexSize; i++)
+        {
+            hash ^= key[i];
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    };
+
+    // Open addressing with linear probing, sized to stay at most half full
+    uint64_t tableSize = 1;
+    while (tableSize < a_NumVertices * 2)
+        tableSize *= 2;
+
+    std::vector<uint32_t> table(tableSize, UnusedVertex);
+    uint32_t numUnique = 0;
+
+    for (uint64_t vertex = 0; vertex < a_NumVertices; vertex++)
+    {
+        uint64_t slot = hashKey(vertex) & (tableSize - 1);
+
+        while (table[slot] != UnusedVertex &&
+               memcmp(keys.data() + table[slot] * vertexSize, keys.data() + vertex * vertexSize, vertexSize) != 0)
+        {
+            slot = (slot + 1) & (tableSize - 1);
+        }
+
+        if (table[slot] == UnusedVertex)
+        {
+            table[slot] = static_cast<uint32_t>(vertex);
+            a_Remap[vertex] = numUnique++;
+        }
+        else
+        {
+            a_Remap[vertex] = a_Remap[table[slot]];
+        }
+    }
+
+    return numUnique;
+}
+
+uint32_t krt::hlp::RemoveDegenerateTriangles(std::vector<uint32_t>& a_Indices)
+{
+    size_t numTriangles = a_Indices.size() / 3;
+    size_t kept = 0;
+
+    for (size_t triangle = 0; triangle < numTriangles; triangle++)
+    {
+        auto* corners = &a_Indices[triangle * 3];
+        if (corners[0] == corners[1] || corners[1] == corners[2] || corners[0] == corners[2])
+            continue;
+
+        std::copy(corners, corners + 3, a_Indices.begin() + kept * 3);
+        kept++;
+    }
+
+    if (kept == 0 && numTriangles != 0)
+        kept = 1;
+
+    a_Indices.resize(kept * 3);
+    return static_cast<uint32_t>(numTriangles - kept);
+}
+
+void krt::hlp::OptimizeVertexCache(std::vector<uint32_t>& a_Indices, uint32_t a_NumVertices)
+{
+    // The adjacency and the emitted flags are built per triangle, so a partial triangle at the end would be read past
+    uint32_t numTriangles = static_cast<uint32_t>(a_Indices.size() / 3);
+    a_Indices.resize(static_cast<size_t>(numTriangles) * 3);
+    if (numTriangles == 0)
+        return;
+
+    // The triangles of each vertex, of which the first m_RemainingTriangles have not been emitted yet
+    std::vector<uint32_t> remainingTriangles(a_NumVertices, 0);
+    for (auto index : a_Indices)
+        remainingTriangles[index]++;
+
+    std::vector<uint32_t> adjacencyOffsets(a_NumVertices + 1, 0);
+    for (uint32_t vertex = 0; vertex < a_NumVertices; vertex++)
+        adjacencyOffsets[vertex + 1] = adjacencyOffsets[vertex] + remainingTriangles[vertex];
+
+    std::vector<uint32_t> adjacency(numTriangles * 3);
+    std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+    for (uint32_t triangle = 0; triangle < numTriangles; triangle++)
+    {
+        for (uint32_t corner = 0; corner < 3; corner++)
+        {
+            auto vertex = a_Indices[triangle * 3 + corner];
+            adjacency[fill[vertex]++] = triangle;
+        }
+    }
+
+    std::vector<int32_t> cachePositions(a_NumVertices, -1);
+    std::vector<float> vertexScores(a_NumVertices);
+    for (uint32_t vertex = 0; vertex < a_NumVertices; vertex++)
+        vertexScores[vertex] = ComputeVertexScore(-1, remainingTriangles[vertex]);
+
+    std::vector<float> triangleScores(numTriangles);
+    std::vector<bool> emitted(numTriangles, false);
+    uint32_t bestTriangle = 0;
+
+    for (uint32_t triangle = 0; triangle < numTriangles; triangle++)
+    {
+        auto* corners = &a_Indices[triangle * 3];
+        triangleScores[triangle] = vertexScores[corners[0]] + vertexScores[corners[1]] + vertexScores[corners[2]];
+
+        if (triangleScores[triangle] > triangleScores[bestTriangle])
+            bestTriangle = triangle;
+    }
+
+    // The cache holds three extra entries, for the vertices pushed out by the triangle that was just emitted
+    std::vector<uint32_t> cache;
+    std::vector<uint32_t> newCache;
+    cache.reserve(LruCacheSize + 3);
+    newCache.reserve(LruCacheSize + 3);
+
+    std::vector<uint32_t> optimized;
+    optimized.reserve(a_Indices.size());
+    uint32_t nextUnemitted = 0;
+
+    while (optimized.size() < a_Indices.size())
+    {
+        // With no candidate left in the cache, the next triangle in the original order starts a new strip
+        if (bestTriangle == NoTriangle)
+        {
+            while (emitted[nextUnemitted])
+                nextUnemitted++;
+            bestTriangle = nextUnemitted;
+        }
+
+        const uint32_t* corners = &a_Indices[bestTriangle * 3];
+        optimized.insert(optimized.end(), corners, corners + 3);
+        emitted[bestTriangle] = true;
+
+        for (uint32_t corner = 0; corner < 3; corner++)
+        {
+            auto vertex = corners[corner];
+            auto* triangles = &adjacency[adjacencyOffsets[vertex]];
+            auto* last = triangles + remainingTriangles[vertex] - 1;
+            std::swap(*std::find(triangles, last + 1, bestTriangle), *last);
+            remainingTriangles[vertex]--;
+        }
+
+        newCache.assign(corners, corners + 3);
+        for (auto vertex : cache)
+        {
+            if (vertex != corners[0] && vertex != corners[1] && vertex != corners[2])
+                newCache.push_back(vertex);
+        }
+
+        // The scores of every vertex whose position changed, including the ones that fell out, are updated together with their triangles
+        for (uint32_t position = 0; position < newCache.size(); position++)
+        {
+            auto vertex = newCache[position];
+            cachePositions[vertex] = position < LruCacheSize ? static_cast<int32_t>(position) : -1;
+
+            float score = ComputeVertexScore(cachePositions[vertex], remainingTriangles[vertex]);
+            float delta = score - vertexScores[vertex];
+            vertexScores[vertex] = score;
+
+            for (uint32_t i = 0; i < remainingTriangles[vertex]; i++)
+                triangleScores[adjacency[adjacencyOffsets[vertex] + i]] += delta;
+        }
+
+        if (newCache.size() > LruCacheSize)
+            newCache.resize(LruCacheSize);
+
+        // Only triangles with a vertex in the cache are candidates for the next one
+        bestTriangle = NoTriangle;
+        float bestScore = -std::numeric_limits<float>::max();
+
+        for (auto vertex : newCache)
+        {
+            for (uint32_t i = 0; i < remainingTriangles[vertex]; i++)
+            {
+                auto triangle = adjacency[adjacencyOffsets[vertex] + i];
+                if (triangleScores[triangle] > bestScore)
+                {
+                    bestScore = triangleScores[triangle];
+                    bestTriangle = triangle;
+                }
+            }
+        }
+
+        std::swap(cache, newCache);
+    }
+
+    a_Indices = std::move(optimized);
+}
+
+void krt::hlp::OptimizeOverdraw(std::vector<uint32_t>& a_Indices, const std::vector<glm::vec3>& a_Positions, float a_Threshold)
+{
+    uint32_t numTriangles = static_cast<uint32_t>(a_Indices.size() / 3);
+    if (numTriangles < 2)
+        return;
+
+    auto numVertices = static_cast<uint32_t>(a_Positions.size());
+
+    // Hard boundaries are the triangles that miss the cache on all three vertices, the cache effectively starts over there.
+    // The first triangle always opens a cluster, even where it is degenerate and hits the cache on its repeated vertex.
+    std::vector<uint32_t> hardBoundaries = { 0 };
+    {
+        FifoCache cache(numVertices);
+        cache.AddTriangle(&a_Indices[0]);
+        for (uint32_t triangle = 1; triangle < numTriangles; triangle++)
+        {
+            if (cache.AddTriangle(&a_Indices[triangle * 3]) == 3)
+                hardBoundaries.push_back(triangle);
+        }
+    }
+    hardBoundaries.push_back(numTriangles);
+
+    // Soft boundaries split the clusters further wherever the cache efficiency so far is close enough to that of the whole cluster.
+    // The cache is emptied at each boundary, since the clusters are drawn in a different order afterwards.
+    std::vector<uint32_t> clusters;
+    FifoCache cache(numVertices);
+
+    for (size_t i = 0; i + 1 < hardBoundaries.size(); i++)
+    {
+        uint32_t start = hardBoundaries[i];
+        uint32_t end = hardBoundaries[i + 1];
+
+        cache.Clear();
+        uint32_t clusterMisses = 0;
+        for (uint32_t triangle = start; triangle < end; triangle++)
+            clusterMisses += cache.AddTriangle(&a_Indices[triangle * 3]);
+
+        float clusterThreshold = a_Threshold * static_cast<float>(clusterMisses) / static_cast<float>(end - start);
+
+        clusters.push_back(start);
+        cache.Clear();
+        uint32_t runningMisses = 0;
+        uint32_t runningTriangles = 0;
+
+        for (uint32_t triangle = start; triangle < end; triangle++)
+        {
+            runningMisses += cache.AddTriangle(&a_Indices[triangle * 3]);
+            runningTriangles++;
+
+            if (static_cast<float>(runningMisses) / static_cast<float>(runningTriangles) <= clusterThreshold && triangle + 1 < end)
+            {
+                clusters.push_back(triangle + 1);
+                cache.Clear();
+                runningMisses = 0;
+                runningTriangles = 0;
+            }
+        }
+    }
+    clusters.push_back(numTriangles);
+
+    glm::vec3 meshCentroid(0.0f);
+    for (auto index : a_Indices)
+        meshCentroid += a_Positions[index];
+    meshCentroid /= static_cast<float>(a_Indices.size());
+
+    // Clusters far out from the center that face away from it are likely to occlude the rest of the mesh, so they are drawn first
+    uint32_t numClusters = static_cast<uint32_t>(clusters.size() - 1);
+    std::vector<float> sortKeys(numClusters);
+
+    for (uint32_t cluster = 0; cluster < numClusters; cluster++)
+    {
+        glm::vec3 centroid(0.0f);
+        glm::vec3 normal(0.0f);
+        float area = 0.0f;
+
+        for (uint32_t triangle = clusters[cluster]; triangle < clusters[cluster + 1]; triangle++)
+        {
+            auto& p0 = a_Positions[a_Indices[triangle * 3 + 0]];
+            auto& p1 = a_Positions[a_Indices[triangle * 3 + 1]];
+            auto& p2 = a_Positions[a_Indices[triangle * 3 + 2]];
+
+            // The length of the cross product is twice the area, so area weighting comes for free
+            glm::vec3 triangleNormal = glm::cross(p1 - p0, p2 - p0);
+            float triangleArea = glm::length(triangleNormal);
+
+            centroid += (p0 + p1 + p2) * (triangleArea / 3.0f);
+            normal += triangleNormal;
+            area += triangleArea;
+        }
+
+        float normalLength = glm::length(normal);
+        if (area == 0.0f || normalLength == 0.0f)
+        {
+            sortKeys[cluster] = 0.0f;
+            continue;
+        }
+
+        sortKeys[cluster] = glm::dot(centroid / area - meshCentroid, normal / normalLength);
+    }
+
+    std::vector<uint32_t> order(numClusters);
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&sortKeys](uint32_t a_Left, uint32_t a_Right)
+    {
+        return sortKeys[a_Left] > sortKeys[a_Right];
+    });
+
+    std::vector<uint32_t> sorted;
+    sorted.reserve(a_Indices.size());
+    for (auto cluster : order)
+        sorted.insert(sorted.end(), a_Indices.begin() + clusters[cluster] * 3, a_Indices.begin() + clusters[cluster + 1] * 3);
+
+    a_Indices = std::move(sorted);
+}
+
+uint32_t krt::hlp::OptimizeVertexFetch(const std::vector<uint32_t>& a_Indices, uint32_t a_NumVertices, std::vector<uint32_t>& a_Remap)
+{
+    a_Remap.assign(a_NumVertices, UnusedVertex);
+    uint32_t numReferenced = 0;
+
+    for (auto index : a_Indices)
+    {
+        if (a_Remap[index] == UnusedVertex)
+            a_Remap[index] = numReferenced++;
+    }
+
+    return numReferenced;
+}
+
+void krt::hlp::RemapIndices(std::vector<uint32_t>& a_Indices, const std::vector<uint32_t>& a_Remap)
+{
+    for (auto& index : a_Indices)
+        index = a_Remap[index];
+}
+
+std::vector<uint8_t> krt::hlp::RemapVertices(const AccessorView& a_Stream, const std::vector<uint32_t>& a_Remap, uint32_t a_NewCount)
+{
+    auto elementSize = a_Stream.GetElementSize();
+    std::vector<uint8_t> remapped(static_cast<size_t>(a_NewCount) * elementSize);
+
+    for (uint64_t i = 0; i < a_Stream.Size(); i++)
+    {
+        if (a_Remap[i] != UnusedVertex)
+            a_Stream.CopyElementTo(i, remapped.data() + static_cast<size_t>(a_Remap[i]) * elementSize);
+    }
+
+    return remapped;
+}
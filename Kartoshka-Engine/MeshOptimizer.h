@@ -0,0 +1,70 @@
+#pragma once
+
+#include "AccessorView.h"
+
+#include <glm/vec3.hpp>
+
+#include <vector>
+
+namespace krt
+{
+    namespace hlp
+    {
+        // Marks vertices of a remap table that are not referenced by any index
+        const uint32_t UnusedVertex = ~0u;
+
+        // Raw counts gathered by AnalyzeMesh, which can be summed over several primitives before computing the ratios
+        struct MeshStatistics
+        {
+            MeshStatistics& operator+=(const MeshStatistics& a_Other);
+
+            // Average cache miss ratio, vertex shader invocations per triangle. 0.5 at best, 3 at worst.
+            float GetACMR() const;
+            // Average transformed vertex ratio, vertex shader invocations per vertex. 1 at best.
+            float GetATVR() const;
+            // Fragments that passed the depth test per covered pixel, averaged over six axis aligned views. 1 at best.
+            float GetOverdraw() const;
+
+            uint64_t m_NumTriangles = 0;
+            uint64_t m_NumVertices = 0;
+            uint64_t m_CacheMisses = 0;
+            uint64_t m_CoveredPixels = 0;
+            uint64_t m_ShadedPixels = 0;
+        };
+
+        // Simulates a 16 entry FIFO post-transform cache, and rasterizes the triangles in order from six directions
+        // into a 256x256 depth buffer without back face culling, like the forward pass.
+        MeshStatistics AnalyzeMesh(const std::vector<uint32_t>& a_Indices, const std::vector<glm::vec3>& a_Positions);
+
+        // Maps every vertex to the first vertex with identical bytes in all of the streams, which all have to hold a_NumVertices elements.
+        // Returns the number of unique vertices, which keep the order of the vertices they were merged from.
+        uint32_t WeldVertices(const std::vector<AccessorView>& a_Streams, uint64_t a_NumVertices, std::vector<uint32_t>& a_Remap);
+
+        // Drops the triangles with two or more identical indices, which welding creates out of triangles between identical vertices.
+        // If every triangle is degenerate the first one is kept, so the primitive keeps a vertex. Returns the number of dropped triangles.
+        uint32_t RemoveDegenerateTriangles(std::vector<uint32_t>& a_Indices);
+
+        // Reorders the triangles for a 32 entry LRU post-transform cache, following Forsyth's linear-speed vertex cache optimisation.
+        // Indices after the last whole triangle are dropped.
+        void OptimizeVertexCache(std::vector<uint32_t>& a_Indices, uint32_t a_NumVertices);
+
+        // Splits the triangles into clusters at the points where the cache starts over, or where the cache efficiency
+        // of a cluster stays within a_Threshold of its original ACMR, and sorts the clusters so the ones facing away from the center
+        // are drawn first, following Sander et al.'s fast triangle reordering. A threshold of 1.05 trades 5% of ACMR for less overdraw.
+        void OptimizeOverdraw(std::vector<uint32_t>& a_Indices, const std::vector<glm::vec3>& a_Positions, float a_Threshold);
+
+        // Numbers the vertices in the order they are first referenced by the indices, so the vertex fetch reads them front to back.
+        // Returns the number of referenced vertices, unreferenced ones are mapped to UnusedVertex.
+        uint32_t OptimizeVertexFetch(const std::vector<uint32_t>& a_Indices, uint32_t a_NumVertices, std::vector<uint32_t>& a_Remap);
+
+        void RemapIndices(std::vector<uint32_t>& a_Indices, const std::vector<uint32_t>& a_Remap);
+
+        // Gathers the elements of the stream into their new positions, vertices mapped to UnusedVertex are dropped
+        std::vector<uint8_t> RemapVertices(const AccessorView& a_Stream, const std::vector<uint32_t>& a_Remap, uint32_t a_NewCount);
+
+        template<typename ElementType>
+        std::vector<ElementType> RemapVertices(const std::vector<ElementType>& a_Vertices, const std::vector<uint32_t>& a_Remap, uint32_t a_NewCount);
+    }
+}
+
+#include "MeshOptimizer.inl"
@@ -0,0 +1,14 @@
+template <typename ElementType>
+std::vector<ElementType> krt::hlp::RemapVertices(const std::vector<ElementType>& a_Vertices, const std::vector<uint32_t>& a_Remap,
+    uint32_t a_NewCount)
+{
+    std::vector<ElementType> remapped(a_NewCount);
+
+    for (size_t i = 0; i < a_Vertices.size(); i++)
+    {
+        if (a_Remap[i] != UnusedVertex)
+            remapped[a_Remap[i]] = a_Vertices[i];
+    }
+
+    return remapped;
+}
@@ -0,0 +1,133 @@
+#include "MeshletBuilder.h"
+
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace
+{
+    // Below this, the triangle normals of a meshlet cancel each other out and there is no meaningful axis
+    const float MinConeAxisLength = 1e-6f;
+
+    // Computes the bounding sphere and normal cone of the triangles in [a_FirstIndex, a_FirstIndex + a_NumIndices)
+    krt::Mesh::Meshlet FinishMeshlet(const std::vector<uint32_t>& a_Indices, const std::vector<glm::vec3>& a_Positions,
+                                     uint32_t a_FirstIndex, uint32_t a_NumIndices)
+    {
+        krt::Mesh::Meshlet meshlet;
+        meshlet.m_FirstIndex = a_FirstIndex;
+        meshlet.m_NumIndices = a_NumIndices;
+
+        glm::vec3 boundsMin(std::numeric_limits<float>::max());
+        glm::vec3 boundsMax(std::numeric_limits<float>::lowest());
+        for (uint32_t i = a_FirstIndex; i < a_FirstIndex + a_NumIndices; i++)
+        {
+            boundsMin = glm::min(boundsMin, a_Positions[a_Indices[i]]);
+            boundsMax = glm::max(boundsMax, a_Positions[a_Indices[i]]);
+        }
+
+        // The center of the box is not the tightest center, but it is within a factor of sqrt(3) and never misses a vertex
+        meshlet.m_Center = (boundsMin + boundsMax) * 0.5f;
+        meshlet.m_Radius = 0.0f;
+        for (uint32_t i = a_FirstIndex; i < a_FirstIndex + a_NumIndices; i++)
+            meshlet.m_Radius = std::max(meshlet.m_Radius, glm::distance(meshlet.m_Center, a_Positions[a_Indices[i]]));
+
+        std::vector<glm::vec3> normals;
+        normals.reserve(a_NumIndices / 3);
+        glm::vec3 axis(0.0f);
+
+        for (uint32_t i = a_FirstIndex; i + 2 < a_FirstIndex + a_NumIndices; i += 3)
+        {
+            auto& p0 = a_Positions[a_Indices[i + 0]];
+            auto& p1 = a_Positions[a_Indices[i + 1]];
+            auto& p2 = a_Positions[a_Indices[i + 2]];
+
+            glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+            float length = glm::length(normal);
+            if (length == 0.0f)
+                continue;
+
+            normals.push_back(normal / length);
+            axis += normals.back();
+        }
+
+        // Meshlets whose cone spans a hemisphere or more can always be seen from somewhere in front of them
+        meshlet.m_ConeAxis = glm::vec3(0.0f, 0.0f, 1.0f);
+        meshlet.m_ConeCutoff = 1.0f;
+
+        float axisLength = glm::length(axis);
+        if (axisLength < MinConeAxisLength)
+            return meshlet;
+
+        axis /= axisLength;
+
+        float minDot = 1.0f;
+        for (auto& normal : normals)
+            minDot = std::min(minDot, glm::dot(normal, axis));
+
+        meshlet.m_ConeAxis = axis;
+        if (minDot > 0.0f)
+            meshlet.m_ConeCutoff = std::sqrt(1.0f - minDot * minDot);
+
+        return meshlet;
+    }
+}
+
+std::vector<krt::Mesh::Meshlet> krt::hlp::BuildMeshlets(const std::vector<uint32_t>& a_Indices, const AccessorView& a_Positions)
+{
+    std::vector<Mesh::Meshlet> meshlets;
+
+    auto numTriangles = a_Indices.size() / 3;
+    if (numTriangles == 0 || a_Positions.GetElementSize() != sizeof(glm::vec3))
+        return meshlets;
+
+    auto positions = a_Positions.ToVector<glm::vec3>();
+
+    // Each vertex remembers the last meshlet it was added to, so checking whether it is new to the current one is a single lookup
+    std::vector<uint32_t> vertexMeshlets(positions.size(), std::numeric_limits<uint32_t>::max());
+
+    uint32_t firstIndex = 0;
+    uint32_t numVertices = 0;
+    uint32_t numMeshletTriangles = 0;
+
+    for (uint32_t triangle = 0; triangle < numTriangles; triangle++)
+    {
+        auto* corners = &a_Indices[triangle * 3];
+        auto meshletIndex = static_cast<uint32_t>(meshlets.size());
+
+        uint32_t newVertices = 0;
+        for (uint32_t corner = 0; corner < 3; corner++)
+        {
+            bool repeated = (corner > 0 && corners[corner] == corners[0]) || (corner > 1 && corners[corner] == corners[1]);
+            if (vertexMeshlets[corners[corner]] != meshletIndex && !repeated)
+                newVertices++;
+        }
+
+        if (numVertices + newVertices > MaxMeshletVertices || numMeshletTriangles == MaxMeshletTriangles)
+        {
+            meshlets.push_back(FinishMeshlet(a_Indices, positions, firstIndex, triangle * 3 - firstIndex));
+            meshletIndex++;
+
+            firstIndex = triangle * 3;
+            numVertices = 0;
+            numMeshletTriangles = 0;
+        }
+
+        for (uint32_t corner = 0; corner < 3; corner++)
+        {
+            if (vertexMeshlets[corners[corner]] != meshletIndex)
+            {
+                vertexMeshlets[corners[corner]] = meshletIndex;
+                numVertices++;
+            }
+        }
+
+        numMeshletTriangles++;
+    }
+
+    meshlets.push_back(FinishMeshlet(a_Indices, positions, firstIndex, static_cast<uint32_t>(numTriangles * 3) - firstIndex));
+
+    return meshlets;
+}
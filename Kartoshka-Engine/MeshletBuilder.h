@@ -0,0 +1,22 @@
+#pragma once
+
+#include "AccessorView.h"
+#include "Mesh.h"
+
+#include <vector>
+
+namespace krt
+{
+    namespace hlp
+    {
+        // Upper bounds of a single meshlet, the sizes mesh shading hardware is usually tuned for
+        const uint32_t MaxMeshletVertices = 64;
+        const uint32_t MaxMeshletTriangles = 124;
+
+        // Splits an indexed triangle list into meshlets of consecutive triangles, starting a new one whenever the next triangle
+        // would exceed either limit. The triangles keep their order, so the meshlets are only as compact as the triangle order is local,
+        // which the vertex cache optimization takes care of.
+        // The normal cones follow the counter-clockwise winding of glTF, degenerate triangles do not widen them.
+        std::vector<Mesh::Meshlet> BuildMeshlets(const std::vector<uint32_t>& a_Indices, const AccessorView& a_Positions);
+    }
+}
@@ -0,0 +1,121 @@
+#include "MipGenerator.h"
+
+#include <emmintrin.h>
+
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+    const uint32_t PixelSize = 4;
+
+    // Scalar version of the SSE path, for the pixels left over at the end of a row and for sources narrower than two pixels
+    void DownsamplePixel(const uint8_t* a_Row0, const uint8_t* a_Row1, uint32_t a_X0, uint32_t a_X1, uint8_t* a_Destination)
+    {
+        for (uint32_t channel = 0; channel < PixelSize; channel++)
+        {
+            uint32_t sum = a_Row0[a_X0 * PixelSize + channel] + a_Row0[a_X1 * PixelSize + channel] +
+                           a_Row1[a_X0 * PixelSize + channel] + a_Row1[a_X1 * PixelSize + channel];
+            a_Destination[channel] = static_cast<uint8_t>((sum + 2) >> 2);
+        }
+    }
+
+    // Averages the 8 source pixels of each of the two rows into 4 destination pixels.
+    // The sums are done in 16 bit, so the rounding matches the scalar path exactly.
+    void DownsampleFour(const uint8_t* a_Row0, const uint8_t* a_Row1, uint8_t* a_Destination)
+    {
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i rounding = _mm_set1_epi16(2);
+
+        __m128i top0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a_Row0));
+        __m128i top1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a_Row0 + 16));
+        __m128i bottom0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a_Row1));
+        __m128i bottom1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a_Row1 + 16));
+
+        // Each register holds the vertical sums of two neighbouring source pixels
+        __m128i sum0 = _mm_add_epi16(_mm_unpacklo_epi8(top0, zero), _mm_unpacklo_epi8(bottom0, zero));
+        __m128i sum1 = _mm_add_epi16(_mm_unpackhi_epi8(top0, zero), _mm_unpackhi_epi8(bottom0, zero));
+        __m128i sum2 = _mm_add_epi16(_mm_unpacklo_epi8(top1, zero), _mm_unpacklo_epi8(bottom1, zero));
+        __m128i sum3 = _mm_add_epi16(_mm_unpackhi_epi8(top1, zero), _mm_unpackhi_epi8(bottom1, zero));
+
+        // Adding the upper pixel onto the lower one leaves the full 2x2 sum in the low 64 bits
+        sum0 = _mm_add_epi16(sum0, _mm_srli_si128(sum0, 8));
+        sum1 = _mm_add_epi16(sum1, _mm_srli_si128(sum1, 8));
+        sum2 = _mm_add_epi16(sum2, _mm_srli_si128(sum2, 8));
+        sum3 = _mm_add_epi16(sum3, _mm_srli_si128(sum3, 8));
+
+        __m128i pixels01 = _mm_srli_epi16(_mm_add_epi16(_mm_unpacklo_epi64(sum0, sum1), rounding), 2);
+        __m128i pixels23 = _mm_srli_epi16(_mm_add_epi16(_mm_unpacklo_epi64(sum2, sum3), rounding), 2);
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(a_Destination), _mm_packus_epi16(pixels01, pixels23));
+    }
+
+    void Downsample(const uint8_t* a_Source, glm::uvec2 a_SourceDimensions, uint8_t* a_Destination, glm::uvec2 a_Dimensions)
+    {
+        uint64_t sourceStride = static_cast<uint64_t>(a_SourceDimensions.x) * PixelSize;
+
+        // Sources of a single row or column average each pixel with itself in that direction
+        for (uint32_t y = 0; y < a_Dimensions.y; y++)
+        {
+            auto* row0 = a_Source + std::min(y * 2, a_SourceDimensions.y - 1) * sourceStride;
+            auto* row1 = a_Source + std::min(y * 2 + 1, a_SourceDimensions.y - 1) * sourceStride;
+            auto* destination = a_Destination + static_cast<uint64_t>(y) * a_Dimensions.x * PixelSize;
+
+            uint32_t x = 0;
+            for (; x + 4 <= a_Dimensions.x; x += 4)
+                DownsampleFour(row0 + x * 2 * PixelSize, row1 + x * 2 * PixelSize, destination + x * PixelSize);
+
+            for (; x < a_Dimensions.x; x++)
+                DownsamplePixel(row0, row1, std::min(x * 2, a_SourceDimensions.x - 1), std::min(x * 2 + 1, a_SourceDimensions.x - 1),
+                                destination + x * PixelSize);
+        }
+    }
+}
+
+uint32_t krt::hlp::GetMipCount(glm::uvec2 a_Dimensions)
+{
+    uint32_t numLevels = 1;
+    for (uint32_t size = std::max(a_Dimensions.x, a_Dimensions.y); size > 1; size >>= 1)
+        numLevels++;
+
+    return numLevels;
+}
+
+glm::uvec2 krt::hlp::GetMipDimensions(glm::uvec2 a_Dimensions, uint32_t a_Level)
+{
+    return glm::uvec2(std::max(a_Dimensions.x >> a_Level, 1u), std::max(a_Dimensions.y >> a_Level, 1u));
+}
+
+uint64_t krt::hlp::GetMipChainSize(glm::uvec2 a_Dimensions, uint32_t a_NumLevels, uint32_t a_PixelSize)
+{
+    uint64_t size = 0;
+    for (uint32_t level = 0; level < a_NumLevels; level++)
+    {
+        auto dimensions = GetMipDimensions(a_Dimensions, level);
+        size += static_cast<uint64_t>(dimensions.x) * dimensions.y * a_PixelSize;
+    }
+
+    return size;
+}
+
+std::vector<uint8_t> krt::hlp::GenerateMipChain(const uint8_t* a_Pixels, glm::uvec2 a_Dimensions)
+{
+    auto numLevels = GetMipCount(a_Dimensions);
+    std::vector<uint8_t> chain(GetMipChainSize(a_Dimensions, numLevels, PixelSize));
+
+    memcpy(chain.data(), a_Pixels, static_cast<uint64_t>(a_Dimensions.x) * a_Dimensions.y * PixelSize);
+
+    // Every level is filtered from the one before it, which is still in the cache from being written
+    uint64_t sourceOffset = 0;
+    for (uint32_t level = 1; level < numLevels; level++)
+    {
+        auto sourceDimensions = GetMipDimensions(a_Dimensions, level - 1);
+        auto dimensions = GetMipDimensions(a_Dimensions, level);
+        uint64_t offset = sourceOffset + static_cast<uint64_t>(sourceDimensions.x) * sourceDimensions.y * PixelSize;
+
+        Downsample(chain.data() + sourceOffset, sourceDimensions, chain.data() + offset, dimensions);
+        sourceOffset = offset;
+    }
+
+    return chain;
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <glm/vec2.hpp>
+
+#include <cstdint>
+#include <vector>
+
+namespace krt
+{
+    namespace hlp
+    {
+        // Number of levels of a full mip chain, down to and including the 1x1 level
+        uint32_t GetMipCount(glm::uvec2 a_Dimensions);
+        // Dimensions of a mip level, each level halves the previous one and rounds down, but never below 1
+        glm::uvec2 GetMipDimensions(glm::uvec2 a_Dimensions, uint32_t a_Level);
+        // Size in bytes of a tightly packed mip chain with a_NumLevels levels
+        uint64_t GetMipChainSize(glm::uvec2 a_Dimensions, uint32_t a_NumLevels, uint32_t a_PixelSize);
+
+        // Builds a full mip chain from tightly packed RGBA8 pixels, with all levels back to back starting at the given image.
+        // Each level is a 2x2 box filter of the previous one, four output pixels at a time with SSE2.
+        // Odd rows and columns are dropped, as in D3DX and most offline tools. The filter runs on the stored values,
+        // which matches how the sampler blends between texels of the UNORM textures the engine creates.
+        std::vector<uint8_t> GenerateMipChain(const uint8_t* a_Pixels, glm::uvec2 a_Dimensions);
+    }
+}
@@ -12,223 +12,1426 @@
 #include "Scene.h"
 #include "StaticMesh.h"
 #include "Transform.h"
+#include "ThreadPool.h"
+#include "UploadBatch.h"
+#include "GltfSource.h"
+#include "MeshCache.h"
+#include "MappedFile.h"
+#include "PhysicalDevice.h"
+#include "Skeleton.h"
+#include "AnimationCompression.h"
+
+#include "AccessorView.h"
+#include "MeshletBuilder.h"
+#include "MipGenerator.h"
+#include "TextureCompressor.h"
+#include "MeshOptimizer.h"
+#include "MorphTargets.h"
+#include "TangentGenerator.h"
+#include "VertexAnimation.h"
+#include "VertexQuantization.h"
+
+#include "stb/stb_image.h"
 
-#include "VectorView.h"
+#include "FX-GLTF/gltf.h"
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+#include <glm/gtx/matrix_decompose.hpp>
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstddef>
+#include <filesystem>
+#include <limits>
+#include <numeric>
+#include <system_error>
+
+namespace
+{
+    const char* TextureCacheDirectory = "../../../../Assets/TextureCache";
+
+    // Bumped whenever the encoder changes its output, so textures compressed by an older version are not reused
+    const uint32_t TextureCacheVersion = 1;
+}
+
+krt::ModelManager::ModelManager(ServiceLocator& a_Services, EVertexLayout a_VertexLayout, bool a_OptimizeMeshes, bool a_GenerateMipmaps,
+    bool a_CompressTextures, uint64_t a_TextureMemoryBudget)
+    : m_Services(a_Services)
+    , m_VertexLayout(a_VertexLayout)
+    , m_OptimizeMeshes(a_OptimizeMeshes)
+    , m_GenerateMipmaps(a_GenerateMipmaps)
+    , m_CompressTextures(a_CompressTextures && a_Services.m_PhysicalDevice->SupportsBlockCompression())
+    , m_TextureStreamer(a_Services, a_TextureMemoryBudget)
+{
+    if (m_CompressTextures)
+    {
+        std::error_code error;
+        std::filesystem::create_directories(TextureCacheDirectory, error);
+    }
+
+    Sampler::CreateInfo info = Sampler::CreateInfo::CreateDefault();
+    m_DefaultSampler = std::make_unique<Sampler>(m_Services, info);
+
+    auto& commandBuffer = m_Services.m_LogicalDevice->GetCommandQueue(ETransferQueue).GetSingleUseCommandBuffer();
+    commandBuffer.Begin();
+
+    m_DefaultDiffuse = commandBuffer.CreateTextureFromFile("../../../../Assets/Textures/DiffuseDefault.png", { EGraphicsQueue });
+
+    glm::vec4 defNormal(0.5f, 0.5f, 1.0f, 1.0f);
+
+    m_DefaultNormalMap = commandBuffer.CreateTexture(&defNormal[0], glm::uvec2(1, 1), 4, 1, { EGraphicsQueue });
+
+    commandBuffer.Submit();
+
+}
+
+krt::ModelManager::~ModelManager()
+{
+    // Loads that never finished can still have jobs in flight which reference them
+    for (auto& load : m_StreamingLoads)
+        WaitForWorkers(*load);
+}
+
+krt::ModelManager::GLTFResource* krt::ModelManager::LoadGltf(std::string a_Path)
+{
+    auto* res = LoadGltfAsync(a_Path);
+    TakeFinishedLoad(*res);
+
+    return res;
+}
+
+krt::ModelManager::GLTFResource* krt::ModelManager::LoadGltfAsync(std::string a_Path)
+{
+    auto findIter = m_LoadedGLTFs.find(a_Path);
+
+    if (findIter != m_LoadedGLTFs.end())
+        return &(*findIter).second;
+
+    auto& res = m_LoadedGLTFs[a_Path];
+    m_StreamingLoads.push_back(BeginLoad(a_Path, res));
+
+    return &res;
+}
+
+void krt::ModelManager::Update(uint64_t a_StagingBudget)
+{
+    // The budget is shared, so files that were requested first also become resident first
+    for (auto iter = m_StreamingLoads.begin(); iter != m_StreamingLoads.end();)
+    {
+        if (StepLoad(**iter, a_StagingBudget))
+            iter = m_StreamingLoads.erase(iter);
+        else
+            ++iter;
+    }
+
+    // Whatever the loads left of the budget goes to the finer levels of the textures that are already resident
+    m_TextureStreamer.Update(a_StagingBudget);
+}
+
+std::shared_ptr<krt::VertexAnimation> krt::ModelManager::BakeVertexAnimation(const std::string& a_Path, float a_FrameRate)
+{
+    auto start = std::chrono::steady_clock::now();
+    auto* res = LoadGltfAsync(a_Path);
+
+    // When this call finishes the load, the primitives it decoded are baked. A file that was loaded before is read back
+    // from its cache, or decoded once more if it has none.
+    auto load = TakeFinishedLoad(*res);
+    std::unique_ptr<MeshCache> cache;
+    std::unique_ptr<GltfSource> source;
+
+    // The first node of any scene that places a skinned mesh whose skeleton has clips
+    int32_t skinnedMesh = -1;
+    int32_t skin = -1;
+    auto findSkinnedNode = [&](int32_t a_Mesh, int32_t a_Skin)
+    {
+        if (skinnedMesh == -1 && a_Mesh != -1 && a_Skin != -1 && !res->m_Skeletons[a_Skin]->m_Clips.empty())
+        {
+            skinnedMesh = a_Mesh;
+            skin = a_Skin;
+        }
+    };
+
+    if (load)
+    {
+        for (auto& nodes : load->m_SceneNodes)
+        {
+            for (auto& node : nodes)
+                findSkinnedNode(node.m_Mesh, node.m_Skin);
+        }
+    }
+    else if ((cache = MeshCache::Open(a_Path, m_VertexLayout, m_OptimizeMeshes)))
+    {
+        auto cachedNodes = cache->GetEntries<MeshCache::NodeEntry>(MeshCache::ENodes);
+        for (uint64_t i = 0; i < cache->GetCount(MeshCache::ENodes); i++)
+            findSkinnedNode(cachedNodes[i].m_Mesh, cachedNodes[i].m_Skin);
+    }
+    else
+    {
+        source = std::make_unique<GltfSource>(a_Path);
+        for (auto& nodes : TraverseScenes(source->GetDocument()))
+        {
+            for (auto& node : nodes)
+                findSkinnedNode(node.m_Mesh, node.m_Skin);
+        }
+    }
+
+    if (skinnedMesh == -1)
+    {
+        printf("Can not bake the vertex animation of %s, none of its skinned meshes has any clips.\n", a_Path.c_str());
+        return nullptr;
+    }
+
+    // The final streams of the primitives in the order of the glTF mesh, which point into the load, the cache or the source above
+    std::vector<PrimitiveData> meshPrimitives;
+    if (load)
+    {
+        for (size_t i = 0; i < load->m_DecodedPrimitives.size(); i++)
+        {
+            if (load->m_PrimitiveMeshes[i] == static_cast<uint32_t>(skinnedMesh))
+                meshPrimitives.push_back(std::move(load->m_DecodedPrimitives[i]));
+        }
+    }
+    else if (cache)
+    {
+        auto cachedPrimitives = ReadCachedPrimitives(*cache);
+        for (auto& future : cachedPrimitives[skinnedMesh])
+            meshPrimitives.push_back(future.get());
+    }
+    else
+    {
+        ImportTimings timings;
+        auto& fxMesh = source->GetDocument().meshes[skinnedMesh];
+        for (auto& fxPrimitive : fxMesh.primitives)
+            meshPrimitives.push_back(DecodePrimitive(*source, fxMesh, fxPrimitive, m_VertexLayout, m_OptimizeMeshes, timings));
+    }
+
+    auto& skeleton = *res->m_Skeletons[skin];
+
+    auto isBakeable = [](const PrimitiveData& a_Data)
+    {
+        return a_Data.m_SkinAttributes.GetElementSize() == sizeof(Mesh::SkinVertex) && a_Data.m_Positions.GetElementSize() == sizeof(glm::vec3);
+    };
+
+    // The frames lie below each other, so the texture of the densest primitive has to fit every frame within the height the device allows
+    uint32_t rowsPerFrame = 1;
+    for (auto& data : meshPrimitives)
+    {
+        if (isBakeable(data))
+            rowsPerFrame = std::max(rowsPerFrame, hlp::GetVertexAnimationRowsPerFrame(static_cast<uint32_t>(data.m_Positions.Size())));
+    }
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(m_Services.m_PhysicalDevice->GetPhysicalDevice(), &properties);
+    uint32_t maxRows = properties.limits.maxImageDimension2D;
+
+    float frameRate = hlp::FitVertexAnimationFrameRate(skeleton, a_FrameRate, rowsPerFrame, maxRows);
+    if (frameRate == 0.0f)
+    {
+        printf("Can not bake the vertex animation of %s, its %zu clips do not fit into %u texture rows at %u rows per frame.\n",
+               a_Path.c_str(), skeleton.m_Clips.size(), maxRows, rowsPerFrame);
+        return nullptr;
+    }
+
+    if (frameRate < a_FrameRate)
+    {
+        printf("Baking the vertex animation of %s at %.1f instead of %.1f frames per second, to fit into %u texture rows.\n",
+               a_Path.c_str(), frameRate, a_FrameRate, maxRows);
+    }
+
+    // The crowd draws the resident primitives of the resource, whose skin attributes the crowd pipelines leave unused
+    auto animation = std::make_shared<VertexAnimation>();
+    animation->m_Mesh = res->m_Meshes[skinnedMesh];
+    animation->m_Clips = hlp::PlanVertexAnimationClips(skeleton, frameRate);
+    animation->m_FrameRate = frameRate;
+
+    UploadBatch batch(m_Services);
+    batch.SetOwner(a_Path);
+    std::vector<hlp::VertexAnimationData> bakes;
+    bakes.reserve(meshPrimitives.size());
+
+    // The primitives of the mesh are stored in the order they became resident in, and find their streams by their index in the glTF mesh
+    for (auto& primitive : animation->m_Mesh->m_Primitives)
+    {
+        auto& baked = animation->m_Primitives.emplace_back();
+        baked.m_Dimensions = glm::uvec2(0);
+        baked.m_RowsPerFrame = 0;
+
+        auto& data = meshPrimitives[primitive.m_Index];
+        if (!isBakeable(data))
+            continue;
+
+        auto& bake = bakes.emplace_back(hlp::BakeVertexAnimation(skeleton, animation->m_Clips, m_VertexLayout, data.m_Positions,
+                                                                 data.m_InterleavedAttributes, data.m_Normals, data.m_Tangents,
+                                                                 data.m_SkinAttributes));
+
+        baked.m_Texture = batch.CreateTexture({ hlp::AccessorView::FromVector(bake.m_Texels) }, bake.m_Dimensions, VK_FORMAT_R32G32B32A32_UINT,
+                                              { EGraphicsQueue }, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT);
+        baked.m_Dimensions = bake.m_Dimensions;
+        baked.m_RowsPerFrame = bake.m_RowsPerFrame;
+        baked.m_BoundsMin = bake.m_BoundsMin;
+        baked.m_BoundsExtent = bake.m_BoundsExtent;
+    }
+
+    batch.Submit();
+    batch.WaitUntilResident();
+
+    uint32_t numFrames = 0;
+    for (auto& clip : animation->m_Clips)
+        numFrames += clip.m_NumFrames;
+
+    printf("Baked the vertex animation of %s: %zu clips, %u frames, %zu primitives, %.1f MB in %.1f ms.\n", a_Path.c_str(),
+           animation->m_Clips.size(), numFrames, animation->m_Primitives.size(),
+           static_cast<float>(animation->GetMemorySize()) / (1024.0f * 1024.0f),
+           std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count());
+
+    return animation;
+}
+
+std::unique_ptr<krt::ModelManager::StreamingLoad> krt::ModelManager::BeginLoad(const std::string& a_Path, GLTFResource& a_Res)
+{
+    auto load = std::make_unique<StreamingLoad>();
+    load->m_Path = a_Path;
+    load->m_Resource = &a_Res;
+    load->m_Start = std::chrono::steady_clock::now();
+
+    load->m_Timings.m_CacheRead.Measure([&]() { load->m_Cache = MeshCache::Open(a_Path, m_VertexLayout, m_OptimizeMeshes); });
+
+    if (load->m_Cache)
+        BeginLoadFromCache(*load);
+    else
+        BeginImport(*load);
+
+    return load;
+}
+
+void krt::ModelManager::BeginImport(StreamingLoad& a_Load)
+{
+    auto& timings = a_Load.m_Timings;
+
+    // The buffers of the file are memory mapped, and stay mapped until the cache has been written
+    timings.m_Parse.Measure([&]() { a_Load.m_Source = std::make_unique<GltfSource>(a_Load.m_Path); });
+    auto& doc = a_Load.m_Source->GetDocument();
+
+    // All CPU side work is queued up front so the workers can run ahead while
+    // the main thread records the uploads, which have to stay on the thread owning the command pools.
+    // The source is only read by the workers, and outlives all of the futures below.
+    a_Load.m_MaterialEntries = DescribeMaterials(doc);
+    DecodeImages(a_Load, GetImageSources(*a_Load.m_Source));
+    auto primitives = DecodePrimitives(*a_Load.m_Source, timings);
+
+    // The scenes have to exist as soon as the load returns, so the nodes are resolved right away
+    timings.m_NodeTraversal.Measure([&]() { a_Load.m_SceneNodes = TraverseScenes(doc); });
+    timings.m_SkeletonBuild.Measure([&]() { a_Load.m_Resource->m_Skeletons = LoadSkeletons(*a_Load.m_Source); });
+
+    BeginStreaming(a_Load, primitives);
+}
+
+void krt::ModelManager::BeginLoadFromCache(StreamingLoad& a_Load)
+{
+    auto& cache = *a_Load.m_Cache;
+
+    std::vector<ImageSource> imageSources;
+    auto cachedImages = cache.GetEntries<MeshCache::ImageEntry>(MeshCache::EImages);
+
+    for (uint64_t i = 0; i < cache.GetCount(MeshCache::EImages); i++)
+    {
+        auto& imageSource = imageSources.emplace_back();
+        if (cachedImages[i].m_Path.m_Length != 0)
+            imageSource.m_Path = cache.GetRootPath() + "/" + cache.GetString(cachedImages[i].m_Path);
+        else
+            imageSource.m_EncodedData = cache.GetData(cachedImages[i].m_DataOffset, cachedImages[i].m_DataSize);
+    }
+
+    auto materials = cache.GetEntries<MeshCache::MaterialEntry>(MeshCache::EMaterials);
+    a_Load.m_MaterialEntries.assign(materials, materials + cache.GetCount(MeshCache::EMaterials));
+
+    DecodeImages(a_Load, std::move(imageSources));
+    auto primitives = ReadCachedPrimitives(cache);
+
+    a_Load.m_Resource->m_Skeletons = ReadCachedSkeletons(cache);
+
+    auto cachedScenes = cache.GetEntries<MeshCache::SceneEntry>(MeshCache::EScenes);
+    auto cachedNodes = cache.GetEntries<MeshCache::NodeEntry>(MeshCache::ENodes);
+
+    for (uint64_t i = 0; i < cache.GetCount(MeshCache::EScenes); i++)
+    {
+        auto& nodes = a_Load.m_SceneNodes.emplace_back();
+
+        for (uint32_t j = 0; j < cachedScenes[i].m_NumNodes; j++)
+        {
+            auto& cachedNode = cachedNodes[cachedScenes[i].m_FirstNode + j];
+
+            auto& instance = nodes.emplace_back();
+            instance.m_Mesh = cachedNode.m_Mesh;
+            instance.m_Skin = cachedNode.m_Skin;
+            instance.m_Transform = std::make_unique<Transform>();
+            instance.m_Transform->SetPosition(glm::vec3(cachedNode.m_Position[0], cachedNode.m_Position[1], cachedNode.m_Position[2]));
+            instance.m_Transform->SetRotation(glm::quat(cachedNode.m_Rotation[3], cachedNode.m_Rotation[0], cachedNode.m_Rotation[1], cachedNode.m_Rotation[2]));
+            instance.m_Transform->SetScale(glm::vec3(cachedNode.m_Scale[0], cachedNode.m_Scale[1], cachedNode.m_Scale[2]));
+        }
+    }
+
+    BeginStreaming(a_Load, primitives);
+}
+
+void krt::ModelManager::BeginStreaming(StreamingLoad& a_Load, PrimitiveFutures& a_Primitives)
+{
+    auto& res = *a_Load.m_Resource;
+
+    a_Load.m_Timings.m_MaterialBuild.Measure([&]() { res.m_Materials = LoadMaterials(a_Load.m_MaterialEntries); });
+    res.m_LoadedTextures.resize(a_Load.m_Images.size());
+
+    // The futures are flattened so they can be polled in a single pass, each remembers the mesh it is handed to
+    for (uint32_t i = 0; i < a_Primitives.size(); i++)
+    {
+        res.m_Meshes.emplace_back(std::make_shared<Mesh>());
+
+        for (uint32_t j = 0; j < a_Primitives[i].size(); j++)
+        {
+            a_Load.m_Primitives.emplace_back(std::move(a_Primitives[i][j]));
+            a_Load.m_PrimitiveMeshes.push_back(i);
+            a_Load.m_PrimitiveIndices.push_back(j);
+        }
+    }
+
+    // Sized up front, the upload batches reference the decoded primitives until they are submitted
+    a_Load.m_DecodedPrimitives.resize(a_Load.m_Primitives.size());
+
+    res.m_Scenes = LoadScenes(a_Load.m_SceneNodes, res);
+}
+
+bool krt::ModelManager::StepLoad(StreamingLoad& a_Load, uint64_t& a_StagingBudget)
+{
+    PublishResidentBatches(a_Load);
+    StageDecodedData(a_Load, a_StagingBudget);
+
+    auto isTaken = [](auto& a_Future) { return !a_Future.valid(); };
+
+    // The cache only needs the decoded primitives, so it is written while the transfer queue is still busy with them
+    if (a_Load.m_Source && !a_Load.m_CacheWrite.valid() &&
+        std::all_of(a_Load.m_Primitives.begin(), a_Load.m_Primitives.end(), isTaken))
+    {
+        a_Load.m_CacheWrite = m_Services.m_ThreadPool->Enqueue([this, &a_Load]()
+        {
+            a_Load.m_Timings.m_CacheWrite.Measure([&]()
+            {
+                WriteCache(a_Load.m_Path, *a_Load.m_Source, a_Load.m_DecodedPrimitives, a_Load.m_SceneNodes, a_Load.m_Resource->m_Skeletons);
+            });
+        });
+    }
+
+    if (a_Load.m_NumPublished < a_Load.m_Images.size() + a_Load.m_Primitives.size())
+        return false;
+
+    a_Load.m_Resource->m_Resident = true;
+
+    if (a_Load.m_CacheWrite.valid() && a_Load.m_CacheWrite.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+        return false;
+
+    a_Load.m_Timings.Print(a_Load.m_Path, m_Services.m_ThreadPool->GetThreadCount(), std::chrono::steady_clock::now() - a_Load.m_Start);
+
+    return true;
+}
+
+void krt::ModelManager::StageDecodedData(StreamingLoad& a_Load, uint64_t& a_StagingBudget)
+{
+    if (a_StagingBudget == 0)
+        return;
+
+    auto isDecoded = [](auto& a_Future)
+    {
+        return a_Future.valid() && a_Future.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+    };
+
+    PendingBatch pending;
+    pending.m_Batch = std::make_shared<UploadBatch>(m_Services);
+    auto& batch = *pending.m_Batch;
+    batch.SetOwner(a_Load.m_Path);
+
+    // The pixels are only copied on submission, and released right after, as are the mappings of cached textures
+    std::vector<ImageData> decodedImages;
+
+    // Whatever is decoded is staged until the budget runs out. The last item may exceed it,
+    // otherwise an image larger than the budget would never be uploaded.
+    a_Load.m_Timings.m_Upload.Measure([&]()
+    {
+        for (uint32_t i = 0; i < a_Load.m_Images.size() && batch.GetStagingSize() < a_StagingBudget; i++)
+        {
+            if (!isDecoded(a_Load.m_Images[i]))
+                continue;
+
+            auto image = a_Load.m_Images[i].get();
+
+            // The image may have been registered since its job started, by another load or by an identical image of this one
+            auto shared = m_TextureRegistry.Share(image.m_Key, image.m_Path, image.m_Stamp);
+            if (shared)
+            {
+                a_Load.m_SharedTextures.push_back({ i, image.m_Key, std::move(shared) });
+                continue;
+            }
+
+            // Streamed textures start out with their coarse levels, and keep their texels around for the finer ones
+            auto& texels = image.m_Texels;
+            auto baseLevel = m_TextureStreamer.GetBaseLevel(texels);
+            std::vector<hlp::AccessorView> levels(texels.m_Levels.begin() + baseLevel, texels.m_Levels.end());
+
+            std::shared_ptr<Texture> texture = batch.CreateTexture(levels, hlp::GetMipDimensions(texels.m_Dimensions, baseLevel), texels.m_Format,
+                                                                   { EGraphicsQueue });
+            m_TextureRegistry.Add(image.m_Key, image.m_Path, image.m_Stamp, texture, pending.m_Batch);
+
+            if (baseLevel != 0)
+                m_TextureStreamer.Add(texture, std::move(texels));
+            else
+                decodedImages.push_back(std::move(image));
+
+            pending.m_Textures.emplace_back(i, std::move(texture));
+        }
+
+        for (uint32_t i = 0; i < a_Load.m_Primitives.size() && batch.GetStagingSize() < a_StagingBudget; i++)
+        {
+            if (!isDecoded(a_Load.m_Primitives[i]))
+                continue;
+
+            auto& data = a_Load.m_DecodedPrimitives[i] = a_Load.m_Primitives[i].get();
+            auto& primitive = pending.m_Primitives.emplace_back();
+            primitive.first = a_Load.m_PrimitiveMeshes[i];
+            primitive.second.m_Index = a_Load.m_PrimitiveIndices[i];
+            UploadPrimitive(data, *a_Load.m_Resource, batch, primitive.second);
+        }
+
+        if (pending.m_Textures.empty() && pending.m_Primitives.empty())
+            return;
+
+        a_StagingBudget -= std::min(a_StagingBudget, batch.GetStagingSize());
+        batch.Submit();
+    });
+
+    if (!pending.m_Textures.empty() || !pending.m_Primitives.empty())
+        a_Load.m_PendingBatches.push_back(std::move(pending));
+}
+
+void krt::ModelManager::PublishResidentBatches(StreamingLoad& a_Load)
+{
+    auto& res = *a_Load.m_Resource;
+
+    // The transfer queue finishes the batches in the order they were submitted in, so the first one that is not resident ends the search
+    auto iter = a_Load.m_PendingBatches.begin();
+    for (; iter != a_Load.m_PendingBatches.end() && iter->m_Batch->IsResident(); ++iter)
+    {
+        for (auto& texture : iter->m_Textures)
+        {
+            res.m_LoadedTextures[texture.first] = texture.second;
+            SetMaterialTextures(a_Load, texture.first, texture.second);
+        }
+
+        for (auto& primitive : iter->m_Primitives)
+        {
+            auto& mesh = *res.m_Meshes[primitive.first];
+            if (primitive.second.m_MorphTargets && mesh.m_MorphWeights.empty())
+                mesh.m_MorphWeights = primitive.second.m_MorphTargets->GetDefaultWeights();
+
+            mesh.m_Primitives.push_back(std::move(primitive.second));
+        }
+
+        a_Load.m_NumPublished += static_cast<uint32_t>(iter->m_Textures.size() + iter->m_Primitives.size());
+    }
+
+    a_Load.m_PendingBatches.erase(a_Load.m_PendingBatches.begin(), iter);
+
+    // Shared textures can be uploaded by any load, including this one, so they are checked independently of the batches above
+    for (auto shared = a_Load.m_SharedTextures.begin(); shared != a_Load.m_SharedTextures.end();)
+    {
+        if (!m_TextureRegistry.IsResident(shared->m_Key))
+        {
+            ++shared;
+            continue;
+        }
+
+        res.m_LoadedTextures[shared->m_Image] = shared->m_Texture;
+        SetMaterialTextures(a_Load, shared->m_Image, shared->m_Texture);
+        a_Load.m_NumPublished++;
+
+        shared = a_Load.m_SharedTextures.erase(shared);
+    }
+}
+
+std::unique_ptr<krt::ModelManager::StreamingLoad> krt::ModelManager::TakeFinishedLoad(GLTFResource& a_Res)
+{
+    // The file may still be streaming from an earlier asynchronous load, or from one that was just started
+    auto loadIter = std::find_if(m_StreamingLoads.begin(), m_StreamingLoads.end(),
+        [&a_Res](const std::unique_ptr<StreamingLoad>& a_Load) { return a_Load->m_Resource == &a_Res; });
+
+    if (loadIter == m_StreamingLoads.end())
+        return nullptr;
+
+    FinishLoad(**loadIter);
+
+    auto load = std::move(*loadIter);
+    m_StreamingLoads.erase(loadIter);
+    return load;
+}
+
+void krt::ModelManager::FinishLoad(StreamingLoad& a_Load)
+{
+    // With every job done before the first step, the remainder of the file is uploaded with a single submission
+    for (auto& image : a_Load.m_Images)
+    {
+        if (image.valid())
+            image.wait();
+    }
+
+    for (auto& primitive : a_Load.m_Primitives)
+    {
+        if (primitive.valid())
+            primitive.wait();
+    }
+
+    uint64_t budget = std::numeric_limits<uint64_t>::max();
+    while (!StepLoad(a_Load, budget))
+    {
+        for (auto& pending : a_Load.m_PendingBatches)
+            pending.m_Batch->WaitUntilResident();
+
+        // Batches of other loads are already submitted when their textures are shared, so this does not depend on them being updated
+        for (auto& shared : a_Load.m_SharedTextures)
+            m_TextureRegistry.WaitUntilResident(shared.m_Key);
+
+        if (a_Load.m_CacheWrite.valid())
+            a_Load.m_CacheWrite.wait();
+    }
+}
+
+void krt::ModelManager::WaitForWorkers(StreamingLoad& a_Load)
+{
+    for (auto& image : a_Load.m_Images)
+    {
+        if (image.valid())
+            image.wait();
+    }
+
+    for (auto& primitive : a_Load.m_Primitives)
+    {
+        if (primitive.valid())
+            primitive.wait();
+    }
+
+    if (a_Load.m_CacheWrite.valid())
+        a_Load.m_CacheWrite.wait();
+}
+
+void krt::ModelManager::WriteCache(const std::string& a_Path, const GltfSource& a_Source, const std::vector<PrimitiveData>& a_DecodedPrimitives,
+    const SceneNodes& a_SceneNodes, const std::vector<std::shared_ptr<const Skeleton>>& a_Skeletons)
+{
+    auto& doc = a_Source.GetDocument();
+    MeshCacheWriter writer(a_Source.GetRootPath(), m_VertexLayout, m_OptimizeMeshes);
+
+    try
+    {
+        // The source file itself covers the JSON and any data embedded in it, external buffers are hashed separately
+        writer.AddDependency(a_Path.substr(a_Path.find_last_of("/\\") + 1));
+        for (auto& buffer : doc.buffers)
+        {
+            if (!buffer.uri.empty() && !buffer.IsEmbeddedResource())
+                writer.AddDependency(buffer.uri);
+        }
+    }
+    catch (std::system_error& e)
+    {
+        printf("Failed to hash the source files of %s, no cache is written: %s\n", a_Path.c_str(), e.what());
+        return;
+    }
+
+    for (uint32_t i = 0; i < doc.images.size(); i++)
+    {
+        auto encoded = a_Source.GetImageData(i);
+        writer.AddImage(encoded.m_Data ? std::string() : doc.images[i].uri, encoded);
+    }
+
+    for (auto& material : DescribeMaterials(doc))
+        writer.AddMaterial(material);
+
+    // Primitives were decoded in the order of the meshes of the document
+    uint64_t primitiveIndex = 0;
+    for (auto& mesh : doc.meshes)
+    {
+        writer.BeginMesh();
+
+        for (size_t i = 0; i < mesh.primitives.size(); i++)
+        {
+            auto& data = a_DecodedPrimitives[primitiveIndex++];
+
+            hlp::AccessorView streams[MeshCache::EStreamCount];
+            streams[MeshCache::EPositions] = data.m_Positions;
+            streams[MeshCache::EInterleavedAttributes] = data.m_InterleavedAttributes;
+            streams[MeshCache::ETexCoords] = data.m_TexCoords;
+            streams[MeshCache::ENormals] = data.m_Normals;
+            streams[MeshCache::EColors] = data.m_Colors;
+            streams[MeshCache::ETangents] = data.m_Tangents;
+            streams[MeshCache::ESkinAttributes] = data.m_SkinAttributes;
+            streams[MeshCache::EIndices] = data.m_Indices;
+            streams[MeshCache::EMeshlets] = data.m_Meshlets;
+            streams[MeshCache::EMorphVertices] = data.m_MorphVertices;
+            streams[MeshCache::EMorphTargets] = data.m_MorphTargets;
+            streams[MeshCache::EMorphDeltas] = data.m_MorphDeltas;
+            streams[MeshCache::EMorphSlots] = data.m_MorphSlots;
+
+            writer.AddPrimitive(streams, data.m_BoundsMin, data.m_BoundsMax, data.m_Material);
+        }
+    }
+
+    for (auto& skeleton : a_Skeletons)
+        writer.AddSkin(skeleton);
+
+    for (auto& nodes : a_SceneNodes)
+    {
+        writer.BeginScene();
+
+        for (auto& node : nodes)
+            writer.AddNode(node.m_Mesh, node.m_Skin, *node.m_Transform);
+    }
+
+    if (!writer.Write(MeshCache::GetCachePath(a_Path)))
+        printf("Failed to write %s.\n", MeshCache::GetCachePath(a_Path).c_str());
+}
+
+std::vector<krt::ModelManager::ImageSource> krt::ModelManager::GetImageSources(const GltfSource& a_Source)
+{
+    auto& doc = a_Source.GetDocument();
+
+    std::vector<ImageSource> imageSources(doc.images.size());
+    for (uint32_t i = 0; i < doc.images.size(); i++)
+    {
+        imageSources[i].m_EncodedData = a_Source.GetImageData(i);
+        if (!imageSources[i].m_EncodedData.m_Data)
+            imageSources[i].m_Path = a_Source.GetRootPath() + "/" + doc.images[i].uri;
+    }
+
+    return imageSources;
+}
+
+std::vector<krt::MeshCache::MaterialEntry> krt::ModelManager::DescribeMaterials(const fx::gltf::Document& a_Doc)
+{
+    // Materials reference textures, which in turn reference the images that are loaded
+    auto getImage = [&a_Doc](const fx::gltf::Material::Texture& a_Texture)
+    {
+        return a_Texture.empty() ? -1 : a_Doc.textures[a_Texture.index].source;
+    };
+
+    std::vector<MeshCache::MaterialEntry> materials;
+    for (auto& material : a_Doc.materials)
+    {
+        auto& entry = materials.emplace_back();
+        memcpy(entry.m_BaseColorFactor, material.pbrMetallicRoughness.baseColorFactor.data(), sizeof(entry.m_BaseColorFactor));
+        entry.m_BaseColorImage = getImage(material.pbrMetallicRoughness.baseColorTexture);
+        entry.m_NormalImage = getImage(material.normalTexture);
+        entry.m_DoubleSided = material.doubleSided ? 1 : 0;
+    }
+
+    return materials;
+}
+
+void krt::ModelManager::DecodeImages(StreamingLoad& a_Load, std::vector<ImageSource> a_Images)
+{
+    for (auto& material : a_Load.m_MaterialEntries)
+    {
+        if (material.m_NormalImage >= 0)
+            a_Images[material.m_NormalImage].m_NormalMap = true;
+    }
+
+    a_Load.m_Images.resize(a_Images.size());
+
+    for (uint32_t i = 0; i < a_Images.size(); i++)
+    {
+        auto& imageSource = a_Images[i];
+
+        // Files that were loaded before are not even read, as long as the texture they were uploaded to is alive
+        if (!imageSource.m_Path.empty())
+        {
+            TextureRegistry::Key key;
+            auto texture = m_TextureRegistry.FindByPath(imageSource.m_Path, imageSource.m_NormalMap, key);
+            if (texture)
+            {
+                a_Load.m_SharedTextures.push_back({ i, key, std::move(texture) });
+                continue;
+            }
+        }
+
+        a_Load.m_Images[i] = m_Services.m_ThreadPool->Enqueue([imageSource, generateMipmaps = m_GenerateMipmaps,
+                                                               compressTextures = m_CompressTextures, &registry = m_TextureRegistry,
+                                                               &timings = a_Load.m_Timings]()
+        {
+            ImageData imageData;
+            imageData.m_Path = imageSource.m_Path;
+            auto& texels = imageData.m_Texels;
+
+            std::unique_ptr<MappedFile> file;
+            ByteSpan encodedData = imageSource.m_EncodedData;
+            const char* name = imageSource.m_Path.empty() ? "embedded in file" : imageSource.m_Path.c_str();
+
+            // Image files are mapped rather than read by stb, so their bytes can be hashed for the texture cache as well
+            if (!imageSource.m_Path.empty())
+            {
+                TextureRegistry::GetFileStamp(imageSource.m_Path, imageData.m_Stamp);
+
+                try
+                {
+                    file = std::make_unique<MappedFile>(imageSource.m_Path);
+                }
+                catch (const std::system_error& a_Error)
+                {
+                    printf("Failed to load image %s: %s\n", name, a_Error.what());
+                    abort();
+                }
+
+                encodedData = { file->GetData(), file->GetSize() };
+            }
+
+            imageData.m_Key.m_Hash = MeshCache::HashBytes(encodedData.m_Data, encodedData.m_Size);
+            imageData.m_Key.m_NormalMap = imageSource.m_NormalMap;
+
+            // Identical images are uploaded once. Two of them can still be decoded at the same time, the second is dropped when it is staged.
+            imageData.m_SharedTexture = registry.Find(imageData.m_Key);
+            if (imageData.m_SharedTexture)
+                return imageData;
+
+            std::string cachePath;
+            if (compressTextures)
+            {
+                timings.m_TextureCache.Measure([&]()
+                {
+                    cachePath = GetTextureCachePath(imageData.m_Key);
+                    texels.m_CachedFile = Ktx2File::Open(cachePath);
+
+                    // A texture cached without mip maps is only reused while they are disabled, and the other way around
+                    if (texels.m_CachedFile)
+                    {
+                        auto dimensions = texels.m_CachedFile->GetDimensions();
+                        if (texels.m_CachedFile->GetNumMips() != (generateMipmaps ? hlp::GetMipCount(dimensions) : 1))
+                            texels.m_CachedFile.reset();
+                    }
+                });
+
+                if (texels.m_CachedFile)
+                {
+                    texels.m_Levels = texels.m_CachedFile->GetLevels();
+                    texels.m_Format = texels.m_CachedFile->GetVkFormat();
+                    texels.m_Dimensions = texels.m_CachedFile->GetDimensions();
+                    return imageData;
+                }
+            }
+
+            stbi_uc* pixels;
+
+            timings.m_ImageDecode.Measure([&]()
+            {
+                int width, height, channels;
+                pixels = stbi_load_from_memory(encodedData.m_Data, static_cast<int>(encodedData.m_Size), &width, &height, &channels, STBI_rgb_alpha);
+
+                if (!pixels)
+                {
+                    printf("Failed to load image %s: %s\n", name, stbi_failure_reason());
+                    abort();
+                }
+
+                texels.m_Dimensions = glm::uvec2(static_cast<uint32_t>(width), static_cast<uint32_t>(height));
+            });
+
+            file.reset();
+
+            // The full resolution image is copied into the chain either way, so the pixels of stb can be released right away
+            uint32_t numMips = 1;
+            timings.m_MipGeneration.Measure([&]()
+            {
+                if (generateMipmaps)
+                {
+                    texels.m_Pixels = hlp::GenerateMipChain(pixels, texels.m_Dimensions);
+                    numMips = hlp::GetMipCount(texels.m_Dimensions);
+                }
+                else
+                {
+                    texels.m_Pixels.assign(pixels, pixels + static_cast<uint64_t>(texels.m_Dimensions.x) * texels.m_Dimensions.y * 4);
+                }
+            });
+
+            stbi_image_free(pixels);
+            texels.m_Format = VK_FORMAT_R8G8B8A8_UNORM;
+
+            if (compressTextures)
+            {
+                // Normal maps only keep X and Y, the shader reconstructs Z. Color textures only pay for alpha if they use it.
+                timings.m_TextureCompression.Measure([&]()
+                {
+                    if (imageSource.m_NormalMap)
+                        texels.m_Format = VK_FORMAT_BC5_UNORM_BLOCK;
+                    else if (hlp::HasTransparency(texels.m_Pixels.data(), static_cast<uint64_t>(texels.m_Dimensions.x) * texels.m_Dimensions.y))
+                        texels.m_Format = VK_FORMAT_BC3_UNORM_BLOCK;
+                    else
+                        texels.m_Format = VK_FORMAT_BC1_RGB_UNORM_BLOCK;
+
+                    texels.m_Pixels = hlp::CompressMipChain(texels.m_Pixels.data(), texels.m_Dimensions, numMips, texels.m_Format);
+                });
+            }
+
+            texels.m_Levels = hlp::GetMipLevels(texels.m_Pixels.data(), texels.m_Format, texels.m_Dimensions, numMips);
+
+            if (compressTextures)
+            {
+                timings.m_TextureCache.Measure([&]()
+                {
+                    if (!Ktx2File::Write(cachePath, texels.m_Format, texels.m_Dimensions, texels.m_Levels))
+                        printf("Failed to write %s.\n", cachePath.c_str());
+                });
+            }
+
+            return imageData;
+        });
+    }
+}
+
+std::string krt::ModelManager::GetTextureCachePath(const TextureRegistry::Key& a_Key)
+{
+    char name[64];
+    snprintf(name, sizeof(name), "/%016" PRIx64 "-%s-v%u.ktx2", a_Key.m_Hash, a_Key.m_NormalMap ? "normal" : "color", TextureCacheVersion);
+
+    return TextureCacheDirectory + std::string(name);
+}
+
+krt::ModelManager::PrimitiveFutures krt::ModelManager::DecodePrimitives(const GltfSource& a_Source, ImportTimings& a_Timings)
+{
+    auto& doc = a_Source.GetDocument();
+
+    PrimitiveFutures primitives(doc.meshes.size());
+
+    for (size_t i = 0; i < doc.meshes.size(); i++)
+    {
+        auto& fxMesh = doc.meshes[i];
+
+        for (auto& fxPrimitive : fxMesh.primitives)
+        {
+            primitives[i].emplace_back(m_Services.m_ThreadPool->Enqueue([&a_Source, &fxMesh, &fxPrimitive, layout = m_VertexLayout,
+                                                                              optimize = m_OptimizeMeshes, &a_Timings]()
+            {
+                return DecodePrimitive(a_Source, fxMesh, fxPrimitive, layout, optimize, a_Timings);
+            }));
+        }
+    }
+
+    return primitives;
+}
+
+krt::ModelManager::PrimitiveFutures krt::ModelManager::ReadCachedPrimitives(const MeshCache& a_Cache)
+{
+    auto cachedMeshes = a_Cache.GetEntries<MeshCache::MeshEntry>(MeshCache::EMeshes);
+    auto cachedPrimitives = a_Cache.GetEntries<MeshCache::PrimitiveEntry>(MeshCache::EPrimitives);
+
+    PrimitiveFutures primitives(a_Cache.GetCount(MeshCache::EMeshes));
+
+    // The streams are final and only need to be copied from the mapped cache into staging memory,
+    // so they are handed out as futures which are ready from the start
+    for (uint64_t i = 0; i < primitives.size(); i++)
+    {
+        for (uint32_t j = 0; j < cachedMeshes[i].m_NumPrimitives; j++)
+        {
+            auto& cachedPrimitive = cachedPrimitives[cachedMeshes[i].m_FirstPrimitive + j];
+
+            PrimitiveData data;
+            data.m_Positions = a_Cache.GetStream(cachedPrimitive, MeshCache::EPositions);
+            data.m_InterleavedAttributes = a_Cache.GetStream(cachedPrimitive, MeshCache::EInterleavedAttributes);
+            data.m_TexCoords = a_Cache.GetStream(cachedPrimitive, MeshCache::ETexCoords);
+            data.m_Normals = a_Cache.GetStream(cachedPrimitive, MeshCache::ENormals);
+            data.m_Colors = a_Cache.GetStream(cachedPrimitive, MeshCache::EColors);
+            data.m_Tangents = a_Cache.GetStream(cachedPrimitive, MeshCache::ETangents);
+            data.m_SkinAttributes = a_Cache.GetStream(cachedPrimitive, MeshCache::ESkinAttributes);
+            data.m_Indices = a_Cache.GetStream(cachedPrimitive, MeshCache::EIndices);
+            data.m_Meshlets = a_Cache.GetStream(cachedPrimitive, MeshCache::EMeshlets);
+            data.m_MorphVertices = a_Cache.GetStream(cachedPrimitive, MeshCache::EMorphVertices);
+            data.m_MorphTargets = a_Cache.GetStream(cachedPrimitive, MeshCache::EMorphTargets);
+            data.m_MorphDeltas = a_Cache.GetStream(cachedPrimitive, MeshCache::EMorphDeltas);
+            data.m_MorphSlots = a_Cache.GetStream(cachedPrimitive, MeshCache::EMorphSlots);
+            data.m_BoundsMin = glm::vec3(cachedPrimitive.m_BoundsMin[0], cachedPrimitive.m_BoundsMin[1], cachedPrimitive.m_BoundsMin[2]);
+            data.m_BoundsMax = glm::vec3(cachedPrimitive.m_BoundsMax[0], cachedPrimitive.m_BoundsMax[1], cachedPrimitive.m_BoundsMax[2]);
+            data.m_Material = cachedPrimitive.m_Material;
+
+            std::promise<PrimitiveData> promise;
+            promise.set_value(std::move(data));
+            primitives[i].emplace_back(promise.get_future());
+        }
+    }
+
+    return primitives;
+}
+
+krt::ModelManager::PrimitiveData krt::ModelManager::DecodePrimitive(const GltfSource& a_Source, const fx::gltf::Mesh& a_Mesh,
+    const fx::gltf::Primitive& a_Primitive, EVertexLayout a_VertexLayout, bool a_Optimize, ImportTimings& a_Timings)
+{
+    PrimitiveData data;
+    data.m_Material = a_Primitive.material;
+
+    a_Timings.m_AccessorDecode.Measure([&]()
+    {
+        // The views point straight into the (mapped) glTF buffers, the data is only copied once it is written to staging memory
+        for (auto& attribute : a_Primitive.attributes)
+        {
+            if (attribute.first == "POSITION")
+                data.m_Positions = a_Source.GetAccessor(attribute.second);
+            else if (attribute.first == "TEXCOORD_0")
+                data.m_TexCoords = a_Source.GetAccessor(attribute.second);
+            else if (attribute.first == "COLOR_0")
+                data.m_Colors = a_Source.GetAccessor(attribute.second);
+            else if (attribute.first == "NORMAL")
+                data.m_Normals = a_Source.GetAccessor(attribute.second);
+            else if (attribute.first == "TANGENT")
+                data.m_Tangents = a_Source.GetAccessor(attribute.second);
+            else if (attribute.first == "JOINTS_0")
+                data.m_Joints = a_Source.GetAccessor(attribute.second);
+            else if (attribute.first == "WEIGHTS_0")
+                data.m_Weights = a_Source.GetAccessor(attribute.second);
+        }
+
+        for (auto& target : a_Primitive.targets)
+        {
+            for (auto* name : { "POSITION", "NORMAL", "TANGENT" })
+            {
+                auto attribute = target.find(name);
+                data.m_TargetStreams.push_back(attribute != target.end() ? a_Source.GetAccessor(attribute->second) : hlp::AccessorView());
+            }
+        }
+
+        data.m_Indices = a_Source.GetAccessor(a_Primitive.indices);
+
+        // Vulkan 1.0 has no 8 bit index type, so those are widened to 16 bit
+        if (data.m_Indices.GetElementSize() == 1)
+        {
+            data.m_WidenedIndices.resize(data.m_Indices.Size());
+            for (uint64_t i = 0; i < data.m_Indices.Size(); i++)
+                data.m_WidenedIndices[i] = data.m_Indices.Get<uint8_t>(i);
+
+            data.m_Indices = hlp::AccessorView::FromVector(data.m_WidenedIndices);
+        }
+
+        data.m_BoundsMin = glm::vec3(data.m_Positions.Empty() ? 0.0f : std::numeric_limits<float>::max());
+        data.m_BoundsMax = glm::vec3(data.m_Positions.Empty() ? 0.0f : std::numeric_limits<float>::lowest());
+        for (uint64_t i = 0; i < data.m_Positions.Size(); i++)
+        {
+            auto position = data.m_Positions.Get<glm::vec3>(i);
+            data.m_BoundsMin = glm::min(data.m_BoundsMin, position);
+            data.m_BoundsMax = glm::max(data.m_BoundsMax, position);
+        }
+    });
+
+    // Runs before any attributes are generated, so the generated ones do not need remapping
+    if (a_Optimize && a_Primitive.mode == fx::gltf::Primitive::Mode::Triangles)
+        OptimizePrimitive(data, a_Timings);
+
+    if (!data.m_Joints.Empty() || !data.m_Weights.Empty())
+        a_Timings.m_AccessorDecode.Measure([&]() { PackSkinAttributes(data); });
+
+    // The deltas are gathered once the vertices are in their final order, which the optimization pass remapped them to as well
+    if (!data.m_TargetStreams.empty())
+    {
+        a_Timings.m_AccessorDecode.Measure([&]()
+        {
+            auto& morph = data.m_GeneratedMorphTargets = hlp::BuildMorphTargets(data.m_Positions.Size(), data.m_TargetStreams, a_Mesh.weights);
+            data.m_TargetStreams.clear();
+
+            if (!morph.m_Vertices.empty())
+            {
+                data.m_MorphVertices = hlp::AccessorView::FromVector(morph.m_Vertices);
+                data.m_MorphTargets = hlp::AccessorView::FromVector(morph.m_Targets);
+                data.m_MorphDeltas = hlp::AccessorView::FromVector(morph.m_Deltas);
+                data.m_MorphSlots = hlp::AccessorView::FromVector(morph.m_Slots);
+            }
+        });
+    }
+
+    // The quantized layout draws primitives without colors with a constant color instead
+    if (data.m_Colors.Empty() && a_VertexLayout != EQuantizedVertexAttributes)
+    {
+        a_Timings.m_AccessorDecode.Measure([&]()
+        {
+            data.m_GeneratedColors.resize(data.m_Positions.Size(), glm::vec4(1.0f));
+            data.m_Colors = hlp::AccessorView::FromVector(data.m_GeneratedColors);
+        });
+    }
+
+    if (data.m_Tangents.Empty())
+    {
+        a_Timings.m_TangentGeneration.Measure([&]()
+        {
+            auto indices = UnpackIndices(data.m_Indices);
+            data.m_GeneratedTangents = hlp::GenerateTangents(data.m_Positions, data.m_Normals, data.m_TexCoords, indices);
+            data.m_Tangents = hlp::AccessorView::FromVector(data.m_GeneratedTangents);
+        });
+    }
 
-#include "FX-GLTF/gltf.h"
-#include <glm/vec2.hpp>
-#include <glm/vec3.hpp>
-#include <glm/gtx/matrix_decompose.hpp>
+    // Meshlets are built from the final indices, and do not depend on the vertex layout
+    if (a_Primitive.mode == fx::gltf::Primitive::Mode::Triangles && !data.m_Indices.Empty())
+    {
+        a_Timings.m_MeshletBuild.Measure([&]()
+        {
+            data.m_GeneratedMeshlets = hlp::BuildMeshlets(UnpackIndices(data.m_Indices), data.m_Positions);
+            data.m_Meshlets = hlp::AccessorView::FromVector(data.m_GeneratedMeshlets);
+        });
+    }
 
+    if (a_VertexLayout == EInterleavedVertexAttributes)
+        a_Timings.m_AccessorDecode.Measure([&]() { InterleaveAttributes(data); });
+    else if (a_VertexLayout == EQuantizedVertexAttributes)
+        a_Timings.m_AccessorDecode.Measure([&]() { QuantizeAttributes(data); });
 
-krt::ModelManager::ModelManager(ServiceLocator& a_Services)
-    : m_Services(a_Services)
+    return data;
+}
+
+void krt::ModelManager::OptimizePrimitive(PrimitiveData& a_Data, ImportTimings& a_Timings)
 {
-    Sampler::CreateInfo info = Sampler::CreateInfo::CreateDefault();
-    m_DefaultSampler = std::make_unique<Sampler>(m_Services, info);
+    using ComponentType = fx::gltf::Accessor::ComponentType;
 
-    auto& commandBuffer = m_Services.m_LogicalDevice->GetCommandQueue(ETransferQueue).GetSingleUseCommandBuffer();
-    commandBuffer.Begin();
+    auto numVertices = a_Data.m_Positions.Size();
+    if (numVertices == 0 || a_Data.m_Positions.GetComponentType() != ComponentType::Float ||
+        a_Data.m_Positions.GetElementSize() != sizeof(glm::vec3))
+    {
+        return;
+    }
 
-    m_DefaultDiffuse = commandBuffer.CreateTextureFromFile("../../../../Assets/Textures/DiffuseDefault.png", { EGraphicsQueue });
+    std::vector<hlp::AccessorView*> attributes = { &a_Data.m_TexCoords, &a_Data.m_Colors, &a_Data.m_Normals, &a_Data.m_Tangents,
+                                                   &a_Data.m_Joints, &a_Data.m_Weights };
 
-    glm::vec4 defNormal(0.5f, 0.5f, 1.0f, 1.0f);
+    // Vertices that only differ in the deltas of a morph target are not welded, and the deltas move along with their vertices
+    for (auto& stream : a_Data.m_TargetStreams)
+        attributes.push_back(&stream);
 
-    m_DefaultNormalMap = commandBuffer.CreateTexture(&defNormal[0], glm::uvec2(1, 1), 4, 1, { EGraphicsQueue });
+    std::vector<hlp::AccessorView> streams = { a_Data.m_Positions };
+    for (auto* attribute : attributes)
+    {
+        if (attribute->Empty())
+            continue;
 
-    commandBuffer.Submit();
+        if (attribute->Size() != numVertices)
+            return;
 
-}
+        streams.push_back(*attribute);
+    }
 
-krt::ModelManager::~ModelManager()
-{
+    // Non-indexed primitives are turned into indexed ones, welding takes care of the duplicates
+    std::vector<uint32_t> indices;
+    if (a_Data.m_Indices.Empty())
+    {
+        indices.resize(numVertices);
+        std::iota(indices.begin(), indices.end(), 0);
+    }
+    else
+    {
+        indices = UnpackIndices(a_Data.m_Indices);
+    }
+
+    // A malformed primitive may end in a partial triangle, which is dropped. One without a whole triangle is left as it is.
+    if (indices.size() < 3)
+        return;
+    indices.resize(indices.size() / 3 * 3);
+
+    auto positions = a_Data.m_Positions.ToVector<glm::vec3>();
+
+    hlp::MeshStatistics before;
+    a_Timings.m_MeshAnalysis.Measure([&]() { before = hlp::AnalyzeMesh(indices, positions); });
+
+    std::vector<uint32_t> remap;
+    uint32_t newVertexCount = 0;
+
+    a_Timings.m_MeshOptimization.Measure([&]()
+    {
+        std::vector<uint32_t> weldRemap;
+        uint32_t numUnique = hlp::WeldVertices(streams, numVertices, weldRemap);
+        hlp::RemapIndices(indices, weldRemap);
+        positions = hlp::RemapVertices(positions, weldRemap, numUnique);
+        hlp::RemoveDegenerateTriangles(indices);
+
+        hlp::OptimizeVertexCache(indices, numUnique);
+        hlp::OptimizeOverdraw(indices, positions, 1.05f);
+
+        std::vector<uint32_t> fetchRemap;
+        newVertexCount = hlp::OptimizeVertexFetch(indices, numUnique, fetchRemap);
+        hlp::RemapIndices(indices, fetchRemap);
+        positions = hlp::RemapVertices(positions, fetchRemap, newVertexCount);
+
+        // Both remaps are applied to the source streams in a single gather
+        remap.resize(numVertices);
+        for (uint64_t i = 0; i < numVertices; i++)
+            remap[i] = fetchRemap[weldRemap[i]];
+
+        a_Data.m_OptimizedPositions = std::move(positions);
+        a_Data.m_Positions = hlp::AccessorView::FromVector(a_Data.m_OptimizedPositions);
+
+        for (auto* attribute : attributes)
+        {
+            if (attribute->Empty())
+                continue;
+
+            auto& stream = a_Data.m_OptimizedStreams.emplace_back(hlp::RemapVertices(*attribute, remap, newVertexCount));
+            *attribute = hlp::AccessorView(stream.data(), newVertexCount, attribute->GetElementSize(), attribute->GetElementSize(),
+                                           attribute->GetComponentType());
+        }
+
+        if (newVertexCount <= std::numeric_limits<uint16_t>::max() + 1u)
+        {
+            a_Data.m_NarrowedIndices.assign(indices.begin(), indices.end());
+            a_Data.m_Indices = hlp::AccessorView::FromVector(a_Data.m_NarrowedIndices);
+        }
+        else
+        {
+            a_Data.m_OptimizedIndices = std::move(indices);
+            a_Data.m_Indices = hlp::AccessorView::FromVector(a_Data.m_OptimizedIndices);
+        }
+
+        // Superseded by the narrowed indices
+        a_Data.m_WidenedIndices = std::vector<uint16_t>();
+    });
+
+    hlp::MeshStatistics after;
+    a_Timings.m_MeshAnalysis.Measure([&]()
+    {
+        after = hlp::AnalyzeMesh(UnpackIndices(a_Data.m_Indices), a_Data.m_OptimizedPositions);
+    });
+
+    a_Timings.AddMeshStatistics(before, after);
 }
 
-krt::ModelManager::GLTFResource* krt::ModelManager::LoadGltf(std::string a_Path)
+void krt::ModelManager::InterleaveAttributes(PrimitiveData& a_Data)
 {
-    auto findIter = m_LoadedGLTFs.find(a_Path);
+    using ComponentType = fx::gltf::Accessor::ComponentType;
 
-    if (findIter != m_LoadedGLTFs.end())
-        return &(*findIter).second;
+    // Missing attributes keep the defaults the separate streams would have used
+    Mesh::InterleavedVertex defaultVertex;
+    defaultVertex.m_TexCoord = glm::vec2(0.0f);
+    defaultVertex.m_Color = glm::vec4(1.0f);
+    defaultVertex.m_Normal = glm::vec3(0.0f);
+    defaultVertex.m_Tangent = glm::vec4(1.0f, 0.0f, 0.0f, 1.0f);
 
-    auto& res = m_LoadedGLTFs[a_Path];
+    auto numVertices = a_Data.m_Positions.Size();
+    a_Data.m_InterleavedVertices.assign(numVertices, defaultVertex);
+
+    auto* vertices = reinterpret_cast<uint8_t*>(a_Data.m_InterleavedVertices.data());
 
-    auto doc = fx::gltf::LoadFromText(a_Path);
+    auto interleave = [&](hlp::AccessorView& a_View, size_t a_Offset, size_t a_Size, const char* a_Name)
+    {
+        // Only float attributes fit the vertex format, RGB colors leave the default alpha in place
+        if (a_View.Size() == numVertices && a_View.GetComponentType() == ComponentType::Float && a_View.GetElementSize() <= a_Size)
+            a_View.CopyTo(vertices + a_Offset, sizeof(Mesh::InterleavedVertex));
+        else if (!a_View.Empty())
+            printf("Skipping %s, its format can not be interleaved.\n", a_Name);
+
+        a_View = hlp::AccessorView();
+    };
 
-    res.m_LoadedTextures = LoadTextures(doc, a_Path);
-    res.m_Materials = LoadMaterials(doc, res);
-    res.m_Meshes = LoadMeshes(doc, res);
-    res.m_Scenes = LoadScenes(doc, res);
+    interleave(a_Data.m_TexCoords, offsetof(Mesh::InterleavedVertex, m_TexCoord), sizeof(glm::vec2), "texture coordinates");
+    interleave(a_Data.m_Colors, offsetof(Mesh::InterleavedVertex, m_Color), sizeof(glm::vec4), "vertex colors");
+    interleave(a_Data.m_Normals, offsetof(Mesh::InterleavedVertex, m_Normal), sizeof(glm::vec3), "normals");
+    interleave(a_Data.m_Tangents, offsetof(Mesh::InterleavedVertex, m_Tangent), sizeof(glm::vec4), "tangents");
 
-    return& res;
+    // The separate streams are no longer referenced
+    a_Data.m_GeneratedColors = std::vector<glm::vec4>();
+    a_Data.m_GeneratedTangents = std::vector<glm::vec4>();
+
+    a_Data.m_InterleavedAttributes = hlp::AccessorView::FromVector(a_Data.m_InterleavedVertices);
 }
 
-std::vector<std::shared_ptr<krt::Mesh>> krt::ModelManager::LoadMeshes(fx::gltf::Document& a_Doc, krt::ModelManager::GLTFResource& a_Res)
+void krt::ModelManager::QuantizeAttributes(PrimitiveData& a_Data)
 {
-    std::vector<std::shared_ptr<krt::Mesh>> meshes;
+    auto numVertices = a_Data.m_Positions.Size();
+
+    // Attributes of any float or normalized integer type are accepted, missing ones get the same defaults as the float layouts.
+    // A missing normal becomes +Z instead of zero, as a zero vector has no octahedral encoding.
+    bool hasTexCoords = a_Data.m_TexCoords.Size() == numVertices;
+    bool hasNormals = a_Data.m_Normals.Size() == numVertices;
+    bool hasTangents = a_Data.m_Tangents.Size() == numVertices;
 
-    for (auto& fxMesh : a_Doc.meshes)
+    a_Data.m_QuantizedVertices.resize(numVertices);
+
+    for (uint64_t i = 0; i < numVertices; i++)
     {
-        auto& mesh = meshes.emplace_back(std::make_shared<Mesh>());
+        glm::vec4 texCoord = hasTexCoords ? hlp::ReadNormalized(a_Data.m_TexCoords, i, glm::vec4(0.0f)) : glm::vec4(0.0f);
+        glm::vec4 normal = hasNormals ? hlp::ReadNormalized(a_Data.m_Normals, i, glm::vec4(0.0f)) : glm::vec4(0.0f, 0.0f, 1.0f, 0.0f);
+        glm::vec4 tangent = hasTangents ? hlp::ReadNormalized(a_Data.m_Tangents, i, glm::vec4(1.0f)) : glm::vec4(1.0f, 0.0f, 0.0f, 1.0f);
+
+        auto& vertex = a_Data.m_QuantizedVertices[i];
+        vertex.m_TexCoord = hlp::EncodeHalf2(glm::vec2(texCoord));
+        vertex.m_Normal = hlp::EncodeOctahedral(glm::vec3(normal));
+        vertex.m_Tangent = hlp::EncodeTangent(tangent);
+    }
 
-        std::vector<uint8_t> positionsData, texData;
+    if (a_Data.m_Colors.Size() == numVertices)
+    {
+        a_Data.m_QuantizedColors.resize(numVertices);
+        for (uint64_t i = 0; i < numVertices; i++)
+            a_Data.m_QuantizedColors[i] = hlp::EncodeUnorm8(hlp::ReadNormalized(a_Data.m_Colors, i, glm::vec4(1.0f)));
 
-        for (auto& fxPrimitive : fxMesh.primitives)
-        {
-            auto& prim = mesh->m_Primitives.emplace_back();
-            for (auto& attribute : fxPrimitive.attributes)
-            {
-                if (attribute.first == "POSITION")
-                {
-                    positionsData = LoadRawData(a_Doc, attribute.second);
-                    prim.m_Positions = MakeVertexBuffer(positionsData, static_cast<uint32_t>(sizeof(glm::vec3)));
-                }
-                else if (attribute.first == "TEXCOORD_0")
-                {
-                    texData = LoadRawData(a_Doc, attribute.second);
-                    prim.m_TexCoords = MakeVertexBuffer(texData, static_cast<uint32_t>(sizeof(glm::vec2)));
-                }
-                else if (attribute.first == "COLOR_0")
-                {
-                    prim.m_VertexColors = LoadVertexBuffer<glm::vec4>(a_Doc, attribute.second);
-                }
-                else if (attribute.first == "NORMAL")
-                {
-                    prim.m_Normals = LoadVertexBuffer<glm::vec3>(a_Doc, attribute.second);
-                }
-                else if (attribute.first == "TANGENT")
-                {
-                    prim.m_Tangents = LoadVertexBuffer<glm::vec4>(a_Doc, attribute.second);
-                }
-            }
-            prim.m_IndexBuffer = LoadIndexBuffer(a_Doc, fxPrimitive.indices);
+        a_Data.m_Colors = hlp::AccessorView::FromVector(a_Data.m_QuantizedColors);
+    }
+    else
+    {
+        a_Data.m_Colors = hlp::AccessorView();
+    }
 
-            prim.m_Material = a_Res.m_Materials[fxPrimitive.material];
+    a_Data.m_TexCoords = hlp::AccessorView();
+    a_Data.m_Normals = hlp::AccessorView();
+    a_Data.m_Tangents = hlp::AccessorView();
+    a_Data.m_GeneratedTangents = std::vector<glm::vec4>();
 
-            if (!prim.m_Tangents)
-            {
-                auto indices = LoadIndices(a_Doc, fxPrimitive.indices);
-                prim.m_Tangents = GenerateTangents(positionsData, texData, indices);
-            }
+    a_Data.m_InterleavedAttributes = hlp::AccessorView::FromVector(a_Data.m_QuantizedVertices);
+}
 
-            if (!prim.m_VertexColors)
-            {
-                std::vector<float> colors = std::vector<float>(prim.m_Positions->GetElementCount() * 4, 1.0f);
-                std::vector<uint8_t> bytes = std::vector<uint8_t>(colors.size() * sizeof(float));
+void krt::ModelManager::PackSkinAttributes(PrimitiveData& a_Data)
+{
+    using ComponentType = fx::gltf::Accessor::ComponentType;
+
+    auto numVertices = a_Data.m_Positions.Size();
+
+    // Joints are four unsigned bytes or shorts
+    bool byteJoints = a_Data.m_Joints.GetElementSize() == sizeof(glm::u8vec4);
+    bool validJoints = a_Data.m_Joints.Size() == numVertices && (byteJoints || a_Data.m_Joints.GetElementSize() == sizeof(glm::u16vec4));
 
-                memcpy(bytes.data(), colors.data(), bytes.size());
+    if (!validJoints || a_Data.m_Weights.Size() != numVertices)
+    {
+        printf("Skipping the skin of a primitive, its joints and weights do not match its vertices.\n");
+    }
+    else
+    {
+        a_Data.m_SkinVertices.resize(numVertices);
 
-                prim.m_VertexColors = MakeVertexBuffer(bytes, static_cast<uint32_t>(sizeof(glm::vec4)));
+        for (uint64_t i = 0; i < numVertices; i++)
+        {
+            auto& vertex = a_Data.m_SkinVertices[i];
+            if (byteJoints)
+                vertex.m_Joints = glm::u16vec4(a_Data.m_Joints.Get<glm::u8vec4>(i));
+            else
+                vertex.m_Joints = a_Data.m_Joints.Get<glm::u16vec4>(i);
+
+            // Exporters do not always normalize the weights, and rounding would otherwise leave them off by a few units
+            glm::vec4 weights = glm::max(hlp::ReadNormalized(a_Data.m_Weights, i, glm::vec4(0.0f)), glm::vec4(0.0f));
+            float sum = weights.x + weights.y + weights.z + weights.w;
+            weights = sum > 0.0f ? weights / sum : glm::vec4(1.0f, 0.0f, 0.0f, 0.0f);
+
+            glm::u16vec4 quantized = glm::u16vec4(glm::round(weights * 65535.0f));
+            uint32_t largest = 0;
+            int32_t remainder = 65535;
+            for (uint32_t j = 0; j < 4; j++)
+            {
+                remainder -= quantized[j];
+                if (quantized[j] > quantized[largest])
+                    largest = j;
             }
+
+            quantized[largest] = static_cast<uint16_t>(quantized[largest] + remainder);
+            vertex.m_Weights = quantized;
         }
+
+        a_Data.m_SkinAttributes = hlp::AccessorView(a_Data.m_SkinVertices.data(), numVertices, sizeof(Mesh::SkinVertex),
+                                                    sizeof(Mesh::SkinVertex), ComponentType::UnsignedShort);
     }
 
-    return meshes;
+    a_Data.m_Joints = hlp::AccessorView();
+    a_Data.m_Weights = hlp::AccessorView();
 }
 
-std::vector<std::shared_ptr<krt::Scene>> krt::ModelManager::LoadScenes(fx::gltf::Document& a_Doc, GLTFResource& a_Res)
+krt::ModelManager::SceneNodes krt::ModelManager::TraverseScenes(const fx::gltf::Document& a_Doc)
 {
-    std::vector<std::shared_ptr<krt::Scene>> scenes;
-    for (auto& fxScene : a_Doc.scenes)
-    {
-        auto& scene = scenes.emplace_back(std::make_shared<Scene>(m_Services));
+    SceneNodes sceneNodes(a_Doc.scenes.size());
 
+    for (size_t i = 0; i < a_Doc.scenes.size(); i++)
+    {
         Transform identity;
 
-        for (auto& node : fxScene.nodes)
+        for (auto& node : a_Doc.scenes[i].nodes)
         {
-            LoadNode(a_Doc, a_Res, node, identity, *scene);
+            LoadNode(a_Doc, node, identity, sceneNodes[i]);
         }
     }
 
-    return scenes;
+    return sceneNodes;
 }
 
-std::unique_ptr<krt::VertexBuffer> krt::ModelManager::GenerateTangents(std::vector<uint8_t>& a_PositionData,
-    std::vector<uint8_t>& a_TexData, std::vector<uint32_t>& a_Indices)
+void krt::ModelManager::UploadPrimitive(const PrimitiveData& a_Data, const GLTFResource& a_Res, UploadBatch& a_Batch,
+    Mesh::Primitive& a_Primitive)
 {
-    auto positions = hlp::VectorView<glm::vec3, uint8_t>(a_PositionData);
-    auto tex = hlp::VectorView<glm::vec2, uint8_t>(a_TexData);
+    auto& prim = a_Primitive;
 
-    std::vector<glm::vec4> tangents(positions.Size());
+    // The order of the uploads matches the order of the streams in the mesh cache, so the staging copies read it front to back
+    prim.m_Positions = a_Batch.CreateVertexBuffer(a_Data.m_Positions, { EGraphicsQueue });
 
-    if (!a_Indices.empty())
+    if (!a_Data.m_InterleavedAttributes.Empty())
     {
-        for (size_t i = 0; i < a_Indices.size(); i += 3)
-        {
-            auto tangent = glm::vec4(1.0f);
-
-            uint32_t i1 = a_Indices[i + 0];
-            uint32_t i2 = a_Indices[i + 1];
-            uint32_t i3 = a_Indices[i + 2];
-
-            glm::vec3 p1 = *positions[i1];
-            glm::vec3 p2 = *positions[i2];
-            glm::vec3 p3 = *positions[i3];
-            glm::vec2 uv1 = *tex[i1];
-            glm::vec2 uv2 = *tex[i2];
-            glm::vec2 uv3 = *tex[i3];
+        prim.m_InterleavedAttributes = a_Batch.CreateVertexBuffer(a_Data.m_InterleavedAttributes, { EGraphicsQueue });
 
-            glm::vec3 edge1 = p2 - p1;
-            glm::vec3 edge2 = p3 - p1;
-            glm::vec2 deltaUV1 = uv2 - uv1;
-            glm::vec2 deltaUV2 = uv3 - uv1;
-
-            float f = 1.0f / (deltaUV1.x * deltaUV2.y - deltaUV2.x * deltaUV1.y);
-
-            tangent.x = f * (deltaUV2.y * edge1.x - deltaUV1.y * edge2.x);
-            tangent.y = f * (deltaUV2.y * edge1.y - deltaUV1.y * edge2.y);
-            tangent.z = f * (deltaUV2.y * edge1.z - deltaUV1.y * edge2.z);
+        if (m_VertexLayout == EQuantizedVertexAttributes)
+        {
+            // Primitives without vertex colors are given a color per instance when they are drawn
+            prim.m_ConstantColor = a_Data.m_Colors.Empty();
 
-            tangents[i1] = tangent;
-            tangents[i2] = tangent;
-            tangents[i3] = tangent;
+            if (!prim.m_ConstantColor)
+                prim.m_VertexColors = a_Batch.CreateVertexBuffer(a_Data.m_Colors, { EGraphicsQueue });
         }
     }
     else
     {
-        for (size_t i = 0; i < positions.Size(); i += 3)
-        {
-            auto tangent = glm::vec4(1.0f);
+        if (!a_Data.m_TexCoords.Empty())
+            prim.m_TexCoords = a_Batch.CreateVertexBuffer(a_Data.m_TexCoords, { EGraphicsQueue });
+        if (!a_Data.m_Normals.Empty())
+            prim.m_Normals = a_Batch.CreateVertexBuffer(a_Data.m_Normals, { EGraphicsQueue });
 
-            uint64_t i1 = i + 0;
-            uint64_t i2 = i + 1;
-            uint64_t i3 = i + 2;
+        prim.m_VertexColors = a_Batch.CreateVertexBuffer(a_Data.m_Colors, { EGraphicsQueue });
+        prim.m_Tangents = a_Batch.CreateVertexBuffer(a_Data.m_Tangents, { EGraphicsQueue });
+    }
 
-            glm::vec3 p1 = *positions[i1];
-            glm::vec3 p2 = *positions[i2];
-            glm::vec3 p3 = *positions[i3];
-            glm::vec2 uv1 = *tex[i1];
-            glm::vec2 uv2 = *tex[i2];
-            glm::vec2 uv3 = *tex[i3];
+    if (a_Data.m_SkinAttributes.GetElementSize() == sizeof(Mesh::SkinVertex))
+        prim.m_SkinAttributes = a_Batch.CreateVertexBuffer(a_Data.m_SkinAttributes, { EGraphicsQueue });
 
-            glm::vec3 edge1 = p2 - p1;
-            glm::vec3 edge2 = p3 - p1;
-            glm::vec2 deltaUV1 = uv2 - uv1;
-            glm::vec2 deltaUV2 = uv3 - uv1;
+    if (!a_Data.m_Indices.Empty())
+        prim.m_IndexBuffer = a_Batch.CreateIndexBuffer(a_Data.m_Indices, { EGraphicsQueue });
 
-            float f = 1.0f / (deltaUV1.x * deltaUV2.y - deltaUV2.x * deltaUV1.y);
+    // Meshlets written by a different build of the engine are ignored rather than misread
+    if (a_Data.m_Meshlets.GetElementSize() == sizeof(Mesh::Meshlet))
+        prim.m_Meshlets = a_Data.m_Meshlets.ToVector<Mesh::Meshlet>();
 
-            tangent.x = f * (deltaUV2.y * edge1.x - deltaUV1.y * edge2.x);
-            tangent.y = f * (deltaUV2.y * edge1.y - deltaUV1.y * edge2.y);
-            tangent.z = f * (deltaUV2.y * edge1.z - deltaUV1.y * edge2.z);
+    prim.m_BoundsMin = a_Data.m_BoundsMin;
+    prim.m_BoundsMax = a_Data.m_BoundsMax;
 
-            tangents[i1] = tangent;
-            tangents[i2] = tangent;
-            tangents[i3] = tangent;
-        }
+    // The morph targets stay on the CPU, where they are blended into copies of the streams that were just uploaded
+    if (a_Data.m_Positions.GetElementSize() == sizeof(glm::vec3) && a_Data.m_MorphTargets.GetElementSize() == sizeof(MorphTargets::Target) &&
+        a_Data.m_MorphDeltas.GetElementSize() == sizeof(MorphTargets::Delta))
+    {
+        prim.m_MorphTargets = std::make_unique<MorphTargets>(m_VertexLayout, a_Data.m_Positions, a_Data.m_InterleavedAttributes,
+                                                             a_Data.m_Normals, a_Data.m_Tangents, a_Data.m_MorphVertices,
+                                                             a_Data.m_MorphTargets, a_Data.m_MorphDeltas, a_Data.m_MorphSlots);
+        prim.m_MorphTargets->ExpandBounds(prim.m_BoundsMin, prim.m_BoundsMax);
     }
-    auto& commandBuffer = m_Services.m_LogicalDevice->GetCommandQueue(ETransferQueue).GetSingleUseCommandBuffer();
-    commandBuffer.Begin();
-    auto buffer = commandBuffer.CreateVertexBuffer(tangents, { EGraphicsQueue });
-    commandBuffer.Submit();
 
-    return buffer;
+    if (a_Data.m_Material != -1)
+        prim.m_Material = a_Res.m_Materials[a_Data.m_Material];
 }
 
+std::vector<std::shared_ptr<krt::Scene>> krt::ModelManager::LoadScenes(const SceneNodes& a_SceneNodes, GLTFResource& a_Res)
+{
+    std::vector<std::shared_ptr<krt::Scene>> scenes;
+    for (auto& nodes : a_SceneNodes)
+    {
+        auto& scene = scenes.emplace_back(std::make_shared<Scene>(m_Services));
+
+        for (auto& node : nodes)
+        {
+            auto& sMesh = scene->m_StaticMeshes.emplace_back(std::make_unique<StaticMesh>());
+            // Copied rather than moved, the nodes are still written to the cache once the file is resident
+            sMesh->m_Transform = std::make_unique<Transform>(*node.m_Transform);
+            sMesh->SetMesh(a_Res.m_Meshes[node.m_Mesh]);
+
+            if (node.m_Skin != -1)
+                sMesh->m_Skeleton = a_Res.m_Skeletons[node.m_Skin];
+        }
+    }
+
+    return scenes;
+}
 
-void krt::ModelManager::LoadNode(fx::gltf::Document& a_Doc, GLTFResource& a_Res, int32_t a_NodeIndex,
-                                 const Transform& a_NodeParent, krt::Scene& a_Scene)
+void krt::ModelManager::LoadNode(const fx::gltf::Document& a_Doc, int32_t a_NodeIndex,
+                                 const Transform& a_NodeParent, std::vector<NodeInstance>& a_Instances)
 {
     auto& node = a_Doc.nodes[a_NodeIndex];
 
@@ -242,18 +1445,23 @@ void krt::ModelManager::LoadNode(fx::gltf::Document& a_Doc, GLTFResource& a_Res,
 
     if (node.mesh != -1)
     {
-        auto& sMesh = a_Scene.m_StaticMeshes.emplace_back(std::make_unique<StaticMesh>());
-        *sMesh->m_Transform = worldTransform;
-        sMesh->SetMesh(a_Res.m_Meshes[node.mesh]);
+        auto& instance = a_Instances.emplace_back();
+        instance.m_Mesh = node.mesh;
+        instance.m_Skin = node.skin;
+        instance.m_Transform = std::make_unique<Transform>();
+
+        // The joints already include the transforms of the nodes above them, the one of the skinned node itself is ignored
+        if (node.skin == -1)
+            *instance.m_Transform = worldTransform;
     }
 
     for (auto& child : node.children)
     {
-        LoadNode(a_Doc, a_Res, child, worldTransform, a_Scene);
+        LoadNode(a_Doc, child, worldTransform, a_Instances);
     }
 }
 
-void krt::ModelManager::GetNodeTransform(fx::gltf::Node& a_Node, Transform& a_Transform)
+void krt::ModelManager::GetNodeTransform(const fx::gltf::Node& a_Node, Transform& a_Transform)
 {
     auto& mat = a_Node.matrix;
 
@@ -281,244 +1489,364 @@ void krt::ModelManager::GetNodeTransform(fx::gltf::Node& a_Node, Transform& a_Tr
     }
 }
 
-std::vector<std::shared_ptr<krt::Material>> krt::ModelManager::LoadMaterials(fx::gltf::Document& a_Doc, krt::ModelManager::GLTFResource& a_Res)
+std::vector<std::shared_ptr<const krt::Skeleton>> krt::ModelManager::LoadSkeletons(const GltfSource& a_Source)
 {
-    std::vector<std::shared_ptr<krt::Material>> materials;
-    for (auto& material : a_Doc.materials)
-    {
-        auto& mat = materials.emplace_back(std::make_shared<Material>());
-        mat->SetSampler(*m_DefaultSampler);
-        if (!material.pbrMetallicRoughness.baseColorTexture.empty())
-        {
-            mat->SetDiffuseTexture(a_Res.m_LoadedTextures[material.pbrMetallicRoughness.baseColorTexture.index]);
-        }
-        else
-        {
-            mat->SetDiffuseTexture(m_DefaultDiffuse);
-        }
+    std::vector<std::shared_ptr<const Skeleton>> skeletons;
+    for (auto& skin : a_Source.GetDocument().skins)
+        skeletons.push_back(LoadSkeleton(a_Source, skin));
 
-        glm::vec4 diffuse = glm::vec4(material.pbrMetallicRoughness.baseColorFactor[0], material.pbrMetallicRoughness.baseColorFactor[1],
-            material.pbrMetallicRoughness.baseColorFactor[2], material.pbrMetallicRoughness.baseColorFactor[3]);
-
-        mat->SetDiffuseColor(diffuse);
-
-        if (!material.normalTexture.empty())
-            mat->SetNormalMap(a_Res.m_LoadedTextures[material.normalTexture.index]);
-        else
-            mat->SetNormalMap(m_DefaultNormalMap);
+    return skeletons;
+}
 
+std::shared_ptr<krt::Skeleton> krt::ModelManager::LoadSkeleton(const GltfSource& a_Source, const fx::gltf::Skin& a_Skin)
+{
+    auto& doc = a_Source.GetDocument();
+    auto numNodes = doc.nodes.size();
 
+    std::vector<int32_t> nodeParents(numNodes, -1);
+    for (size_t i = 0; i < numNodes; i++)
+    {
+        for (auto child : doc.nodes[i].children)
+            nodeParents[child] = static_cast<int32_t>(i);
     }
-    return materials;
-}
 
-std::vector<std::shared_ptr<krt::Texture>> krt::ModelManager::LoadTextures(fx::gltf::Document& a_Doc, std::string a_Filepath)
-{
-    std::vector<std::shared_ptr<Texture>> textures;
+    // The joints and every node above them, so a pose can be resolved without the rest of the scene
+    std::vector<bool> isBone(numNodes, false);
+    for (auto joint : a_Skin.joints)
+    {
+        for (auto node = static_cast<int32_t>(joint); node != -1 && !isBone[node]; node = nodeParents[node])
+            isBone[node] = true;
+    }
 
-    auto& commandQueue = m_Services.m_LogicalDevice->GetCommandQueue(ETransferQueue);
-    auto& commandBuffer = commandQueue.GetSingleUseCommandBuffer();
-    commandBuffer.Begin();
+    auto skeleton = std::make_shared<Skeleton>();
+    auto& rest = skeleton->m_RestPose;
 
-    for (auto& image : a_Doc.images)
+    // Walking down from the roots puts every parent before its children
+    std::vector<int32_t> nodeBones(numNodes, -1);
+    std::vector<int32_t> stack;
+    for (size_t i = 0; i < numNodes; i++)
     {
-        // Don't want to support embedded textures yet, assert if it's an embedded texture
-        assert(image.IsEmbeddedResource() || !image.uri.empty());
+        if (isBone[i] && nodeParents[i] == -1)
+            stack.push_back(static_cast<int32_t>(i));
+    }
 
-        auto texPath = a_Filepath + "/../" + image.uri;
+    while (!stack.empty())
+    {
+        auto nodeIndex = stack.back();
+        stack.pop_back();
 
-        auto tex = commandBuffer.CreateTextureFromFile(texPath, { EGraphicsQueue });
+        auto& node = doc.nodes[nodeIndex];
+        auto parent = nodeParents[nodeIndex];
 
-        textures.emplace_back(tex.release());
-    }
+        nodeBones[nodeIndex] = static_cast<int32_t>(skeleton->GetNumBones());
+        skeleton->m_Parents.push_back(parent == -1 ? -1 : nodeBones[parent]);
 
-    commandBuffer.Submit();
-    commandQueue.Flush();
+        glm::vec3 translation(node.translation[0], node.translation[1], node.translation[2]);
+        glm::quat rotation(node.rotation[3], node.rotation[0], node.rotation[1], node.rotation[2]);
+        glm::vec3 scale(node.scale[0], node.scale[1], node.scale[2]);
 
-    return textures;
-}
+        if (node.matrix != fx::gltf::defaults::IdentityMatrix)
+        {
+            glm::mat4 matrix;
+            memcpy(&matrix[0][0], node.matrix.data(), sizeof(matrix));
 
+            glm::vec3 skew;
+            glm::vec4 perspective;
+            glm::decompose(matrix, scale, rotation, translation, skew, perspective);
+        }
 
-uint32_t krt::ModelManager::GetAttributeSize(fx::gltf::Accessor& a_Accessor)
-{
-    return GetComponentCount(a_Accessor) * GetComponentSize(a_Accessor);
-}
+        rest.m_Translations.push_back(translation);
+        rest.m_Rotations.push_back(rotation);
+        rest.m_Scales.push_back(scale);
 
-uint32_t krt::ModelManager::GetComponentCount(fx::gltf::Accessor& a_Accessor)
-{
-    switch (a_Accessor.type)
-    {
-    case fx::gltf::Accessor::Type::Scalar:
-        return 1;
-    case fx::gltf::Accessor::Type::Vec2:
-        return 2;
-    case fx::gltf::Accessor::Type::Vec3:
-        return 3;
-    case fx::gltf::Accessor::Type::Vec4:
-    case fx::gltf::Accessor::Type::Mat2:
-        return 4;
-    case fx::gltf::Accessor::Type::Mat3:
-        return 9;
-    case fx::gltf::Accessor::Type::Mat4:
-        return 16;
-    default:
-        assert(0 && "Failed to load GLTF file.");
-        return 0;
+        for (auto child : node.children)
+        {
+            if (isBone[child] && nodeBones[child] == -1)
+                stack.push_back(static_cast<int32_t>(child));
+        }
     }
-}
 
-uint32_t krt::ModelManager::GetComponentSize(fx::gltf::Accessor& a_Accessor)
-{
-    switch (a_Accessor.componentType)
+    auto inverseBindMatrices = a_Source.GetAccessor(a_Skin.inverseBindMatrices);
+    bool hasInverseBindMatrices = inverseBindMatrices.Size() == a_Skin.joints.size() &&
+                                  inverseBindMatrices.GetElementSize() == sizeof(glm::mat4);
+
+    for (size_t i = 0; i < a_Skin.joints.size(); i++)
     {
-    case fx::gltf::Accessor::ComponentType::Byte:
-    case fx::gltf::Accessor::ComponentType::UnsignedByte:
-        return 1;
-    case fx::gltf::Accessor::ComponentType::Short:
-    case fx::gltf::Accessor::ComponentType::UnsignedShort:
-        return 2;
-    case fx::gltf::Accessor::ComponentType::Float:
-    case fx::gltf::Accessor::ComponentType::UnsignedInt:
-        return 4;
-    default:
-        assert(0 && "Failed to load GLTF file.");
-        return 0;
+        skeleton->m_JointBones.push_back(static_cast<uint32_t>(nodeBones[a_Skin.joints[i]]));
+        skeleton->m_InverseBindMatrices.push_back(hasInverseBindMatrices ? inverseBindMatrices.Get<glm::mat4>(i) : glm::mat4(1.0f));
     }
-}
 
-std::unique_ptr<krt::VertexBuffer> krt::ModelManager::MakeVertexBuffer(std::vector<uint8_t>& a_Data,
-                                                                       uint32_t a_AttributeSize) const
-{
-    auto& commandBuffer = m_Services.m_LogicalDevice->GetCommandQueue(ETransferQueue).GetSingleUseCommandBuffer();
+    using Interpolation = fx::gltf::Animation::Sampler::Type;
 
-    std::vector<float> fs;
-
-    for (size_t i = 0; i < a_Data.size() / 4; i++)
+    // Channels of other nodes belong to other skins or to plain nodes, and the weights of morph targets are not animated
+    for (auto& animation : doc.animations)
     {
-        union u
+        AnimationClip clip;
+        clip.m_Name = animation.name;
+        clip.m_Duration = 0.0f;
+
+        // Key times are stored relative to the duration, so every channel has to be read before any of them is compressed
+        std::vector<hlp::RawTrack> rawTracks;
+
+        for (auto& channel : animation.channels)
         {
-            uint8_t b[4];
-            float f;
-        } u;
-        for (size_t j = 0; j < 4; j++)
+            auto node = channel.target.node;
+            if (node < 0 || node >= static_cast<int32_t>(numNodes) || nodeBones[node] == -1 ||
+                channel.sampler < 0 || channel.sampler >= static_cast<int32_t>(animation.samplers.size()))
+            {
+                continue;
+            }
+
+            hlp::RawTrack track;
+            if (channel.target.path == "translation")
+                track.m_Path = AnimationTrack::ETranslation;
+            else if (channel.target.path == "rotation")
+                track.m_Path = AnimationTrack::ERotation;
+            else if (channel.target.path == "scale")
+                track.m_Path = AnimationTrack::EScale;
+            else
+                continue;
+
+            auto& sampler = animation.samplers[channel.sampler];
+            auto times = a_Source.GetAccessor(sampler.input);
+            auto values = a_Source.GetAccessor(sampler.output);
+
+            // Cubic splines store an in and out tangent around every value, only the values are kept and interpolated linearly
+            bool cubic = sampler.interpolation == Interpolation::CubicSpline;
+            uint64_t valuesPerKey = cubic ? 3 : 1;
+
+            if (times.Empty() || times.GetElementSize() != sizeof(float) || values.Size() != times.Size() * valuesPerKey)
+            {
+                printf("Skipping a channel of animation %s, its keys do not match its values.\n", animation.name.c_str());
+                continue;
+            }
+
+            track.m_Bone = static_cast<uint32_t>(nodeBones[node]);
+            track.m_Step = sampler.interpolation == Interpolation::Step;
+            track.m_Times = times.ToVector<float>();
+            track.m_Values.resize(times.Size());
+
+            for (uint64_t i = 0; i < times.Size(); i++)
+                track.m_Values[i] = hlp::ReadNormalized(values, i * valuesPerKey + (cubic ? 1 : 0), glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
+
+            clip.m_Duration = std::max(clip.m_Duration, track.m_Times.back());
+            rawTracks.push_back(std::move(track));
+        }
+
+        hlp::ClipCompressionStatistics statistics;
+        for (auto& rawTrack : rawTracks)
         {
-            u.b[j] = a_Data[i * 4 + j];
+            glm::vec4 restValue;
+            if (rawTrack.m_Path == AnimationTrack::ETranslation)
+                restValue = glm::vec4(rest.m_Translations[rawTrack.m_Bone], 0.0f);
+            else if (rawTrack.m_Path == AnimationTrack::EScale)
+                restValue = glm::vec4(rest.m_Scales[rawTrack.m_Bone], 0.0f);
+            else
+            {
+                auto& rotation = rest.m_Rotations[rawTrack.m_Bone];
+                restValue = glm::vec4(rotation.x, rotation.y, rotation.z, rotation.w);
+            }
+
+            AnimationTrack track;
+            if (hlp::CompressTrack(rawTrack, restValue, clip.m_Duration, track, statistics))
+                clip.m_Tracks.push_back(std::move(track));
         }
 
-        fs.push_back(u.f);
-    }
+        if (rawTracks.empty())
+            continue;
 
-    commandBuffer.Begin();
-    auto buffer = commandBuffer.CreateVertexBuffer(a_Data.data(), a_Data.size() / a_AttributeSize,
-        a_AttributeSize, { EGraphicsQueue });
+        printf("Animation %s: %u of %u tracks kept, %llu of %llu keys, %.1f KB compressed from %.1f KB\n", clip.m_Name.c_str(),
+               statistics.m_NumTracks - statistics.m_DroppedTracks, statistics.m_NumTracks,
+               static_cast<unsigned long long>(statistics.m_KeptKeys), static_cast<unsigned long long>(statistics.m_NumKeys),
+               static_cast<float>(statistics.m_CompressedSize) / 1024.0f, static_cast<float>(statistics.m_RawSize) / 1024.0f);
 
-    commandBuffer.Submit();
+        // Kept even if every track holds the rest pose, since the animation does target this skeleton
+        skeleton->m_Clips.push_back(std::move(clip));
+    }
 
-    return buffer;
+    return skeleton;
 }
 
-std::vector<uint32_t> krt::ModelManager::LoadIndices(fx::gltf::Document& a_Doc, int32_t a_AccessorIndex)
+std::vector<std::shared_ptr<const krt::Skeleton>> krt::ModelManager::ReadCachedSkeletons(const MeshCache& a_Cache)
 {
-    if (a_AccessorIndex == -1)
+    auto cachedSkins = a_Cache.GetEntries<MeshCache::SkinEntry>(MeshCache::ESkins);
+    auto cachedBones = a_Cache.GetEntries<MeshCache::BoneEntry>(MeshCache::EBones);
+    auto cachedJoints = a_Cache.GetEntries<MeshCache::JointEntry>(MeshCache::EJoints);
+    auto cachedClips = a_Cache.GetEntries<MeshCache::ClipEntry>(MeshCache::EClips);
+    auto cachedTracks = a_Cache.GetEntries<MeshCache::TrackEntry>(MeshCache::ETracks);
+
+    std::vector<std::shared_ptr<const Skeleton>> skeletons;
+    for (uint64_t i = 0; i < a_Cache.GetCount(MeshCache::ESkins); i++)
     {
-        return std::vector<uint32_t>();
-    }
-    auto accessor = a_Doc.accessors[a_AccessorIndex];
-
-    auto indexSize = GetAttributeSize(accessor);
+        auto& cachedSkin = cachedSkins[i];
+        auto skeleton = std::make_shared<Skeleton>();
+        auto& rest = skeleton->m_RestPose;
 
-    auto data = LoadRawData(a_Doc, a_AccessorIndex);
-
-    std::vector<uint32_t> indices;
-    indices.reserve(data.size() / indexSize);
+        for (uint32_t j = 0; j < cachedSkin.m_NumBones; j++)
+        {
+            auto& bone = cachedBones[cachedSkin.m_FirstBone + j];
+            skeleton->m_Parents.push_back(bone.m_Parent);
+            rest.m_Translations.emplace_back(bone.m_Translation[0], bone.m_Translation[1], bone.m_Translation[2]);
+            rest.m_Rotations.emplace_back(bone.m_Rotation[3], bone.m_Rotation[0], bone.m_Rotation[1], bone.m_Rotation[2]);
+            rest.m_Scales.emplace_back(bone.m_Scale[0], bone.m_Scale[1], bone.m_Scale[2]);
+        }
 
-    switch (indexSize)
-    {
-    case 1:
-        for (size_t i = 0; i < data.size(); i++)
-            indices.push_back(data[i]);
-        break;
-    case 2:
+        for (uint32_t j = 0; j < cachedSkin.m_NumJoints; j++)
         {
-            hlp::VectorView<uint16_t, uint8_t> ushortView(data);
-            for (size_t i = 0; i < ushortView.Size(); i++)
-                indices.push_back(*ushortView[i]);
-            break;
+            auto& joint = cachedJoints[cachedSkin.m_FirstJoint + j];
+            skeleton->m_JointBones.push_back(joint.m_Bone);
+
+            auto& inverseBindMatrix = skeleton->m_InverseBindMatrices.emplace_back();
+            memcpy(&inverseBindMatrix[0][0], joint.m_InverseBindMatrix, sizeof(joint.m_InverseBindMatrix));
         }
-    case 4:
+
+        for (uint32_t j = 0; j < cachedSkin.m_NumClips; j++)
         {
-            hlp::VectorView<uint32_t, uint8_t> uintView(data);
-            for (size_t i = 0; i < uintView.Size(); i++)
-                indices.push_back(*uintView[i]);
-            break;
+            auto& cachedClip = cachedClips[cachedSkin.m_FirstClip + j];
+
+            auto& clip = skeleton->m_Clips.emplace_back();
+            clip.m_Name = a_Cache.GetString(cachedClip.m_Name);
+            clip.m_Duration = cachedClip.m_Duration;
+
+            for (uint32_t k = 0; k < cachedClip.m_NumTracks; k++)
+            {
+                auto& cachedTrack = cachedTracks[cachedClip.m_FirstTrack + k];
+
+                auto& track = clip.m_Tracks.emplace_back();
+                track.m_Bone = cachedTrack.m_Bone;
+                track.m_Path = static_cast<AnimationTrack::EPath>(cachedTrack.m_Path);
+                track.m_Step = cachedTrack.m_Step != 0;
+                track.m_Min = glm::vec3(cachedTrack.m_Min[0], cachedTrack.m_Min[1], cachedTrack.m_Min[2]);
+                track.m_Extent = glm::vec3(cachedTrack.m_Extent[0], cachedTrack.m_Extent[1], cachedTrack.m_Extent[2]);
+                track.m_Times.resize(cachedTrack.m_NumKeys);
+                track.m_Values.resize(cachedTrack.m_NumKeys);
+
+                auto times = a_Cache.GetData(cachedTrack.m_TimesOffset, cachedTrack.m_NumKeys * sizeof(uint16_t));
+                auto values = a_Cache.GetData(cachedTrack.m_ValuesOffset, cachedTrack.m_NumKeys * sizeof(glm::u16vec3));
+                memcpy(track.m_Times.data(), times.m_Data, times.m_Size);
+                memcpy(track.m_Values.data(), values.m_Data, values.m_Size);
+            }
         }
-    default:
-        break;
+
+        skeletons.push_back(std::move(skeleton));
     }
 
-    return indices;
+    return skeletons;
 }
 
-std::unique_ptr<krt::IndexBuffer> krt::ModelManager::LoadIndexBuffer(fx::gltf::Document& a_Doc, int32_t a_AccessorIndex)
+std::vector<std::shared_ptr<krt::Material>> krt::ModelManager::LoadMaterials(const std::vector<MeshCache::MaterialEntry>& a_Materials)
 {
-    if (a_AccessorIndex == -1)
+    std::vector<std::shared_ptr<krt::Material>> materials;
+    for (auto& material : a_Materials)
     {
-        return nullptr;
-    }
-    auto accessor = a_Doc.accessors[a_AccessorIndex];
+        auto& mat = materials.emplace_back(std::make_shared<Material>());
+        mat->SetSampler(*m_DefaultSampler);
+        mat->SetDiffuseTexture(m_DefaultDiffuse);
+
+        glm::vec4 diffuse = glm::vec4(material.m_BaseColorFactor[0], material.m_BaseColorFactor[1],
+            material.m_BaseColorFactor[2], material.m_BaseColorFactor[3]);
 
-    auto indexSize = GetAttributeSize(accessor);
+        mat->SetDiffuseColor(diffuse);
+        mat->SetNormalMap(m_DefaultNormalMap);
 
-    auto data = LoadRawData(a_Doc, a_AccessorIndex);
+        mat->SetDoubleSided(material.m_DoubleSided != 0);
 
-    auto& commandBuffer = m_Services.m_LogicalDevice->GetCommandQueue(ETransferQueue).GetSingleUseCommandBuffer();
+    }
+    return materials;
+}
 
-    commandBuffer.Begin();
-    auto indexBuffer = commandBuffer.CreateIndexBuffer(data.data(), 
-        data.size() / indexSize, static_cast<uint8_t>(indexSize), { EGraphicsQueue });
+void krt::ModelManager::SetMaterialTextures(const StreamingLoad& a_Load, uint32_t a_Image, const std::shared_ptr<Texture>& a_Texture)
+{
+    auto& materials = a_Load.m_Resource->m_Materials;
+    auto image = static_cast<int32_t>(a_Image);
 
-    commandBuffer.Submit();
+    for (size_t i = 0; i < a_Load.m_MaterialEntries.size(); i++)
+    {
+        if (a_Load.m_MaterialEntries[i].m_BaseColorImage == image)
+            m_TextureStreamer.Bind(a_Texture, materials[i], false);
 
-    return indexBuffer;
+        if (a_Load.m_MaterialEntries[i].m_NormalImage == image)
+            m_TextureStreamer.Bind(a_Texture, materials[i], true);
+    }
 }
 
-std::vector<uint8_t> krt::ModelManager::LoadRawData(fx::gltf::Document& a_Doc, int32_t a_AccessorIndex) const
+std::vector<uint32_t> krt::ModelManager::UnpackIndices(const hlp::AccessorView& a_Indices)
 {
-    auto accessor = a_Doc.accessors[a_AccessorIndex];
-    auto bufferView = a_Doc.bufferViews[accessor.bufferView];
+    std::vector<uint32_t> indices(a_Indices.Size());
 
-    auto attributeSize = GetAttributeSize(accessor);
-    auto componentCount = GetComponentCount(accessor);
-    auto componentSize = GetComponentSize(accessor);
+    switch (a_Indices.GetElementSize())
+    {
+    case 2:
+        for (uint64_t i = 0; i < indices.size(); i++)
+            indices[i] = a_Indices.Get<uint16_t>(i);
+        break;
+    case 4:
+        a_Indices.CopyTo(indices.data());
+        break;
+    default:
+        break;
+    }
 
-    auto buffer = a_Doc.buffers[bufferView.buffer];
+    return indices;
+}
 
-    // According to the GLTF spec, BufferView::byteStride can be 0.
-    // In those cases the expected stride is the size of the attributes instead.
-    auto stride = std::max(attributeSize, bufferView.byteStride);
+krt::ModelManager::ImportPhase::ImportPhase()
+    : m_BusyTime(0)
+    , m_NumTasks(0)
+{
+}
 
-    std::vector<unsigned char> data;
-    // The attribute count is the length of the buffer divided by the stride.
-    // Knowing the size of the attributes we can determine how many bytes are needed.
-    data.reserve(bufferView.byteLength / stride * attributeSize);
+void krt::ModelManager::ImportTimings::Print(const std::string& a_Path, uint32_t a_NumThreads,
+    std::chrono::steady_clock::duration a_TotalTime)
+{
+    using Milliseconds = std::chrono::duration<double, std::milli>;
 
-    auto bufferOffset = bufferView.byteOffset + accessor.byteOffset;
-    //auto endOffset = bufferOffset + bufferView.byteLength;
+    printf("Loaded %s in %.2f ms using %u worker threads.\n", a_Path.c_str(), Milliseconds(a_TotalTime).count(), a_NumThreads);
 
-    for(uint32_t i = 0; i < accessor.count; i++)
+    auto printPhase = [](const char* a_Name, const ImportPhase& a_Phase)
     {
-        for (uint32_t component = 0; component < componentCount; component++)
-        {
-            for (size_t byte = 0; byte < componentSize; byte++)
-            {
-                data.push_back(buffer.data[bufferOffset + (component * componentSize) + byte]);
-            }
-        }
-        
-        bufferOffset += stride;
-    }
-
-    //std::reverse(data.begin(), data.end());
+        if (a_Phase.m_NumTasks == 0)
+            return;
+
+        // Wall time is how long the phase was in flight, busy time is the sum over all threads.
+        // The ratio between the two is how many threads the phase kept busy on average.
+        auto wall = Milliseconds(a_Phase.m_LastEnd - a_Phase.m_FirstStart).count();
+        auto busy = Milliseconds(a_Phase.m_BusyTime).count();
+
+        printf("    %-20s wall %9.2f ms, busy %9.2f ms, %5u tasks\n", a_Name, wall, busy, a_Phase.m_NumTasks);
+    };
+
+    printPhase("Cache read", m_CacheRead);
+    printPhase("Parse", m_Parse);
+    printPhase("Image decode", m_ImageDecode);
+    printPhase("Mip generation", m_MipGeneration);
+    printPhase("Texture compression", m_TextureCompression);
+    printPhase("Texture cache", m_TextureCache);
+    printPhase("Accessor decode", m_AccessorDecode);
+    printPhase("Mesh optimization", m_MeshOptimization);
+    printPhase("Mesh analysis", m_MeshAnalysis);
+    printPhase("Tangent generation", m_TangentGeneration);
+    printPhase("Meshlet build", m_MeshletBuild);
+    printPhase("Material build", m_MaterialBuild);
+    printPhase("Node traversal", m_NodeTraversal);
+    printPhase("Skeleton build", m_SkeletonBuild);
+    printPhase("GPU upload", m_Upload);
+    printPhase("Cache write", m_CacheWrite);
+
+    if (m_StatisticsBefore.m_NumTriangles == 0)
+        return;
+
+    // Vertex counts are of the referenced vertices, before and after welding
+    printf("    Mesh optimization: %llu triangles, %llu -> %llu vertices\n", static_cast<unsigned long long>(m_StatisticsBefore.m_NumTriangles),
+           static_cast<unsigned long long>(m_StatisticsBefore.m_NumVertices), static_cast<unsigned long long>(m_StatisticsAfter.m_NumVertices));
+    printf("        ACMR     %6.3f -> %6.3f\n", m_StatisticsBefore.GetACMR(), m_StatisticsAfter.GetACMR());
+    printf("        ATVR     %6.3f -> %6.3f\n", m_StatisticsBefore.GetATVR(), m_StatisticsAfter.GetATVR());
+    printf("        Overdraw %6.3f -> %6.3f\n", m_StatisticsBefore.GetOverdraw(), m_StatisticsAfter.GetOverdraw());
+}
 
-    return data;
+void krt::ModelManager::ImportTimings::AddMeshStatistics(const hlp::MeshStatistics& a_Before, const hlp::MeshStatistics& a_After)
+{
+    std::lock_guard<std::mutex> lock(m_StatisticsMutex);
+    m_StatisticsBefore += a_Before;
+    m_StatisticsAfter += a_After;
 }
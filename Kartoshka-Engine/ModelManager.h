@@ -1,9 +1,24 @@
 #pragma once
 
 #include "FX-GLTF/gltf.h"
+#include "AccessorView.h"
+#include "MeshCache.h"
+#include "Mesh.h"
+#include "MeshOptimizer.h"
+#include "MorphTargets.h"
+#include "Ktx2File.h"
+#include "TextureRegistry.h"
+#include "TextureStreamer.h"
 
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+
+#include <chrono>
+#include <future>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
@@ -11,7 +26,6 @@ namespace krt
 {
     class Transform;
     struct ServiceLocator;
-    struct Mesh;
     class VertexBuffer;
     class IndexBuffer;
     class Material;
@@ -19,6 +33,9 @@ namespace krt
     class Sampler;
     class Scene;
     class StaticMesh;
+    class UploadBatch;
+    struct Skeleton;
+    struct VertexAnimation;
 }
 
 namespace krt
@@ -36,15 +53,30 @@ namespace krt
 
             std::shared_ptr<Scene> GetScene(uint32_t a_Index = 0) { return m_Scenes[a_Index]; }
 
+            // Skeletons are indexed like the skins of the file
+            std::shared_ptr<const Skeleton> GetSkeleton(uint32_t a_Index = 0) { return m_Skeletons[a_Index]; }
+
+            // Returns true once all GPU resources of the file have finished uploading and were handed to its meshes and materials
+            bool IsResident() const { return m_Resident; }
+
         private:
             std::vector<std::shared_ptr<Mesh>>      m_Meshes;
             std::vector<std::shared_ptr<Material>>  m_Materials;
-            std::vector<std::shared_ptr<Texture>>   m_LoadedTextures;
+            std::vector<std::shared_ptr<Texture>>   m_LoadedTextures; // nullptr until the image is resident
             std::vector<std::shared_ptr<Scene>>     m_Scenes;
+            std::vector<std::shared_ptr<const Skeleton>> m_Skeletons;
+
+            bool                                    m_Resident = false;
 
         };
 
-        ModelManager(ServiceLocator& a_Services);
+        // Bytes Update stages per call if no budget is given, small enough to upload within a frame
+        static const uint64_t DefaultStreamingBudget = 16 * 1024 * 1024;
+
+        // Compressed textures are only used if the device supports block compression, otherwise they stay RGBA8.
+        // A texture memory budget of 0 keeps all levels of every texture resident instead of streaming them.
+        ModelManager(ServiceLocator& a_Services, EVertexLayout a_VertexLayout, bool a_OptimizeMeshes, bool a_GenerateMipmaps,
+                     bool a_CompressTextures, uint64_t a_TextureMemoryBudget);
         ~ModelManager();
 
         ModelManager(ModelManager&) = delete;
@@ -52,38 +84,275 @@ namespace krt
         ModelManager& operator=(ModelManager&) = delete;
         ModelManager& operator=(ModelManager&&) = delete;
 
+        // Loads the file and blocks until all of its resources are resident
         GLTFResource* LoadGltf(std::string a_Path);
 
+        // Starts loading the file and returns before any of its images or primitives are decoded.
+        // Only the structure of the file is read on the calling thread, so the scenes, meshes and materials of the resource exist right away.
+        // The meshes start out empty and the materials use the default textures, until Update hands them their primitives and textures.
+        GLTFResource* LoadGltfAsync(std::string a_Path);
+
+        // Uploads the images and primitives the workers have decoded since the last call, staging at most about a_StagingBudget bytes,
+        // and hands everything that has become resident to the meshes and materials it belongs to.
+        // The remainder of the budget streams the levels the texture streamer was asked for.
+        // Has to be called once per frame on the thread that owns the command pools while files are streaming.
+        void Update(uint64_t a_StagingBudget = DefaultStreamingBudget);
+
+        bool IsStreaming() const { return !m_StreamingLoads.empty(); }
+
+        // How many images of the loaded files turned out to be shared with other images
+        TextureRegistry::Statistics GetTextureStatistics() { return m_TextureRegistry.GetStatistics(); }
+
+        TextureStreamer& GetTextureStreamer() { return m_TextureStreamer; }
+
+        // Bakes the clips of the first skinned mesh of the file into a vertex animation, with a_FrameRate frames per second of every clip.
+        // The file is loaded first, and the final streams its load decoded are baked, so the texels are in the order the vertices
+        // are uploaded in. Files that were loaded before are read back from their mesh cache, or decoded again without one.
+        // Blocks until the textures are resident. Returns nullptr if no scene of the file has a skinned mesh whose skeleton has clips.
+        std::shared_ptr<VertexAnimation> BakeVertexAnimation(const std::string& a_Path, float a_FrameRate);
+
     private:
 
-        static uint32_t GetAttributeSize(fx::gltf::Accessor& a_Accessor);
-        static uint32_t GetComponentCount(fx::gltf::Accessor& a_Accessor);
-        static uint32_t GetComponentSize(fx::gltf::Accessor& a_Accessor);
+        // Wall time and accumulated thread time of one stage of a glTF import.
+        // Tasks of the same phase can run on several worker threads at once.
+        struct ImportPhase
+        {
+            ImportPhase();
+
+            template<typename Function>
+            void Measure(Function&& a_Function);
+
+            std::mutex m_Mutex;
+            std::chrono::steady_clock::time_point m_FirstStart;
+            std::chrono::steady_clock::time_point m_LastEnd;
+            std::chrono::steady_clock::duration m_BusyTime;
+            uint32_t m_NumTasks;
+        };
+
+        struct ImportTimings
+        {
+            void Print(const std::string& a_Path, uint32_t a_NumThreads, std::chrono::steady_clock::duration a_TotalTime);
+
+            // Sums up the statistics of an optimized primitive, can be called from several worker threads at once
+            void AddMeshStatistics(const hlp::MeshStatistics& a_Before, const hlp::MeshStatistics& a_After);
+
+            ImportPhase m_CacheRead;
+            ImportPhase m_Parse;
+            ImportPhase m_ImageDecode;
+            ImportPhase m_MipGeneration;
+            ImportPhase m_TextureCompression;
+            ImportPhase m_TextureCache;
+            ImportPhase m_AccessorDecode;
+            ImportPhase m_MeshOptimization;
+            ImportPhase m_MeshAnalysis;
+            ImportPhase m_TangentGeneration;
+            ImportPhase m_MeshletBuild;
+            ImportPhase m_MaterialBuild;
+            ImportPhase m_NodeTraversal;
+            ImportPhase m_SkeletonBuild;
+            ImportPhase m_Upload;
+            ImportPhase m_CacheWrite;
+
+            std::mutex m_StatisticsMutex;
+            hlp::MeshStatistics m_StatisticsBefore;
+            hlp::MeshStatistics m_StatisticsAfter;
+        };
+
+        // Where to decode an image from, either a file or encoded data in memory
+        struct ImageSource
+        {
+            std::string m_Path;
+            ByteSpan m_EncodedData;
+            bool m_NormalMap = false; // Only the X and Y of normal maps are kept when they are compressed
+        };
+
+        // Texel data of an image, decoded on a worker thread.
+        // Images that are already registered are not decoded, and hold on to their texture instead.
+        struct ImageData
+        {
+            TextureRegistry::Key m_Key;
+            std::string m_Path;
+            TextureRegistry::FileStamp m_Stamp;     // Of the file at m_Path when it was hashed
+            std::shared_ptr<Texture> m_SharedTexture;
+
+            TextureData m_Texels;
+        };
+
+        // Vertex and index data of a primitive, prepared on a worker thread.
+        // The views point either into the glTF buffers or into the generated streams below,
+        // so the struct can be moved but not copied without invalidating them.
+        // In the interleaved layout all attributes but the positions are merged into m_InterleavedAttributes,
+        // and their separate views are left empty.
+        struct PrimitiveData
+        {
+            hlp::AccessorView m_Positions;
+            hlp::AccessorView m_InterleavedAttributes;
+            hlp::AccessorView m_TexCoords;
+            hlp::AccessorView m_Colors;
+            hlp::AccessorView m_Normals;
+            hlp::AccessorView m_Tangents;
+            hlp::AccessorView m_Joints;
+            hlp::AccessorView m_Weights;
+            hlp::AccessorView m_SkinAttributes;     // The joints and weights packed into Mesh::SkinVertex, in every layout
+            hlp::AccessorView m_Indices;
+            hlp::AccessorView m_Meshlets;
+            hlp::AccessorView m_MorphVertices;
+            hlp::AccessorView m_MorphTargets;
+            hlp::AccessorView m_MorphDeltas;
+            hlp::AccessorView m_MorphSlots;
+
+            // POSITION, NORMAL and TANGENT deltas of every morph target, which are empty for attributes a target does not have
+            std::vector<hlp::AccessorView> m_TargetStreams;
+
+            std::vector<glm::vec4> m_GeneratedColors;
+            std::vector<glm::vec4> m_GeneratedTangents;
+            std::vector<uint16_t> m_WidenedIndices;
+            std::vector<glm::vec3> m_OptimizedPositions;
+            std::vector<std::vector<uint8_t>> m_OptimizedStreams;
+            std::vector<uint32_t> m_OptimizedIndices;
+            std::vector<uint16_t> m_NarrowedIndices;
+            std::vector<Mesh::InterleavedVertex> m_InterleavedVertices;
+            std::vector<Mesh::QuantizedVertex> m_QuantizedVertices;
+            std::vector<glm::u8vec4> m_QuantizedColors;
+            std::vector<Mesh::SkinVertex> m_SkinVertices;
+            std::vector<Mesh::Meshlet> m_GeneratedMeshlets;
+            hlp::MorphTargetData m_GeneratedMorphTargets;
+
+            glm::vec3 m_BoundsMin;
+            glm::vec3 m_BoundsMax;
+            int32_t m_Material;
+        };
+
+        // A node of a scene which references a mesh, with its transform already resolved to world space.
+        // Skinned meshes are placed by their skeleton, so their transform is left at identity.
+        struct NodeInstance
+        {
+            int32_t m_Mesh;
+            int32_t m_Skin = -1;
+            std::unique_ptr<Transform> m_Transform;
+        };
+
+        using PrimitiveFutures = std::vector<std::vector<std::future<PrimitiveData>>>;
+        using SceneNodes = std::vector<std::vector<NodeInstance>>;
+
+        // Resources of one submitted upload batch, which are handed out once the batch is resident
+        struct PendingBatch
+        {
+            std::shared_ptr<UploadBatch> m_Batch; // Shared with the texture registry, until it is resident
+            std::vector<std::pair<uint32_t, std::shared_ptr<Texture>>> m_Textures;  // Image index and texture
+            std::vector<std::pair<uint32_t, Mesh::Primitive>> m_Primitives;         // Mesh index and primitive
+        };
+
+        // A texture of another image, which is handed out once that image is resident
+        struct SharedTexture
+        {
+            uint32_t m_Image;
+            TextureRegistry::Key m_Key;
+            std::shared_ptr<Texture> m_Texture;
+        };
+
+        // A file that is being loaded, with everything the workers and the pending uploads still reference.
+        // Heap allocated, since the workers hold on to its timings and source.
+        struct StreamingLoad
+        {
+            std::string m_Path;
+            GLTFResource* m_Resource;
+            std::chrono::steady_clock::time_point m_Start;
+            ImportTimings m_Timings;
+
+            // Only one of the two is set, depending on whether the file is imported or loaded from its cache
+            std::unique_ptr<GltfSource> m_Source;
+            std::unique_ptr<MeshCache> m_Cache;
+
+            std::vector<MeshCache::MaterialEntry> m_MaterialEntries;
+            SceneNodes m_SceneNodes;
+
+            // Decoded on the workers and uploaded in the order they finish in, a future is no longer valid once its result is staged.
+            // Images that were found in the texture registry by their path have no future at all.
+            // Decoded primitives are kept for the cache, and are indexed like their futures.
+            std::vector<std::future<ImageData>> m_Images;
+            std::vector<std::future<PrimitiveData>> m_Primitives;
+            std::vector<PrimitiveData> m_DecodedPrimitives;
+            std::vector<uint32_t> m_PrimitiveMeshes;
+            std::vector<uint32_t> m_PrimitiveIndices;   // Index of the primitive in its mesh
+
+            std::vector<PendingBatch> m_PendingBatches;
+            std::vector<SharedTexture> m_SharedTextures;
+            uint32_t m_NumPublished = 0;
+
+            std::future<void> m_CacheWrite;
+        };
+
+        // Reads the structure of the file and queues up the decoding of its images and primitives
+        std::unique_ptr<StreamingLoad> BeginLoad(const std::string& a_Path, GLTFResource& a_Res);
+        void BeginImport(StreamingLoad& a_Load);
+        void BeginLoadFromCache(StreamingLoad& a_Load);
+        // Creates the materials, empty meshes and scenes of the resource, which are filled in as the data becomes resident
+        void BeginStreaming(StreamingLoad& a_Load, PrimitiveFutures& a_Primitives);
+
+        // Moves the load forward without blocking and returns true once it is complete
+        bool StepLoad(StreamingLoad& a_Load, uint64_t& a_StagingBudget);
+        void StageDecodedData(StreamingLoad& a_Load, uint64_t& a_StagingBudget);
+        void PublishResidentBatches(StreamingLoad& a_Load);
+        // Blocks until the load is complete
+        void FinishLoad(StreamingLoad& a_Load);
+        // Finishes the load of the resource if it is still streaming and hands it over, with the primitives it decoded.
+        // Returns nullptr if the resource was loaded before.
+        std::unique_ptr<StreamingLoad> TakeFinishedLoad(GLTFResource& a_Res);
+        // Waits for every worker job that references the load
+        static void WaitForWorkers(StreamingLoad& a_Load);
+
+        void WriteCache(const std::string& a_Path, const GltfSource& a_Source, const std::vector<PrimitiveData>& a_DecodedPrimitives,
+                        const SceneNodes& a_SceneNodes, const std::vector<std::shared_ptr<const Skeleton>>& a_Skeletons);
 
-        std::vector<std::shared_ptr<Texture>> LoadTextures(fx::gltf::Document& a_Doc, std::string a_Filepath);
-        std::vector<std::shared_ptr<Material>> LoadMaterials(fx::gltf::Document& a_Doc, GLTFResource& a_Res);
-        std::vector<std::shared_ptr<Mesh>> LoadMeshes(fx::gltf::Document& a_Doc, GLTFResource& a_Res);
-        std::vector<std::shared_ptr<Scene>> LoadScenes(fx::gltf::Document& a_Doc, GLTFResource& a_Res);
+        static std::vector<ImageSource> GetImageSources(const GltfSource& a_Source);
+        static std::vector<MeshCache::MaterialEntry> DescribeMaterials(const fx::gltf::Document& a_Doc);
 
-        std::unique_ptr<VertexBuffer> GenerateTangents(std::vector<uint8_t>& a_PositionData, std::vector<uint8_t>& a_TexData, std::vector<uint32_t>& a_Indices);
+        // Marks the images the materials of the load use as normal maps, and queues the decoding of those that are not registered yet
+        void DecodeImages(StreamingLoad& a_Load, std::vector<ImageSource> a_Images);
+        // Compressed textures are cached by the hash of their encoded image, so they are found again no matter which file uses them
+        static std::string GetTextureCachePath(const TextureRegistry::Key& a_Key);
+        PrimitiveFutures DecodePrimitives(const GltfSource& a_Source, ImportTimings& a_Timings);
+        static PrimitiveFutures ReadCachedPrimitives(const MeshCache& a_Cache);
+        static PrimitiveData DecodePrimitive(const GltfSource& a_Source, const fx::gltf::Mesh& a_Mesh, const fx::gltf::Primitive& a_Primitive,
+                                             EVertexLayout a_VertexLayout, bool a_Optimize, ImportTimings& a_Timings);
+        // Welds the vertices of an indexed or non-indexed triangle list, reorders them and their triangles and narrows the indices.
+        // Only runs on float positions, and leaves the primitive as it is if its attributes have different vertex counts.
+        static void OptimizePrimitive(PrimitiveData& a_Data, ImportTimings& a_Timings);
+        static void InterleaveAttributes(PrimitiveData& a_Data);
+        // Packs the joints and weights into Mesh::SkinVertex, leaving the primitive unskinned if either of them is missing
+        static void PackSkinAttributes(PrimitiveData& a_Data);
+        static void QuantizeAttributes(PrimitiveData& a_Data);
+        static SceneNodes TraverseScenes(const fx::gltf::Document& a_Doc);
 
-        void LoadNode(fx::gltf::Document& a_Doc, GLTFResource& a_Res, int32_t a_NodeIndex, const Transform& a_NodeParent,
-                      Scene& a_Scene);
+        // Builds a skeleton for every skin of the file, each with the channels of the animations that move its bones
+        static std::vector<std::shared_ptr<const Skeleton>> LoadSkeletons(const GltfSource& a_Source);
+        static std::shared_ptr<Skeleton> LoadSkeleton(const GltfSource& a_Source, const fx::gltf::Skin& a_Skin);
+        static std::vector<std::shared_ptr<const Skeleton>> ReadCachedSkeletons(const MeshCache& a_Cache);
 
-        void GetNodeTransform(fx::gltf::Node& a_Node, Transform& a_Transform);
+        // Materials start out with the default textures, their own textures are set once they are resident
+        std::vector<std::shared_ptr<Material>> LoadMaterials(const std::vector<MeshCache::MaterialEntry>& a_Materials);
+        void SetMaterialTextures(const StreamingLoad& a_Load, uint32_t a_Image, const std::shared_ptr<Texture>& a_Texture);
+        void UploadPrimitive(const PrimitiveData& a_Data, const GLTFResource& a_Res, UploadBatch& a_Batch, Mesh::Primitive& a_Primitive);
+        std::vector<std::shared_ptr<Scene>> LoadScenes(const SceneNodes& a_SceneNodes, GLTFResource& a_Res);
 
-        template<typename AttributeType>
-        std::unique_ptr<VertexBuffer> LoadVertexBuffer(fx::gltf::Document& a_Doc, int32_t a_AccessorIndex) const;
-        std::unique_ptr<VertexBuffer> MakeVertexBuffer(std::vector<uint8_t>& a_Data, uint32_t a_AttributeSize) const;
+        static void LoadNode(const fx::gltf::Document& a_Doc, int32_t a_NodeIndex, const Transform& a_NodeParent,
+                             std::vector<NodeInstance>& a_Instances);
 
-        std::vector<uint32_t> LoadIndices(fx::gltf::Document& a_Doc, int32_t a_AccessorIndex);
-        std::unique_ptr<IndexBuffer> LoadIndexBuffer(fx::gltf::Document& a_Doc, int32_t a_AccessorIndex);
+        static void GetNodeTransform(const fx::gltf::Node& a_Node, Transform& a_Transform);
 
-        std::vector<uint8_t> LoadRawData(fx::gltf::Document& a_Doc, int32_t a_AccessorIndex) const;
+        static std::vector<uint32_t> UnpackIndices(const hlp::AccessorView& a_Indices);
 
         ServiceLocator& m_Services;
+        EVertexLayout m_VertexLayout;
+        bool m_OptimizeMeshes;
+        bool m_GenerateMipmaps;
+        bool m_CompressTextures;
 
         std::map<std::string, GLTFResource> m_LoadedGLTFs;
+        TextureRegistry m_TextureRegistry;
+        TextureStreamer m_TextureStreamer;
+        std::vector<std::unique_ptr<StreamingLoad>> m_StreamingLoads;
 
         std::shared_ptr<Sampler> m_DefaultSampler;
         std::shared_ptr<Texture> m_DefaultDiffuse;
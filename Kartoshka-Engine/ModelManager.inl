@@ -1,12 +1,15 @@
-
-template <typename AttributeType>
-std::unique_ptr<krt::VertexBuffer> krt::ModelManager::LoadVertexBuffer(fx::gltf::Document& a_Doc, int32_t a_AccessorIndex) const
+template <typename Function>
+void krt::ModelManager::ImportPhase::Measure(Function&& a_Function)
 {
-    if (a_AccessorIndex >= 0)
-    {
-        auto data = LoadRawData(a_Doc, a_AccessorIndex);
+    auto start = std::chrono::steady_clock::now();
+    a_Function();
+    auto end = std::chrono::steady_clock::now();
 
-        return MakeVertexBuffer(data, static_cast<uint32_t>(sizeof(AttributeType)));
-    }
-    return nullptr;
-}
\ No newline at end of file
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    if (m_NumTasks == 0 || start < m_FirstStart)
+        m_FirstStart = start;
+    if (m_NumTasks == 0 || end > m_LastEnd)
+        m_LastEnd = end;
+    m_BusyTime += end - start;
+    m_NumTasks++;
+}
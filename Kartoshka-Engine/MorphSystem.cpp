@@ -0,0 +1,152 @@
+#include "MorphSystem.h"
+
+#include "ThreadPool.h"
+#include "Scene.h"
+#include "StaticMesh.h"
+#include "MorphTargets.h"
+#include "Buffer.h"
+#include "CommandBuffer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <future>
+#include <unordered_set>
+
+namespace
+{
+    // Outputs are placed at offsets that suit any vertex attribute
+    const uint64_t OutputAlignment = 16;
+
+    uint64_t GetAlignedSize(const krt::hlp::AccessorView& a_Output)
+    {
+        return (a_Output.GetSizeInBytes() + OutputAlignment - 1) / OutputAlignment * OutputAlignment;
+    }
+}
+
+krt::MorphSystem::MorphSystem(ThreadPool& a_ThreadPool)
+    : m_ThreadPool(a_ThreadPool)
+{
+}
+
+void krt::MorphSystem::Update(const Scene& a_Scene)
+{
+    auto start = std::chrono::steady_clock::now();
+    m_Statistics = Statistics();
+
+    // Every primitive gets its range of the staging memory before the jobs start, so they write to it without synchronization
+    m_Entries.clear();
+    m_Offsets.clear();
+    uint64_t size = 0;
+
+    std::unordered_set<const Mesh*> blended;
+
+    for (auto& staticMesh : a_Scene.m_StaticMeshes)
+    {
+        auto* mesh = staticMesh->GetMesh().get();
+        if (!staticMesh->m_Enabled || !mesh || mesh->m_MorphWeights.empty() || !blended.insert(mesh).second)
+            continue;
+
+        for (auto& primitive : mesh->m_Primitives)
+        {
+            auto* morphTargets = primitive.m_MorphTargets.get();
+            if (!morphTargets)
+                continue;
+
+            m_Entries.push_back({ morphTargets, &mesh->m_MorphWeights, size });
+            m_Offsets.emplace(morphTargets, size);
+
+            for (auto& output : morphTargets->GetOutputs())
+                size += GetAlignedSize(output.m_Data);
+
+            m_Statistics.m_NumTargets += morphTargets->GetNumTargets();
+            m_Statistics.m_NumMorphedVertices += morphTargets->GetNumMorphedVertices();
+
+            auto numTargets = std::min<size_t>(morphTargets->GetNumTargets(), mesh->m_MorphWeights.size());
+            m_Statistics.m_ActiveTargets += static_cast<uint32_t>(std::count_if(mesh->m_MorphWeights.begin(),
+                mesh->m_MorphWeights.begin() + numTargets, [](float a_Weight) { return a_Weight != 0.0f; }));
+        }
+    }
+
+    m_Statistics.m_NumPrimitives = static_cast<uint32_t>(m_Entries.size());
+    m_Statistics.m_UploadSize = size;
+    m_Staging.resize(size);
+
+    auto numEntries = static_cast<uint32_t>(m_Entries.size());
+    auto numJobs = std::min(m_ThreadPool.GetThreadCount(), (numEntries + MinPrimitivesPerJob - 1) / MinPrimitivesPerJob);
+
+    // Each job reports the number of deltas it applied and the time it spent blending
+    using JobResult = std::pair<uint64_t, std::chrono::steady_clock::duration>;
+    std::vector<std::future<JobResult>> jobs;
+    jobs.reserve(numJobs);
+
+    for (uint32_t job = 0; job < numJobs; job++)
+    {
+        uint32_t first = numEntries * job / numJobs;
+        uint32_t last = numEntries * (job + 1) / numJobs;
+
+        jobs.push_back(m_ThreadPool.Enqueue([this, first, last]()
+        {
+            uint64_t numDeltas = 0;
+            std::chrono::steady_clock::duration blendTime(0);
+
+            for (uint32_t i = first; i < last; i++)
+            {
+                auto& entry = m_Entries[i];
+
+                auto blendStart = std::chrono::steady_clock::now();
+                numDeltas += entry.m_MorphTargets->Blend(*entry.m_Weights);
+                blendTime += std::chrono::steady_clock::now() - blendStart;
+
+                auto offset = entry.m_Offset;
+                for (auto& output : entry.m_MorphTargets->GetOutputs())
+                {
+                    output.m_Data.CopyTo(m_Staging.data() + offset);
+                    offset += GetAlignedSize(output.m_Data);
+                }
+            }
+
+            return JobResult(numDeltas, blendTime);
+        }));
+    }
+
+    std::chrono::steady_clock::duration blendTime(0);
+    for (auto& job : jobs)
+    {
+        auto result = job.get();
+        m_Statistics.m_NumDeltas += result.first;
+        blendTime += result.second;
+    }
+
+    using Milliseconds = std::chrono::duration<float, std::milli>;
+    m_Statistics.m_BlendTime = std::chrono::duration_cast<Milliseconds>(blendTime).count();
+    m_Statistics.m_WallTime = std::chrono::duration_cast<Milliseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+void krt::MorphSystem::Upload(CommandBuffer& a_CommandBuffer)
+{
+    m_Buffer = {};
+    if (m_Staging.empty())
+        return;
+
+    m_Buffer = a_CommandBuffer.CreateTransientBuffer(m_Staging.data(), m_Staging.size());
+}
+
+void krt::MorphSystem::BindVertexBuffers(CommandBuffer& a_CommandBuffer, const Mesh::Primitive& a_Primitive, bool a_PositionsOnly) const
+{
+    if (!a_Primitive.m_MorphTargets || !m_Buffer.m_Buffer)
+        return;
+
+    auto offset = m_Offsets.find(a_Primitive.m_MorphTargets.get());
+    if (offset == m_Offsets.end())
+        return;
+
+    auto position = m_Buffer.m_Offset + offset->second;
+    for (auto& output : a_Primitive.m_MorphTargets->GetOutputs())
+    {
+        a_CommandBuffer.SetVertexBuffer(*m_Buffer.m_Buffer, output.m_Binding, position);
+        if (a_PositionsOnly)
+            break;
+
+        position += GetAlignedSize(output.m_Data);
+    }
+}
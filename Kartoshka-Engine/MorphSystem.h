@@ -0,0 +1,79 @@
+#pragma once
+
+#include "Mesh.h"
+#include "FrameAllocator.h"
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace krt
+{
+    class ThreadPool;
+    class Scene;
+    class CommandBuffer;
+    class MorphTargets;
+}
+
+namespace krt
+{
+    // Blends the morph targets of the meshes of a scene on the worker threads, with the weights of each mesh.
+    // The blended streams of all primitives are gathered in one buffer, which is bound over the streams of the primitives when they are drawn.
+    // All static meshes that share a mesh share its weights, so they stay instances of one another.
+    class MorphSystem
+    {
+    public:
+
+        struct Statistics
+        {
+            uint32_t m_NumPrimitives = 0;       // Primitives with morph targets that were blended
+            uint32_t m_NumTargets = 0;          // Summed over those primitives
+            uint32_t m_ActiveTargets = 0;       // Targets with a non-zero weight
+            uint32_t m_NumMorphedVertices = 0;  // Vertices any of the targets move
+            uint64_t m_NumDeltas = 0;           // Deltas that were applied
+            uint64_t m_UploadSize = 0;          // Bytes of blended streams copied into every command buffer
+            float m_WallTime = 0.0f;            // Milliseconds the update took on the calling thread
+            float m_BlendTime = 0.0f;           // Milliseconds the workers spent blending, summed over all of them
+        };
+
+        explicit MorphSystem(ThreadPool& a_ThreadPool);
+
+        MorphSystem(MorphSystem&) = delete;
+        MorphSystem(MorphSystem&&) = delete;
+        MorphSystem& operator=(MorphSystem&) = delete;
+        MorphSystem& operator=(MorphSystem&&) = delete;
+
+        // Blends the primitives of the meshes the enabled static meshes use, which have to stay loaded until the next update
+        void Update(const Scene& a_Scene);
+
+        // Copies the blended streams into a buffer that is kept alive by the command buffer, which has to happen once per command buffer
+        void Upload(CommandBuffer& a_CommandBuffer);
+        // Binds the blended streams of a primitive over the ones Primitive::BindVertexBuffers bound, or only its positions with a_PositionsOnly.
+        // Primitives without morph targets, and those that were loaded after the update, keep their own streams.
+        void BindVertexBuffers(CommandBuffer& a_CommandBuffer, const Mesh::Primitive& a_Primitive, bool a_PositionsOnly = false) const;
+
+        const Statistics& GetStatistics() const { return m_Statistics; }
+
+    private:
+
+        struct Entry
+        {
+            MorphTargets* m_MorphTargets;
+            const std::vector<float>* m_Weights;
+            uint64_t m_Offset;  // Of the first output in the staging memory
+        };
+
+        // Fewer primitives are not worth the overhead of a job of their own
+        static const uint32_t MinPrimitivesPerJob = 4;
+
+        ThreadPool& m_ThreadPool;
+
+        std::vector<Entry> m_Entries;
+        std::unordered_map<const MorphTargets*, uint64_t> m_Offsets;
+        std::vector<uint8_t> m_Staging;
+
+        FrameAllocator::Allocation m_Buffer;
+
+        Statistics m_Statistics;
+    };
+}
@@ -0,0 +1,293 @@
+#include "MorphTargets.h"
+
+#include "VertexQuantization.h"
+
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+
+#include <xmmintrin.h>
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+namespace
+{
+    // Deltas this small do not move a vertex visibly, exporters often write them for vertices a target does not touch
+    const float MinDelta = 1e-7f;
+
+    bool IsZero(const glm::vec4& a_Delta)
+    {
+        return glm::all(glm::lessThanEqual(glm::abs(a_Delta), glm::vec4(MinDelta)));
+    }
+}
+
+krt::MorphTargets::MorphTargets(EVertexLayout a_Layout, const hlp::AccessorView& a_Positions, const hlp::AccessorView& a_Attributes,
+                                const hlp::AccessorView& a_Normals, const hlp::AccessorView& a_Tangents, const hlp::AccessorView& a_Vertices,
+                                const hlp::AccessorView& a_Targets, const hlp::AccessorView& a_Deltas, const hlp::AccessorView& a_Slots)
+    : m_Layout(a_Layout)
+    , m_MorphsNormals(false)
+{
+    m_Vertices = a_Vertices.ToVector<uint32_t>();
+    m_Targets = a_Targets.ToVector<Target>();
+    m_Deltas = a_Deltas.ToVector<Delta>();
+    m_Slots = a_Slots.ToVector<uint32_t>();
+    m_Positions = a_Positions.ToVector<glm::vec3>();
+
+    auto numVertices = m_Positions.size();
+
+    for (auto& delta : m_Deltas)
+        m_MorphsNormals |= !IsZero(delta.m_Normal) || !IsZero(delta.m_Tangent);
+
+    // The separate layout can only have its normals morphed if it has float normals and tangents to write them to
+    if (m_Layout == ESeparateVertexStreams)
+    {
+        m_MorphsNormals &= a_Normals.Size() == numVertices && a_Normals.GetElementSize() == sizeof(glm::vec3) &&
+                           a_Tangents.Size() == numVertices && a_Tangents.GetElementSize() == sizeof(glm::vec4);
+    }
+
+    if (m_MorphsNormals)
+    {
+        if (m_Layout == ESeparateVertexStreams)
+        {
+            m_Attributes.resize(a_Normals.GetSizeInBytes());
+            a_Normals.CopyTo(m_Attributes.data());
+            m_Tangents = a_Tangents.ToVector<glm::vec4>();
+        }
+        else
+        {
+            m_Attributes.resize(a_Attributes.GetSizeInBytes());
+            a_Attributes.CopyTo(m_Attributes.data());
+        }
+    }
+
+    m_BaseVertices.resize(m_Vertices.size());
+    m_Accumulated.resize(m_Vertices.size());
+
+    for (size_t i = 0; i < m_Vertices.size(); i++)
+    {
+        auto vertex = m_Vertices[i];
+        auto& base = m_BaseVertices[i];
+        base.m_Position = glm::vec4(m_Positions[vertex], 0.0f);
+        base.m_Normal = glm::vec4(0.0f, 0.0f, 1.0f, 0.0f);
+        base.m_Tangent = glm::vec4(1.0f, 0.0f, 0.0f, 1.0f);
+
+        if (!m_MorphsNormals)
+            continue;
+
+        if (m_Layout == ESeparateVertexStreams)
+        {
+            base.m_Normal = glm::vec4(reinterpret_cast<const glm::vec3*>(m_Attributes.data())[vertex], 0.0f);
+            base.m_Tangent = m_Tangents[vertex];
+        }
+        else if (m_Layout == EInterleavedVertexAttributes)
+        {
+            auto& interleaved = reinterpret_cast<const Mesh::InterleavedVertex*>(m_Attributes.data())[vertex];
+            base.m_Normal = glm::vec4(interleaved.m_Normal, 0.0f);
+            base.m_Tangent = interleaved.m_Tangent;
+        }
+        else
+        {
+            auto& quantized = reinterpret_cast<const Mesh::QuantizedVertex*>(m_Attributes.data())[vertex];
+            base.m_Normal = glm::vec4(hlp::DecodeOctahedral(glm::vec2(quantized.m_Normal) / 32767.0f), 0.0f);
+            base.m_Tangent = hlp::DecodeTangent(quantized.m_Tangent);
+        }
+    }
+
+    m_Outputs.push_back({ 0, hlp::AccessorView::FromVector(m_Positions) });
+
+    if (m_MorphsNormals)
+    {
+        if (m_Layout == ESeparateVertexStreams)
+        {
+            m_Outputs.push_back({ 3, hlp::AccessorView(m_Attributes.data(), numVertices, sizeof(glm::vec3), sizeof(glm::vec3)) });
+            m_Outputs.push_back({ 4, hlp::AccessorView::FromVector(m_Tangents) });
+        }
+        else
+        {
+            auto stride = static_cast<uint32_t>(m_Attributes.size() / std::max<size_t>(numVertices, 1));
+            m_Outputs.push_back({ 1, hlp::AccessorView(m_Attributes.data(), numVertices, stride, stride) });
+        }
+    }
+}
+
+std::vector<float> krt::MorphTargets::GetDefaultWeights() const
+{
+    std::vector<float> weights;
+    weights.reserve(m_Targets.size());
+
+    for (auto& target : m_Targets)
+        weights.push_back(target.m_DefaultWeight);
+
+    return weights;
+}
+
+void krt::MorphTargets::ExpandBounds(glm::vec3& a_Min, glm::vec3& a_Max) const
+{
+    // Every target pulls a vertex along its own delta, so the farthest it can get is the sum of the deltas pointing the same way
+    std::vector<glm::vec3> lower(m_Vertices.size(), glm::vec3(0.0f));
+    std::vector<glm::vec3> upper(m_Vertices.size(), glm::vec3(0.0f));
+
+    for (size_t i = 0; i < m_Deltas.size(); i++)
+    {
+        glm::vec3 delta(m_Deltas[i].m_Position);
+        lower[m_Slots[i]] += glm::min(delta, glm::vec3(0.0f));
+        upper[m_Slots[i]] += glm::max(delta, glm::vec3(0.0f));
+    }
+
+    for (size_t i = 0; i < m_Vertices.size(); i++)
+    {
+        glm::vec3 position(m_BaseVertices[i].m_Position);
+        a_Min = glm::min(a_Min, position + lower[i]);
+        a_Max = glm::max(a_Max, position + upper[i]);
+    }
+}
+
+uint64_t krt::MorphTargets::Blend(const std::vector<float>& a_Weights)
+{
+    if (a_Weights == m_BlendedWeights)
+        return 0;
+
+    m_BlendedWeights = a_Weights;
+    memset(m_Accumulated.data(), 0, m_Accumulated.size() * sizeof(Delta));
+
+    uint64_t numApplied = 0;
+    auto numTargets = std::min(a_Weights.size(), m_Targets.size());
+
+    for (size_t i = 0; i < numTargets; i++)
+    {
+        // Most targets of a face rig are inactive at any time, those cost nothing
+        if (a_Weights[i] == 0.0f)
+            continue;
+
+        auto& target = m_Targets[i];
+        const __m128 weight = _mm_set1_ps(a_Weights[i]);
+        const Delta* deltas = m_Deltas.data() + target.m_FirstDelta;
+        const uint32_t* slots = m_Slots.data() + target.m_FirstDelta;
+
+        if (m_MorphsNormals)
+        {
+            for (uint32_t j = 0; j < target.m_NumDeltas; j++)
+            {
+                float* sum = &m_Accumulated[slots[j]].m_Position.x;
+                const float* delta = &deltas[j].m_Position.x;
+
+                _mm_storeu_ps(sum, _mm_add_ps(_mm_loadu_ps(sum), _mm_mul_ps(weight, _mm_loadu_ps(delta))));
+                _mm_storeu_ps(sum + 4, _mm_add_ps(_mm_loadu_ps(sum + 4), _mm_mul_ps(weight, _mm_loadu_ps(delta + 4))));
+                _mm_storeu_ps(sum + 8, _mm_add_ps(_mm_loadu_ps(sum + 8), _mm_mul_ps(weight, _mm_loadu_ps(delta + 8))));
+            }
+        }
+        else
+        {
+            for (uint32_t j = 0; j < target.m_NumDeltas; j++)
+            {
+                float* sum = &m_Accumulated[slots[j]].m_Position.x;
+                _mm_storeu_ps(sum, _mm_add_ps(_mm_loadu_ps(sum), _mm_mul_ps(weight, _mm_loadu_ps(&deltas[j].m_Position.x))));
+            }
+        }
+
+        numApplied += target.m_NumDeltas;
+    }
+
+    for (size_t i = 0; i < m_Vertices.size(); i++)
+    {
+        auto& base = m_BaseVertices[i];
+        auto& sum = m_Accumulated[i];
+        glm::vec3 position = glm::vec3(base.m_Position) + glm::vec3(sum.m_Position);
+
+        if (!m_MorphsNormals)
+        {
+            m_Positions[m_Vertices[i]] = position;
+            continue;
+        }
+
+        glm::vec3 normal = glm::vec3(base.m_Normal) + glm::vec3(sum.m_Normal);
+        float normalLength = glm::length(normal);
+        normal = normalLength > 0.0f ? normal / normalLength : glm::vec3(base.m_Normal);
+
+        // Gram-Schmidt, so the tangent frame stays orthonormal even for targets without tangent deltas
+        glm::vec3 tangent = glm::vec3(base.m_Tangent) + glm::vec3(sum.m_Tangent);
+        tangent -= normal * glm::dot(normal, tangent);
+        float tangentLength = glm::length(tangent);
+        tangent = tangentLength > 0.0f ? tangent / tangentLength : glm::vec3(base.m_Tangent);
+
+        WriteVertex(m_Vertices[i], position, normal, glm::vec4(tangent, base.m_Tangent.w));
+    }
+
+    return numApplied;
+}
+
+void krt::MorphTargets::WriteVertex(uint32_t a_Vertex, const glm::vec3& a_Position, const glm::vec3& a_Normal, const glm::vec4& a_Tangent)
+{
+    m_Positions[a_Vertex] = a_Position;
+
+    if (m_Layout == ESeparateVertexStreams)
+    {
+        reinterpret_cast<glm::vec3*>(m_Attributes.data())[a_Vertex] = a_Normal;
+        m_Tangents[a_Vertex] = a_Tangent;
+    }
+    else if (m_Layout == EInterleavedVertexAttributes)
+    {
+        auto& interleaved = reinterpret_cast<Mesh::InterleavedVertex*>(m_Attributes.data())[a_Vertex];
+        interleaved.m_Normal = a_Normal;
+        interleaved.m_Tangent = a_Tangent;
+    }
+    else
+    {
+        auto& quantized = reinterpret_cast<Mesh::QuantizedVertex*>(m_Attributes.data())[a_Vertex];
+        quantized.m_Normal = hlp::EncodeOctahedral(a_Normal);
+        quantized.m_Tangent = hlp::EncodeTangent(a_Tangent);
+    }
+}
+
+krt::hlp::MorphTargetData krt::hlp::BuildMorphTargets(uint64_t a_NumVertices, const std::vector<AccessorView>& a_TargetStreams,
+                                                      const std::vector<float>& a_DefaultWeights)
+{
+    MorphTargetData data;
+    auto numTargets = a_TargetStreams.size() / 3;
+
+    // Targets store their deltas densely unless they are sparse accessors, so the zero deltas are dropped here either way
+    auto readDelta = [&](size_t a_Target, uint32_t a_Attribute, uint64_t a_Vertex)
+    {
+        auto& stream = a_TargetStreams[a_Target * 3 + a_Attribute];
+        if (stream.Size() != a_NumVertices)
+            return glm::vec4(0.0f);
+
+        return glm::vec4(glm::vec3(ReadNormalized(stream, a_Vertex, glm::vec4(0.0f))), 0.0f);
+    };
+
+    std::vector<uint32_t> slots(a_NumVertices, std::numeric_limits<uint32_t>::max());
+
+    for (size_t i = 0; i < numTargets; i++)
+    {
+        auto& target = data.m_Targets.emplace_back();
+        target.m_FirstDelta = static_cast<uint32_t>(data.m_Deltas.size());
+        target.m_DefaultWeight = i < a_DefaultWeights.size() ? a_DefaultWeights[i] : 0.0f;
+        target.m_Padding = 0;
+
+        for (uint64_t j = 0; j < a_NumVertices; j++)
+        {
+            MorphTargets::Delta delta;
+            delta.m_Position = readDelta(i, 0, j);
+            delta.m_Normal = readDelta(i, 1, j);
+            delta.m_Tangent = readDelta(i, 2, j);
+
+            if (IsZero(delta.m_Position) && IsZero(delta.m_Normal) && IsZero(delta.m_Tangent))
+                continue;
+
+            // Slots are handed out in the order the vertices are first moved in, which is in vertex order for the first target
+            if (slots[j] == std::numeric_limits<uint32_t>::max())
+            {
+                slots[j] = static_cast<uint32_t>(data.m_Vertices.size());
+                data.m_Vertices.push_back(static_cast<uint32_t>(j));
+            }
+
+            data.m_Deltas.push_back(delta);
+            data.m_Slots.push_back(slots[j]);
+        }
+
+        target.m_NumDeltas = static_cast<uint32_t>(data.m_Deltas.size()) - target.m_FirstDelta;
+    }
+
+    return data;
+}
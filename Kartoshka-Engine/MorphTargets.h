@@ -0,0 +1,120 @@
+#pragma once
+
+#include "AccessorView.h"
+#include "Mesh.h"
+
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+
+#include <cstdint>
+#include <vector>
+
+namespace krt
+{
+    // The morph targets of a primitive, stored as sparse deltas of the vertices each target moves.
+    // Blending applies the targets with a non-zero weight to the base attributes of the morphed vertices, and writes those into
+    // copies of the vertex streams they replace. All other vertices never change, so their part of the copies is written only once.
+    class MorphTargets
+    {
+    public:
+
+        // What a target adds to one vertex, w is always zero so the deltas are applied as whole SSE vectors
+        struct Delta
+        {
+            glm::vec4 m_Position;
+            glm::vec4 m_Normal;
+            glm::vec4 m_Tangent;
+        };
+
+        // The deltas of a target are stored back to back, together with the slots of the morphed vertices they apply to
+        struct Target
+        {
+            uint32_t m_FirstDelta;
+            uint32_t m_NumDeltas;
+            float m_DefaultWeight;  // From the weights of the glTF mesh
+            uint32_t m_Padding;
+        };
+
+        // A blended stream, and the vertex binding of the buffer of the primitive it replaces
+        struct Output
+        {
+            uint32_t m_Binding;
+            hlp::AccessorView m_Data;
+        };
+
+        // Takes the final streams of the primitive in the given layout, which are the separate normals and tangents or the interleaved attributes.
+        // a_Vertices lists the morphed vertices by slot, a_Slots holds the slot of every delta.
+        MorphTargets(EVertexLayout a_Layout, const hlp::AccessorView& a_Positions, const hlp::AccessorView& a_Attributes,
+                     const hlp::AccessorView& a_Normals, const hlp::AccessorView& a_Tangents, const hlp::AccessorView& a_Vertices,
+                     const hlp::AccessorView& a_Targets, const hlp::AccessorView& a_Deltas, const hlp::AccessorView& a_Slots);
+
+        // The outputs point into the morph targets
+        MorphTargets(MorphTargets&) = delete;
+        MorphTargets(MorphTargets&&) = delete;
+        MorphTargets& operator=(MorphTargets&) = delete;
+        MorphTargets& operator=(MorphTargets&&) = delete;
+
+        uint32_t GetNumTargets() const { return static_cast<uint32_t>(m_Targets.size()); }
+        uint32_t GetNumMorphedVertices() const { return static_cast<uint32_t>(m_Vertices.size()); }
+        std::vector<float> GetDefaultWeights() const;
+
+        // Grows an object space bounding box by the farthest the targets can move the vertices, with weights between 0 and 1
+        void ExpandBounds(glm::vec3& a_Min, glm::vec3& a_Max) const;
+
+        // Accumulates the deltas of the targets with a non-zero weight with SSE, and writes the morphed vertices to the outputs.
+        // Normals are renormalized, and tangents orthogonalized against them. Returns the number of deltas that were applied,
+        // which is 0 if the weights are the same as those of the previous blend, whose outputs are still valid.
+        uint64_t Blend(const std::vector<float>& a_Weights);
+
+        // The positions come first, followed by the attributes the targets change in the layout of the primitive
+        const std::vector<Output>& GetOutputs() const { return m_Outputs; }
+
+    private:
+
+        // Base attributes of a morphed vertex, which the accumulated deltas are added to
+        struct BaseVertex
+        {
+            glm::vec4 m_Position;
+            glm::vec4 m_Normal;
+            glm::vec4 m_Tangent;    // w holds the handedness, which morphing does not change
+        };
+
+        void WriteVertex(uint32_t a_Vertex, const glm::vec3& a_Position, const glm::vec3& a_Normal, const glm::vec4& a_Tangent);
+
+        EVertexLayout m_Layout;
+        bool m_MorphsNormals;   // Set if any target has normal or tangent deltas, otherwise only the positions are blended
+
+        std::vector<uint32_t> m_Vertices;
+        std::vector<Target> m_Targets;
+        std::vector<Delta> m_Deltas;
+        std::vector<uint32_t> m_Slots;
+
+        std::vector<BaseVertex> m_BaseVertices;
+        std::vector<Delta> m_Accumulated;   // One per slot
+        std::vector<float> m_BlendedWeights;
+
+        // Copies of the streams of the primitive, with the morphed vertices overwritten by every blend
+        std::vector<glm::vec3> m_Positions;
+        std::vector<uint8_t> m_Attributes;  // Interleaved or quantized vertices, or the normals of the separate layout
+        std::vector<glm::vec4> m_Tangents;  // Only used by the separate layout
+
+        std::vector<Output> m_Outputs;
+    };
+
+    namespace hlp
+    {
+        // The sparse deltas of a primitive, in the layout of the streams MorphTargets is created from
+        struct MorphTargetData
+        {
+            std::vector<uint32_t> m_Vertices;
+            std::vector<MorphTargets::Target> m_Targets;
+            std::vector<MorphTargets::Delta> m_Deltas;
+            std::vector<uint32_t> m_Slots;
+        };
+
+        // Gathers the POSITION, NORMAL and TANGENT deltas of every target, given as three views per target which may be empty.
+        // Only the deltas that are not zero are kept, and a vertex gets a slot if any target moves it.
+        MorphTargetData BuildMorphTargets(uint64_t a_NumVertices, const std::vector<AccessorView>& a_TargetStreams,
+                                          const std::vector<float>& a_DefaultWeights);
+    }
+}
@@ -122,6 +122,30 @@ VkFormat krt::PhysicalDevice::FindSupportedFormat(std::vector<VkFormat> a_Candid
     return VK_FORMAT_UNDEFINED;
 }
 
+bool krt::PhysicalDevice::SupportsBlockCompression()
+{
+    VkPhysicalDeviceFeatures features;
+    vkGetPhysicalDeviceFeatures(m_VkPhysicalDevice, &features);
+
+    return features.textureCompressionBC == VK_TRUE;
+}
+
+bool krt::PhysicalDevice::SupportsExtension(const char* a_Extension)
+{
+    uint32_t extCount;
+    vkEnumerateDeviceExtensionProperties(m_VkPhysicalDevice, nullptr, &extCount, nullptr);
+    std::vector<VkExtensionProperties> availableExtensions(extCount);
+    vkEnumerateDeviceExtensionProperties(m_VkPhysicalDevice, nullptr, &extCount, availableExtensions.data());
+
+    for (auto& ext : availableExtensions)
+    {
+        if (!strcmp(ext.extensionName, a_Extension))
+            return true;
+    }
+
+    return false;
+}
+
 uint32_t krt::PhysicalDevice::FindMemoryType(uint32_t a_MemoryType, VkMemoryPropertyFlags a_Properties)
 {
 
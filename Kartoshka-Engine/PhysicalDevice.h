@@ -51,6 +51,11 @@ namespace krt
 
         VkFormat FindSupportedFormat(std::vector<VkFormat> a_Candidates, VkImageTiling a_Tiling, VkFormatFeatureFlags a_Features);
 
+        // Whether textures can use the BC1 to BC7 formats, which is optional but supported by all desktop GPUs
+        bool SupportsBlockCompression();
+        // For optional device extensions, which are only enabled when this returns true
+        bool SupportsExtension(const char* a_Extension);
+
     private:
         uint32_t FindMemoryType(uint32_t a_MemoryType, VkMemoryPropertyFlags a_Properties);
         static bool IsDeviceSuitable(VkPhysicalDevice a_PhysicalDevice, VkSurfaceKHR a_TargetSurface, std::vector<const char*>& a_ReqExtensions);
@@ -23,7 +23,8 @@ krt::Sampler::CreateInfo krt::Sampler::CreateInfo::CreateDefault()
     info->compareOp = VK_COMPARE_OP_ALWAYS;
     info->magFilter = VK_FILTER_LINEAR;
     info->minFilter = VK_FILTER_LINEAR;
-    info->maxLod = 0.0f;
+    // Trilinear filtering over every mip level the sampled image view has
+    info->maxLod = VK_LOD_CLAMP_NONE;
     info->minLod = 0.0f;
     info->mipLodBias = 0.0f;
     info->mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
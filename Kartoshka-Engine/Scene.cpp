@@ -38,6 +38,30 @@ krt::Scene::~Scene()
 {
 }
 
+void krt::Scene::AddCopies(const Scene& a_Source, const std::vector<glm::mat4>& a_Placements)
+{
+    m_StaticMeshes.reserve(m_StaticMeshes.size() + a_Source.m_StaticMeshes.size() * a_Placements.size());
+
+    // Reserving first also keeps the source valid when a scene is copied into itself
+    auto numSourceMeshes = a_Source.m_StaticMeshes.size();
+
+    for (auto& placement : a_Placements)
+    {
+        for (size_t i = 0; i < numSourceMeshes; i++)
+        {
+            auto& source = *a_Source.m_StaticMeshes[i];
+            glm::mat4 world = placement * source.m_Transform->GetTransformationMatrix();
+
+            auto& copy = m_StaticMeshes.emplace_back(std::make_unique<StaticMesh>());
+            copy->m_Transform = std::make_unique<Transform>(world);
+            copy->m_Enabled = source.m_Enabled;
+            copy->SetMesh(source.GetMesh());
+            copy->m_Skeleton = source.m_Skeleton;
+            copy->m_Animation = source.m_Animation;
+        }
+    }
+}
+
 krt::PointLight* krt::Scene::AddPointLight()
 {
     std::unique_ptr<CubeShadowMap> cubeMap = std::make_unique<CubeShadowMap>(m_Services, 2048);
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <glm/mat4x4.hpp>
+
 #include <memory>
 #include <vector>
 
@@ -24,6 +26,10 @@ namespace krt
 
         std::vector<std::unique_ptr<StaticMesh>> m_StaticMeshes;
 
+        // Adds a copy of the static meshes of a_Source for every placement, which transforms the copy as a whole.
+        // The copies share the meshes of a_Source, so they are drawn as instances of them.
+        void AddCopies(const Scene& a_Source, const std::vector<glm::mat4>& a_Placements);
+
         PointLight* AddPointLight();
 
         DescriptorSet& GetLightsDescriptorSet(SemaphoreWait& a_WaitSemaphore) const;
@@ -14,6 +14,8 @@ namespace krt
     class GraphicsPipeline;
     class SemaphoreAllocator;
     class RenderPass;
+    class ThreadPool;
+    class FrameAllocator;
 }
 
 namespace krt
@@ -22,7 +24,13 @@ namespace krt
         : uint16_t
     {
         Forward = 0,
-        ShadowMap
+        ShadowMap,
+        ForwardConstantColor, // Only created for the quantized vertex layout
+        ForwardSkinned,
+        ForwardSkinnedConstantColor, // Only created for the quantized vertex layout
+        ShadowMapSkinned,
+        ForwardCrowd,
+        ForwardCrowdConstantColor // Only created for the quantized vertex layout
     };
 
     enum RenderPasses
@@ -41,6 +49,8 @@ namespace krt
         LogicalDevice* m_LogicalDevice;
         ModelManager* m_ModelManager;
         SemaphoreAllocator* m_SemaphoreAllocator;
+        ThreadPool* m_ThreadPool;
+        FrameAllocator* m_FrameAllocator;
 
         std::map<Pipelines, GraphicsPipeline*> m_GraphicsPipelines;
         std::map<RenderPasses, RenderPass*> m_RenderPasses;
@@ -0,0 +1,100 @@
+#include "Skeleton.h"
+
+#include "AnimationCompression.h"
+
+#include <algorithm>
+
+uint64_t krt::AnimationClip::GetMemorySize() const
+{
+    uint64_t size = 0;
+    for (auto& track : m_Tracks)
+        size += track.m_Times.size() * sizeof(uint16_t) + track.m_Values.size() * sizeof(glm::u16vec3);
+
+    return size;
+}
+
+void krt::Skeleton::SamplePose(const AnimationClip& a_Clip, float a_Time, AnimationCursor& a_Cursor, SkeletonPose& a_Pose) const
+{
+    a_Pose.m_Translations = m_RestPose.m_Translations;
+    a_Pose.m_Rotations = m_RestPose.m_Rotations;
+    a_Pose.m_Scales = m_RestPose.m_Scales;
+
+    if (a_Cursor.m_Clip != &a_Clip)
+    {
+        a_Cursor.m_Clip = &a_Clip;
+        a_Cursor.m_Keys.assign(a_Clip.m_Tracks.size(), 0);
+    }
+
+    float time = hlp::GetTrackTime(a_Time, a_Clip.m_Duration);
+    auto quantizedTime = static_cast<uint16_t>(time);
+
+    for (size_t i = 0; i < a_Clip.m_Tracks.size(); i++)
+    {
+        auto& track = a_Clip.m_Tracks[i];
+        auto& times = track.m_Times;
+        auto numKeys = static_cast<uint32_t>(times.size());
+
+        // Going back in time, which happens whenever the clip loops, is the only case that needs a search
+        auto key = a_Cursor.m_Keys[i];
+        if (key >= numKeys || times[key] > quantizedTime)
+        {
+            auto next = std::upper_bound(times.begin(), times.end(), quantizedTime);
+            key = next == times.begin() ? 0 : static_cast<uint32_t>(next - times.begin()) - 1;
+        }
+
+        while (key + 1 < numKeys && times[key + 1] <= quantizedTime)
+            key++;
+
+        a_Cursor.m_Keys[i] = key;
+
+        // Times outside of the keys clamp to the first or last key
+        auto nextKey = std::min(key + 1, numKeys - 1);
+        float span = static_cast<float>(times[nextKey]) - static_cast<float>(times[key]);
+        float factor = track.m_Step || span <= 0.0f ? 0.0f : glm::clamp((time - times[key]) / span, 0.0f, 1.0f);
+
+        auto& a = track.m_Values[key];
+        auto& b = track.m_Values[nextKey];
+
+        switch (track.m_Path)
+        {
+        case AnimationTrack::ETranslation:
+            a_Pose.m_Translations[track.m_Bone] = glm::mix(hlp::DecodeTrackVector(a, track.m_Min, track.m_Extent),
+                                                           hlp::DecodeTrackVector(b, track.m_Min, track.m_Extent), factor);
+            break;
+        case AnimationTrack::ERotation:
+            a_Pose.m_Rotations[track.m_Bone] = glm::slerp(hlp::DecodeRotation(a), hlp::DecodeRotation(b), factor);
+            break;
+        case AnimationTrack::EScale:
+            a_Pose.m_Scales[track.m_Bone] = glm::mix(hlp::DecodeTrackVector(a, track.m_Min, track.m_Extent),
+                                                     hlp::DecodeTrackVector(b, track.m_Min, track.m_Extent), factor);
+            break;
+        }
+    }
+}
+
+void krt::Skeleton::ComputePalette(const SkeletonPose& a_Pose, std::vector<glm::mat4>& a_BoneMatrices, glm::vec4* a_Palette) const
+{
+    auto numBones = GetNumBones();
+    a_BoneMatrices.resize(numBones);
+
+    // Parents come first, so every bone finds the transform of its parent already resolved
+    for (uint32_t i = 0; i < numBones; i++)
+    {
+        glm::mat4 local = glm::mat4_cast(a_Pose.m_Rotations[i]);
+        local[0] *= a_Pose.m_Scales[i].x;
+        local[1] *= a_Pose.m_Scales[i].y;
+        local[2] *= a_Pose.m_Scales[i].z;
+        local[3] = glm::vec4(a_Pose.m_Translations[i], 1.0f);
+
+        a_BoneMatrices[i] = m_Parents[i] < 0 ? local : a_BoneMatrices[m_Parents[i]] * local;
+    }
+
+    for (uint32_t i = 0; i < GetNumJoints(); i++)
+    {
+        glm::mat4 skin = a_BoneMatrices[m_JointBones[i]] * m_InverseBindMatrices[i];
+
+        // glm matrices are column major, the rows are gathered from the columns
+        for (uint32_t row = 0; row < PaletteRowsPerJoint; row++)
+            a_Palette[i * PaletteRowsPerJoint + row] = glm::vec4(skin[0][row], skin[1][row], skin[2][row], skin[3][row]);
+    }
+}
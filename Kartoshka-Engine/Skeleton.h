@@ -0,0 +1,88 @@
+#pragma once
+
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <glm/gtc/type_precision.hpp>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace krt
+{
+    // Keyframes of one property of one bone, quantized to 16 bits per component, see AnimationCompression.h.
+    // Keys that interpolation restores closely enough are left out when the track is compressed.
+    struct AnimationTrack
+    {
+        enum EPath : uint8_t
+        {
+            ETranslation,
+            ERotation,
+            EScale
+        };
+
+        uint32_t m_Bone;
+        EPath m_Path;
+        bool m_Step;                        // Holds every key until the next one instead of interpolating
+        glm::vec3 m_Min;                    // Range the translations and scales are quantized to, unused for rotations
+        glm::vec3 m_Extent;
+        std::vector<uint16_t> m_Times;      // Ascending, as a fraction of the duration of the clip
+        std::vector<glm::u16vec3> m_Values; // Translations and scales within the range, rotations as their smallest three components
+    };
+
+    struct AnimationClip
+    {
+        // Bytes of the keys of all tracks
+        uint64_t GetMemorySize() const;
+
+        std::string m_Name;
+        float m_Duration;
+        std::vector<AnimationTrack> m_Tracks;
+    };
+
+    // The key every track of a clip was last sampled at, so playback that moves forward finds its keys without searching.
+    // Belongs to a single character, and is reset whenever it samples a different clip.
+    struct AnimationCursor
+    {
+        const AnimationClip* m_Clip = nullptr;
+        std::vector<uint32_t> m_Keys;
+    };
+
+    // Local transforms of the bones of a skeleton, with one array per component so a pose is sampled one component at a time
+    struct SkeletonPose
+    {
+        std::vector<glm::vec3> m_Translations;
+        std::vector<glm::quat> m_Rotations;
+        std::vector<glm::vec3> m_Scales;
+    };
+
+    // The joints of a glTF skin together with every node above them, so a pose can be resolved without the rest of the node tree.
+    // Bones are ordered with parents before their children, and the clips only animate bones of the skeleton.
+    struct Skeleton
+    {
+        // A joint is skinned with an affine matrix, which is stored as its first three rows
+        static const uint32_t PaletteRowsPerJoint = 3;
+
+        uint32_t GetNumBones() const { return static_cast<uint32_t>(m_Parents.size()); }
+        uint32_t GetNumJoints() const { return static_cast<uint32_t>(m_JointBones.size()); }
+
+        // Starts from the rest pose, so bones the clip does not animate keep their own transform.
+        // The cursor only moves forward by the keys that were passed since the last sample, going back searches for the keys.
+        void SamplePose(const AnimationClip& a_Clip, float a_Time, AnimationCursor& a_Cursor, SkeletonPose& a_Pose) const;
+
+        // Writes PaletteRowsPerJoint rows for every joint, which take the bind pose vertices to the space of the skeleton.
+        // a_BoneMatrices is scratch memory, which ends up holding the bone transforms in the space of the skeleton.
+        void ComputePalette(const SkeletonPose& a_Pose, std::vector<glm::mat4>& a_BoneMatrices, glm::vec4* a_Palette) const;
+
+        std::vector<int32_t> m_Parents;     // -1 for the roots
+        SkeletonPose m_RestPose;
+
+        // Joints in the order of the skin, which JOINTS_0 indexes into
+        std::vector<uint32_t> m_JointBones;
+        std::vector<glm::mat4> m_InverseBindMatrices;
+
+        std::vector<AnimationClip> m_Clips;
+    };
+}
@@ -0,0 +1,131 @@
+#include "SkinningSystem.h"
+
+#include "ThreadPool.h"
+#include "Scene.h"
+#include "StaticMesh.h"
+#include "Buffer.h"
+#include "CommandBuffer.h"
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <future>
+#include <utility>
+
+krt::SkinningSystem::SkinningSystem(ThreadPool& a_ThreadPool)
+    : m_ThreadPool(a_ThreadPool)
+{
+}
+
+void krt::SkinningSystem::Update(Scene& a_Scene, float a_DeltaTime)
+{
+    auto start = std::chrono::steady_clock::now();
+    m_Statistics = Statistics();
+
+    // Every character gets its range of the palette before the jobs start, so they write to it without synchronization
+    m_Characters.clear();
+    uint32_t numRows = 0;
+
+    for (auto& staticMesh : a_Scene.m_StaticMeshes)
+    {
+        auto& skeleton = staticMesh->m_Skeleton;
+        if (!staticMesh->m_Enabled || !skeleton || !staticMesh->GetMesh())
+            continue;
+
+        auto& animation = staticMesh->m_Animation;
+        if (!skeleton->m_Clips.empty())
+        {
+            auto& clip = skeleton->m_Clips[animation.m_Clip % skeleton->m_Clips.size()];
+            animation.m_Time += a_DeltaTime * animation.m_Speed;
+
+            if (clip.m_Duration > 0.0f)
+            {
+                animation.m_Time = std::fmod(animation.m_Time, clip.m_Duration);
+                if (animation.m_Time < 0.0f)
+                    animation.m_Time += clip.m_Duration;
+            }
+        }
+
+        staticMesh->m_PaletteOffset = numRows;
+        numRows += skeleton->GetNumJoints() * Skeleton::PaletteRowsPerJoint;
+
+        m_Characters.push_back(staticMesh.get());
+        m_Statistics.m_NumJoints += skeleton->GetNumJoints();
+    }
+
+    m_Statistics.m_NumCharacters = static_cast<uint32_t>(m_Characters.size());
+    m_Palette.resize(numRows);
+
+    auto numCharacters = static_cast<uint32_t>(m_Characters.size());
+    auto numJobs = std::min(m_ThreadPool.GetThreadCount(), (numCharacters + MinCharactersPerJob - 1) / MinCharactersPerJob);
+    if (m_Scratch.size() < numJobs)
+        m_Scratch.resize(numJobs);
+
+    // Each job reports the time it spent in total and the time it spent sampling
+    using JobTimes = std::pair<std::chrono::steady_clock::duration, std::chrono::steady_clock::duration>;
+    std::vector<std::future<JobTimes>> jobs;
+    jobs.reserve(numJobs);
+
+    for (uint32_t job = 0; job < numJobs; job++)
+    {
+        uint32_t first = numCharacters * job / numJobs;
+        uint32_t last = numCharacters * (job + 1) / numJobs;
+
+        jobs.push_back(m_ThreadPool.Enqueue([this, first, last, &scratch = m_Scratch[job]]()
+        {
+            auto jobStart = std::chrono::steady_clock::now();
+            std::chrono::steady_clock::duration sampleTime(0);
+
+            for (uint32_t i = first; i < last; i++)
+            {
+                auto* character = m_Characters[i];
+                auto& skeleton = *character->m_Skeleton;
+                auto sampleStart = std::chrono::steady_clock::now();
+
+                if (skeleton.m_Clips.empty())
+                    scratch.m_Pose = skeleton.m_RestPose;
+                else
+                {
+                    auto& animation = character->m_Animation;
+                    skeleton.SamplePose(skeleton.m_Clips[animation.m_Clip % skeleton.m_Clips.size()], animation.m_Time, animation.m_Cursor,
+                                        scratch.m_Pose);
+                }
+
+                sampleTime += std::chrono::steady_clock::now() - sampleStart;
+                skeleton.ComputePalette(scratch.m_Pose, scratch.m_BoneMatrices, &m_Palette[character->m_PaletteOffset]);
+            }
+
+            return JobTimes(std::chrono::steady_clock::now() - jobStart, sampleTime);
+        }));
+    }
+
+    std::chrono::steady_clock::duration threadTime(0);
+    std::chrono::steady_clock::duration sampleTime(0);
+    for (auto& job : jobs)
+    {
+        auto times = job.get();
+        threadTime += times.first;
+        sampleTime += times.second;
+    }
+
+    using Milliseconds = std::chrono::duration<float, std::milli>;
+    m_Statistics.m_ThreadTime = std::chrono::duration_cast<Milliseconds>(threadTime).count();
+    m_Statistics.m_SampleTime = std::chrono::duration_cast<Milliseconds>(sampleTime).count();
+    m_Statistics.m_WallTime = std::chrono::duration_cast<Milliseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+void krt::SkinningSystem::Upload(CommandBuffer& a_CommandBuffer)
+{
+    m_PaletteBuffer = {};
+    if (m_Palette.empty())
+        return;
+
+    m_PaletteBuffer = a_CommandBuffer.CreateTransientStorageBuffer(m_Palette.data(), m_Palette.size() * sizeof(glm::vec4));
+}
+
+void krt::SkinningSystem::BindPalette(CommandBuffer& a_CommandBuffer, uint32_t a_Set) const
+{
+    assert(m_PaletteBuffer.m_Buffer && "No palette was uploaded for the skinned meshes.");
+    a_CommandBuffer.SetDynamicBuffer(m_PaletteBuffer, 0, a_Set);
+}
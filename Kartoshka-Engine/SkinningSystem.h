@@ -0,0 +1,77 @@
+#pragma once
+
+#include "Skeleton.h"
+#include "FrameAllocator.h"
+
+#include <glm/vec4.hpp>
+
+#include <cstdint>
+#include <vector>
+
+namespace krt
+{
+    class ThreadPool;
+    class Scene;
+    class StaticMesh;
+    class CommandBuffer;
+}
+
+namespace krt
+{
+    // Plays back the clips of the skinned static meshes of a scene and computes their joint matrices on the worker threads.
+    // The joints of all characters are gathered in one palette, which the skinned pipelines read from a dynamic storage buffer.
+    // Every static mesh remembers where its joints start in the palette, which the instance batcher passes on per instance.
+    class SkinningSystem
+    {
+    public:
+
+        struct Statistics
+        {
+            uint32_t m_NumCharacters = 0;   // Skinned static meshes that were posed
+            uint32_t m_NumJoints = 0;
+            float m_WallTime = 0.0f;        // Milliseconds the update took on the calling thread
+            float m_ThreadTime = 0.0f;      // Milliseconds the workers spent posing, summed over all of them
+            float m_SampleTime = 0.0f;      // Part of the thread time spent sampling the clips
+        };
+
+        explicit SkinningSystem(ThreadPool& a_ThreadPool);
+
+        SkinningSystem(SkinningSystem&) = delete;
+        SkinningSystem(SkinningSystem&&) = delete;
+        SkinningSystem& operator=(SkinningSystem&) = delete;
+        SkinningSystem& operator=(SkinningSystem&&) = delete;
+
+        // Advances the animations of the enabled skinned static meshes and rebuilds the palette from their poses
+        void Update(Scene& a_Scene, float a_DeltaTime);
+
+        // Copies the palette into the buffer of the current frame, which has to happen once per command buffer
+        void Upload(CommandBuffer& a_CommandBuffer);
+        // Binds the uploaded palette to binding 0 of a_Set, which has to be done after every bind of a skinned pipeline.
+        // The forward pipelines hold it in set 2 after the material and the lights, the shadow pipeline in set 0.
+        void BindPalette(CommandBuffer& a_CommandBuffer, uint32_t a_Set) const;
+
+        const Statistics& GetStatistics() const { return m_Statistics; }
+
+    private:
+
+        // Memory a job poses its characters with, which is kept across updates
+        struct Scratch
+        {
+            SkeletonPose m_Pose;
+            std::vector<glm::mat4> m_BoneMatrices;
+        };
+
+        // Fewer characters are not worth the overhead of a job of their own
+        static const uint32_t MinCharactersPerJob = 16;
+
+        ThreadPool& m_ThreadPool;
+
+        std::vector<StaticMesh*> m_Characters;
+        std::vector<Scratch> m_Scratch;
+        std::vector<glm::vec4> m_Palette;
+
+        FrameAllocator::Allocation m_PaletteBuffer;
+
+        Statistics m_Statistics;
+    };
+}
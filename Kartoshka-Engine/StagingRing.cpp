@@ -0,0 +1,172 @@
+#include "StagingRing.h"
+
+#include "ServiceLocator.h"
+#include "LogicalDevice.h"
+#include "Buffer.h"
+
+#include <cassert>
+
+namespace
+{
+    VkDeviceSize AlignUp(VkDeviceSize a_Value, VkDeviceSize a_Alignment)
+    {
+        return a_Alignment <= 1 ? a_Value : (a_Value + a_Alignment - 1) / a_Alignment * a_Alignment;
+    }
+}
+
+krt::StagingRing::StagingRing(ServiceLocator& a_Services)
+    : m_Services(a_Services)
+    , m_FrontId(1)
+    , m_Head(0)
+    , m_Tail(0)
+{
+    // Uploads are recorded on every queue, so all of them may read from the ring
+    m_Buffer = m_Services.m_LogicalDevice->CreateBuffer(RingSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, { EGraphicsQueue, EComputeQueue, ETransferQueue },
+        EStagingMemory, "Staging ring");
+}
+
+krt::StagingRing::~StagingRing()
+{
+}
+
+bool krt::StagingRing::Reserve(VkDeviceSize a_Size, VkDeviceSize a_Alignment, Range& a_Range)
+{
+    assert(a_Size != 0);
+
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    if (a_Size > RingSize)
+        return false;
+
+    if (m_Entries.empty())
+    {
+        m_Head = 0;
+        m_Tail = 0;
+    }
+
+    VkDeviceSize offset = AlignUp(m_Head, a_Alignment);
+    if (m_Entries.empty() || m_Head > m_Tail)
+    {
+        // The free space is split into the end of the ring and the start of it, up to the tail
+        if (offset + a_Size > RingSize)
+        {
+            if (a_Size > m_Tail)
+                return false;
+
+            offset = 0;
+        }
+    }
+    else if (offset + a_Size > m_Tail)
+    {
+        return false;
+    }
+
+    auto& entry = m_Entries.emplace_back();
+    entry.m_End = offset + a_Size;
+    entry.m_Released = false;
+    entry.m_Queue = ETransferQueue;
+    entry.m_SubmissionIndex = 0;
+
+    m_Head = entry.m_End;
+
+    a_Range.m_VkBuffer = m_Buffer->m_VkBuffer;
+    a_Range.m_Offset = offset;
+    a_Range.m_Size = a_Size;
+    a_Range.m_Mapped = m_Buffer->GetMappedData() + offset;
+    a_Range.m_Id = m_FrontId + m_Entries.size() - 1;
+
+    m_Statistics.m_NumReservations++;
+    m_Statistics.m_StagedBytes += a_Size;
+
+    return true;
+}
+
+void krt::StagingRing::Release(uint64_t a_Id)
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    auto* entry = FindEntry(a_Id);
+    assert(entry && !entry->m_Released);
+    entry->m_Released = true;
+
+    while (!m_Entries.empty() && m_Entries.front().m_Released)
+    {
+        m_Tail = m_Entries.front().m_End;
+        m_Entries.pop_front();
+        m_FrontId++;
+    }
+
+    if (m_Entries.empty())
+    {
+        m_Head = 0;
+        m_Tail = 0;
+    }
+}
+
+void krt::StagingRing::SetSubmission(const std::vector<uint64_t>& a_Ids, ECommandQueueType a_Queue, uint64_t a_SubmissionIndex)
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    for (auto id : a_Ids)
+    {
+        auto* entry = FindEntry(id);
+        assert(entry);
+        entry->m_Queue = a_Queue;
+        entry->m_SubmissionIndex = a_SubmissionIndex;
+    }
+}
+
+bool krt::StagingRing::GetOldestSubmission(ECommandQueueType& a_Queue, uint64_t& a_SubmissionIndex) const
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    if (m_Entries.empty() || m_Entries.front().m_SubmissionIndex == 0)
+        return false;
+
+    a_Queue = m_Entries.front().m_Queue;
+    a_SubmissionIndex = m_Entries.front().m_SubmissionIndex;
+    return true;
+}
+
+void krt::StagingRing::CountWait()
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    m_Statistics.m_NumWaits++;
+}
+
+void krt::StagingRing::CountFallbackBuffer()
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    m_Statistics.m_NumFallbackBuffers++;
+}
+
+krt::StagingRing::Statistics krt::StagingRing::GetStatistics() const
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    Statistics statistics = m_Statistics;
+    statistics.m_NumLiveRanges = 0;
+    for (auto& entry : m_Entries)
+    {
+        if (!entry.m_Released)
+            statistics.m_NumLiveRanges++;
+    }
+
+    if (m_Entries.empty())
+        statistics.m_UsedBytes = 0;
+    else if (m_Head > m_Tail)
+        statistics.m_UsedBytes = m_Head - m_Tail;
+    else
+        statistics.m_UsedBytes = RingSize - m_Tail + m_Head;
+
+    return statistics;
+}
+
+krt::StagingRing::Entry* krt::StagingRing::FindEntry(uint64_t a_Id)
+{
+    if (a_Id < m_FrontId || a_Id - m_FrontId >= m_Entries.size())
+        return nullptr;
+
+    return &m_Entries[a_Id - m_FrontId];
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include "vulkan/vulkan.h"
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace krt
+{
+    struct ServiceLocator;
+    class Buffer;
+    enum ECommandQueueType : uint8_t;
+}
+
+namespace krt
+{
+    // One large, persistently mapped and coherent staging buffer which every upload copies its data through, instead of creating a staging buffer each.
+    // Ranges are handed out in a ring. The command buffer which copies from a range releases it when it is reset, which happens once its
+    // fence has signaled. Ranges may be released out of order, the ring only moves past the oldest range once it has been released.
+    class StagingRing
+    {
+    public:
+
+        static const VkDeviceSize RingSize = 64 * 1024 * 1024;
+        // Uploads larger than this are streamed through the ring in pieces of this size
+        static const VkDeviceSize ChunkSize = RingSize / 4;
+
+        struct Range
+        {
+            VkBuffer m_VkBuffer = VK_NULL_HANDLE;
+            VkDeviceSize m_Offset = 0;
+            VkDeviceSize m_Size = 0;
+            uint8_t* m_Mapped = nullptr;    // Start of the range in the mapped ring
+            uint64_t m_Id = 0;
+        };
+
+        struct Statistics
+        {
+            uint64_t m_NumReservations = 0;
+            uint64_t m_StagedBytes = 0;
+            uint64_t m_UsedBytes = 0;           // Bytes between the oldest live range and the newest one, including padding
+            uint32_t m_NumLiveRanges = 0;
+            uint64_t m_NumWaits = 0;            // Times an upload waited for a submission to free space in the ring
+            uint64_t m_NumFallbackBuffers = 0;  // Staging buffers created because the ring was held by unsubmitted uploads
+        };
+
+        explicit StagingRing(ServiceLocator& a_Services);
+        ~StagingRing();
+
+        StagingRing(StagingRing&) = delete;
+        StagingRing(StagingRing&&) = delete;
+        StagingRing& operator=(StagingRing&) = delete;
+        StagingRing& operator=(StagingRing&&) = delete;
+
+        // Reserves a_Size bytes with the given alignment. Returns false if the ring has no room for it until older ranges are released.
+        bool Reserve(VkDeviceSize a_Size, VkDeviceSize a_Alignment, Range& a_Range);
+        // The range may be reused as soon as this is called, so only call it once the device is done reading from it
+        void Release(uint64_t a_Id);
+
+        // Marks the ranges as read by a submission, which can be waited on to free them
+        void SetSubmission(const std::vector<uint64_t>& a_Ids, ECommandQueueType a_Queue, uint64_t a_SubmissionIndex);
+        // Finds the submission which holds the oldest range. Returns false if it has not been submitted yet, so waiting on it would never end.
+        bool GetOldestSubmission(ECommandQueueType& a_Queue, uint64_t& a_SubmissionIndex) const;
+
+        void CountWait();
+        void CountFallbackBuffer();
+
+        Statistics GetStatistics() const;
+
+    private:
+
+        struct Entry
+        {
+            VkDeviceSize m_End;
+            bool m_Released;
+            ECommandQueueType m_Queue;
+            uint64_t m_SubmissionIndex;     // 0 until the range has been submitted
+        };
+
+        Entry* FindEntry(uint64_t a_Id);
+
+        ServiceLocator& m_Services;
+
+        std::unique_ptr<Buffer> m_Buffer;
+
+        mutable std::mutex m_Mutex;
+        // Live ranges from oldest to newest. The ring is full when the head has caught up with the tail while there are live ranges.
+        std::deque<Entry> m_Entries;
+        uint64_t m_FrontId;
+        VkDeviceSize m_Head;
+        VkDeviceSize m_Tail;
+
+        Statistics m_Statistics;
+    };
+}
@@ -1,5 +1,8 @@
 #pragma once
 
+#include "Skeleton.h"
+
+#include <cstdint>
 #include <memory>
 
 namespace krt
@@ -10,6 +13,15 @@ namespace krt
 
 namespace krt
 {
+    // Playback of one of the clips of a skeleton, which the skinning system advances every frame
+    struct AnimationState
+    {
+        uint32_t m_Clip = 0;
+        float m_Time = 0.0f;    // Seconds into the clip
+        float m_Speed = 1.0f;
+        AnimationCursor m_Cursor;
+    };
+
     class StaticMesh
     {
     public:
@@ -24,9 +36,16 @@ namespace krt
         std::unique_ptr<Transform> m_Transform;
 
         void SetMesh(std::shared_ptr<Mesh> a_Mesh) { m_Mesh = a_Mesh; }
+        const std::shared_ptr<Mesh>& GetMesh() const { return m_Mesh; }
 
         bool m_Enabled;
 
+        // Set for meshes that are deformed by a skeleton, in which case the transform places the skeleton as a whole
+        std::shared_ptr<const Skeleton> m_Skeleton;
+        AnimationState m_Animation;
+        // First palette row of the joints of this mesh, assigned by the skinning system for the frame that is being drawn
+        uint32_t m_PaletteOffset = 0;
+
     private:
         std::shared_ptr<Mesh> m_Mesh;
     };
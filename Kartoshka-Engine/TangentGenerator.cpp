@@ -0,0 +1,274 @@
+#include "TangentGenerator.h"
+
+#include <glm/geometric.hpp>
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+
+#include <xmmintrin.h>
+
+#include <cmath>
+#include <cstdio>
+#include <numeric>
+
+namespace
+{
+    // Triangles whose texture coordinates span less than this in UV space do not contribute a tangent
+    const float MinUVDeterminant = 1e-12f;
+    // Accumulated tangents shorter than this after removing their normal component are considered degenerate
+    const float MinTangentLengthSq = 1e-30f;
+
+    // Unnormalized tangent, bitangent and normal of a single triangle.
+    // The tangent and bitangent are scaled by the ratio of the area of the triangle to its area in UV space,
+    // so large triangles contribute more to the vertices they share.
+    struct TriangleFrame
+    {
+        glm::vec3 m_Tangent;
+        glm::vec3 m_Bitangent;
+        glm::vec3 m_Normal;
+    };
+
+    // Scalar version of the SSE path, for the triangles left over after the batches of four
+    TriangleFrame ComputeTriangleFrame(const glm::vec3& a_P0, const glm::vec3& a_P1, const glm::vec3& a_P2,
+                                       const glm::vec2& a_UV0, const glm::vec2& a_UV1, const glm::vec2& a_UV2)
+    {
+        glm::vec3 edge1 = a_P1 - a_P0;
+        glm::vec3 edge2 = a_P2 - a_P0;
+        glm::vec2 deltaUV1 = a_UV1 - a_UV0;
+        glm::vec2 deltaUV2 = a_UV2 - a_UV0;
+
+        float det = deltaUV1.x * deltaUV2.y - deltaUV2.x * deltaUV1.y;
+        float r = std::abs(det) > MinUVDeterminant ? 1.0f / det : 0.0f;
+
+        TriangleFrame frame;
+        frame.m_Tangent = (edge1 * deltaUV2.y - edge2 * deltaUV1.y) * r;
+        frame.m_Bitangent = (edge2 * deltaUV1.x - edge1 * deltaUV2.x) * r;
+        frame.m_Normal = glm::cross(edge1, edge2);
+        return frame;
+    }
+
+    // Sums of the frames of all triangles sharing a vertex, the fourth component of each vector is unused
+    struct alignas(16) VertexSums
+    {
+        float m_Tangent[4];
+        float m_Bitangent[4];
+        float m_Normal[4];
+    };
+
+    // Any unit vector orthogonal to the given unit vector
+    glm::vec3 GetPerpendicular(const glm::vec3& a_Normal)
+    {
+        glm::vec3 axis = std::abs(a_Normal.x) < 0.9f ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+        return glm::normalize(glm::cross(axis, a_Normal));
+    }
+}
+
+std::vector<glm::vec4> krt::hlp::GenerateTangents(const AccessorView& a_Positions, const AccessorView& a_Normals,
+    const AccessorView& a_TexCoords, const std::vector<uint32_t>& a_Indices)
+{
+    using ComponentType = fx::gltf::Accessor::ComponentType;
+
+    auto numVertices = a_Positions.Size();
+    std::vector<glm::vec4> tangents(numVertices, glm::vec4(1.0f, 0.0f, 0.0f, 1.0f));
+
+    if (numVertices == 0 || a_Positions.GetElementSize() != sizeof(glm::vec3))
+        return tangents;
+
+    bool hasNormals = a_Normals.Size() == numVertices && a_Normals.GetElementSize() == sizeof(glm::vec3);
+    bool hasTexCoords = a_TexCoords.Size() == numVertices && a_TexCoords.GetElementSize() == sizeof(glm::vec2) &&
+                        a_TexCoords.GetComponentType() == ComponentType::Float;
+
+    auto positions = a_Positions.ToVector<glm::vec3>();
+    auto texCoords = hasTexCoords ? a_TexCoords.ToVector<glm::vec2>() : std::vector<glm::vec2>(numVertices, glm::vec2(0.0f));
+
+    // Non-indexed triangle lists are treated as if their indices were 0, 1, 2, ...
+    std::vector<uint32_t> sequentialIndices;
+    const std::vector<uint32_t>* indices = &a_Indices;
+    if (a_Indices.empty())
+    {
+        sequentialIndices.resize(numVertices - numVertices % 3);
+        std::iota(sequentialIndices.begin(), sequentialIndices.end(), 0);
+        indices = &sequentialIndices;
+    }
+
+    for (auto index : *indices)
+    {
+        if (index >= numVertices)
+        {
+            printf("Skipping tangent generation, index %u is out of range of %llu vertices.\n", index, static_cast<unsigned long long>(numVertices));
+            return tangents;
+        }
+    }
+
+    // Per vertex sums, stored as aligned 4 component vectors so every triangle corner is a single SSE add per vector.
+    // The count is padded to a multiple of four so the final pass can process four vertices at once.
+    uint64_t paddedCount = (numVertices + 3) & ~3ull;
+    std::vector<VertexSums> sums(paddedCount, VertexSums{});
+
+    if (hasNormals)
+    {
+        for (uint64_t i = 0; i < numVertices; i++)
+        {
+            auto normal = a_Normals.Get<glm::vec3>(i);
+            _mm_store_ps(sums[i].m_Normal, _mm_setr_ps(normal.x, normal.y, normal.z, 0.0f));
+        }
+    }
+
+    auto accumulate = [&](const uint32_t* a_Triangle, __m128 a_Tangent, __m128 a_Bitangent, __m128 a_Normal)
+    {
+        for (uint32_t corner = 0; corner < 3; corner++)
+        {
+            auto& vertex = sums[a_Triangle[corner]];
+            _mm_store_ps(vertex.m_Tangent, _mm_add_ps(_mm_load_ps(vertex.m_Tangent), a_Tangent));
+            _mm_store_ps(vertex.m_Bitangent, _mm_add_ps(_mm_load_ps(vertex.m_Bitangent), a_Bitangent));
+            if (!hasNormals)
+                _mm_store_ps(vertex.m_Normal, _mm_add_ps(_mm_load_ps(vertex.m_Normal), a_Normal));
+        }
+    };
+
+    uint64_t numTriangles = indices->size() / 3;
+    const uint32_t* triangles = indices->data();
+    uint64_t triangle = 0;
+
+    // Four triangles are transposed into one SSE register per component,
+    // and the resulting frames are transposed back into one register per triangle to be added to its vertices
+    for (; triangle + 4 <= numTriangles; triangle += 4)
+    {
+        const uint32_t* batch = triangles + triangle * 3;
+
+        auto gatherPosition = [&](uint32_t a_Corner, uint32_t a_Component)
+        {
+            return _mm_setr_ps(positions[batch[a_Corner]][a_Component], positions[batch[3 + a_Corner]][a_Component],
+                               positions[batch[6 + a_Corner]][a_Component], positions[batch[9 + a_Corner]][a_Component]);
+        };
+        auto gatherTexCoord = [&](uint32_t a_Corner, uint32_t a_Component)
+        {
+            return _mm_setr_ps(texCoords[batch[a_Corner]][a_Component], texCoords[batch[3 + a_Corner]][a_Component],
+                               texCoords[batch[6 + a_Corner]][a_Component], texCoords[batch[9 + a_Corner]][a_Component]);
+        };
+
+        __m128 edge1[3], edge2[3];
+        for (uint32_t c = 0; c < 3; c++)
+        {
+            __m128 p0 = gatherPosition(0, c);
+            edge1[c] = _mm_sub_ps(gatherPosition(1, c), p0);
+            edge2[c] = _mm_sub_ps(gatherPosition(2, c), p0);
+        }
+
+        __m128 u0 = gatherTexCoord(0, 0);
+        __m128 v0 = gatherTexCoord(0, 1);
+        __m128 deltaU1 = _mm_sub_ps(gatherTexCoord(1, 0), u0);
+        __m128 deltaV1 = _mm_sub_ps(gatherTexCoord(1, 1), v0);
+        __m128 deltaU2 = _mm_sub_ps(gatherTexCoord(2, 0), u0);
+        __m128 deltaV2 = _mm_sub_ps(gatherTexCoord(2, 1), v0);
+
+        // Degenerate UVs divide by zero, the resulting infinities are masked away
+        __m128 det = _mm_sub_ps(_mm_mul_ps(deltaU1, deltaV2), _mm_mul_ps(deltaU2, deltaV1));
+        __m128 absDet = _mm_andnot_ps(_mm_set1_ps(-0.0f), det);
+        __m128 valid = _mm_cmpgt_ps(absDet, _mm_set1_ps(MinUVDeterminant));
+        __m128 r = _mm_and_ps(valid, _mm_div_ps(_mm_set1_ps(1.0f), det));
+
+        __m128 tangent[4], bitangent[4], normal[4];
+        for (uint32_t c = 0; c < 3; c++)
+        {
+            tangent[c] = _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(edge1[c], deltaV2), _mm_mul_ps(edge2[c], deltaV1)), r);
+            bitangent[c] = _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(edge2[c], deltaU1), _mm_mul_ps(edge1[c], deltaU2)), r);
+        }
+        tangent[3] = bitangent[3] = normal[3] = _mm_setzero_ps();
+
+        _MM_TRANSPOSE4_PS(tangent[0], tangent[1], tangent[2], tangent[3]);
+        _MM_TRANSPOSE4_PS(bitangent[0], bitangent[1], bitangent[2], bitangent[3]);
+
+        if (!hasNormals)
+        {
+            normal[0] = _mm_sub_ps(_mm_mul_ps(edge1[1], edge2[2]), _mm_mul_ps(edge1[2], edge2[1]));
+            normal[1] = _mm_sub_ps(_mm_mul_ps(edge1[2], edge2[0]), _mm_mul_ps(edge1[0], edge2[2]));
+            normal[2] = _mm_sub_ps(_mm_mul_ps(edge1[0], edge2[1]), _mm_mul_ps(edge1[1], edge2[0]));
+            _MM_TRANSPOSE4_PS(normal[0], normal[1], normal[2], normal[3]);
+        }
+
+        for (uint32_t lane = 0; lane < 4; lane++)
+            accumulate(batch + lane * 3, tangent[lane], bitangent[lane], normal[lane]);
+    }
+
+    for (; triangle < numTriangles; triangle++)
+    {
+        const uint32_t* tri = triangles + triangle * 3;
+        auto frame = ComputeTriangleFrame(positions[tri[0]], positions[tri[1]], positions[tri[2]],
+                                          texCoords[tri[0]], texCoords[tri[1]], texCoords[tri[2]]);
+
+        accumulate(tri, _mm_setr_ps(frame.m_Tangent.x, frame.m_Tangent.y, frame.m_Tangent.z, 0.0f),
+                   _mm_setr_ps(frame.m_Bitangent.x, frame.m_Bitangent.y, frame.m_Bitangent.z, 0.0f),
+                   _mm_setr_ps(frame.m_Normal.x, frame.m_Normal.y, frame.m_Normal.z, 0.0f));
+    }
+
+    // Gram-Schmidt orthonormalization against the normal, with four vertices transposed into one register per component.
+    // The accumulated bitangent only decides the handedness.
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+
+    for (uint64_t i = 0; i < paddedCount; i += 4)
+    {
+        __m128 n[4], t[4], b[4];
+        for (uint32_t lane = 0; lane < 4; lane++)
+        {
+            n[lane] = _mm_load_ps(sums[i + lane].m_Normal);
+            t[lane] = _mm_load_ps(sums[i + lane].m_Tangent);
+            b[lane] = _mm_load_ps(sums[i + lane].m_Bitangent);
+        }
+
+        _MM_TRANSPOSE4_PS(n[0], n[1], n[2], n[3]);
+        _MM_TRANSPOSE4_PS(t[0], t[1], t[2], t[3]);
+        _MM_TRANSPOSE4_PS(b[0], b[1], b[2], b[3]);
+
+        // Vertices without a usable normal get +Z, like the scalar fallback below
+        __m128 normalLengthSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(n[0], n[0]), _mm_mul_ps(n[1], n[1])), _mm_mul_ps(n[2], n[2]));
+        __m128 normalValid = _mm_cmpgt_ps(normalLengthSq, zero);
+        __m128 normalScale = _mm_and_ps(normalValid, _mm_div_ps(one, _mm_sqrt_ps(normalLengthSq)));
+        n[0] = _mm_mul_ps(n[0], normalScale);
+        n[1] = _mm_mul_ps(n[1], normalScale);
+        n[2] = _mm_or_ps(_mm_mul_ps(n[2], normalScale), _mm_andnot_ps(normalValid, one));
+
+        __m128 nDotT = _mm_add_ps(_mm_add_ps(_mm_mul_ps(n[0], t[0]), _mm_mul_ps(n[1], t[1])), _mm_mul_ps(n[2], t[2]));
+        for (uint32_t c = 0; c < 3; c++)
+            t[c] = _mm_sub_ps(t[c], _mm_mul_ps(n[c], nDotT));
+
+        __m128 tangentLengthSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(t[0], t[0]), _mm_mul_ps(t[1], t[1])), _mm_mul_ps(t[2], t[2]));
+        __m128 tangentValid = _mm_cmpgt_ps(tangentLengthSq, _mm_set1_ps(MinTangentLengthSq));
+        __m128 tangentScale = _mm_and_ps(tangentValid, _mm_div_ps(one, _mm_sqrt_ps(tangentLengthSq)));
+        for (uint32_t c = 0; c < 3; c++)
+            t[c] = _mm_mul_ps(t[c], tangentScale);
+
+        // glTF texture coordinates have their origin in the top left, so V increases opposite to the bitangent
+        __m128 crossX = _mm_sub_ps(_mm_mul_ps(n[1], t[2]), _mm_mul_ps(n[2], t[1]));
+        __m128 crossY = _mm_sub_ps(_mm_mul_ps(n[2], t[0]), _mm_mul_ps(n[0], t[2]));
+        __m128 crossZ = _mm_sub_ps(_mm_mul_ps(n[0], t[1]), _mm_mul_ps(n[1], t[0]));
+        __m128 crossDotB = _mm_add_ps(_mm_add_ps(_mm_mul_ps(crossX, b[0]), _mm_mul_ps(crossY, b[1])), _mm_mul_ps(crossZ, b[2]));
+        __m128 handedness = _mm_or_ps(one, _mm_and_ps(_mm_cmpgt_ps(crossDotB, zero), _mm_set1_ps(-0.0f)));
+
+        _MM_TRANSPOSE4_PS(t[0], t[1], t[2], handedness);
+
+        alignas(16) glm::vec4 frames[4];
+        _mm_store_ps(&frames[0].x, t[0]);
+        _mm_store_ps(&frames[1].x, t[1]);
+        _mm_store_ps(&frames[2].x, t[2]);
+        _mm_store_ps(&frames[3].x, handedness);
+
+        int validLanes = _mm_movemask_ps(tangentValid);
+        for (uint64_t lane = 0; lane < 4 && i + lane < numVertices; lane++)
+        {
+            // Vertices whose triangles all have degenerate UVs get an arbitrary frame around their normal
+            if ((validLanes & (1 << lane)) == 0)
+            {
+                auto& sum = sums[i + lane].m_Normal;
+                glm::vec3 normal = glm::vec3(sum[0], sum[1], sum[2]);
+                float normalLength = glm::length(normal);
+                normal = normalLength > 0.0f ? normal / normalLength : glm::vec3(0.0f, 0.0f, 1.0f);
+                frames[lane] = glm::vec4(GetPerpendicular(normal), 1.0f);
+            }
+
+            tangents[i + lane] = frames[lane];
+        }
+    }
+
+    return tangents;
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include "AccessorView.h"
+
+#include <glm/vec4.hpp>
+
+#include <vector>
+
+namespace krt
+{
+    namespace hlp
+    {
+        // Generates a tangent for every vertex of a triangle list, following the conventions of MikkTSpace and glTF:
+        // xyz is a unit vector orthogonal to the vertex normal, w is the handedness of the frame,
+        // so that the bitangent is cross(normal, tangent.xyz) * w.
+        // The tangents of all triangles sharing a vertex are accumulated before they are orthonormalized,
+        // the triangles are processed four at a time with SSE.
+        // Without normals, the normals are derived from the triangles as well.
+        // Without texture coordinates, or with texture coordinates that are not 32 bit floats, an arbitrary frame around the normal is returned.
+        // An empty index list means the vertices are not indexed.
+        std::vector<glm::vec4> GenerateTangents(const AccessorView& a_Positions, const AccessorView& a_Normals,
+                                                const AccessorView& a_TexCoords, const std::vector<uint32_t>& a_Indices);
+    }
+}
@@ -7,12 +7,14 @@ krt::Texture::~Texture()
 {
     vkDestroyImageView(m_Services.m_LogicalDevice->GetVkDevice(), m_VkImageView, m_Services.m_AllocationCallbacks);
     vkDestroyImage(m_Services.m_LogicalDevice->GetVkDevice(), m_VkImage, m_Services.m_AllocationCallbacks);
-    vkFreeMemory(m_Services.m_LogicalDevice->GetVkDevice(), m_VkDeviceMemory, m_Services.m_AllocationCallbacks);
+    m_Services.m_LogicalDevice->GetMemoryTracker().Untrack(this);
+    m_Services.m_LogicalDevice->GetMemoryAllocator().Free(m_Allocation);
 }
 
 krt::Texture::Texture(ServiceLocator& a_Services, VkFormat a_Format)
     : m_Services(a_Services)
     , m_Format(a_Format)
+    , m_NumMips(1)
 {
 
 }
@@ -2,9 +2,13 @@
 
 #include "vulkan/vulkan.h"
 
+#include "DeviceMemoryAllocator.h"
+
 namespace krt
 {
     class CommandBuffer;
+    class LogicalDevice;
+    class UploadBatch;
     struct ServiceLocator;
 }
 
@@ -13,6 +17,8 @@ namespace krt
     class Texture
     {
         friend CommandBuffer;
+        friend LogicalDevice;
+        friend UploadBatch;
     public:
         Texture(ServiceLocator& a_Services, VkFormat a_Format);
 
@@ -25,16 +31,18 @@ namespace krt
 
         VkFormat GetVkFormat() const { return m_Format; }
         VkImageView GetVkImageView() const { return m_VkImageView; }
+        uint32_t GetNumMips() const { return m_NumMips; }
 
     protected:
 
         ServiceLocator& m_Services;
 
         VkImage m_VkImage;
-        VkDeviceMemory m_VkDeviceMemory;
+        DeviceMemoryAllocator::Allocation m_Allocation;
         VkImageView m_VkImageView;
 
         VkFormat m_Format;
+        uint32_t m_NumMips;
 
     };
 }
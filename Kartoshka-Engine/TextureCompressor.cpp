@@ -0,0 +1,360 @@
+#include "TextureCompressor.h"
+
+#include "MipGenerator.h"
+
+#include <glm/geometric.hpp>
+#include <glm/vec3.hpp>
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+namespace
+{
+    const uint32_t PixelSize = 4;
+    const uint32_t BlockPixels = 16;
+
+    // Below this, the colors of a block lie so close together that they are encoded as a single color
+    const float MinAxisLengthSq = 1e-8f;
+
+    uint16_t PackColor565(const glm::vec3& a_Color)
+    {
+        auto r = static_cast<uint32_t>(glm::clamp(a_Color.r, 0.0f, 255.0f) * 31.0f / 255.0f + 0.5f);
+        auto g = static_cast<uint32_t>(glm::clamp(a_Color.g, 0.0f, 255.0f) * 63.0f / 255.0f + 0.5f);
+        auto b = static_cast<uint32_t>(glm::clamp(a_Color.b, 0.0f, 255.0f) * 31.0f / 255.0f + 0.5f);
+        return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+    }
+
+    // Expands a 565 color the way the hardware does, by replicating the high bits into the low ones
+    glm::vec3 UnpackColor565(uint16_t a_Color)
+    {
+        uint32_t r = (a_Color >> 11) & 31;
+        uint32_t g = (a_Color >> 5) & 63;
+        uint32_t b = a_Color & 31;
+        return glm::vec3(static_cast<float>((r << 3) | (r >> 2)), static_cast<float>((g << 2) | (g >> 4)), static_cast<float>((b << 3) | (b >> 2)));
+    }
+
+    // Picks the closest of the four palette entries for every pixel, and returns the squared error of the block
+    float FindColorIndices(const glm::vec3* a_Colors, uint16_t a_Color0, uint16_t a_Color1, uint32_t& a_Indices)
+    {
+        glm::vec3 palette[4];
+        palette[0] = UnpackColor565(a_Color0);
+        palette[1] = UnpackColor565(a_Color1);
+        palette[2] = (palette[0] * 2.0f + palette[1]) / 3.0f;
+        palette[3] = (palette[0] + palette[1] * 2.0f) / 3.0f;
+
+        float error = 0.0f;
+        a_Indices = 0;
+
+        for (uint32_t i = 0; i < BlockPixels; i++)
+        {
+            uint32_t best = 0;
+            float bestDistance = std::numeric_limits<float>::max();
+
+            for (uint32_t entry = 0; entry < 4; entry++)
+            {
+                glm::vec3 delta = a_Colors[i] - palette[entry];
+                float distance = glm::dot(delta, delta);
+                if (distance < bestDistance)
+                {
+                    bestDistance = distance;
+                    best = entry;
+                }
+            }
+
+            a_Indices |= best << (i * 2);
+            error += bestDistance;
+        }
+
+        return error;
+    }
+
+    // Solves for the two endpoints that reproduce the pixels best with the given indices
+    bool RefineEndpoints(const glm::vec3* a_Colors, uint32_t a_Indices, glm::vec3& a_Endpoint0, glm::vec3& a_Endpoint1)
+    {
+        const float weights0[4] = { 1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f };
+
+        float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+        glm::vec3 ax(0.0f), bx(0.0f);
+
+        for (uint32_t i = 0; i < BlockPixels; i++)
+        {
+            float a = weights0[(a_Indices >> (i * 2)) & 3];
+            float b = 1.0f - a;
+
+            aa += a * a;
+            ab += a * b;
+            bb += b * b;
+            ax += a * a_Colors[i];
+            bx += b * a_Colors[i];
+        }
+
+        float determinant = aa * bb - ab * ab;
+        if (std::abs(determinant) < 1e-6f)
+            return false;
+
+        a_Endpoint0 = (ax * bb - bx * ab) / determinant;
+        a_Endpoint1 = (bx * aa - ax * ab) / determinant;
+        return true;
+    }
+
+    // Encodes the RGB channels of a block in the 4 color mode of BC1, which is also the only mode of the color block of BC3
+    void EncodeColorBlock(const uint8_t* a_Block, uint8_t* a_Destination)
+    {
+        glm::vec3 colors[BlockPixels];
+        glm::vec3 mean(0.0f);
+        for (uint32_t i = 0; i < BlockPixels; i++)
+        {
+            colors[i] = glm::vec3(a_Block[i * PixelSize], a_Block[i * PixelSize + 1], a_Block[i * PixelSize + 2]);
+            mean += colors[i];
+        }
+        mean /= static_cast<float>(BlockPixels);
+
+        // The principal axis of the colors is found by a few rounds of power iteration on their covariance
+        float covariance[6] = {};
+        for (auto& color : colors)
+        {
+            glm::vec3 delta = color - mean;
+            covariance[0] += delta.r * delta.r;
+            covariance[1] += delta.r * delta.g;
+            covariance[2] += delta.r * delta.b;
+            covariance[3] += delta.g * delta.g;
+            covariance[4] += delta.g * delta.b;
+            covariance[5] += delta.b * delta.b;
+        }
+
+        glm::vec3 axis(1.0f, 1.0f, 1.0f);
+        for (uint32_t iteration = 0; iteration < 4; iteration++)
+        {
+            axis = glm::vec3(covariance[0] * axis.r + covariance[1] * axis.g + covariance[2] * axis.b,
+                             covariance[1] * axis.r + covariance[3] * axis.g + covariance[4] * axis.b,
+                             covariance[2] * axis.r + covariance[4] * axis.g + covariance[5] * axis.b);
+
+            float lengthSq = glm::dot(axis, axis);
+            if (lengthSq < MinAxisLengthSq)
+                break;
+
+            axis /= std::sqrt(lengthSq);
+        }
+
+        uint16_t color0;
+        uint16_t color1;
+        uint32_t indices = 0;
+
+        if (glm::dot(axis, axis) < MinAxisLengthSq)
+        {
+            color0 = color1 = PackColor565(mean);
+        }
+        else
+        {
+            float minProjection = std::numeric_limits<float>::max();
+            float maxProjection = std::numeric_limits<float>::lowest();
+            for (auto& color : colors)
+            {
+                float projection = glm::dot(color - mean, axis);
+                minProjection = std::min(minProjection, projection);
+                maxProjection = std::max(maxProjection, projection);
+            }
+
+            // Insetting the endpoints by a sixteenth of the range lowers the error of the pixels between them
+            float inset = (maxProjection - minProjection) / 16.0f;
+            glm::vec3 endpoint0 = mean + axis * (maxProjection - inset);
+            glm::vec3 endpoint1 = mean + axis * (minProjection + inset);
+
+            color0 = PackColor565(endpoint0);
+            color1 = PackColor565(endpoint1);
+            float error = FindColorIndices(colors, color0, color1, indices);
+
+            if (RefineEndpoints(colors, indices, endpoint0, endpoint1))
+            {
+                uint16_t refined0 = PackColor565(endpoint0);
+                uint16_t refined1 = PackColor565(endpoint1);
+                uint32_t refinedIndices;
+
+                if (FindColorIndices(colors, refined0, refined1, refinedIndices) < error)
+                {
+                    color0 = refined0;
+                    color1 = refined1;
+                    indices = refinedIndices;
+                }
+            }
+        }
+
+        // BC1 only uses the 4 color mode if the first endpoint is the larger one.
+        // Swapping the endpoints swaps indices 0 and 1 and indices 2 and 3, which flipping the low bit does.
+        if (color0 < color1)
+        {
+            std::swap(color0, color1);
+            indices ^= 0x55555555;
+        }
+        else if (color0 == color1)
+        {
+            indices = 0;
+        }
+
+        memcpy(a_Destination, &color0, sizeof(color0));
+        memcpy(a_Destination + 2, &color1, sizeof(color1));
+        memcpy(a_Destination + 4, &indices, sizeof(indices));
+    }
+
+    // Encodes one channel of a block in the 8 value mode of BC4, which the alpha block of BC3 shares
+    void EncodeChannelBlock(const uint8_t* a_Block, uint32_t a_Channel, uint8_t* a_Destination)
+    {
+        uint8_t minValue = 255;
+        uint8_t maxValue = 0;
+        for (uint32_t i = 0; i < BlockPixels; i++)
+        {
+            minValue = std::min(minValue, a_Block[i * PixelSize + a_Channel]);
+            maxValue = std::max(maxValue, a_Block[i * PixelSize + a_Channel]);
+        }
+
+        a_Destination[0] = maxValue;
+        a_Destination[1] = minValue;
+
+        uint64_t indices = 0;
+        if (maxValue != minValue)
+        {
+            // The palette runs from the first endpoint (index 0) over the interpolated values (indices 2 to 7) to the second one (index 1)
+            float range = static_cast<float>(maxValue - minValue);
+            for (uint32_t i = 0; i < BlockPixels; i++)
+            {
+                float position = (a_Block[i * PixelSize + a_Channel] - minValue) / range * 7.0f;
+                auto step = static_cast<uint32_t>(position + 0.5f);
+
+                uint64_t index = step == 7 ? 0 : step == 0 ? 1 : 8 - step;
+                indices |= index << (i * 3);
+            }
+        }
+
+        for (uint32_t i = 0; i < 6; i++)
+            a_Destination[2 + i] = static_cast<uint8_t>(indices >> (i * 8));
+    }
+
+    // Gathers the 4x4 pixels of a block, repeating the last row and column for blocks that reach past the edge of the level
+    void GatherBlock(const uint8_t* a_Level, glm::uvec2 a_Dimensions, uint32_t a_BlockX, uint32_t a_BlockY, uint8_t* a_Block)
+    {
+        for (uint32_t y = 0; y < 4; y++)
+        {
+            uint32_t sourceY = std::min(a_BlockY * 4 + y, a_Dimensions.y - 1);
+            for (uint32_t x = 0; x < 4; x++)
+            {
+                uint32_t sourceX = std::min(a_BlockX * 4 + x, a_Dimensions.x - 1);
+                memcpy(a_Block + (y * 4 + x) * PixelSize, a_Level + (static_cast<uint64_t>(sourceY) * a_Dimensions.x + sourceX) * PixelSize, PixelSize);
+            }
+        }
+    }
+}
+
+uint32_t krt::hlp::GetBlockSize(VkFormat a_Format)
+{
+    switch (a_Format)
+    {
+    case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+    case VK_FORMAT_BC4_UNORM_BLOCK:
+        return 8;
+    case VK_FORMAT_BC3_UNORM_BLOCK:
+    case VK_FORMAT_BC5_UNORM_BLOCK:
+        return 16;
+    case VK_FORMAT_R8G8B8A8_UNORM:
+        return PixelSize;
+    default:
+        assert(false && "Unsupported texture format.");
+        return 0;
+    }
+}
+
+uint32_t krt::hlp::GetBlockDimension(VkFormat a_Format)
+{
+    return a_Format == VK_FORMAT_R8G8B8A8_UNORM ? 1 : 4;
+}
+
+uint64_t krt::hlp::GetLevelSize(VkFormat a_Format, glm::uvec2 a_Dimensions)
+{
+    auto blockDimension = GetBlockDimension(a_Format);
+    uint64_t blocksX = (a_Dimensions.x + blockDimension - 1) / blockDimension;
+    uint64_t blocksY = (a_Dimensions.y + blockDimension - 1) / blockDimension;
+    return blocksX * blocksY * GetBlockSize(a_Format);
+}
+
+std::vector<krt::hlp::AccessorView> krt::hlp::GetMipLevels(const uint8_t* a_Data, VkFormat a_Format, glm::uvec2 a_Dimensions,
+    uint32_t a_NumMips)
+{
+    auto blockSize = GetBlockSize(a_Format);
+
+    std::vector<AccessorView> levels;
+    for (uint32_t level = 0; level < a_NumMips; level++)
+    {
+        auto size = GetLevelSize(a_Format, GetMipDimensions(a_Dimensions, level));
+        levels.emplace_back(a_Data, size / blockSize, blockSize, blockSize);
+        a_Data += size;
+    }
+
+    return levels;
+}
+
+bool krt::hlp::HasTransparency(const uint8_t* a_Pixels, uint64_t a_NumPixels)
+{
+    for (uint64_t i = 0; i < a_NumPixels; i++)
+    {
+        if (a_Pixels[i * PixelSize + 3] != 255)
+            return true;
+    }
+
+    return false;
+}
+
+std::vector<uint8_t> krt::hlp::CompressMipChain(const uint8_t* a_Pixels, glm::uvec2 a_Dimensions, uint32_t a_NumMips, VkFormat a_Format)
+{
+    uint64_t chainSize = 0;
+    for (uint32_t level = 0; level < a_NumMips; level++)
+        chainSize += GetLevelSize(a_Format, GetMipDimensions(a_Dimensions, level));
+
+    std::vector<uint8_t> blocks(chainSize);
+    auto* destination = blocks.data();
+
+    uint8_t block[BlockPixels * PixelSize];
+
+    for (uint32_t level = 0; level < a_NumMips; level++)
+    {
+        auto dimensions = GetMipDimensions(a_Dimensions, level);
+        uint32_t blocksX = (dimensions.x + 3) / 4;
+        uint32_t blocksY = (dimensions.y + 3) / 4;
+
+        for (uint32_t blockY = 0; blockY < blocksY; blockY++)
+        {
+            for (uint32_t blockX = 0; blockX < blocksX; blockX++)
+            {
+                GatherBlock(a_Pixels, dimensions, blockX, blockY, block);
+
+                switch (a_Format)
+                {
+                case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+                    EncodeColorBlock(block, destination);
+                    break;
+                case VK_FORMAT_BC3_UNORM_BLOCK:
+                    EncodeChannelBlock(block, 3, destination);
+                    EncodeColorBlock(block, destination + 8);
+                    break;
+                case VK_FORMAT_BC4_UNORM_BLOCK:
+                    EncodeChannelBlock(block, 0, destination);
+                    break;
+                case VK_FORMAT_BC5_UNORM_BLOCK:
+                    EncodeChannelBlock(block, 0, destination);
+                    EncodeChannelBlock(block, 1, destination + 8);
+                    break;
+                default:
+                    assert(false && "Unsupported block compressed format.");
+                    break;
+                }
+
+                destination += GetBlockSize(a_Format);
+            }
+        }
+
+        a_Pixels += static_cast<uint64_t>(dimensions.x) * dimensions.y * PixelSize;
+    }
+
+    return blocks;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "AccessorView.h"
+
+#include "vulkan/vulkan.h"
+
+#include <glm/vec2.hpp>
+
+#include <cstdint>
+#include <vector>
+
+namespace krt
+{
+    namespace hlp
+    {
+        // Size in bytes of a 4x4 block of the block compressed formats below, or of a single pixel of VK_FORMAT_R8G8B8A8_UNORM
+        uint32_t GetBlockSize(VkFormat a_Format);
+        // Width and height of a block in pixels, 4 for block compressed formats and 1 otherwise
+        uint32_t GetBlockDimension(VkFormat a_Format);
+        // Size in bytes of a single mip level, edge blocks count in full even if they cover pixels past the edge
+        uint64_t GetLevelSize(VkFormat a_Format, glm::uvec2 a_Dimensions);
+        // Splits a chain of tightly packed levels, starting at the full resolution level, into one view per level
+        std::vector<AccessorView> GetMipLevels(const uint8_t* a_Data, VkFormat a_Format, glm::uvec2 a_Dimensions, uint32_t a_NumMips);
+
+        // Returns true if any of the RGBA8 pixels is not fully opaque
+        bool HasTransparency(const uint8_t* a_Pixels, uint64_t a_NumPixels);
+
+        // Encodes an RGBA8 mip chain as laid out by GenerateMipChain into the blocks of a_Format, level by level.
+        // Supported are BC1 (RGB, alpha is dropped), BC3 (RGBA), BC4 (R) and BC5 (RG).
+        // Color endpoints are fit along the principal axis of the block and refined once by least squares,
+        // single channel endpoints are the extremes of the block.
+        std::vector<uint8_t> CompressMipChain(const uint8_t* a_Pixels, glm::uvec2 a_Dimensions, uint32_t a_NumMips, VkFormat a_Format);
+    }
+}
@@ -0,0 +1,146 @@
+#include "TextureRegistry.h"
+
+#include "UploadBatch.h"
+
+#include <filesystem>
+
+bool krt::TextureRegistry::Key::operator<(const Key& a_Other) const
+{
+    return m_Hash != a_Other.m_Hash ? m_Hash < a_Other.m_Hash : m_NormalMap < a_Other.m_NormalMap;
+}
+
+bool krt::TextureRegistry::GetFileStamp(const std::string& a_Path, FileStamp& a_Stamp)
+{
+    std::error_code error;
+    auto size = std::filesystem::file_size(a_Path, error);
+    if (error)
+        return false;
+
+    auto writeTime = std::filesystem::last_write_time(a_Path, error);
+    if (error)
+        return false;
+
+    a_Stamp.m_Size = size;
+    a_Stamp.m_WriteTime = writeTime.time_since_epoch().count();
+    return true;
+}
+
+std::shared_ptr<krt::Texture> krt::TextureRegistry::FindByPath(const std::string& a_Path, bool a_NormalMap, Key& a_Key)
+{
+    // Checked outside of the lock, the file system can be slow
+    FileStamp stamp;
+    if (!GetFileStamp(a_Path, stamp))
+        return nullptr;
+
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    // A file that was edited since it was hashed has to be read again
+    auto pathIter = m_Paths.find(NormalizePath(a_Path));
+    if (pathIter == m_Paths.end() || pathIter->second.m_Stamp != stamp)
+        return nullptr;
+
+    Key key = { pathIter->second.m_Hash, a_NormalMap };
+    auto entryIter = m_Entries.find(key);
+    if (entryIter == m_Entries.end())
+        return nullptr;
+
+    auto texture = entryIter->second.m_Texture.lock();
+    if (texture)
+    {
+        a_Key = key;
+        m_Statistics.m_PathHits++;
+    }
+
+    return texture;
+}
+
+std::shared_ptr<krt::Texture> krt::TextureRegistry::Find(const Key& a_Key)
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    auto iter = m_Entries.find(a_Key);
+    return iter != m_Entries.end() ? iter->second.m_Texture.lock() : nullptr;
+}
+
+std::shared_ptr<krt::Texture> krt::TextureRegistry::Share(const Key& a_Key, const std::string& a_Path, const FileStamp& a_Stamp)
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    auto iter = m_Entries.find(a_Key);
+    if (iter == m_Entries.end())
+        return nullptr;
+
+    auto texture = iter->second.m_Texture.lock();
+    if (!texture)
+        return nullptr;
+
+    if (!a_Path.empty())
+        m_Paths[NormalizePath(a_Path)] = { a_Key.m_Hash, a_Stamp };
+
+    m_Statistics.m_ContentHits++;
+    return texture;
+}
+
+void krt::TextureRegistry::Add(const Key& a_Key, const std::string& a_Path, const FileStamp& a_Stamp, const std::shared_ptr<Texture>& a_Texture,
+    const std::shared_ptr<UploadBatch>& a_Upload)
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    // Entries of released textures are replaced rather than removed, their paths still lead to the same hash
+    auto& entry = m_Entries[a_Key];
+    entry.m_Texture = a_Texture;
+    entry.m_Upload = a_Upload;
+
+    if (!a_Path.empty())
+        m_Paths[NormalizePath(a_Path)] = { a_Key.m_Hash, a_Stamp };
+
+    m_Statistics.m_Misses++;
+}
+
+bool krt::TextureRegistry::IsResident(const Key& a_Key)
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    // The batch is released by the load that submitted it once it is resident, or when it has nothing left to upload
+    auto iter = m_Entries.find(a_Key);
+    if (iter == m_Entries.end())
+        return true;
+
+    auto upload = iter->second.m_Upload.lock();
+    return !upload || upload->IsResident();
+}
+
+void krt::TextureRegistry::WaitUntilResident(const Key& a_Key)
+{
+    std::shared_ptr<UploadBatch> upload;
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+
+        auto iter = m_Entries.find(a_Key);
+        if (iter != m_Entries.end())
+            upload = iter->second.m_Upload.lock();
+    }
+
+    if (upload)
+        upload->WaitUntilResident();
+}
+
+krt::TextureRegistry::Statistics krt::TextureRegistry::GetStatistics()
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    Statistics statistics = m_Statistics;
+    for (auto& entry : m_Entries)
+    {
+        if (!entry.second.m_Texture.expired())
+            statistics.m_NumTextures++;
+    }
+
+    return statistics;
+}
+
+std::string krt::TextureRegistry::NormalizePath(const std::string& a_Path)
+{
+    // Files refer to their images relative to themselves, so the same image can be reached through different paths
+    return std::filesystem::path(a_Path).lexically_normal().generic_string();
+}
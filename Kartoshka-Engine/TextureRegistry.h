@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace krt
+{
+    class Texture;
+    class UploadBatch;
+}
+
+namespace krt
+{
+    // Textures of every loaded file, keyed by the hash of their encoded image, so identical images are only uploaded once.
+    // The registry does not keep textures alive, they are released as soon as the last resource using them is.
+    // Paths of image files are remembered as well, so a file that was seen before does not have to be read again to find its texture.
+    // Lookups by key are safe from the worker threads, everything else has to happen on the thread that uploads the textures.
+    class TextureRegistry
+    {
+    public:
+
+        // The same image is encoded differently when it is used as a normal map, so the two are separate textures
+        struct Key
+        {
+            uint64_t m_Hash;
+            bool m_NormalMap;
+
+            bool operator<(const Key& a_Other) const;
+        };
+
+        // Size and modification time of an image file, to notice that it changed since it was hashed
+        struct FileStamp
+        {
+            uint64_t m_Size = 0;
+            int64_t m_WriteTime = 0;
+
+            bool operator==(const FileStamp& a_Other) const { return m_Size == a_Other.m_Size && m_WriteTime == a_Other.m_WriteTime; }
+            bool operator!=(const FileStamp& a_Other) const { return !(*this == a_Other); }
+        };
+
+        struct Statistics
+        {
+            uint32_t m_PathHits = 0;     // Images whose file was found by its path, without reading it
+            uint32_t m_ContentHits = 0;  // Images whose encoded data matched a registered texture
+            uint32_t m_Misses = 0;       // Images that had to be uploaded
+            uint32_t m_NumTextures = 0;  // Registered textures that are still alive
+        };
+
+        // Returns false if the file can not be found. Taken before the file is read, so a change while it is read is noticed the next time.
+        static bool GetFileStamp(const std::string& a_Path, FileStamp& a_Stamp);
+
+        // Returns the texture of the file at a_Path and its key, or nullptr if the file was not loaded the same way before, has changed since,
+        // or its texture was released
+        std::shared_ptr<Texture> FindByPath(const std::string& a_Path, bool a_NormalMap, Key& a_Key);
+        // Returns the texture with the key without counting it as a hit, to skip decoding images that are already uploaded
+        std::shared_ptr<Texture> Find(const Key& a_Key);
+
+        // Returns the texture with the key and remembers a_Path as one of its files, or nullptr if there is none.
+        // a_Path is empty for images embedded in their file, a_Stamp is the one of the file when it was hashed.
+        std::shared_ptr<Texture> Share(const Key& a_Key, const std::string& a_Path, const FileStamp& a_Stamp);
+        // Registers a texture that a_Upload is about to upload, which has to be dropped once it is resident
+        void Add(const Key& a_Key, const std::string& a_Path, const FileStamp& a_Stamp, const std::shared_ptr<Texture>& a_Texture,
+                 const std::shared_ptr<UploadBatch>& a_Upload);
+
+        // Textures can be shared before they are resident, their users have to wait for the upload like the one that added them
+        bool IsResident(const Key& a_Key);
+        void WaitUntilResident(const Key& a_Key);
+
+        Statistics GetStatistics();
+
+    private:
+
+        struct Entry
+        {
+            std::weak_ptr<Texture> m_Texture;
+            std::weak_ptr<UploadBatch> m_Upload;
+        };
+
+        struct PathEntry
+        {
+            uint64_t m_Hash;
+            FileStamp m_Stamp;
+        };
+
+        static std::string NormalizePath(const std::string& a_Path);
+
+        std::mutex m_Mutex;
+        std::map<Key, Entry> m_Entries;
+        std::map<std::string, PathEntry> m_Paths; // Hash of the contents of every file, and the stamp of the file it was taken from
+        Statistics m_Statistics;
+    };
+}
@@ -0,0 +1,328 @@
+#include "TextureStreamer.h"
+
+#include "ServiceLocator.h"
+#include "LogicalDevice.h"
+#include "UploadBatch.h"
+#include "Texture.h"
+#include "Mesh.h"
+#include "Scene.h"
+#include "StaticMesh.h"
+#include "Transform.h"
+#include "Camera.h"
+
+#include "MipGenerator.h"
+#include "TextureCompressor.h"
+
+#include <glm/geometric.hpp>
+#include <glm/trigonometric.hpp>
+#include <glm/mat4x4.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+krt::TextureStreamer::TextureStreamer(ServiceLocator& a_Services, uint64_t a_MemoryBudget)
+    : m_Services(a_Services)
+    , m_MemoryBudget(a_MemoryBudget)
+{
+}
+
+krt::TextureStreamer::~TextureStreamer()
+{
+    // The staging memory of a batch has to outlive its transfer
+    for (auto& texture : m_Textures)
+    {
+        if (texture.second->m_PendingUpload)
+            texture.second->m_PendingUpload->WaitUntilResident();
+    }
+}
+
+uint32_t krt::TextureStreamer::GetBaseLevel(const TextureData& a_Data) const
+{
+    if (!IsEnabled())
+        return 0;
+
+    auto numLevels = static_cast<uint32_t>(a_Data.m_Levels.size());
+
+    uint32_t level = 0;
+    while (level + 1 < numLevels)
+    {
+        auto dimensions = hlp::GetMipDimensions(a_Data.m_Dimensions, level);
+        if (std::max(dimensions.x, dimensions.y) <= BaseLevelSize)
+            break;
+
+        level++;
+    }
+
+    return level;
+}
+
+void krt::TextureStreamer::Add(const std::shared_ptr<Texture>& a_Texture, TextureData&& a_Data)
+{
+    auto streamed = std::make_unique<StreamedTexture>();
+    streamed->m_BaseLevel = GetBaseLevel(a_Data);
+    streamed->m_Data = std::move(a_Data);
+    streamed->m_Texture = a_Texture;
+    streamed->m_ResidentLevel = streamed->m_BaseLevel;
+    streamed->m_RequestedLevel = streamed->m_BaseLevel;
+    streamed->m_PendingLevel = streamed->m_BaseLevel;
+
+    m_Textures[a_Texture.get()] = std::move(streamed);
+}
+
+void krt::TextureStreamer::Bind(const std::shared_ptr<Texture>& a_Texture, const std::shared_ptr<Material>& a_Material, bool a_NormalMap)
+{
+    auto texture = a_Texture;
+
+    auto iter = m_Textures.find(a_Texture.get());
+    if (iter != m_Textures.end())
+    {
+        auto& streamed = *iter->second;
+        streamed.m_Users.push_back({ a_Material, a_Material.get(), a_NormalMap });
+
+        // An entry left by a released material at the same address is replaced
+        auto& materialTextures = m_MaterialTextures[a_Material.get()];
+        if (materialTextures.m_Material.lock() != a_Material)
+            materialTextures = { a_Material, {} };
+
+        materialTextures.m_Textures.push_back(&streamed);
+
+        texture = streamed.m_Texture;
+    }
+
+    if (a_NormalMap)
+        a_Material->SetNormalMap(texture);
+    else
+        a_Material->SetDiffuseTexture(texture);
+}
+
+void krt::TextureStreamer::RequestLevels(const Scene& a_Scene, const Camera& a_Camera, float a_ScreenHeight)
+{
+    if (!IsEnabled())
+        return;
+
+    // Distance at which one unit covers one pixel on the screen
+    float focalLength = a_ScreenHeight * 0.5f / std::tan(glm::radians(a_Camera.GetFieldOfView()) * 0.5f);
+
+    for (auto& mesh : a_Scene.m_StaticMeshes)
+    {
+        if (!mesh->m_Enabled)
+            continue;
+
+        auto& m = *mesh;
+        glm::mat4 world = m.m_Transform->GetTransformationMatrix();
+        float scale = std::max(glm::length(glm::vec3(world[0])), std::max(glm::length(glm::vec3(world[1])), glm::length(glm::vec3(world[2]))));
+
+        for (auto& primitive : m->m_Primitives)
+        {
+            auto iter = m_MaterialTextures.find(primitive.m_Material.get());
+            if (iter == m_MaterialTextures.end() || iter->second.m_Material.expired())
+                continue;
+
+            // The bounding sphere of the primitive, seen from the closest point on it.
+            // Assumes the texture is mapped across the primitive once, so tiling textures are requested at a coarser level than they are seen at.
+            glm::vec3 center = glm::vec3(world * glm::vec4((primitive.m_BoundsMin + primitive.m_BoundsMax) * 0.5f, 1.0f));
+            float radius = glm::length(primitive.m_BoundsMax - primitive.m_BoundsMin) * 0.5f * scale;
+            float distance = std::max(glm::distance(center, a_Camera.GetPosition()) - radius, a_Camera.GetNearClipDistance());
+            float coverage = std::max(2.0f * radius * focalLength / distance, 1.0f);
+
+            for (auto* texture : iter->second.m_Textures)
+            {
+                auto dimensions = texture->m_Data.m_Dimensions;
+                float level = std::floor(std::log2(static_cast<float>(std::max(dimensions.x, dimensions.y)) / coverage));
+
+                auto requested = static_cast<uint32_t>(std::max(level, 0.0f));
+                texture->m_RequestedLevel = std::min(texture->m_RequestedLevel, requested);
+            }
+        }
+    }
+}
+
+void krt::TextureStreamer::Update(uint64_t a_StagingBudget)
+{
+    PublishResidentTextures();
+    ReleaseUnusedTextures();
+
+    // Textures count at the size they are changing to, the ones they replace are released within a few frames
+    uint64_t residentBytes = 0;
+    std::vector<StreamedTexture*> upgrades;
+    std::vector<StreamedTexture*> evictions;
+
+    for (auto& entry : m_Textures)
+    {
+        auto& texture = *entry.second;
+        if (texture.m_PendingUpload)
+        {
+            residentBytes += GetMemorySize(texture.m_Data, texture.m_PendingLevel);
+            continue;
+        }
+
+        residentBytes += GetMemorySize(texture.m_Data, texture.m_ResidentLevel);
+
+        if (texture.m_ResidentLevel > texture.m_RequestedLevel)
+            upgrades.push_back(&texture);
+        else if (texture.m_ResidentLevel < texture.m_RequestedLevel)
+            evictions.push_back(&texture);
+    }
+
+    // The textures missing the most levels are served first, and the ones with the most levels to spare are evicted first
+    std::sort(upgrades.begin(), upgrades.end(), [](const StreamedTexture* a_Left, const StreamedTexture* a_Right)
+    {
+        return a_Left->m_ResidentLevel - a_Left->m_RequestedLevel > a_Right->m_ResidentLevel - a_Right->m_RequestedLevel;
+    });
+
+    std::sort(evictions.begin(), evictions.end(), [](const StreamedTexture* a_Left, const StreamedTexture* a_Right)
+    {
+        return a_Left->m_RequestedLevel - a_Left->m_ResidentLevel > a_Right->m_RequestedLevel - a_Right->m_ResidentLevel;
+    });
+
+    auto batch = std::make_shared<UploadBatch>(m_Services);
+    uint32_t nextEviction = 0;
+
+    auto evict = [&]()
+    {
+        auto& evicted = *evictions[nextEviction++];
+        residentBytes -= GetMemorySize(evicted.m_Data, evicted.m_ResidentLevel) - GetMemorySize(evicted.m_Data, evicted.m_RequestedLevel);
+        StageLevels(evicted, evicted.m_RequestedLevel, batch);
+    };
+
+    // Textures gain one level per update, so the staging budget is spread across as many of them as possible
+    for (auto* texture : upgrades)
+    {
+        if (batch->GetStagingSize() >= a_StagingBudget)
+            break;
+
+        uint32_t level = texture->m_ResidentLevel - 1;
+        uint64_t growth = GetMemorySize(texture->m_Data, level) - GetMemorySize(texture->m_Data, texture->m_ResidentLevel);
+
+        while (residentBytes + growth > m_MemoryBudget && nextEviction < evictions.size())
+            evict();
+
+        if (residentBytes + growth > m_MemoryBudget)
+            continue;
+
+        residentBytes += growth;
+        StageLevels(*texture, level, batch);
+    }
+
+    // Nothing may have been requested this update, while the budget was lowered or the loaded textures grew past it
+    while (residentBytes > m_MemoryBudget && nextEviction < evictions.size())
+        evict();
+
+    if (batch->GetNumUploads() != 0)
+        batch->Submit();
+
+    m_Statistics = Statistics();
+    m_Statistics.m_ResidentBytes = residentBytes;
+    m_Statistics.m_NumTextures = static_cast<uint32_t>(m_Textures.size());
+
+    // Requests only hold for a single update, textures that are not seen again fall back to their base level
+    for (auto& entry : m_Textures)
+    {
+        auto& texture = *entry.second;
+        uint32_t level = texture.m_PendingUpload ? texture.m_PendingLevel : texture.m_ResidentLevel;
+
+        if (texture.m_PendingUpload)
+            m_Statistics.m_NumPending++;
+        if (level > texture.m_RequestedLevel)
+            m_Statistics.m_NumMissingLevels += level - texture.m_RequestedLevel;
+
+        texture.m_RequestedLevel = texture.m_BaseLevel;
+    }
+}
+
+uint64_t krt::TextureStreamer::GetMemorySize(const TextureData& a_Data, uint32_t a_Level)
+{
+    uint64_t size = 0;
+    for (uint32_t level = a_Level; level < a_Data.m_Levels.size(); level++)
+        size += hlp::GetLevelSize(a_Data.m_Format, hlp::GetMipDimensions(a_Data.m_Dimensions, level));
+
+    return size;
+}
+
+void krt::TextureStreamer::PublishResidentTextures()
+{
+    for (auto& entry : m_Textures)
+    {
+        auto& texture = *entry.second;
+        if (!texture.m_PendingUpload || !texture.m_PendingUpload->IsResident())
+            continue;
+
+        texture.m_Texture = std::move(texture.m_PendingTexture);
+        texture.m_ResidentLevel = texture.m_PendingLevel;
+        texture.m_PendingUpload.reset();
+
+        // The materials rebuild their descriptor sets, and keep the texture that was replaced until the GPU is done with it
+        for (auto& user : texture.m_Users)
+        {
+            auto material = user.m_Material.lock();
+            if (!material)
+                continue;
+
+            if (user.m_NormalMap)
+                material->SetNormalMap(texture.m_Texture);
+            else
+                material->SetDiffuseTexture(texture.m_Texture);
+        }
+    }
+}
+
+void krt::TextureStreamer::ReleaseUnusedTextures()
+{
+    for (auto iter = m_Textures.begin(); iter != m_Textures.end();)
+    {
+        auto& texture = *iter->second;
+        bool bound = !texture.m_Users.empty();
+
+        // Materials that were released no longer request any levels
+        auto expired = std::remove_if(texture.m_Users.begin(), texture.m_Users.end(), [this](const User& a_User)
+        {
+            if (!a_User.m_Material.expired())
+                return false;
+
+            // A new material may have been bound at the address of the released one, whose entry is kept
+            auto materialTextures = m_MaterialTextures.find(a_User.m_Key);
+            if (materialTextures != m_MaterialTextures.end() && materialTextures->second.m_Material.expired())
+                m_MaterialTextures.erase(materialTextures);
+
+            return true;
+        });
+        texture.m_Users.erase(expired, texture.m_Users.end());
+
+        // Textures that were never bound are kept, they may still be handed to a material
+        if (!bound || !texture.m_Users.empty() || texture.m_PendingUpload)
+        {
+            ++iter;
+            continue;
+        }
+
+        for (auto& material : m_MaterialTextures)
+        {
+            auto& textures = material.second.m_Textures;
+            textures.erase(std::remove(textures.begin(), textures.end(), &texture), textures.end());
+        }
+
+        iter = m_Textures.erase(iter);
+    }
+
+    for (auto iter = m_MaterialTextures.begin(); iter != m_MaterialTextures.end();)
+    {
+        if (iter->second.m_Textures.empty())
+            iter = m_MaterialTextures.erase(iter);
+        else
+            ++iter;
+    }
+}
+
+void krt::TextureStreamer::StageLevels(StreamedTexture& a_Texture, uint32_t a_Level, const std::shared_ptr<UploadBatch>& a_Batch)
+{
+    auto& data = a_Texture.m_Data;
+    std::vector<hlp::AccessorView> levels(data.m_Levels.begin() + a_Level, data.m_Levels.end());
+
+    a_Texture.m_PendingTexture = a_Batch->CreateTexture(levels, hlp::GetMipDimensions(data.m_Dimensions, a_Level), data.m_Format, { EGraphicsQueue });
+
+    // The new levels belong to whichever asset the texture they replace was loaded for
+    auto& tracker = m_Services.m_LogicalDevice->GetMemoryTracker();
+    tracker.SetOwner(a_Texture.m_PendingTexture.get(), tracker.GetOwner(a_Texture.m_Texture.get()));
+    a_Texture.m_PendingUpload = a_Batch;
+    a_Texture.m_PendingLevel = a_Level;
+}
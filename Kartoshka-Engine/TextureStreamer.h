@@ -0,0 +1,142 @@
+#pragma once
+
+#include "AccessorView.h"
+#include "Ktx2File.h"
+
+#include "vulkan/vulkan.h"
+
+#include <glm/vec2.hpp>
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <vector>
+
+namespace krt
+{
+    struct ServiceLocator;
+    class Texture;
+    class Material;
+    class Camera;
+    class Scene;
+    class UploadBatch;
+}
+
+namespace krt
+{
+    // Texel data of a mip chain in CPU memory, either decoded into m_Pixels or read from a mapped KTX2 file.
+    // The levels point into one of the two, starting at the full resolution level, so the struct can be moved but not copied.
+    struct TextureData
+    {
+        std::vector<uint8_t> m_Pixels;
+        std::unique_ptr<Ktx2File> m_CachedFile;
+        std::vector<hlp::AccessorView> m_Levels;
+        VkFormat m_Format;
+        glm::uvec2 m_Dimensions;
+    };
+
+    // Keeps only the mip levels of textures resident that the camera needs, within a budget of device memory.
+    // Textures start out with their coarse levels only. Finer levels are uploaded one at a time once the meshes using a texture
+    // cover enough of the screen, and textures with more detail than needed give up theirs when the budget runs out.
+    // A change of levels uploads a new texture from the texel data kept in CPU memory, which replaces the old one in the materials
+    // once it is resident. The materials keep the old texture alive until the frames that still use it have finished.
+    class TextureStreamer
+    {
+    public:
+
+        // Largest dimension of the coarsest levels every streamed texture keeps resident
+        static const uint32_t BaseLevelSize = 64;
+
+        struct Statistics
+        {
+            uint64_t m_ResidentBytes = 0;   // Device memory of the streamed textures, counting pending uploads at their new size
+            uint32_t m_NumTextures = 0;
+            uint32_t m_NumPending = 0;      // Textures waiting for a change of levels to become resident
+            uint32_t m_NumMissingLevels = 0; // Levels that were requested but do not fit in the budget
+        };
+
+        TextureStreamer(ServiceLocator& a_Services, uint64_t a_MemoryBudget);
+        ~TextureStreamer();
+
+        TextureStreamer(TextureStreamer&) = delete;
+        TextureStreamer(TextureStreamer&&) = delete;
+        TextureStreamer& operator=(TextureStreamer&) = delete;
+        TextureStreamer& operator=(TextureStreamer&&) = delete;
+
+        // A budget of 0 disables streaming, textures are uploaded with all of their levels
+        bool IsEnabled() const { return m_MemoryBudget != 0; }
+
+        // The first level of a texture that is uploaded when it is loaded, which is 0 if streaming is disabled
+        uint32_t GetBaseLevel(const TextureData& a_Data) const;
+
+        // Takes over the texel data of a texture that was uploaded from its base level, so its finer levels can be streamed in later
+        void Add(const std::shared_ptr<Texture>& a_Texture, TextureData&& a_Data);
+
+        // Hands the texture to the material, or the texture that currently replaces it if it is streamed.
+        // The material receives the finer levels of the texture whenever they become resident.
+        void Bind(const std::shared_ptr<Texture>& a_Texture, const std::shared_ptr<Material>& a_Material, bool a_NormalMap);
+
+        // Estimates the mip levels the textures of the meshes in the scene need from the size they cover on the screen.
+        // Can be called for several scenes, the requests are reset by Update.
+        void RequestLevels(const Scene& a_Scene, const Camera& a_Camera, float a_ScreenHeight);
+
+        // Hands out the textures that have become resident, and evicts and uploads levels toward the requests since the last update.
+        // Stages at most about a_StagingBudget bytes, and has to be called on the thread that owns the command pools.
+        void Update(uint64_t a_StagingBudget);
+
+        const Statistics& GetStatistics() const { return m_Statistics; }
+
+    private:
+
+        struct User
+        {
+            std::weak_ptr<Material> m_Material;
+            const Material* m_Key;  // Stays valid as a key of m_MaterialTextures after the material is released
+            bool m_NormalMap;
+        };
+
+        struct StreamedTexture;
+
+        // The streamed textures of a material. The key of a released material can be reused by a new one,
+        // so the entry keeps the material it was made for.
+        struct MaterialTextures
+        {
+            std::weak_ptr<Material> m_Material;
+            std::vector<StreamedTexture*> m_Textures;
+        };
+
+        struct StreamedTexture
+        {
+            TextureData m_Data;
+            uint32_t m_BaseLevel;
+
+            std::shared_ptr<Texture> m_Texture;     // Holds the levels from m_ResidentLevel on
+            uint32_t m_ResidentLevel;
+            uint32_t m_RequestedLevel;
+
+            // Texture with the levels from m_PendingLevel on, which replaces the current one once its upload is resident
+            std::shared_ptr<Texture> m_PendingTexture;
+            std::shared_ptr<UploadBatch> m_PendingUpload;
+            uint32_t m_PendingLevel;
+
+            std::vector<User> m_Users;
+        };
+
+        // Device memory of the levels from a_Level on
+        static uint64_t GetMemorySize(const TextureData& a_Data, uint32_t a_Level);
+
+        void PublishResidentTextures();
+        void ReleaseUnusedTextures();
+        // Creates the texture with the levels from a_Level on and adds it to the batch
+        void StageLevels(StreamedTexture& a_Texture, uint32_t a_Level, const std::shared_ptr<UploadBatch>& a_Batch);
+
+        ServiceLocator& m_Services;
+        uint64_t m_MemoryBudget;
+
+        // Keyed by the texture that was added, which the materials are bound to by the model manager
+        std::map<const Texture*, std::unique_ptr<StreamedTexture>> m_Textures;
+        std::map<const Material*, MaterialTextures> m_MaterialTextures;
+
+        Statistics m_Statistics;
+    };
+}
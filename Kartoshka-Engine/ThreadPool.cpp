@@ -0,0 +1,54 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cstdio>
+
+krt::ThreadPool::ThreadPool(uint32_t a_NumThreads)
+    : m_ShuttingDown(false)
+{
+    if (a_NumThreads == 0)
+        a_NumThreads = std::max(1u, std::thread::hardware_concurrency());
+
+    printf("Starting thread pool with %u worker threads.\n", a_NumThreads);
+
+    m_Workers.reserve(a_NumThreads);
+    for (uint32_t i = 0; i < a_NumThreads; i++)
+    {
+        m_Workers.emplace_back(&ThreadPool::WorkerLoop, this);
+    }
+}
+
+krt::ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_JobsMutex);
+        m_ShuttingDown = true;
+    }
+    m_JobsCondition.notify_all();
+
+    // Workers finish all queued jobs before exiting, so no futures are left unfulfilled
+    for (auto& worker : m_Workers)
+    {
+        worker.join();
+    }
+}
+
+void krt::ThreadPool::WorkerLoop()
+{
+    while (true)
+    {
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> lock(m_JobsMutex);
+            m_JobsCondition.wait(lock, [this]() { return m_ShuttingDown || !m_Jobs.empty(); });
+
+            if (m_Jobs.empty())
+                return;
+
+            job = std::move(m_Jobs.front());
+            m_Jobs.pop();
+        }
+
+        job();
+    }
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace krt
+{
+    // Fixed size pool of worker threads which execute jobs in the order they were enqueued.
+    // Jobs must not touch Vulkan objects that require external synchronization, like command pools and queues,
+    // those are meant to stay on the main thread.
+    class ThreadPool
+    {
+    public:
+        // A thread count of 0 uses one thread per hardware thread
+        explicit ThreadPool(uint32_t a_NumThreads = 0);
+        ~ThreadPool();
+
+        ThreadPool(ThreadPool&) = delete;             // No copy c-tor
+        ThreadPool(ThreadPool&&) = delete;            // No move c-tor
+        ThreadPool& operator=(ThreadPool&) = delete;  // No copy assignment
+        ThreadPool& operator=(ThreadPool&&) = delete; // No move assignment
+
+        // Queues a job for execution on one of the worker threads.
+        // The returned future holds the result of the job once it has been executed.
+        template<typename Function>
+        auto Enqueue(Function&& a_Function) -> std::future<decltype(a_Function())>;
+
+        uint32_t GetThreadCount() const { return static_cast<uint32_t>(m_Workers.size()); }
+
+    private:
+        void WorkerLoop();
+
+        std::vector<std::thread> m_Workers;
+
+        std::queue<std::function<void()>> m_Jobs;
+        std::mutex m_JobsMutex;
+        std::condition_variable m_JobsCondition;
+
+        bool m_ShuttingDown;
+    };
+}
+
+#include "ThreadPool.inl"
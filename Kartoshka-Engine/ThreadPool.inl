@@ -0,0 +1,17 @@
+template <typename Function>
+auto krt::ThreadPool::Enqueue(Function&& a_Function) -> std::future<decltype(a_Function())>
+{
+    using ResultType = decltype(a_Function());
+
+    // std::function requires copyable callables, so the packaged task is kept alive through a shared_ptr
+    auto task = std::make_shared<std::packaged_task<ResultType()>>(std::forward<Function>(a_Function));
+    auto future = task->get_future();
+
+    {
+        std::lock_guard<std::mutex> lock(m_JobsMutex);
+        m_Jobs.emplace([task]() { (*task)(); });
+    }
+    m_JobsCondition.notify_one();
+
+    return future;
+}
@@ -0,0 +1,319 @@
+#include "UploadBatch.h"
+
+#include "ServiceLocator.h"
+#include "LogicalDevice.h"
+#include "CommandQueue.h"
+#include "CommandBuffer.h"
+#include "VertexBuffer.h"
+#include "IndexBuffer.h"
+#include "Texture.h"
+
+#include "VkHelpers.h"
+#include "VkConstants.h"
+#include "MipGenerator.h"
+#include "StagingRing.h"
+
+#include <algorithm>
+#include <cassert>
+
+krt::UploadBatch::UploadBatch(ServiceLocator& a_Services)
+    : m_Services(a_Services)
+    , m_StagingSize(0)
+    , m_SubmissionIndex(0)
+{
+}
+
+krt::UploadBatch::~UploadBatch()
+{
+    // Resources returned by the batch would stay uninitialized if it was never submitted
+    assert(m_SubmissionIndex != 0 || (m_BufferUploads.empty() && m_TextureUploads.empty()));
+}
+
+std::unique_ptr<krt::VertexBuffer> krt::UploadBatch::CreateVertexBuffer(const hlp::AccessorView& a_Elements,
+    std::set<ECommandQueueType> a_QueuesWithAccess)
+{
+    a_QueuesWithAccess.insert(ETransferQueue);
+
+    uint64_t bufferSize = a_Elements.GetSizeInBytes();
+
+    auto local = m_Services.m_LogicalDevice->CreateBuffer<VertexBuffer>(bufferSize,
+        VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, a_QueuesWithAccess,
+        EGeometryMemory, m_Owner);
+
+    local->m_NumElements = static_cast<uint32_t>(a_Elements.Size());
+
+    auto& upload = m_BufferUploads.emplace_back();
+    upload.m_Target = local->m_VkBuffer;
+    upload.m_Source = a_Elements;
+    AddStagingSize(a_Elements);
+
+    return local;
+}
+
+std::unique_ptr<krt::VertexBuffer> krt::UploadBatch::CreateVertexBuffer(const void* a_BufferData, uint64_t a_NumElements,
+    uint64_t a_ElementSize, std::set<ECommandQueueType> a_QueuesWithAccess)
+{
+    auto elementSize = static_cast<uint32_t>(a_ElementSize);
+    return CreateVertexBuffer(hlp::AccessorView(a_BufferData, a_NumElements, elementSize, elementSize), a_QueuesWithAccess);
+}
+
+std::unique_ptr<krt::IndexBuffer> krt::UploadBatch::CreateIndexBuffer(const hlp::AccessorView& a_Indices,
+    std::set<ECommandQueueType> a_QueuesWithAccess)
+{
+    a_QueuesWithAccess.insert(ETransferQueue);
+
+    uint64_t bufferSize = a_Indices.GetSizeInBytes();
+
+    auto local = m_Services.m_LogicalDevice->CreateBuffer<IndexBuffer>(bufferSize,
+        VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, a_QueuesWithAccess,
+        EGeometryMemory, m_Owner);
+
+    local->m_NumElements = static_cast<uint32_t>(a_Indices.Size());
+
+    switch (a_Indices.GetElementSize())
+    {
+    case 2:
+        local->m_IndexType = VK_INDEX_TYPE_UINT16;
+        break;
+    case 4:
+        local->m_IndexType = VK_INDEX_TYPE_UINT32;
+        break;
+    default:
+        printf("Unknown Index buffer index type with size %d\n", a_Indices.GetElementSize());
+        abort();
+    }
+
+    auto& upload = m_BufferUploads.emplace_back();
+    upload.m_Target = local->m_VkBuffer;
+    upload.m_Source = a_Indices;
+    AddStagingSize(a_Indices);
+
+    return local;
+}
+
+std::unique_ptr<krt::IndexBuffer> krt::UploadBatch::CreateIndexBuffer(const void* a_IndexData, uint64_t a_NumElements,
+    uint8_t a_ElementSize, std::set<ECommandQueueType> a_QueuesWithAccess)
+{
+    return CreateIndexBuffer(hlp::AccessorView(a_IndexData, a_NumElements, a_ElementSize, a_ElementSize), a_QueuesWithAccess);
+}
+
+std::unique_ptr<krt::Texture> krt::UploadBatch::CreateTexture(const void* a_Data, glm::uvec2 a_Dimensions, const uint8_t a_NumChannels,
+    const uint8_t a_BytesPerChannel, std::set<ECommandQueueType> a_QueuesWithAccess, VkPipelineStageFlags a_UsingStages, uint32_t a_NumMips)
+{
+    assert(a_NumChannels <= 4);
+    assert(a_BytesPerChannel <= 8);
+
+    a_QueuesWithAccess.insert(ETransferQueue);
+
+    auto pixelSize = static_cast<uint32_t>(a_NumChannels) * a_BytesPerChannel;
+    uint64_t sizeInBytes = hlp::GetMipChainSize(a_Dimensions, a_NumMips, pixelSize);
+
+    auto texture = m_Services.m_LogicalDevice->CreateTexture(a_Dimensions, hlp::PickTextureFormat(a_NumChannels),
+        VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, a_QueuesWithAccess, a_NumMips, m_Owner);
+
+    auto& upload = m_TextureUploads.emplace_back();
+    upload.m_Target = texture->m_VkImage;
+    upload.m_Dimensions = a_Dimensions;
+    upload.m_UsingStages = a_UsingStages;
+    upload.m_PixelSize = pixelSize;
+
+    // The levels follow each other as multiples of the pixel size
+    auto* levelData = static_cast<const uint8_t*>(a_Data);
+    for (uint32_t level = 0; level < a_NumMips; level++)
+    {
+        auto dimensions = hlp::GetMipDimensions(a_Dimensions, level);
+        uint64_t numPixels = static_cast<uint64_t>(dimensions.x) * dimensions.y;
+
+        upload.m_Levels.emplace_back(levelData, numPixels, pixelSize, pixelSize);
+        levelData += numPixels * pixelSize;
+    }
+
+    AddStagingSize(hlp::AccessorView(a_Data, sizeInBytes / pixelSize, pixelSize, pixelSize));
+
+    return texture;
+}
+
+std::unique_ptr<krt::Texture> krt::UploadBatch::CreateTexture(const std::vector<hlp::AccessorView>& a_Levels, glm::uvec2 a_Dimensions,
+    VkFormat a_Format, std::set<ECommandQueueType> a_QueuesWithAccess, VkPipelineStageFlags a_UsingStages)
+{
+    a_QueuesWithAccess.insert(ETransferQueue);
+
+    auto texture = m_Services.m_LogicalDevice->CreateTexture(a_Dimensions, a_Format,
+        VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, a_QueuesWithAccess, static_cast<uint32_t>(a_Levels.size()), m_Owner);
+
+    auto& upload = m_TextureUploads.emplace_back();
+    upload.m_Target = texture->m_VkImage;
+    upload.m_Dimensions = a_Dimensions;
+    upload.m_UsingStages = a_UsingStages;
+    upload.m_PixelSize = 0;
+    upload.m_Levels = a_Levels;
+
+    // Every level is staged on its own, the staging alignment is a multiple of the size of any block
+    for (auto& level : a_Levels)
+        AddStagingSize(level);
+
+    return texture;
+}
+
+void krt::UploadBatch::Submit(Semaphore a_SignalSemaphore)
+{
+    assert(m_SubmissionIndex == 0 && "Upload batches can only be submitted once.");
+
+    auto& commandQueue = m_Services.m_LogicalDevice->GetCommandQueue(ETransferQueue);
+    auto* commandBuffer = &commandQueue.GetSingleUseCommandBuffer();
+    commandBuffer->Begin();
+
+    // Every level is moved to the transfer layout up front. Barriers order against earlier submissions to the queue,
+    // so the copies and the final transitions can be recorded into the command buffers of later chunks.
+    for (auto& upload : m_TextureUploads)
+    {
+        commandBuffer->TransitionImageLayout(upload.m_Target, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            0, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+            static_cast<uint32_t>(upload.m_Levels.size()));
+    }
+
+    const uint64_t alignment = constants::StagingBufferAlignment;
+    auto copies = SplitIntoCopies();
+
+    size_t first = 0;
+    while (first < copies.size())
+    {
+        // Packs as many copies into the chunk as fit, a single copy can only exceed it when it is a level made of blocks
+        uint64_t chunkSize = 0;
+        size_t last = first;
+        for (; last < copies.size(); last++)
+        {
+            uint64_t offset = (chunkSize + alignment - 1) & ~(alignment - 1);
+            uint64_t size = copies[last].m_Source.GetSizeInBytes();
+            if (last != first && offset + size > StagingRing::ChunkSize)
+                break;
+
+            copies[last].m_StagingOffset = offset;
+            chunkSize = offset + size;
+        }
+
+        // The previous chunk is submitted first, so reserving this one can wait for older chunks instead of running out of ring
+        if (first != 0)
+        {
+            commandBuffer->Submit();
+            commandBuffer = &commandQueue.GetSingleUseCommandBuffer();
+            commandBuffer->Begin();
+        }
+
+        // The staging ring is coherent and needs no flush
+        auto staging = commandBuffer->ReserveStaging(chunkSize, alignment);
+        for (size_t i = first; i < last; i++)
+        {
+            auto& copy = copies[i];
+            copy.m_Source.CopyTo(staging.m_Mapped + copy.m_StagingOffset);
+
+            if (copy.m_Buffer != VK_NULL_HANDLE)
+            {
+                commandBuffer->BufferCopy(staging.m_VkBuffer, copy.m_Buffer, copy.m_Source.GetSizeInBytes(),
+                    staging.m_Offset + copy.m_StagingOffset, copy.m_BufferOffset);
+            }
+            else
+            {
+                commandBuffer->CopyBufferToImage(staging.m_VkBuffer, copy.m_Image, copy.m_Extent, staging.m_Offset + copy.m_StagingOffset,
+                    copy.m_MipLevel, copy.m_FirstRow);
+            }
+        }
+
+        first = last;
+    }
+
+    for (auto& upload : m_TextureUploads)
+    {
+        commandBuffer->TransitionImageLayout(upload.m_Target, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+            VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, upload.m_UsingStages,
+            static_cast<uint32_t>(upload.m_Levels.size()));
+    }
+
+    if (a_SignalSemaphore)
+        commandBuffer->AddSignalSemaphore(a_SignalSemaphore);
+
+    // The transfer queue completes its submissions in order, so the last one being done means the whole batch is
+    m_SubmissionIndex = commandBuffer->Submit();
+}
+
+bool krt::UploadBatch::IsResident()
+{
+    if (m_SubmissionIndex == 0)
+        return false;
+
+    return m_Services.m_LogicalDevice->GetCommandQueue(ETransferQueue).IsSubmissionComplete(m_SubmissionIndex);
+}
+
+void krt::UploadBatch::WaitUntilResident()
+{
+    assert(m_SubmissionIndex != 0 && "Waiting for an upload batch which has not been submitted.");
+
+    m_Services.m_LogicalDevice->GetCommandQueue(ETransferQueue).WaitForSubmission(m_SubmissionIndex);
+}
+
+void krt::UploadBatch::AddStagingSize(const hlp::AccessorView& a_Data)
+{
+    assert(m_SubmissionIndex == 0 && "Adding uploads to a batch which has already been submitted.");
+
+    const uint64_t alignment = constants::StagingBufferAlignment;
+    m_StagingSize = ((m_StagingSize + alignment - 1) & ~(alignment - 1)) + a_Data.GetSizeInBytes();
+}
+
+std::vector<krt::UploadBatch::StagedCopy> krt::UploadBatch::SplitIntoCopies() const
+{
+    const uint64_t chunkSize = StagingRing::ChunkSize;
+    std::vector<StagedCopy> copies;
+
+    for (auto& upload : m_BufferUploads)
+    {
+        if (upload.m_Source.Empty())
+            continue;
+
+        const uint64_t elementSize = upload.m_Source.GetElementSize();
+        const uint64_t elementsPerCopy = std::max<uint64_t>(chunkSize / elementSize, 1);
+
+        for (uint64_t element = 0; element < upload.m_Source.Size(); element += elementsPerCopy)
+        {
+            auto& copy = copies.emplace_back();
+            copy.m_Source = upload.m_Source.Slice(element, std::min(elementsPerCopy, upload.m_Source.Size() - element));
+            copy.m_Buffer = upload.m_Target;
+            copy.m_BufferOffset = element * elementSize;
+            copy.m_Image = VK_NULL_HANDLE;
+        }
+    }
+
+    for (auto& upload : m_TextureUploads)
+    {
+        for (uint32_t level = 0; level < upload.m_Levels.size(); level++)
+        {
+            auto& levelData = upload.m_Levels[level];
+            auto dimensions = hlp::GetMipDimensions(upload.m_Dimensions, level);
+
+            // Rows of blocks cannot be told apart from the view, so compressed levels are never cut
+            uint32_t rowsPerCopy = dimensions.y;
+            if (upload.m_PixelSize != 0)
+            {
+                uint64_t rowSize = static_cast<uint64_t>(dimensions.x) * upload.m_PixelSize;
+                rowsPerCopy = static_cast<uint32_t>(std::clamp<uint64_t>(chunkSize / rowSize, 1, dimensions.y));
+            }
+
+            for (uint32_t row = 0; row < dimensions.y; row += rowsPerCopy)
+            {
+                uint32_t numRows = std::min(rowsPerCopy, dimensions.y - row);
+
+                auto& copy = copies.emplace_back();
+                copy.m_Source = upload.m_PixelSize != 0
+                    ? levelData.Slice(static_cast<uint64_t>(row) * dimensions.x, static_cast<uint64_t>(numRows) * dimensions.x)
+                    : levelData;
+                copy.m_Buffer = VK_NULL_HANDLE;
+                copy.m_BufferOffset = 0;
+                copy.m_Image = upload.m_Target;
+                copy.m_Extent = glm::uvec2(dimensions.x, numRows);
+                copy.m_MipLevel = level;
+                copy.m_FirstRow = row;
+            }
+        }
+    }
+
+    return copies;
+}
@@ -0,0 +1,121 @@
+#pragma once
+
+#include "SemaphoreAllocator.h"
+#include "AccessorView.h"
+
+#include "vulkan/vulkan.h"
+
+#include <glm/vec2.hpp>
+
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace krt
+{
+    struct ServiceLocator;
+    class VertexBuffer;
+    class IndexBuffer;
+    class Texture;
+    enum ECommandQueueType : uint8_t;
+}
+
+namespace krt
+{
+    // Gathers the uploads of many resources so that they share staging ranges, transfer command buffers and queue submissions.
+    // The batch is staged a chunk of the staging ring at a time, so it never holds more of the ring than a few chunks.
+    // Resources are created immediately, but their contents are only valid once the batch is resident.
+    // The CPU data handed to the batch is not copied until Submit, so it must stay alive until then.
+    // Data passed as an AccessorView is gathered straight from its source into the staging memory.
+    class UploadBatch
+    {
+    public:
+        UploadBatch(ServiceLocator& a_Services);
+        ~UploadBatch();
+
+        UploadBatch(UploadBatch&) = delete;             // No copy c-tor
+        UploadBatch(UploadBatch&&) = delete;            // No move c-tor
+        UploadBatch& operator=(UploadBatch&) = delete;  // No copy assignment
+        UploadBatch& operator=(UploadBatch&&) = delete; // No move assignment
+
+        // The asset the resources created from here on belong to, which their memory is accounted to
+        void SetOwner(const std::string& a_Owner) { m_Owner = a_Owner; }
+
+        std::unique_ptr<VertexBuffer> CreateVertexBuffer(const hlp::AccessorView& a_Elements, std::set<ECommandQueueType> a_QueuesWithAccess);
+        std::unique_ptr<VertexBuffer> CreateVertexBuffer(const void* a_BufferData, uint64_t a_NumElements,
+            uint64_t a_ElementSize, std::set<ECommandQueueType> a_QueuesWithAccess);
+
+        std::unique_ptr<IndexBuffer> CreateIndexBuffer(const hlp::AccessorView& a_Indices, std::set<ECommandQueueType> a_QueuesWithAccess);
+        std::unique_ptr<IndexBuffer> CreateIndexBuffer(const void* a_IndexData, uint64_t a_NumElements,
+            uint8_t a_ElementSize, std::set<ECommandQueueType> a_QueuesWithAccess);
+
+        // a_Data holds a_NumMips levels back to back, each tightly packed and half the size of the previous one (see hlp::GetMipDimensions)
+        std::unique_ptr<Texture> CreateTexture(const void* a_Data, glm::uvec2 a_Dimensions, const uint8_t a_NumChannels, const uint8_t a_BytesPerChannel,
+            std::set<ECommandQueueType> a_QueuesWithAccess, VkPipelineStageFlags a_UsingStages = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+            uint32_t a_NumMips = 1);
+        // Uploads data that is already in the layout of a_Format, such as the blocks of a compressed texture.
+        // There is one view per mip level, starting at the full resolution level, and the levels do not have to be contiguous.
+        std::unique_ptr<Texture> CreateTexture(const std::vector<hlp::AccessorView>& a_Levels, glm::uvec2 a_Dimensions, VkFormat a_Format,
+            std::set<ECommandQueueType> a_QueuesWithAccess, VkPipelineStageFlags a_UsingStages = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+
+        // Copies the pending data into the staging ring one chunk at a time, submitting a command buffer on the transfer queue per chunk.
+        // Once the ring is full, staging the next chunk waits for the oldest submitted one to be done with its range.
+        // The optional semaphore is signaled once all resources of the batch are resident.
+        void Submit(Semaphore a_SignalSemaphore = nullptr);
+
+        // Returns true once the transfer queue has finished executing the batch
+        bool IsResident();
+        // Puts the thread to sleep until the transfer queue has finished executing the batch
+        void WaitUntilResident();
+
+        uint64_t GetStagingSize() const { return m_StagingSize; }
+        uint32_t GetNumUploads() const { return static_cast<uint32_t>(m_BufferUploads.size() + m_TextureUploads.size()); }
+
+    private:
+
+        // Adds the data to the staging size of the batch
+        void AddStagingSize(const hlp::AccessorView& a_Data);
+
+        struct BufferUpload
+        {
+            VkBuffer m_Target;
+            hlp::AccessorView m_Source;
+        };
+
+        struct TextureUpload
+        {
+            VkImage m_Target;
+            glm::uvec2 m_Dimensions;
+            VkPipelineStageFlags m_UsingStages;
+            uint32_t m_PixelSize;                   // 0 when the levels are made of blocks, which are staged a whole level at a time
+            std::vector<hlp::AccessorView> m_Levels;
+        };
+
+        // A piece of an upload small enough to share a chunk of the staging ring with others.
+        // Either m_Buffer or m_Image is set.
+        struct StagedCopy
+        {
+            hlp::AccessorView m_Source;
+            uint64_t m_StagingOffset;               // Offset within the chunk
+            VkBuffer m_Buffer;
+            uint64_t m_BufferOffset;
+            VkImage m_Image;
+            glm::uvec2 m_Extent;                    // Width of the level and number of rows
+            uint32_t m_MipLevel;
+            uint32_t m_FirstRow;
+        };
+
+        // Cuts the uploads into pieces of at most a chunk, buffers at element boundaries and textures in bands of rows
+        std::vector<StagedCopy> SplitIntoCopies() const;
+
+        ServiceLocator& m_Services;
+        std::string m_Owner;
+
+        std::vector<BufferUpload> m_BufferUploads;
+        std::vector<TextureUpload> m_TextureUploads;
+
+        uint64_t m_StagingSize;
+        uint64_t m_SubmissionIndex; // 0 until the batch has been submitted
+    };
+}
@@ -22,7 +22,7 @@ namespace krt
             ViewType* operator[](uint64_t a_Index);
 
         private:
-            std::vector<VectorType> m_Vector;
+            std::vector<VectorType>& m_Vector;
         };
 
         template <typename ViewType, typename VectorType>
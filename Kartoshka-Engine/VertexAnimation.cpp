@@ -0,0 +1,225 @@
+#include "VertexAnimation.h"
+
+#include "Skeleton.h"
+#include "Texture.h"
+#include "VertexQuantization.h"
+
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+#include <glm/mat3x3.hpp>
+#include <glm/matrix.hpp>
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <limits>
+
+namespace
+{
+    // Normals that are missing in the interleaved layout are stored as zero, and vertices without weights skin any direction to zero
+    glm::vec3 GetDirection(const glm::vec3& a_Normal)
+    {
+        return glm::dot(a_Normal, a_Normal) > 0.0f ? glm::normalize(a_Normal) : glm::vec3(0.0f, 0.0f, 1.0f);
+    }
+}
+
+krt::VertexAnimation::VertexAnimation()
+    : m_FrameRate(0.0f)
+{
+}
+
+krt::VertexAnimation::~VertexAnimation()
+{
+}
+
+uint64_t krt::VertexAnimation::GetMemorySize() const
+{
+    uint64_t size = 0;
+    for (auto& primitive : m_Primitives)
+        size += static_cast<uint64_t>(primitive.m_Dimensions.x) * primitive.m_Dimensions.y * sizeof(Texel);
+
+    return size;
+}
+
+std::vector<krt::VertexAnimation::Clip> krt::hlp::PlanVertexAnimationClips(const Skeleton& a_Skeleton, float a_FrameRate)
+{
+    assert(a_FrameRate > 0.0f);
+
+    std::vector<VertexAnimation::Clip> clips;
+    uint32_t firstFrame = 0;
+
+    for (auto& animationClip : a_Skeleton.m_Clips)
+    {
+        auto& clip = clips.emplace_back();
+        clip.m_Name = animationClip.m_Name;
+        clip.m_FirstFrame = firstFrame;
+        clip.m_NumFrames = std::max(static_cast<uint32_t>(std::ceil(animationClip.m_Duration * a_FrameRate)) + 1, 2u);
+        clip.m_Duration = animationClip.m_Duration;
+
+        firstFrame += clip.m_NumFrames;
+    }
+
+    return clips;
+}
+
+uint32_t krt::hlp::GetVertexAnimationRowsPerFrame(uint32_t a_NumVertices)
+{
+    return std::max((a_NumVertices + VertexAnimation::MaxTextureWidth - 1) / VertexAnimation::MaxTextureWidth, 1u);
+}
+
+float krt::hlp::FitVertexAnimationFrameRate(const Skeleton& a_Skeleton, float a_FrameRate, uint32_t a_RowsPerFrame, uint32_t a_MaxRows)
+{
+    assert(a_RowsPerFrame > 0);
+
+    uint64_t maxFrames = a_MaxRows / a_RowsPerFrame;
+    if (2 * static_cast<uint64_t>(a_Skeleton.m_Clips.size()) > maxFrames)
+        return 0.0f;
+
+    // Every clip rounds its frames up and adds the one at its end, so the rate is lowered in steps until the total fits.
+    // Clips shorter than a frame end up with their two frames, which the check above allows for.
+    float frameRate = a_FrameRate;
+    for (;;)
+    {
+        auto clips = PlanVertexAnimationClips(a_Skeleton, frameRate);
+        uint64_t numFrames = clips.empty() ? 0 : clips.back().m_FirstFrame + clips.back().m_NumFrames;
+        if (numFrames <= maxFrames)
+            return frameRate;
+
+        frameRate *= std::min(0.95f, static_cast<float>(maxFrames) / static_cast<float>(numFrames));
+    }
+}
+
+krt::hlp::VertexAnimationData krt::hlp::BakeVertexAnimation(const Skeleton& a_Skeleton, const std::vector<VertexAnimation::Clip>& a_Clips,
+    EVertexLayout a_Layout, const AccessorView& a_Positions, const AccessorView& a_Attributes, const AccessorView& a_Normals,
+    const AccessorView& a_Tangents, const AccessorView& a_SkinAttributes)
+{
+    auto numVertices = static_cast<uint32_t>(a_Positions.Size());
+    assert(a_SkinAttributes.Size() == numVertices && a_SkinAttributes.GetElementSize() == sizeof(Mesh::SkinVertex));
+    assert(a_Clips.size() == a_Skeleton.m_Clips.size());
+
+    // The bind pose attributes are decoded once, in whichever layout the primitive was uploaded in
+    std::vector<glm::vec3> normals(numVertices, glm::vec3(0.0f, 0.0f, 1.0f));
+    std::vector<glm::vec4> tangents(numVertices, glm::vec4(1.0f, 0.0f, 0.0f, 1.0f));
+
+    for (uint32_t i = 0; i < numVertices; i++)
+    {
+        if (a_Layout == ESeparateVertexStreams)
+        {
+            if (a_Normals.Size() == numVertices)
+                normals[i] = glm::vec3(ReadNormalized(a_Normals, i, glm::vec4(0.0f, 0.0f, 1.0f, 0.0f)));
+            if (a_Tangents.Size() == numVertices)
+                tangents[i] = ReadNormalized(a_Tangents, i, glm::vec4(1.0f));
+        }
+        else if (a_Layout == EInterleavedVertexAttributes)
+        {
+            auto interleaved = a_Attributes.Get<Mesh::InterleavedVertex>(i);
+            normals[i] = interleaved.m_Normal;
+            tangents[i] = interleaved.m_Tangent;
+        }
+        else
+        {
+            auto quantized = a_Attributes.Get<Mesh::QuantizedVertex>(i);
+            normals[i] = DecodeOctahedral(glm::vec2(quantized.m_Normal) / 32767.0f);
+            tangents[i] = DecodeTangent(quantized.m_Tangent);
+        }
+
+        normals[i] = GetDirection(normals[i]);
+    }
+
+    uint32_t numFrames = 0;
+    for (auto& clip : a_Clips)
+        numFrames = std::max(numFrames, clip.m_FirstFrame + clip.m_NumFrames);
+
+    VertexAnimationData data;
+    data.m_Dimensions.x = std::max(std::min(numVertices, VertexAnimation::MaxTextureWidth), 1u);
+    data.m_RowsPerFrame = GetVertexAnimationRowsPerFrame(numVertices);
+    data.m_Dimensions.y = numFrames * data.m_RowsPerFrame;
+
+    // The positions are only quantized once the bounds of every frame are known, the directions are encoded right away
+    std::vector<glm::vec3> positions(static_cast<size_t>(numVertices) * numFrames);
+    data.m_Texels.resize(static_cast<size_t>(data.m_Dimensions.x) * data.m_Dimensions.y);
+
+    glm::vec3 boundsMin(std::numeric_limits<float>::max());
+    glm::vec3 boundsMax(std::numeric_limits<float>::lowest());
+
+    SkeletonPose pose;
+    AnimationCursor cursor;
+    std::vector<glm::mat4> boneMatrices;
+    std::vector<glm::vec4> palette(a_Skeleton.GetNumJoints() * Skeleton::PaletteRowsPerJoint);
+
+    for (size_t c = 0; c < a_Clips.size(); c++)
+    {
+        auto& clip = a_Clips[c];
+
+        for (uint32_t f = 0; f < clip.m_NumFrames; f++)
+        {
+            // Sampled front to back, so the cursor only ever moves forward
+            float time = clip.m_Duration * static_cast<float>(f) / static_cast<float>(clip.m_NumFrames - 1);
+            a_Skeleton.SamplePose(a_Skeleton.m_Clips[c], time, cursor, pose);
+            a_Skeleton.ComputePalette(pose, boneMatrices, palette.data());
+
+            auto frame = clip.m_FirstFrame + f;
+            auto* frameTexels = &data.m_Texels[static_cast<size_t>(frame) * data.m_RowsPerFrame * data.m_Dimensions.x];
+            auto* framePositions = &positions[static_cast<size_t>(frame) * numVertices];
+
+            for (uint32_t i = 0; i < numVertices; i++)
+            {
+                auto skin = a_SkinAttributes.Get<Mesh::SkinVertex>(i);
+
+                // Same blend of the palette rows as SkinnedVertex.glsl, which keeps the last column for the translation
+                glm::vec4 rows[Skeleton::PaletteRowsPerJoint] = { glm::vec4(0.0f), glm::vec4(0.0f), glm::vec4(0.0f) };
+                for (uint32_t j = 0; j < 4; j++)
+                {
+                    float weight = static_cast<float>(skin.m_Weights[j]) / 65535.0f;
+                    if (weight == 0.0f)
+                        continue;
+
+                    auto* joint = &palette[skin.m_Joints[j] * Skeleton::PaletteRowsPerJoint];
+                    for (uint32_t row = 0; row < Skeleton::PaletteRowsPerJoint; row++)
+                        rows[row] += joint[row] * weight;
+                }
+
+                glm::vec4 position(a_Positions.Get<glm::vec3>(i), 1.0f);
+                glm::vec3 skinned(glm::dot(rows[0], position), glm::dot(rows[1], position), glm::dot(rows[2], position));
+
+                // The rows are transposed into the columns of the linear part, whose inverse transpose carries the normal.
+                // Vertices without any weight collapse, and keep their bind pose normal.
+                glm::mat3 linear = glm::transpose(glm::mat3(glm::vec3(rows[0]), glm::vec3(rows[1]), glm::vec3(rows[2])));
+                glm::mat3 normalMatrix = glm::determinant(linear) != 0.0f ? glm::transpose(glm::inverse(linear)) : glm::mat3(1.0f);
+                glm::vec3 normal = GetDirection(normalMatrix * normals[i]);
+                glm::vec3 tangent = GetDirection(linear * glm::vec3(tangents[i]));
+
+                framePositions[i] = skinned;
+                boundsMin = glm::min(boundsMin, skinned);
+                boundsMax = glm::max(boundsMax, skinned);
+
+                auto& texel = frameTexels[i];
+                texel.m_Normal = EncodeOctahedral(normal);
+                texel.m_Tangent = EncodeTangent(glm::vec4(tangent, tangents[i].w < 0.0f ? -1.0f : 1.0f));
+            }
+        }
+    }
+
+    if (numVertices == 0 || numFrames == 0)
+        boundsMin = boundsMax = glm::vec3(0.0f);
+
+    data.m_BoundsMin = boundsMin;
+    data.m_BoundsExtent = boundsMax - boundsMin;
+
+    // Flat axes would divide by zero, their positions all quantize to the minimum
+    glm::vec3 scale = glm::vec3(65535.0f) / glm::max(data.m_BoundsExtent, glm::vec3(std::numeric_limits<float>::min()));
+
+    for (uint32_t frame = 0; frame < numFrames; frame++)
+    {
+        auto* frameTexels = &data.m_Texels[static_cast<size_t>(frame) * data.m_RowsPerFrame * data.m_Dimensions.x];
+        auto* framePositions = &positions[static_cast<size_t>(frame) * numVertices];
+
+        for (uint32_t i = 0; i < numVertices; i++)
+        {
+            glm::vec3 quantized = glm::clamp(glm::round((framePositions[i] - boundsMin) * scale), glm::vec3(0.0f), glm::vec3(65535.0f));
+            frameTexels[i].m_Position = glm::u16vec4(glm::u16vec3(quantized), 0);
+        }
+    }
+
+    return data;
+}
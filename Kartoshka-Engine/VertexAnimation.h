@@ -0,0 +1,107 @@
+#pragma once
+
+#include "AccessorView.h"
+#include "Mesh.h"
+
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+#include <glm/gtc/type_precision.hpp>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace krt
+{
+    class Texture;
+    struct Skeleton;
+}
+
+namespace krt
+{
+    // The clips of a skeleton baked into a vertex animation texture for every primitive of a skinned mesh, see hlp::BakeVertexAnimation.
+    // Every frame of every clip holds the skinned position, normal and tangent of each vertex, so drawing an animated instance
+    // is a texture fetch per vertex instead of a pose sample and palette on the CPU.
+    struct VertexAnimation
+    {
+        // One vertex in one frame, read as R32G32B32A32_UINT by CrowdVertex.glsl
+        struct Texel
+        {
+            glm::u16vec4 m_Position;    // UNORM16 within the bounds of the bake, w is unused
+            glm::i16vec2 m_Normal;      // Octahedral SNORM16
+            glm::i16vec2 m_Tangent;     // Octahedral SNORM16, with the handedness in the sign of y
+        };
+
+        // The frames of a clip follow each other in the texture. The last frame is sampled at the duration of the clip,
+        // so playback that loops interpolates from it back to the first.
+        struct Clip
+        {
+            std::string m_Name;
+            uint32_t m_FirstFrame;
+            uint32_t m_NumFrames;
+            float m_Duration;
+        };
+
+        struct BakedPrimitive
+        {
+            std::unique_ptr<Texture> m_Texture;  // Empty for primitives without joints and weights, which are not drawn
+            glm::uvec2 m_Dimensions;
+            uint32_t m_RowsPerFrame;    // Vertices wrap to the next row once a row is MaxTextureWidth texels wide
+            glm::vec3 m_BoundsMin;      // Of the positions of every frame, which the texels are quantized to
+            glm::vec3 m_BoundsExtent;
+        };
+
+        // Wide enough for most meshes to fit a frame in a single row, and well within the limits of any device
+        static const uint32_t MaxTextureWidth = 4096;
+
+        VertexAnimation();
+        ~VertexAnimation();
+
+        VertexAnimation(VertexAnimation&) = delete;
+        VertexAnimation(VertexAnimation&&) = delete;
+        VertexAnimation& operator=(VertexAnimation&) = delete;
+        VertexAnimation& operator=(VertexAnimation&&) = delete;
+
+        // Bytes of all textures
+        uint64_t GetMemorySize() const;
+
+        // The resident mesh of the file, whose joints and weights are left unused since they are already applied
+        std::shared_ptr<Mesh> m_Mesh;
+        std::vector<BakedPrimitive> m_Primitives;  // Indexed like the primitives of the mesh
+
+        std::vector<Clip> m_Clips;
+        float m_FrameRate;
+    };
+
+    namespace hlp
+    {
+        // Texels of one primitive, laid out as rows of at most MaxTextureWidth vertices with the frames below each other
+        struct VertexAnimationData
+        {
+            glm::uvec2 m_Dimensions;
+            uint32_t m_RowsPerFrame;
+            glm::vec3 m_BoundsMin;
+            glm::vec3 m_BoundsExtent;
+            std::vector<VertexAnimation::Texel> m_Texels;
+        };
+
+        // Places the clips of the skeleton back to back, with a frame every 1 / a_FrameRate seconds and at least two frames per clip
+        std::vector<VertexAnimation::Clip> PlanVertexAnimationClips(const Skeleton& a_Skeleton, float a_FrameRate);
+
+        // Rows a frame of a primitive with this many vertices takes up in its texture
+        uint32_t GetVertexAnimationRowsPerFrame(uint32_t a_NumVertices);
+
+        // Lowers the frame rate until the frames of every clip fit into a texture that is a_MaxRows high.
+        // Returns 0 if they do not fit even with the two frames every clip has at least.
+        float FitVertexAnimationFrameRate(const Skeleton& a_Skeleton, float a_FrameRate, uint32_t a_RowsPerFrame, uint32_t a_MaxRows);
+
+        // Samples the clips and skins the final streams of a primitive in the given layout with the palette of every frame,
+        // which are the separate normals and tangents or the interleaved attributes like for MorphTargets.
+        // The positions end up in the space of the skeleton, as they do when the primitive is skinned on the GPU.
+        VertexAnimationData BakeVertexAnimation(const Skeleton& a_Skeleton, const std::vector<VertexAnimation::Clip>& a_Clips,
+                                                EVertexLayout a_Layout, const AccessorView& a_Positions, const AccessorView& a_Attributes,
+                                                const AccessorView& a_Normals, const AccessorView& a_Tangents,
+                                                const AccessorView& a_SkinAttributes);
+    }
+}
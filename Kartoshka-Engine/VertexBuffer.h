@@ -8,6 +8,7 @@ namespace krt
 {
     struct ServiceLocator;
     class CommandBuffer;
+    class UploadBatch;
 }
 
 namespace krt
@@ -16,6 +17,7 @@ namespace krt
     class VertexBuffer : public Buffer
     {
         friend CommandBuffer;
+        friend UploadBatch;
     public:
         VertexBuffer(ServiceLocator& a_Services, uint64_t a_InitialSize, VkBufferUsageFlags a_UsageFlags,
             VkMemoryPropertyFlags a_MemoryPropertyFlags, std::set<ECommandQueueType>  a_QueuesWithAccess);
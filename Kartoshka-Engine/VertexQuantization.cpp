@@ -0,0 +1,170 @@
+#include "VertexQuantization.h"
+
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+#include <glm/gtc/packing.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+    const float Snorm16Max = 32767.0f;
+
+    glm::vec2 SignNotZero(const glm::vec2& a_Value)
+    {
+        return glm::vec2(a_Value.x >= 0.0f ? 1.0f : -1.0f, a_Value.y >= 0.0f ? 1.0f : -1.0f);
+    }
+
+    // Unquantized octahedral coordinates in [-1, 1]
+    glm::vec2 ProjectOctahedral(const glm::vec3& a_Direction)
+    {
+        float l1Norm = std::abs(a_Direction.x) + std::abs(a_Direction.y) + std::abs(a_Direction.z);
+        if (l1Norm == 0.0f)
+            return glm::vec2(0.0f);
+
+        glm::vec2 projected = glm::vec2(a_Direction.x, a_Direction.y) / l1Norm;
+
+        // The lower hemisphere is folded over the diagonals
+        if (a_Direction.z < 0.0f)
+            projected = (1.0f - glm::abs(glm::vec2(projected.y, projected.x))) * SignNotZero(projected);
+
+        return projected;
+    }
+
+    float ReadComponent(const uint8_t* a_Element, uint32_t a_Component, fx::gltf::Accessor::ComponentType a_Type)
+    {
+        using ComponentType = fx::gltf::Accessor::ComponentType;
+
+        switch (a_Type)
+        {
+        case ComponentType::Float:
+        {
+            float value;
+            memcpy(&value, a_Element + a_Component * sizeof(float), sizeof(value));
+            return value;
+        }
+        case ComponentType::UnsignedByte:
+            return a_Element[a_Component] / 255.0f;
+        case ComponentType::UnsignedShort:
+        {
+            uint16_t value;
+            memcpy(&value, a_Element + a_Component * sizeof(uint16_t), sizeof(value));
+            return value / 65535.0f;
+        }
+        case ComponentType::Byte:
+            return std::max(static_cast<int8_t>(a_Element[a_Component]) / 127.0f, -1.0f);
+        case ComponentType::Short:
+        {
+            int16_t value;
+            memcpy(&value, a_Element + a_Component * sizeof(int16_t), sizeof(value));
+            return std::max(value / Snorm16Max, -1.0f);
+        }
+        default:
+            return 0.0f;
+        }
+    }
+
+    uint32_t GetComponentSize(fx::gltf::Accessor::ComponentType a_Type)
+    {
+        using ComponentType = fx::gltf::Accessor::ComponentType;
+
+        switch (a_Type)
+        {
+        case ComponentType::Byte:
+        case ComponentType::UnsignedByte:
+            return 1;
+        case ComponentType::Short:
+        case ComponentType::UnsignedShort:
+            return 2;
+        default:
+            return 4;
+        }
+    }
+}
+
+glm::i16vec2 krt::hlp::EncodeOctahedral(const glm::vec3& a_Direction)
+{
+    glm::vec2 projected = ProjectOctahedral(a_Direction);
+    glm::vec2 scaled = projected * Snorm16Max;
+    glm::vec2 base = glm::floor(scaled);
+
+    glm::vec3 direction = glm::normalize(a_Direction);
+    glm::i16vec2 best(0, 0);
+    float bestCos = -2.0f;
+
+    for (uint32_t i = 0; i < 4; i++)
+    {
+        glm::vec2 candidate = glm::clamp(base + glm::vec2(static_cast<float>(i & 1), static_cast<float>(i >> 1)), -Snorm16Max, Snorm16Max);
+        float cosAngle = glm::dot(DecodeOctahedral(candidate / Snorm16Max), direction);
+
+        if (cosAngle > bestCos)
+        {
+            bestCos = cosAngle;
+            best = glm::i16vec2(static_cast<int16_t>(candidate.x), static_cast<int16_t>(candidate.y));
+        }
+    }
+
+    return best;
+}
+
+glm::vec3 krt::hlp::DecodeOctahedral(const glm::vec2& a_Encoded)
+{
+    glm::vec3 direction(a_Encoded.x, a_Encoded.y, 1.0f - std::abs(a_Encoded.x) - std::abs(a_Encoded.y));
+
+    float fold = std::max(-direction.z, 0.0f);
+    direction.x += direction.x >= 0.0f ? -fold : fold;
+    direction.y += direction.y >= 0.0f ? -fold : fold;
+
+    return glm::normalize(direction);
+}
+
+glm::i16vec2 krt::hlp::EncodeTangent(const glm::vec4& a_Tangent)
+{
+    glm::vec2 projected = ProjectOctahedral(glm::vec3(a_Tangent));
+
+    // Remapped to [0, 1] to free up the sign, and kept at least one step away from zero so the sign survives
+    float magnitude = std::max(std::round((projected.y * 0.5f + 0.5f) * Snorm16Max), 1.0f);
+    float y = a_Tangent.w < 0.0f ? -magnitude : magnitude;
+
+    return glm::i16vec2(static_cast<int16_t>(std::round(projected.x * Snorm16Max)), static_cast<int16_t>(y));
+}
+
+glm::vec4 krt::hlp::DecodeTangent(const glm::i16vec2& a_Encoded)
+{
+    float handedness = a_Encoded.y < 0 ? -1.0f : 1.0f;
+    glm::vec2 projected(a_Encoded.x / Snorm16Max, (std::abs(a_Encoded.y) / Snorm16Max) * 2.0f - 1.0f);
+
+    return glm::vec4(DecodeOctahedral(projected), handedness);
+}
+
+glm::u16vec2 krt::hlp::EncodeHalf2(const glm::vec2& a_Value)
+{
+    auto packed = glm::packHalf2x16(a_Value);
+    return glm::u16vec2(static_cast<uint16_t>(packed & 0xFFFF), static_cast<uint16_t>(packed >> 16));
+}
+
+glm::u8vec4 krt::hlp::EncodeUnorm8(const glm::vec4& a_Value)
+{
+    glm::vec4 scaled = glm::round(glm::clamp(a_Value, 0.0f, 1.0f) * 255.0f);
+    return glm::u8vec4(scaled);
+}
+
+glm::vec4 krt::hlp::ReadNormalized(const AccessorView& a_View, uint64_t a_Index, const glm::vec4& a_Default)
+{
+    // Four float components are the largest element any of the quantized attributes can have
+    uint8_t element[sizeof(glm::vec4)];
+    if (a_View.GetElementSize() > sizeof(element))
+        return a_Default;
+
+    a_View.CopyElementTo(a_Index, element);
+
+    uint32_t numComponents = std::min(a_View.GetElementSize() / GetComponentSize(a_View.GetComponentType()), 4u);
+
+    glm::vec4 value = a_Default;
+    for (uint32_t i = 0; i < numComponents; i++)
+        value[i] = ReadComponent(element, i, a_View.GetComponentType());
+
+    return value;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "AccessorView.h"
+
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+#include <glm/gtc/type_precision.hpp>
+
+namespace krt
+{
+    namespace hlp
+    {
+        // Octahedral encoding of a unit vector as two SNORM16 components.
+        // Of the four neighbouring SNORM16 values, the one that decodes closest to the input is picked,
+        // which keeps the angular error below 0.01 degrees.
+        glm::i16vec2 EncodeOctahedral(const glm::vec3& a_Direction);
+        glm::vec3 DecodeOctahedral(const glm::vec2& a_Encoded);
+
+        // Octahedral encoding of a glTF tangent, with its handedness folded into the sign of the second component.
+        // The second component stores (y * 0.5 + 0.5) * handedness, so it can never be zero.
+        glm::i16vec2 EncodeTangent(const glm::vec4& a_Tangent);
+        glm::vec4 DecodeTangent(const glm::i16vec2& a_Encoded);
+
+        glm::u16vec2 EncodeHalf2(const glm::vec2& a_Value);
+        glm::u8vec4 EncodeUnorm8(const glm::vec4& a_Value);
+
+        // Reads an element of a float or normalized integer accessor with up to four components.
+        // Components the accessor does not have are filled in from the default.
+        glm::vec4 ReadNormalized(const AccessorView& a_View, uint64_t a_Index, const glm::vec4& a_Default);
+    }
+}
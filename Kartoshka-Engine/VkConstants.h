@@ -5,6 +5,7 @@
  * This currently includes the following constants:
  *  -- The validation layers to use when running in debug
  *  -- The required extensions
+ *  -- The alignment of regions within staging buffers
  *
  */
 
@@ -22,6 +23,9 @@ namespace krt
             VK_KHR_SWAPCHAIN_EXTENSION_NAME,
             VK_KHR_MAINTENANCE1_EXTENSION_NAME,
         };
+
+        // Satisfies the texel size requirement of vkCmdCopyBufferToImage for all formats used by the engine
+        const uint64_t StagingBufferAlignment = 16;
     }
 
 }
@@ -155,6 +155,17 @@ VkResult krt::vkext::CreateDebugUtilsMessengerEXT(VkInstance a_Instance, VkDebug
     return VK_SUCCESS;
 }
 
+VkResult krt::vkext::GetPhysicalDeviceMemoryProperties2KHR(VkInstance a_Instance, VkPhysicalDevice a_PhysicalDevice,
+    VkPhysicalDeviceMemoryProperties2& a_Properties)
+{
+    auto func = (PFN_vkGetPhysicalDeviceMemoryProperties2KHR)vkGetInstanceProcAddr(a_Instance, "vkGetPhysicalDeviceMemoryProperties2KHR");
+    if (func != nullptr)
+        func(a_PhysicalDevice, &a_Properties);
+    else
+        return VK_ERROR_EXTENSION_NOT_PRESENT;
+    return VK_SUCCESS;
+}
+
 VkResult krt::vkext::DestroyDebugUtilsMessengerEXT(VkInstance a_Instance, VkDebugUtilsMessengerEXT& a_Messenger, VkAllocationCallbacks* a_Callbacks)
 {
     auto func = (PFN_vkDestroyDebugUtilsMessengerEXT)vkGetInstanceProcAddr(a_Instance, "vkDestroyDebugUtilsMessengerEXT");
@@ -46,5 +46,9 @@ namespace krt
 
         VkResult DestroyDebugUtilsMessengerEXT(VkInstance a_Instance, VkDebugUtilsMessengerEXT& a_Messenger,
             VkAllocationCallbacks* a_Callbacks);
+
+        // Needs VK_KHR_get_physical_device_properties2 on the instance, which is how VK_EXT_memory_budget reports its numbers
+        VkResult GetPhysicalDeviceMemoryProperties2KHR(VkInstance a_Instance, VkPhysicalDevice a_PhysicalDevice,
+            VkPhysicalDeviceMemoryProperties2& a_Properties);
     }
 }
@@ -8,6 +8,9 @@ int main()
     init.m_Width = 1440;
     init.m_Height = 900;
     init.m_Title = "Kartofelnoe Pyure";
+    init.m_WorkerThreadCount = 0;
+    init.m_VertexLayout = krt::EQuantizedVertexAttributes;
+    init.m_OptimizeMeshes = true;
 
     app.Run(init);
 }
\ No newline at end of file
@@ -0,0 +1,122 @@
+#version 450
+#pragma shader_stage(vertex)
+
+// Vertex shader of crowds, which reads the skinned vertex from the vertex animation texture of the primitive instead of skinning it,
+// see VertexAnimation.h. Every agent plays its own clip from its own time offset, the frames around its time are blended.
+// Only the texture coordinates and colors are read from the vertex buffers, so it works with every vertex layout.
+
+layout (location = 1) in vec2 i_Tex;
+layout (location = 2) in vec4 i_Color;
+layout (location = 5) in mat4 i_WorldMatrix; // Local to World, per instance
+layout (location = 9) in uvec2 i_Clip; // First frame and number of frames of the clip of the instance
+layout (location = 10) in vec2 i_Playback; // Seconds the instance is ahead of the crowd, and loops of the clip per second
+
+layout(push_constant) uniform PushConstants
+{
+	mat4 m_ViewProjection; // World to Clip
+	vec3 m_BoundsMin; // The positions are quantized to the bounds of the bake
+	float m_Time; // Seconds since the crowd started
+	vec3 m_BoundsExtent;
+	uint m_RowsPerFrame;
+} u_Push;
+
+// Texels are fetched by their coordinates, so the sampler is only there to combine with the texture
+layout(set = 2, binding = 0) uniform utexture2D u_Animation;
+layout(set = 2, binding = 1) uniform sampler u_Sampler;
+
+layout (location = 1) out vec3 o_WorldPosition;
+layout (location = 0) out vec2 o_Tex;
+layout (location = 2) out vec4 o_Color;
+layout (location = 3) out vec3 o_Normal;
+layout (location = 4) out mat3x3 o_TBN;
+
+out gl_PerVertex
+{
+	vec4 gl_Position;
+};
+
+struct AnimatedVertex
+{
+	vec3 m_Position;
+	vec3 m_Normal;
+	vec4 m_Tangent;
+};
+
+vec3 DecodeOctahedral(vec2 a_Encoded)
+{
+	vec3 v = vec3(a_Encoded, 1.0f - abs(a_Encoded.x) - abs(a_Encoded.y));
+
+	// Unfold the lower hemisphere
+	float fold = max(-v.z, 0.0f);
+	v.x += v.x >= 0.0f ? -fold : fold;
+	v.y += v.y >= 0.0f ? -fold : fold;
+
+	return normalize(v);
+}
+
+vec4 DecodeTangent(vec2 a_Encoded)
+{
+	float handedness = a_Encoded.y < 0.0f ? -1.0f : 1.0f;
+	vec2 octahedral = vec2(a_Encoded.x, abs(a_Encoded.y) * 2.0f - 1.0f);
+
+	return vec4(DecodeOctahedral(octahedral), handedness);
+}
+
+// The vertices of a frame fill its rows from left to right, see VertexAnimation::Texel for the packing
+AnimatedVertex FetchVertex(uint a_Frame)
+{
+	uint width = uint(textureSize(usampler2D(u_Animation, u_Sampler), 0).x);
+	uint vertex = uint(gl_VertexIndex);
+	ivec2 coordinates = ivec2(vertex % width, a_Frame * u_Push.m_RowsPerFrame + vertex / width);
+
+	uvec4 texel = texelFetch(usampler2D(u_Animation, u_Sampler), coordinates, 0);
+
+	AnimatedVertex result;
+	result.m_Position = u_Push.m_BoundsMin + vec3(unpackUnorm2x16(texel.x), unpackUnorm2x16(texel.y).x) * u_Push.m_BoundsExtent;
+	result.m_Normal = DecodeOctahedral(unpackSnorm2x16(texel.z));
+	result.m_Tangent = DecodeTangent(unpackSnorm2x16(texel.w));
+
+	return result;
+}
+
+mat3x3 CalculateTBN(mat4 a_Model, vec4 a_Tangent, vec3 a_Normal)
+{
+	mat4 mat = inverse(transpose(a_Model));
+
+	// Transform the normal into world space
+	vec3 N = normalize(vec4(a_Normal, 0.0f) * mat).xyz;
+
+	// Transform the tangent into world space
+	vec3 T = normalize(vec4(a_Tangent.xyz, 0.0f) * mat).xyz;
+
+	vec3 B = cross(T, N) * a_Tangent.w;
+
+	return inverse(mat3x3(T, B, N));
+}
+
+void main()
+{
+	// The last frame of a clip is its first one again, so looping blends back into the start
+	float position = fract((u_Push.m_Time + i_Playback.x) * i_Playback.y) * float(i_Clip.y - 1);
+	uint frame = min(uint(position), i_Clip.y - 2);
+	float blend = position - float(frame);
+
+	AnimatedVertex current = FetchVertex(i_Clip.x + frame);
+	AnimatedVertex next = FetchVertex(i_Clip.x + frame + 1);
+
+	vec3 localPosition = mix(current.m_Position, next.m_Position, blend);
+	vec3 normal = normalize(mix(current.m_Normal, next.m_Normal, blend));
+	vec4 tangent = vec4(normalize(mix(current.m_Tangent.xyz, next.m_Tangent.xyz, blend)), current.m_Tangent.w);
+
+	mat4 model = i_WorldMatrix;
+
+	o_Tex = i_Tex;
+	o_Color = i_Color;
+	vec4 worldPosition = model * vec4(localPosition, 1.0f);
+
+	o_WorldPosition = worldPosition.xyz;
+	o_Normal = normalize(vec4(normal, 0.0f) * inverse(model)).xyz;
+	o_TBN = CalculateTBN(model, tangent, normal);
+
+	gl_Position = u_Push.m_ViewProjection * worldPosition;
+}
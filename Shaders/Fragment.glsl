@@ -65,6 +65,8 @@ void main()
 	vec3 sampledNormal = texture(sampler2D(u_NormalMap, smp), vec2(i_TexCoords.x, i_TexCoords.y)).xyz;
 	sampledNormal.y = 1.0f - sampledNormal.y;
 	sampledNormal = sampledNormal * 2.0f - 1.0f;
+	// Compressed normal maps only store X and Y
+	sampledNormal.z = sqrt(max(0.0f, 1.0f - dot(sampledNormal.xy, sampledNormal.xy)));
 	
 	vec3 normal;
 	//normal = i_TBN * sampledNormal;
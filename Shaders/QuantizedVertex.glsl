@@ -0,0 +1,79 @@
+#version 450
+#pragma shader_stage(vertex)
+
+// Vertex shader of the quantized vertex layout, see Mesh::QuantizedVertex.
+// The texture coordinates and colors are expanded by the vertex fetch, only the normals and tangents need decoding.
+
+layout (location = 0) in vec3 i_Pos;
+layout (location = 1) in vec2 i_Tex;
+layout (location = 2) in vec4 i_Color;
+layout (location = 3) in vec2 i_Normal;  // Octahedral
+layout (location = 4) in vec2 i_Tangent; // Octahedral, y holds (y * 0.5 + 0.5) * handedness
+layout (location = 5) in mat4 i_WorldMatrix; // Local to World, per instance
+
+layout(push_constant) uniform PushConstants
+{
+	mat4 m_ViewProjection; // World to Clip
+} u_Push;
+
+layout (location = 1) out vec3 o_WorldPosition;
+layout (location = 0) out vec2 o_Tex;
+layout (location = 2) out vec4 o_Color;
+layout (location = 3) out vec3 o_Normal;
+layout (location = 4) out mat3x3 o_TBN;
+
+out gl_PerVertex
+{
+	vec4 gl_Position;
+};
+
+vec3 DecodeOctahedral(vec2 a_Encoded)
+{
+	vec3 v = vec3(a_Encoded, 1.0f - abs(a_Encoded.x) - abs(a_Encoded.y));
+
+	// Unfold the lower hemisphere
+	float fold = max(-v.z, 0.0f);
+	v.x += v.x >= 0.0f ? -fold : fold;
+	v.y += v.y >= 0.0f ? -fold : fold;
+
+	return normalize(v);
+}
+
+vec4 DecodeTangent(vec2 a_Encoded)
+{
+	float handedness = a_Encoded.y < 0.0f ? -1.0f : 1.0f;
+	vec2 octahedral = vec2(a_Encoded.x, abs(a_Encoded.y) * 2.0f - 1.0f);
+
+	return vec4(DecodeOctahedral(octahedral), handedness);
+}
+
+mat3x3 CalculateTBN(vec4 a_Tangent, vec3 a_Normal)
+{
+	mat4 mat = inverse(transpose(i_WorldMatrix));
+
+	// Transform the normal into world space
+	vec3 N = normalize(vec4(a_Normal, 0.0f) * mat).xyz;
+
+	// Transform the tangent into world space
+	vec3 T = normalize(vec4(a_Tangent.xyz, 0.0f) * mat).xyz;
+
+	vec3 B = cross(T, N) * a_Tangent.w;
+
+	return inverse(mat3x3(T, B, N));
+}
+
+void main()
+{
+	vec3 normal = DecodeOctahedral(i_Normal);
+	vec4 tangent = DecodeTangent(i_Tangent);
+
+	o_Tex = i_Tex;
+	o_Color = i_Color;
+	vec4 worldPosition = i_WorldMatrix * vec4(i_Pos, 1.0f);
+
+	o_WorldPosition = worldPosition.xyz;
+	o_Normal = normalize(vec4(normal, 0.0f) * inverse((i_WorldMatrix))).xyz;
+	o_TBN = CalculateTBN(tangent, normal);
+
+	gl_Position = u_Push.m_ViewProjection * worldPosition;
+}
@@ -2,10 +2,11 @@
 #pragma shader_stage(vertex)
 
 layout (location = 0) in vec3 i_Pos;
+layout (location = 5) in mat4 i_WorldMatrix; // Local to World, per instance
 
 layout(push_constant) uniform PushConstants 
 {
-	mat4 m_MVP; // Local to Clip
+	mat4 m_ViewProjection; // World to Clip
 } u_Push;
 
 out gl_PerVertex
@@ -15,5 +16,5 @@ out gl_PerVertex
 
 void main() 
 {
-	gl_Position = u_Push.m_MVP * vec4(i_Pos, 1.0f);
+	gl_Position = u_Push.m_ViewProjection * i_WorldMatrix * vec4(i_Pos, 1.0f);
 }
\ No newline at end of file
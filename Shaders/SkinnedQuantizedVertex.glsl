@@ -0,0 +1,103 @@
+#version 450
+#pragma shader_stage(vertex)
+
+// Vertex shader of skinned meshes with the quantized vertex layout, see SkinnedVertex.glsl and QuantizedVertex.glsl.
+
+layout (location = 0) in vec3 i_Pos;
+layout (location = 1) in vec2 i_Tex;
+layout (location = 2) in vec4 i_Color;
+layout (location = 3) in vec2 i_Normal;  // Octahedral
+layout (location = 4) in vec2 i_Tangent; // Octahedral, y holds (y * 0.5 + 0.5) * handedness
+layout (location = 5) in mat4 i_WorldMatrix; // Local to World, per instance
+layout (location = 9) in uint i_PaletteOffset; // First palette row of the joints of the instance
+layout (location = 10) in uvec4 i_Joints;
+layout (location = 11) in vec4 i_Weights;
+
+layout(push_constant) uniform PushConstants
+{
+	mat4 m_ViewProjection; // World to Clip
+} u_Push;
+
+// The first three rows of every joint matrix, see Skeleton::ComputePalette
+layout(set = 2, binding = 0) readonly buffer Palette
+{
+	vec4 m_Rows[];
+} u_Palette;
+
+layout (location = 1) out vec3 o_WorldPosition;
+layout (location = 0) out vec2 o_Tex;
+layout (location = 2) out vec4 o_Color;
+layout (location = 3) out vec3 o_Normal;
+layout (location = 4) out mat3x3 o_TBN;
+
+out gl_PerVertex
+{
+	vec4 gl_Position;
+};
+
+vec3 DecodeOctahedral(vec2 a_Encoded)
+{
+	vec3 v = vec3(a_Encoded, 1.0f - abs(a_Encoded.x) - abs(a_Encoded.y));
+
+	// Unfold the lower hemisphere
+	float fold = max(-v.z, 0.0f);
+	v.x += v.x >= 0.0f ? -fold : fold;
+	v.y += v.y >= 0.0f ? -fold : fold;
+
+	return normalize(v);
+}
+
+vec4 DecodeTangent(vec2 a_Encoded)
+{
+	float handedness = a_Encoded.y < 0.0f ? -1.0f : 1.0f;
+	vec2 octahedral = vec2(a_Encoded.x, abs(a_Encoded.y) * 2.0f - 1.0f);
+
+	return vec4(DecodeOctahedral(octahedral), handedness);
+}
+
+mat4 BlendJoints()
+{
+	vec4 rows[3] = vec4[3](vec4(0.0f), vec4(0.0f), vec4(0.0f));
+
+	for (int i = 0; i < 4; i++)
+	{
+		uint first = i_PaletteOffset + i_Joints[i] * 3;
+		rows[0] += u_Palette.m_Rows[first + 0] * i_Weights[i];
+		rows[1] += u_Palette.m_Rows[first + 1] * i_Weights[i];
+		rows[2] += u_Palette.m_Rows[first + 2] * i_Weights[i];
+	}
+
+	return transpose(mat4(rows[0], rows[1], rows[2], vec4(0.0f, 0.0f, 0.0f, 1.0f)));
+}
+
+mat3x3 CalculateTBN(mat4 a_Model, vec4 a_Tangent, vec3 a_Normal)
+{
+	mat4 mat = inverse(transpose(a_Model));
+
+	// Transform the normal into world space
+	vec3 N = normalize(vec4(a_Normal, 0.0f) * mat).xyz;
+
+	// Transform the tangent into world space
+	vec3 T = normalize(vec4(a_Tangent.xyz, 0.0f) * mat).xyz;
+
+	vec3 B = cross(T, N) * a_Tangent.w;
+
+	return inverse(mat3x3(T, B, N));
+}
+
+void main()
+{
+	vec3 normal = DecodeOctahedral(i_Normal);
+	vec4 tangent = DecodeTangent(i_Tangent);
+	mat4 model = i_WorldMatrix * BlendJoints();
+
+	o_Tex = i_Tex;
+	o_Color = i_Color;
+	vec4 worldPosition = model * vec4(i_Pos, 1.0f);
+
+	o_WorldPosition = worldPosition.xyz;
+	o_Normal = normalize(vec4(normal, 0.0f) * inverse(model)).xyz;
+	o_TBN = CalculateTBN(model, tangent, normal);
+
+	gl_Position = u_Push.m_ViewProjection * worldPosition;
+}
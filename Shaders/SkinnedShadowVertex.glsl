@@ -0,0 +1,41 @@
+#version 450
+#pragma shader_stage(vertex)
+
+layout (location = 0) in vec3 i_Pos;
+layout (location = 5) in mat4 i_WorldMatrix; // Local to World, per instance
+layout (location = 9) in uint i_PaletteOffset; // First palette row of the joints of the instance
+layout (location = 10) in uvec4 i_Joints;
+layout (location = 11) in vec4 i_Weights;
+
+layout(push_constant) uniform PushConstants 
+{
+	mat4 m_ViewProjection; // World to Clip
+} u_Push;
+
+// The first three rows of every joint matrix, see Skeleton::ComputePalette.
+// The shadow pipeline has no other descriptor sets, so the palette is in the first one.
+layout(set = 0, binding = 0) readonly buffer Palette
+{
+	vec4 m_Rows[];
+} u_Palette;
+
+out gl_PerVertex
+{
+	vec4 gl_Position;
+};
+
+void main() 
+{
+	vec4 position = vec4(i_Pos, 1.0f);
+	vec3 skinned = vec3(0.0f);
+
+	for (int i = 0; i < 4; i++)
+	{
+		uint first = i_PaletteOffset + i_Joints[i] * 3;
+		skinned.x += dot(u_Palette.m_Rows[first + 0], position) * i_Weights[i];
+		skinned.y += dot(u_Palette.m_Rows[first + 1], position) * i_Weights[i];
+		skinned.z += dot(u_Palette.m_Rows[first + 2], position) * i_Weights[i];
+	}
+
+	gl_Position = u_Push.m_ViewProjection * i_WorldMatrix * vec4(skinned, 1.0f);
+}
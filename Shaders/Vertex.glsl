@@ -6,12 +6,11 @@ layout (location = 1) in vec2 i_Tex;
 layout (location = 2) in vec4 i_Color;
 layout (location = 3) in vec3 i_Normal;
 layout (location = 4) in vec4 i_Tangent;
+layout (location = 5) in mat4 i_WorldMatrix; // Local to World, per instance
 
 layout(push_constant) uniform PushConstants 
 {
-	mat4 m_WorldMatrix; // Local to View 
-
-	mat4 m_MVP; // Local to Clip
+	mat4 m_ViewProjection; // World to Clip
 } u_Push;
 
 layout (location = 1) out vec3 o_WorldPosition;
@@ -28,7 +27,7 @@ out gl_PerVertex
 mat3x3 CalculateTBN(vec4 a_Tangent, vec3 a_Normal)
 {
 
-	mat4 mat = inverse(transpose(u_Push.m_WorldMatrix));
+	mat4 mat = inverse(transpose(i_WorldMatrix));
 
 	// Transform the normal into world space
 	vec3 N = normalize(vec4(a_Normal, 0.0f) * mat).xyz;
@@ -52,9 +51,11 @@ void main()
 {
 	o_Tex = i_Tex;
 	o_Color = i_Color;
-	o_WorldPosition = (u_Push.m_WorldMatrix * vec4(i_Pos, 1.0f)).xyz;
-	o_Normal = normalize(vec4(i_Normal, 0.0f) * inverse((u_Push.m_WorldMatrix))).xyz;
+	vec4 worldPosition = i_WorldMatrix * vec4(i_Pos, 1.0f);
+
+	o_WorldPosition = worldPosition.xyz;
+	o_Normal = normalize(vec4(i_Normal, 0.0f) * inverse((i_WorldMatrix))).xyz;
 	o_TBN = CalculateTBN(i_Tangent, i_Normal);
 
-	gl_Position = u_Push.m_MVP * vec4(i_Pos, 1.0f);
+	gl_Position = u_Push.m_ViewProjection * worldPosition;
 }
\ No newline at end of file